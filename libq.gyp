@@ -12,6 +12,12 @@
     ],
     'sources': [
       'src/backends/simulators/cppkernels/Wrapper.cpp',
+      'src/backends/simulators/cppkernels/StabilizerWrapper.cpp',
+      'src/backends/simulators/cppkernels/MPSWrapper.cpp',
+      'src/backends/simulators/cppkernels/ReversibleWrapper.cpp',
+      'src/backends/simulators/cppkernels/BatchWrapper.cpp',
+      'src/backends/simulators/cppkernels/PoolWrapper.cpp',
+      'src/backends/simulators/cppkernels/CompiledWrapper.cpp',
       'src/backends/simulators/cppkernels/2dmapper.cpp'
     ],
     'cflags': [
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import { expect } from 'chai'
+import { MainEngine } from '@/cengines/main'
+import CPPSimulatorBackend from '@/backends/simulators/cppsim'
+import { BatchSimulator } from '@/backends/simulators/batchsimulator'
+import { Simulator } from '@/backends/simulators/simulator'
+import BatchedGate from '@/ops/batchedgate'
+import QubitOperator from '@/ops/qubitoperator'
+import { H, Measure, Rx, Ry } from '@/ops/gates'
+import { All } from '@/ops/metagates'
+import { CNOT } from '@/ops/shortcuts'
+import { tuple } from '@/libs/util'
+
+const native = CPPSimulatorBackend && CPPSimulatorBackend.BatchSimulator
+const itNative = native ? it : it.skip
+
+describe('batch simulator test', () => {
+  it('should test_batched_gate', () => {
+    const gate = new BatchedGate([new Rx(0.1), new Rx(0.2)])
+    expect(gate.equal(new BatchedGate([new Rx(0.1), new Rx(0.2)]))).to.equal(true)
+    expect(gate.equal(new BatchedGate([new Rx(0.1)]))).to.equal(false)
+    expect(gate.getInverse().equal(new BatchedGate([new Rx(-0.1), new Rx(-0.2)]))).to.equal(true)
+    expect(() => new BatchedGate([])).to.throw()
+  })
+
+  itNative('should test_batch_matches_simulator', () => {
+    const angles = [0, 0.3, 1.2, 2.5, Math.PI]
+    const sim = new BatchSimulator(angles.length, 1)
+    const eng = new MainEngine(sim, [])
+    const qureg = eng.allocateQureg(3)
+    H.or(qureg[2])
+    new BatchedGate(angles.map(theta => new Ry(theta))).or(qureg[0])
+    CNOT.or(tuple(qureg[0], qureg[1]))
+    new BatchedGate(angles.map(theta => new Rx(2 * theta))).or(qureg[1])
+    eng.flush()
+    const op = new QubitOperator('Z0 Z1', 0.5).add(new QubitOperator('X1'))
+    const values = sim.getExpectationValues(op, qureg)
+    const probabilities = sim.getProbabilities('10', qureg.slice(0, 2))
+
+    angles.forEach((theta, b) => {
+      const dense = new Simulator(false, 1)
+      const deng = new MainEngine(dense, [])
+      const dreg = deng.allocateQureg(3)
+      H.or(dreg[2])
+      new Ry(theta).or(dreg[0])
+      CNOT.or(tuple(dreg[0], dreg[1]))
+      new Rx(2 * theta).or(dreg[1])
+      deng.flush()
+      expect(values[b]).to.be.closeTo(dense.getExpectationValue(op, dreg), 1e-12)
+      expect(probabilities[b]).to.be.closeTo(dense.getProbability('10', dreg.slice(0, 2)), 1e-12)
+      new All(Measure).or(dreg)
+    })
+    new All(Measure).or(qureg)
+  })
+
+  itNative('should test_batch_measurement', () => {
+    const sim = new BatchSimulator(4, 1)
+    const eng = new MainEngine(sim, [])
+    const qureg = eng.allocateQureg(2)
+    new BatchedGate([0, Math.PI, 0, Math.PI].map(theta => new Rx(theta))).or(qureg[0])
+    CNOT.or(tuple(qureg[0], qureg[1]))
+    new All(Measure).or(qureg)
+    eng.flush()
+    expect(sim.getMeasurementResults(qureg[0])).to.deep.equal([false, true, false, true])
+    expect(sim.getMeasurementResults(qureg[1])).to.deep.equal([false, true, false, true])
+    expect(qureg[0].toBoolean()).to.equal(false)
+  })
+})
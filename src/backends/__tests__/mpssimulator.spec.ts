@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import { expect } from 'chai'
+import { MainEngine } from '@/cengines/main'
+import { DummyEngine } from '@/cengines/testengine'
+import { LinearMapper } from '@/cengines/linearmapper'
+import CPPSimulatorBackend from '@/backends/simulators/cppsim'
+import { MPSSimulator } from '@/backends/simulators/mpssimulator'
+import { Simulator } from '@/backends/simulators/simulator'
+import {
+  H, Measure, Rx, Ry, Rz
+} from '@/ops/gates'
+import { All } from '@/ops/metagates'
+import { CNOT, Toffoli } from '@/ops/shortcuts'
+import { tuple } from '@/libs/util'
+
+const native = CPPSimulatorBackend && CPPSimulatorBackend.MPSSimulator
+const itNative = native ? it : it.skip
+
+describe('mps simulator test', () => {
+  itNative('should test_mps_is_available', () => {
+    const sim = new MPSSimulator(8, 1)
+    const backend = new DummyEngine(true)
+    const eng = new MainEngine(backend, [sim])
+    const qubits = eng.allocateQureg(3)
+    CNOT.or(tuple(qubits[0], qubits[1]))
+    Toffoli.or(tuple(qubits[0], qubits[1], qubits[2]))
+    const available = backend.receivedCommands.map(cmd => sim.isAvailable(cmd))
+    expect(available).to.deep.equal([true, true, true, true, false])
+  })
+
+  itNative('should test_mps_ghz_chain', () => {
+    const n = 60
+    const sim = new MPSSimulator(4, 1)
+    const eng = new MainEngine(sim, [new LinearMapper(n)])
+    const qureg = eng.allocateQureg(n)
+    H.or(qureg[0])
+    for (let i = 1; i < n; ++i) {
+      CNOT.or(tuple(qureg[i - 1], qureg[i]))
+    }
+    eng.flush()
+    expect(Math.max(...sim.bondDimensions())).to.equal(2)
+    expect(sim.truncationError()).to.be.closeTo(0, 1e-12)
+    new All(Measure).or(qureg)
+    eng.flush()
+    const first = qureg[0].toBoolean()
+    qureg.forEach(qb => expect(qb.toBoolean()).to.equal(first))
+  })
+
+  itNative('should test_mps_matches_simulator', () => {
+    const mps = new MPSSimulator(16, 1)
+    const dense = new Simulator(false, 1)
+    const engs = [new MainEngine(mps, []), new MainEngine(dense, [])]
+    const regs = engs.map(eng => eng.allocateQureg(4))
+    regs.forEach((qureg) => {
+      new Ry(0.3).or(qureg[0])
+      H.or(qureg[1])
+      new Rx(1.1).or(qureg[2])
+      CNOT.or(tuple(qureg[0], qureg[1]))
+      CNOT.or(tuple(qureg[1], qureg[3]))
+      new Rz(0.7).or(qureg[3])
+      CNOT.or(tuple(qureg[3], qureg[0]))
+    })
+    engs.forEach(eng => eng.flush())
+    for (let i = 0; i < 16; ++i) {
+      const bits = [0, 1, 2, 3].map(k => String((i >> k) & 1)).join('')
+      const a = mps.getAmplitude(bits, regs[0])
+      const b = dense.getAmplitude(bits, regs[1])
+      expect(a.re).to.be.closeTo(b.re, 1e-12)
+      expect(a.im).to.be.closeTo(b.im, 1e-12)
+    }
+    expect(mps.truncationError()).to.be.closeTo(0, 1e-12)
+  })
+
+  itNative('should test_mps_truncation_error', () => {
+    const sim = new MPSSimulator(1, 1)
+    const eng = new MainEngine(sim, [])
+    const qureg = eng.allocateQureg(2)
+    new Ry(0.5).or(qureg[0])
+    CNOT.or(tuple(qureg[0], qureg[1]))
+    eng.flush()
+    // cos(1/4)|00> + sin(1/4)|11> truncated to its larger Schmidt vector
+    expect(sim.bondDimensions()).to.deep.equal([1])
+    expect(sim.truncationError()).to.be.closeTo(Math.sin(0.25) ** 2, 1e-12)
+    expect(sim.getAmplitude('00', qureg).re).to.be.closeTo(1, 1e-12)
+    new All(Measure).or(qureg)
+  })
+})
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import { expect } from 'chai'
+import fs from 'fs'
+import os from 'os'
+import path from 'path'
+import { MainEngine } from '@/cengines/main'
+import CPPSimulatorBackend from '@/backends/simulators/cppsim'
+import { ParametrizedCircuit } from '@/backends/simulators/parametrizedcircuit'
+import { Simulator } from '@/backends/simulators/simulator'
+import QubitOperator from '@/ops/qubitoperator'
+import TimeEvolution from '@/ops/timeevolution'
+import { H, Measure, Ph, R, Rx, Ry, Rz, X } from '@/ops/gates'
+import { Control } from '@/meta/control'
+import { tuple } from '@/libs/util'
+
+const native = CPPSimulatorBackend && CPPSimulatorBackend.Simulator
+const itNative = native ? it : it.skip
+
+const hamiltonian = new QubitOperator('Z0 Z1', 0.7).add(new QubitOperator('X2', -0.4)).add(new QubitOperator('Y0 X1', 1.1))
+
+// the circuit of the gradient test, applied with regular gates
+function prepare(params: number[]) {
+  const sim = new Simulator(false, 1)
+  const eng = new MainEngine(sim, [])
+  const qureg = eng.allocateQureg(3)
+  qureg.forEach(qb => H.or(qb))
+  new Ry(params[0]).or(qureg[0])
+  X.or(tuple(qureg[0], qureg[1]))
+  Control(eng, qureg[2], () => new Rz(2 * params[1]).or(qureg[1]))
+  new TimeEvolution(params[2], new QubitOperator('Z0 Z1')).or(qureg.slice(0, 2))
+  Control(eng, qureg[0], () => new R(params[0]).or(qureg[2]))
+  Control(eng, qureg[1], () => new Ph(-params[1]).or(qureg[2]))
+  new Rx(0.3).or(qureg[1])
+  eng.flush()
+  return sim.getExpectationValue(hamiltonian, qureg)
+}
+
+describe('parametrized circuit test', () => {
+  it('should test_recording', () => {
+    const eng = new MainEngine(new Simulator(), [])
+    const qureg = eng.allocateQureg(2)
+    const circuit = new ParametrizedCircuit()
+    circuit.rotate('Ry', 2, qureg[0]).apply(X, qureg[1], [qureg[0]])
+    expect(circuit.numParameters).to.equal(3)
+    expect(circuit.gates.length).to.equal(2)
+    expect(() => circuit.rotate('Rx', -1, qureg[0])).to.throw()
+    expect(() => circuit.apply(X, [qureg[0], qureg[1]])).to.throw()
+  })
+
+  itNative('should test_gradient_matches_finite_differences', () => {
+    const params = [0.4, -1.3, 0.8]
+    const sim = new Simulator(false, 1)
+    const eng = new MainEngine(sim, [])
+    const qureg = eng.allocateQureg(3)
+    qureg.forEach(qb => H.or(qb))
+    eng.flush()
+
+    const circuit = new ParametrizedCircuit()
+    circuit.rotate('Ry', 0, qureg[0])
+      .apply(X, qureg[1], [qureg[0]])
+      .rotate('Rz', 1, qureg[1], [qureg[2]], 2)
+      .evolve([[0, 'Z'], [1, 'Z']], 2, [qureg[0], qureg[1]])
+      .rotate('R', 0, qureg[2], [qureg[0]])
+      .rotate('Ph', 1, qureg[2], [qureg[1]], -1)
+      .apply(new Rx(0.3), qureg[1])
+    const { value, gradient } = sim.getExpectationGradient(circuit, params, hamiltonian, qureg)
+
+    expect(value).to.be.closeTo(prepare(params), 1e-10)
+    const eps = 1e-5
+    params.forEach((_, i) => {
+      const plus = params.slice(0)
+      const minus = params.slice(0)
+      plus[i] += eps
+      minus[i] -= eps
+      expect(gradient[i]).to.be.closeTo((prepare(plus) - prepare(minus)) / (2 * eps), 1e-6)
+    })
+    // the state of the simulator is left unchanged
+    expect(sim.getProbability('000', qureg)).to.be.closeTo(1 / 8, 1e-12)
+  })
+
+  itNative('should test_compiled_replay', () => {
+    const sim = new Simulator(false, 1)
+    const eng = new MainEngine(sim, [])
+    const qureg = eng.allocateQureg(3)
+    eng.flush()
+
+    const circuit = new ParametrizedCircuit()
+    qureg.forEach(qb => circuit.apply(H, qb))
+    circuit.rotate('Ry', 0, qureg[0])
+      .apply(X, qureg[1], [qureg[0]])
+      .rotate('Rz', 1, qureg[1], [qureg[2]], 2)
+      .evolve([[0, 'Z'], [1, 'Z']], 2, [qureg[0], qureg[1]])
+      .rotate('R', 0, qureg[2], [qureg[0]])
+      .rotate('Ph', 1, qureg[2], [qureg[1]], -1)
+      .apply(new Rx(0.3), qureg[1])
+    const compiled = sim.compile(circuit, [0, 0, 0])
+    expect(compiled.numParameters).to.equal(3)
+    expect(compiled.numBlocks).to.be.at.least(1)
+
+    const sets = [[0.4, -1.3, 0.8], [0.4, -1.3, 0.8], [1.1, -1.3, 0.8], [0.2, 0.5, -2.0]]
+    sets.forEach((params) => {
+      sim.applyCompiled(compiled, params, true)
+      expect(sim.getExpectationValue(hamiltonian, qureg)).to.be.closeTo(prepare(params), 1e-10)
+    })
+  })
+  itNative('should test_compiled_fusion_width', () => {
+    const sim = new Simulator(false, 1)
+    const eng = new MainEngine(sim, [])
+    const qureg = eng.allocateQureg(6)
+    eng.flush()
+
+    // with the default costs, a 5-qubit sweep costs as much as two narrower
+    // ones, so five single-qubit gates fuse into one block of 5 qubits
+    const five = new ParametrizedCircuit()
+    qureg.slice(0, 5).forEach(qb => five.apply(H, qb))
+    expect(sim.compile(five).numBlocks).to.equal(1)
+
+    const six = new ParametrizedCircuit()
+    qureg.forEach(qb => six.apply(H, qb))
+    expect(sim.compile(six).numBlocks).to.equal(2)
+
+    sim.applyCompiled(sim.compile(five), [], true)
+    qureg.slice(0, 5).forEach(qb => H.or(qb))
+    eng.flush()
+    expect(sim.getProbability('00000', qureg.slice(0, 5))).to.be.closeTo(1, 1e-12)
+  })
+  itNative('should test_compiled_save_load', () => {
+    const sim = new Simulator(false, 1)
+    const eng = new MainEngine(sim, [])
+    const qureg = eng.allocateQureg(3)
+    eng.flush()
+
+    sim.startRecording()
+    X.or(qureg[0])
+    X.or(tuple(qureg[0], qureg[1]))
+    Measure.or(qureg[1])
+    H.or(qureg[2])
+    new Ry(0.7).or(qureg[0])
+    new TimeEvolution(0.4, new QubitOperator('Z0 X2', 1.5)).or(qureg)
+    eng.flush()
+    const recorded = sim.stopRecording()
+    const expected = sim.getExpectationValue(hamiltonian, qureg)
+
+    const file = path.join(os.tmpdir(), `qjs-compiled-${process.pid}.bin`)
+    recorded.save(file)
+
+    const sim2 = new Simulator(false, 1)
+    const eng2 = new MainEngine(sim2, [])
+    const qureg2 = eng2.allocateQureg(3)
+    eng2.flush()
+    const loaded = sim2.loadCompiled(file)
+    expect(loaded.numBlocks).to.equal(recorded.numBlocks)
+    expect(sim2.applyCompiled(loaded, [], true)).to.deep.equal([true])
+    expect(sim2.getExpectationValue(hamiltonian, qureg2)).to.be.closeTo(expected, 1e-12)
+  })
+  itNative('should test_compiled_load_rejects_bad_pauli_term', () => {
+    const sim = new Simulator(false, 1)
+    const eng = new MainEngine(sim, [])
+    const qureg = eng.allocateQureg(2)
+    eng.flush()
+
+    sim.startRecording()
+    new TimeEvolution(0.4, new QubitOperator('Z0 X1')).or(qureg)
+    eng.flush()
+    const file = path.join(os.tmpdir(), `qjs-pauli-${process.pid}.bin`)
+    sim.stopRecording().save(file)
+
+    // the term is stored as (index into the gate's qubits, operator char)
+    const data = fs.readFileSync(file)
+    const at = data.indexOf(Buffer.from([1, 0, 0, 0, 'X'.charCodeAt(0), 0, 0, 0]))
+    expect(at).to.be.above(0)
+    data[at + 4] = 'Q'.charCodeAt(0)
+    fs.writeFileSync(file, data)
+    expect(() => sim.loadCompiled(file)).to.throw(/Pauli term/)
+    data[at + 4] = 'X'.charCodeAt(0)
+    data[at] = 2
+    fs.writeFileSync(file, data)
+    expect(() => sim.loadCompiled(file)).to.throw(/Pauli term/)
+  })
+})
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import { expect } from 'chai'
+import { MainEngine } from '@/cengines/main'
+import CPPSimulatorBackend from '@/backends/simulators/cppsim'
+import { ReversibleSimulator } from '@/backends/simulators/reversiblesimulator'
+import { Measure, Swap, X } from '@/ops/gates'
+import { All, C } from '@/ops/metagates'
+import { BasicMathGate } from '@/ops/basics'
+import { AddConstant, MultiplyByConstantModN } from '@/libs/math/gates'
+import { CNOT, Toffoli } from '@/ops/shortcuts'
+import { tuple } from '@/libs/util'
+
+const native = CPPSimulatorBackend && CPPSimulatorBackend.ReversibleSimulator
+const itNative = native ? it : it.skip
+
+describe('reversible simulator test', () => {
+  itNative('should test_reversible_triangle_increment_cycle', () => {
+    const sim = new ReversibleSimulator()
+    const eng = new MainEngine(sim, [])
+    const a = eng.allocateQureg(6)
+    for (let t = 0; t < 1 << 6; ++t) {
+      eng.flush()
+      expect(sim.readRegister(a)).to.equal(t)
+      for (let i = 5; i >= 0; --i) {
+        C(X, i).or(tuple(a.slice(0, i), a[i]))
+      }
+    }
+    eng.flush()
+    expect(sim.readRegister(a)).to.equal(0)
+  })
+
+  itNative('should test_reversible_ripple_adder_all_inputs', () => {
+    // b += a with a Cuccaro-style ripple of Toffolis, checked on all 2^8 inputs
+    const n = 4
+    const patterns = 1 << (2 * n)
+    const sim = new ReversibleSimulator(patterns)
+    const eng = new MainEngine(sim, [])
+    const a = eng.allocateQureg(n)
+    const b = eng.allocateQureg(n + 1)
+    const carry = eng.allocateQureg(n + 1)
+    const inputs = [...Array(patterns).keys()]
+    sim.writeRegisterPatterns(a, inputs.map(p => p & ((1 << n) - 1)))
+    sim.writeRegisterPatterns(b, inputs.map(p => p >> n))
+    for (let i = 0; i < n; ++i) {
+      Toffoli.or(tuple(a[i], b[i], carry[i + 1]))
+      CNOT.or(tuple(a[i], b[i]))
+      Toffoli.or(tuple(carry[i], b[i], carry[i + 1]))
+      CNOT.or(tuple(carry[i], b[i]))
+    }
+    CNOT.or(tuple(carry[n], b[n]))
+    eng.flush()
+    const sums = sim.readRegisterPatterns(b)
+    inputs.forEach(p => expect(sums[p]).to.equal((p & ((1 << n) - 1)) + (p >> n)))
+  })
+
+  itNative('should test_reversible_math_and_swap', () => {
+    const patterns = 100
+    const sim = new ReversibleSimulator(patterns)
+    const eng = new MainEngine(sim, [])
+    const a = eng.allocateQureg(7)
+    const b = eng.allocateQureg(7)
+    const ctrl = eng.allocateQubit()
+    const inputs = [...Array(patterns).keys()]
+    sim.writeRegisterPatterns(a, inputs)
+    sim.writeRegisterPatterns(ctrl, inputs.map(p => p & 1))
+    new AddConstant(5).or(a)
+    C(new MultiplyByConstantModN(3, 109)).or(tuple(ctrl, a))
+    Swap.or(tuple(a[0], b[0]))
+    const plus2 = new BasicMathGate(([x]: number[]) => [x + 2])
+    plus2.or(b)
+    eng.flush()
+    const outA = sim.readRegisterPatterns(a)
+    const outB = sim.readRegisterPatterns(b)
+    inputs.forEach((p) => {
+      let x = (p + 5) & 127
+      if (p & 1) {
+        x = (3 * x) % 109
+      }
+      expect(outA[p]).to.equal(x & ~1)
+      expect(outB[p]).to.equal((x & 1) + 2)
+    })
+    new All(Measure).or(a)
+    eng.flush()
+    expect(a.map(qb => Number(qb.toBoolean()))).to.deep.equal([0, 0, 1, 0, 0, 0, 0])
+  })
+})
@@ -14,9 +14,38 @@
  * limitations under the License.
  */
 
+import { expect } from 'chai'
+import * as math from 'mathjs'
+import { Matrix, Complex } from 'mathjs'
 import { BasicMapperEngine } from '@/cengines/basicmapper';
 import { ICommand } from '@/interfaces';
 
+export function getMatrixValue(m: Matrix, idx: number): Complex {
+  let v
+  if (m.subset) {
+    v = m.subset(math.index(idx))
+  } else {
+    v = m[idx]
+  }
+  if (typeof v === 'number') {
+    v = math.complex(v, 0)
+  }
+  return v
+}
+
+/**
+ * Expects the first `count` amplitudes of two state vectors (as returned by
+ * Simulator.cheat()) to agree up to `tolerance`.
+ */
+export function expectStatesClose(actual: any, expected: any, count: number, tolerance: number = 1e-12) {
+  for (let i = 0; i < count; ++i) {
+    const a = getMatrixValue(actual, i)
+    const b = getMatrixValue(expected, i)
+    expect(a.re, `real part of amplitude ${i}`).to.be.closeTo(b.re, tolerance)
+    expect(a.im, `imaginary part of amplitude ${i}`).to.be.closeTo(b.im, tolerance)
+  }
+}
+
 export class TrivialMapper extends BasicMapperEngine {
   constructor() {
     super()
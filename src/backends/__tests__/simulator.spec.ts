@@ -16,15 +16,18 @@
 
 import { expect } from 'chai'
 import * as math from 'mathjs'
-import { Matrix, Complex, zeros, identity } from 'mathjs'
-import { TrivialMapper } from './shared'
+import { Complex, zeros, identity } from 'mathjs'
+import { TrivialMapper, getMatrixValue, expectStatesClose } from './shared'
 import { BasicGate, BasicMathGate } from '@/ops/basics'
 import { DummyEngine } from '@/cengines/testengine';
 import { MainEngine } from '@/cengines/main';
 import {
   Allocate, H, Measure, X, Y, Rx, Ry, Rz, Z, S
 } from '@/ops/gates';
-import { Simulator } from '@/backends/simulators/simulator'
+import {
+  Simulator, nativeMathDescriptor, pauliTermsCommute, qftDirection
+} from '@/backends/simulators/simulator'
+import { AddConstant, AddConstantModN, MultiplyByConstantModN } from '@/libs/math/gates';
 import { len } from '@/libs/polyfill';
 import { CNOT, Toffoli } from '@/ops/shortcuts';
 import { tuple } from '@/libs/util';
@@ -39,21 +42,16 @@ import { LocalOptimizer } from '@/cengines/optimize';
 import QubitOperator, { stringToArray } from '@/ops/qubitoperator';
 import { BasicMapperEngine } from '@/cengines/basicmapper'
 import TimeEvolution from '@/ops/timeevolution';
+import { QFT } from '@/ops/qftgate';
+import qft2crandhadamard from '@/setups/decompositions/qft2crandhadamard';
+import { DecompositionRuleSet } from '@/cengines/replacer/decompositionruleset';
+import { AutoReplacer, InstructionFilter } from '@/cengines/replacer/replacer';
+import { UniformlyControlledRy, UniformlyControlledRz } from '@/ops/uniformly_controlled_rotation';
+import { StatePreparation } from '@/ops/statepreparation';
+import { PhaseOracle } from '@/ops/phaseoracle';
+import CPPSimulatorBackend from '@/backends/simulators/cppsim';
 import { ICommand } from '@/interfaces';
 
-function getMatrixValue(m: Matrix, idx: number): Complex {
-  let v
-  if (m.subset) {
-    v = m.subset(math.index(idx))
-  } else {
-    v = m[idx]
-  }
-  if (typeof v === 'number') {
-    v = math.complex(v, 0)
-  }
-  return v
-}
-
 class Mock1QubitGate extends BasicGate {
   cnt: number;
   constructor() {
@@ -80,6 +78,12 @@ class Mock6QubitGate extends BasicGate {
   }
 }
 
+class Mock11QubitGate extends BasicGate {
+  get matrix() {
+    return math.identity(2 ** 11, 'sparse')
+  }
+}
+
 class MockNoMatrixGate extends BasicGate {
   cnt: number;
   constructor() {
@@ -107,6 +111,9 @@ function convertNativeMatrix(vec) {
   return m
 }
 
+const native = CPPSimulatorBackend && CPPSimulatorBackend.Simulator
+const itNative = native ? it : it.skip
+
 const settings = [
   ['CPP Simulator Test', false, null, false],
   ['JS Simulator Test', false, null, true]
@@ -135,10 +142,14 @@ settings.forEach(([testName, gate_fusion, rndSeed, forceSimulation]) => {
       expect(sim.isAvailable(new_cmd)).to.equal(true)
       expect(new_cmd.gate.cnt).to.equal(1)
 
+      // the C++ simulator applies up to 10-qubit gates
       new_cmd.gate = new Mock6QubitGate()
-      expect(sim.isAvailable(new_cmd)).to.equal(false)
+      expect(sim.isAvailable(new_cmd)).to.equal(!!native && !forceSimulation)
       expect(new_cmd.gate.cnt).to.equal(1)
 
+      new_cmd.gate = new Mock11QubitGate()
+      expect(sim.isAvailable(new_cmd)).to.equal(false)
+
       new_cmd.gate = new MockNoMatrixGate()
 
       expect(sim.isAvailable(new_cmd)).to.equal(false)
@@ -233,6 +244,50 @@ settings.forEach(([testName, gate_fusion, rndSeed, forceSimulation]) => {
       new All(Measure).or(tuple(qubit1.concat(qubit2).concat(qubit3)))
     });
 
+    it('should test_simulator_native_math_emulation', () => {
+      expect(nativeMathDescriptor(new AddConstant(3))).to.deep.equal([0, 3, 0])
+      expect(nativeMathDescriptor(new MultiplyByConstantModN(2, 5))).to.deep.equal([2, 2, 5])
+      expect(nativeMathDescriptor(new Plus2Gate())).to.equal(undefined)
+
+      const sim = new Simulator(gate_fusion, rndSeed, forceSimulation)
+      const eng = new MainEngine(sim, [])
+      const qureg = eng.allocateQureg(3)
+      const ctrl = eng.allocateQubit()
+
+      new AddConstant(3).or(qureg)
+      Control(eng, ctrl, () => new AddConstant(1).or(qureg))
+      let v = getMatrixValue(sim.cheat()[1], 3)
+      expect(v.re).to.equal(1)
+
+      X.or(ctrl)
+      Control(eng, ctrl, () => new MultiplyByConstantModN(2, 5).or(qureg))
+      new AddConstantModN(4, 5).or(qureg)
+      // (2 * 3) mod 5 = 1, (1 + 4) mod 5 = 0
+      v = getMatrixValue(sim.cheat()[1], 8)
+      expect(v.re).to.equal(1)
+
+      new All(Measure).or(tuple(qureg.concat(ctrl)))
+    });
+
+    it('should test_simulator_native_math_negative_constant', () => {
+      // (a * x) % N keeps the sign of a * x, the register holds its low bits
+      for (let x = 0; x < 8; ++x) {
+        const sim = new Simulator(gate_fusion, rndSeed, forceSimulation)
+        const eng = new MainEngine(sim, [])
+        const qureg = eng.allocateQureg(3)
+        for (let i = 0; i < 3; ++i) {
+          if ((x >> i) & 1) {
+            X.or(qureg[i])
+          }
+        }
+        new MultiplyByConstantModN(-3, 5).or(qureg)
+        eng.flush()
+        const v = getMatrixValue(sim.cheat()[1], ((-3 * x) % 5) & 7)
+        expect(v.re).to.be.closeTo(1, 1e-12)
+        new All(Measure).or(qureg)
+      }
+    });
+
     it('should test_simulator_kqubit_gate', () => {
       const sim = new Simulator(gate_fusion, rndSeed, forceSimulation)
       const m1 = new Rx(0.3).matrix
@@ -456,6 +511,28 @@ settings.forEach(([testName, gate_fusion, rndSeed, forceSimulation]) => {
       expect(() => sim.getExpectationValue(op3, qureg)).to.throw()
     });
 
+    it('should test_simulator_prepared_observable', () => {
+      const sim = new Simulator(gate_fusion, rndSeed, forceSimulation)
+      const eng = new MainEngine(sim, [])
+      const qureg = eng.allocateQureg(4)
+      const op = new QubitOperator('Y0 X1 Z2', 0.5).add(new QubitOperator('X1', -1.5))
+        .add(new QubitOperator('Z0 Z3', 0.25)).add(new QubitOperator([], 0.4))
+      const prepared = sim.prepareObservable(op)
+      expect(prepared.numQubits).to.equal(4)
+      expect(prepared.numTerms).to.equal(4)
+      const reversed = qureg.slice().reverse()
+      for (let i = 0; i < 3; ++i) {
+        new Rx(0.3 + i).or(qureg[i])
+        H.or(qureg[i + 1])
+        CNOT.or(tuple(qureg[i], qureg[3]))
+        eng.flush()
+        // same qubits in another order as well, which moves the terms
+        expect(sim.getExpectationValue(prepared, qureg)).to.be.closeTo(sim.getExpectationValue(op, qureg), 1e-12)
+        expect(sim.getExpectationValue(prepared, reversed)).to.be.closeTo(sim.getExpectationValue(op, reversed), 1e-12)
+      }
+      expect(() => sim.getExpectationValue(prepared, qureg.slice(0, 3))).to.throw()
+    });
+
     it('should test_simulator_applyqubitoperator_exception', () => {
       const sim = new Simulator(gate_fusion, rndSeed, forceSimulation)
       const eng = new MainEngine(sim, [])
@@ -603,6 +680,12 @@ settings.forEach(([testName, gate_fusion, rndSeed, forceSimulation]) => {
       expect(math.deepEqual(head, math.multiply(hadamard_f, init_wavefunction))).to.equal(true)
     });
 
+    it('should test_pauli_terms_commute', () => {
+      expect(pauliTermsCommute([[[0, 'X'], [1, 'X']], [[0, 'Z'], [1, 'Z']]])).to.equal(true)
+      expect(pauliTermsCommute([[[0, 'X']], [[0, 'Z'], [1, 'Z']]])).to.equal(false)
+      expect(pauliTermsCommute([[[0, 'Y']], [[1, 'X']], []])).to.equal(true)
+    });
+
     it('should test_simulator_set_wavefunction', () => {
       const mp = new TrivialMapper()
 
@@ -791,6 +874,30 @@ settings.forEach(([testName, gate_fusion, rndSeed, forceSimulation]) => {
       new All(Measure).or(qubits)
     });
 
+    it('should test_simulator_qft', () => {
+      const rule_set = new DecompositionRuleSet(qft2crandhadamard)
+      // QFT on qubits 1..4, its inverse on 0..2 and a controlled QFT on 2..5
+      const apply = (sim: Simulator, engines: any[]) => {
+        const eng = new MainEngine(sim, engines)
+        const qureg = eng.allocateQureg(6)
+        qureg.forEach((qb, i) => {
+          new Rx(0.3 + i).or(qb)
+          new Ry(1.7 * i).or(qb)
+        })
+        QFT.or(qureg.slice(1, 5))
+        Dagger(eng, () => QFT.or(qureg.slice(0, 3)))
+        Control(eng, qureg[0], () => QFT.or(qureg.slice(2)))
+        eng.flush()
+        return sim.cheat()[1]
+      }
+      const sim = new Simulator(gate_fusion as boolean, rndSeed as any, forceSimulation as boolean)
+      const actual = apply(sim, [new AutoReplacer(rule_set)])
+      const reference = apply(new Simulator(gate_fusion as boolean, rndSeed as any, forceSimulation as boolean), [
+        new AutoReplacer(rule_set), new InstructionFilter((eng, cmd) => typeof qftDirection(cmd.gate) === 'undefined')
+      ])
+      expectStatesClose(actual, reference, 64)
+    });
+
     it('should test_simulator_convert_logical_to_mapped_qubits', () => {
       const sim = new Simulator(gate_fusion, rndSeed, forceSimulation)
       const mapper = new BasicMapperEngine()
@@ -809,3 +916,446 @@ settings.forEach(([testName, gate_fusion, rndSeed, forceSimulation]) => {
     });
   })
 })
+
+
+describe('CPP Simulator native kernels', () => {
+  itNative('should test_simulator_uniformly_controlled_rotation', () => {
+    const angles = [0.3, -1.2, 2.5, 0.7, -0.1, 1.9, -2.8, 0.4]
+    const prepare = () => {
+      const sim = new Simulator()
+      const eng = new MainEngine(sim, [])
+      const qureg = eng.allocateQureg(5)
+      qureg.forEach((qb, i) => {
+        new Rx(0.3 + i).or(qb)
+        new Ry(1.7 * i).or(qb)
+      })
+      return { sim, eng, controls: [qureg[3], qureg[0], qureg[4]], target: qureg[1], ctrl: qureg[2] }
+    }
+    // Ry / Rz(angles[k]) on the target if the controls are in state k, with regular gates
+    const reference = (eng: MainEngine, Gate: any, controls: any[], target: any, ctrl: any) => {
+      angles.forEach((angle, k) => {
+        const flipped = controls.filter((qb, b) => !((k >> b) & 1))
+        flipped.forEach(qb => X.or(qb))
+        Control(eng, controls.concat(ctrl), () => new Gate(angle).or(target))
+        flipped.forEach(qb => X.or(qb))
+      })
+      eng.flush()
+    }
+    const pairs: [any, any][] = [[UniformlyControlledRy, Ry], [UniformlyControlledRz, Rz]]
+    pairs.forEach(([Uniform, Gate]) => {
+      const a = prepare()
+      Control(a.eng, a.ctrl, () => new Uniform(angles).or(tuple(a.controls, a.target)))
+      a.eng.flush()
+      const b = prepare()
+      reference(b.eng, Gate, b.controls, b.target, b.ctrl)
+      expectStatesClose(a.sim.cheat()[1], b.sim.cheat()[1], 32)
+    })
+  })
+
+  itNative('should test_simulator_prepare_state', () => {
+    const sim = new Simulator()
+    const eng = new MainEngine(sim, [])
+    const qureg = eng.allocateQureg(4)
+    new Ry(0.8).or(qureg[1])
+    CNOT.or(tuple(qureg[1], qureg[3]))
+    eng.flush()
+    const [, before] = sim.cheat()
+    const bases = [0, 10]
+    const rest = bases.map(base => math.clone(getMatrixValue(before, base)))
+
+    // qureg[2] is the least significant qubit of the prepared register
+    const amplitudes = [0.5, math.complex(0, -0.5), -0.5, 0.5]
+    new StatePreparation(amplitudes).or([qureg[2], qureg[0]])
+    eng.flush()
+    amplitudes.forEach((a, x) => {
+      const offset = ((x & 1) << 2) | (x >> 1)
+      bases.forEach((base, j) => {
+        const v = getMatrixValue(sim.cheat()[1], base | offset)
+        const w = math.multiply(rest[j], a) as Complex
+        expect(v.re).to.be.closeTo(math.re(w) as number, 1e-12)
+        expect(v.im).to.be.closeTo(math.im(w) as number, 1e-12)
+      })
+    })
+
+    // real amplitudes from a Float64Array, without going through the engines
+    const other = eng.allocateQureg(2)
+    eng.flush()
+    sim.prepareState(other, new Float64Array([0.6, 0, 0, 0.8]))
+    expect(sim.getProbability('11', other)).to.be.closeTo(0.64, 1e-12)
+    expect(sim.getProbability('00', other)).to.be.closeTo(0.36, 1e-12)
+    // only registers in |0...0> can be prepared
+    expect(() => sim.prepareState(other, [0, 1, 0, 0])).to.throw()
+  })
+
+  itNative('should test_simulator_phase_oracle', () => {
+    const table = new Uint8Array(16)
+    table[6] = 1
+    table[9] = 1
+    const oracles = [new PhaseOracle([6, 9]), new PhaseOracle(table), PhaseOracle.fromPredicate(4, x => x === 6 || x === 9)]
+    oracles.forEach((oracle) => {
+      const sim = new Simulator()
+      const eng = new MainEngine(sim, [])
+      const qureg = eng.allocateQureg(4)
+      const ctrl = eng.allocateQubit()
+      new All(H).or(qureg)
+      X.or(ctrl)
+      Control(eng, ctrl, () => oracle.or(qureg))
+      eng.flush()
+      for (let x = 0; x < 16; ++x) {
+        const v = getMatrixValue(sim.cheat()[1], x | 16)
+        expect(v.re).to.be.closeTo(x === 6 || x === 9 ? -0.25 : 0.25, 1e-12)
+      }
+    })
+  })
+
+  itNative('should test_simulator_tabulated_math', () => {
+    // registers smaller than the state: the C++ simulator calls the function
+    // once per register value, the JS simulator once per amplitude
+    const f = (x: number, y: number) => [(x + 3 * y) % 8, y ^ 1]
+    const run = (forceSimulation: boolean) => {
+      const sim = new Simulator(false, 7, forceSimulation)
+      const eng = new MainEngine(sim, [])
+      const spectator = eng.allocateQubit()
+      const x = eng.allocateQureg(3)
+      const ctrls = eng.allocateQureg(2)
+      const y = eng.allocateQureg(2)
+      spectator.concat(x, ctrls, y).forEach((qb, i) => {
+        new Ry(0.3 * (i + 1)).or(qb)
+        new Rz(0.7 * i).or(qb)
+      })
+      Control(eng, ctrls, () => new BasicMathGate(f).or(tuple(x, y)))
+      eng.flush()
+      return sim.cheat()[1]
+    }
+    expectStatesClose(run(false), run(true), 256)
+  })
+
+  itNative('should test_simulator_emulate_math_table', () => {
+    // a permutation (applied in place) and a function which is not one
+    const functions = [
+      (x: number, y: number) => [x, (x + y) % 4],
+      (x: number, y: number) => [(2 * x) % 8, y]
+    ]
+    functions.forEach((f, k) => {
+      const run = (table?: string) => {
+        const sim = new Simulator()
+        const eng = new MainEngine(sim, [])
+        const a = eng.allocateQureg(3)
+        const b = eng.allocateQureg(2)
+        const ctrl = eng.allocateQubit()
+        const rest = eng.allocateQubit()
+        a.concat(b, ctrl, rest).forEach((qb, i) => new Ry(0.4 * (i + 1)).or(qb))
+        eng.flush()
+        const before = sim.cheat()[1]
+        if (table) {
+          const values = []
+          for (let v = 0; v < 32; ++v) {
+            const [x, y] = f(v & 7, v >> 3)
+            values.push(x | (y << 3))
+          }
+          const ids = [a.map(qb => qb.id), b.map(qb => qb.id)];
+          (sim as any)._simulator.emulateMathTable(table === 'typed' ? Uint32Array.from(values) : values, ids, [ctrl[0].id])
+        } else {
+          Control(eng, ctrl, () => new BasicMathGate(f).or(tuple(a, b)))
+          eng.flush()
+        }
+        return { before, after: sim.cheat()[1] }
+      }
+      // a, b, ctrl and rest are bits 0-2, 3-4, 5 and 6; amplitudes of inputs
+      // mapped to the same output add up
+      const { before, after } = run()
+      const expected = []
+      for (let i = 0; i < 128; ++i) {
+        expected.push({ re: 0, im: 0 })
+      }
+      for (let i = 0; i < 128; ++i) {
+        let j = i
+        if ((i >> 5) & 1) {
+          const [x, y] = f(i & 7, (i >> 3) & 3)
+          j = (i & ~31) | x | (y << 3)
+        }
+        const v = getMatrixValue(before, i)
+        expected[j].re += v.re
+        expected[j].im += v.im
+      }
+      const states = [after, run('typed').after, run('array').after]
+      states.forEach(state => expectStatesClose(state, expected, 128))
+    })
+  })
+
+  itNative('should test_simulator_split_layout', () => {
+    const run = (split: boolean, n: number) => {
+      const sim = new Simulator(true, 7, false, split)
+      const eng = new MainEngine(sim, [])
+      const qureg = eng.allocateQureg(n)
+      new All(H).or(qureg)
+      for (let i = 0; i < n; ++i) {
+        new Rx(0.3 * (i + 1)).or(qureg[i])
+        CNOT.or(tuple(qureg[i], qureg[(i + 2) % n]))
+        new Rz(-0.7 * i).or(qureg[(i + 1) % n])
+      }
+      eng.flush()
+      const probability = sim.getProbability([1, 0], [qureg[1], qureg[4]])
+      Measure.or(qureg[2])
+      eng.flush()
+      const result = qureg[2].toBoolean()
+      new Ry(1.1).or(qureg[0])
+      eng.flush()
+      return { probability, result, state: sim.cheat()[1] }
+    }
+    // with 12 qubits, the conversion between the layouts moves blocks of
+    // 2048 amplitudes
+    const sizes = [6, 12]
+    sizes.forEach((n) => {
+      const interleaved = run(false, n)
+      const split = run(true, n)
+      expect(split.probability).to.be.closeTo(interleaved.probability, 1e-12)
+      expect(split.result).to.equal(interleaved.result)
+      expectStatesClose(split.state, interleaved.state, 2 ** n)
+    })
+  })
+
+  itNative('should test_simulator_real_kernels', () => {
+    // random circuit of real gates (fused into real blocks) on a complex state
+    let seed = 12345
+    const random = () => {
+      seed = (seed * 16807) % 2147483647
+      return seed / 2147483647
+    }
+    const n = 7
+    const circuit: number[][] = []
+    for (let g = 0; g < 80; ++g) {
+      const kind = Math.floor(random() * 4)
+      const qubit = Math.floor(random() * n)
+      const target = (qubit + 1 + Math.floor(random() * (n - 1))) % n
+      circuit.push([kind, qubit, target, random() * 6])
+    }
+    const run = (fusion: boolean, forceSimulation: boolean, split: boolean) => {
+      const sim = new Simulator(fusion, 3, forceSimulation, split)
+      const eng = new MainEngine(sim, [])
+      const qureg = eng.allocateQureg(n)
+      qureg.forEach((qb, i) => {
+        new Rx(0.4 + i).or(qb)
+        new Rz(0.9 * i).or(qb)
+      })
+      eng.flush()
+      circuit.forEach(([kind, qubit, target, angle]) => {
+        if (kind === 0) {
+          H.or(qureg[qubit])
+        } else if (kind === 1) {
+          X.or(qureg[qubit])
+        } else if (kind === 2) {
+          new Ry(angle).or(qureg[qubit])
+        } else {
+          CNOT.or(tuple(qureg[qubit], qureg[target]))
+        }
+      })
+      eng.flush()
+      return sim.cheat()[1]
+    }
+    // the JS simulator applies every gate as a complex matrix
+    const expected = run(false, true, false)
+    const states = [run(true, false, false), run(true, false, true), run(false, false, false)]
+    states.forEach(state => expectStatesClose(state, expected, 2 ** n))
+  })
+
+  itNative('should test_simulator_fusion_limits', () => {
+    const run = (limits?: number[]) => {
+      const sim = new Simulator(true, 7)
+      if (limits) {
+        sim.setFusionLimits(limits[0], limits[1])
+      }
+      const eng = new MainEngine(sim, [])
+      const qureg = eng.allocateQureg(8)
+      new All(H).or(qureg)
+      for (let i = 0; i < 8; ++i) {
+        new Rx(0.3 * (i + 1)).or(qureg[i])
+        CNOT.or(tuple(qureg[i], qureg[(i + 3) % 8]))
+        new Rz(-0.7 * i).or(qureg[(i + 1) % 8])
+      }
+      eng.flush()
+      return sim.cheat()[1]
+    }
+    const expected = run()
+    const states = [run([6, 8]), run([1, 10])]
+    states.forEach(state => expectStatesClose(state, expected, 256))
+    const sim = new Simulator(true)
+    expect(() => sim.setFusionLimits(3, 11)).to.throw()
+    const [min, max] = sim.autotuneFusion(12)
+    expect(min).to.be.within(1, max)
+    expect(max).to.be.within(1, 10)
+    expect(() => sim.autotuneFusion(25)).to.throw()
+    // the scratch state of 2^18 amplitudes takes 4 MiB
+    sim.setScratchBudget(1 << 20)
+    expect(() => sim.autotuneFusion(18)).to.throw()
+  })
+
+  itNative('should test_simulator_prefetch_threshold', () => {
+    // every kernel width, with and without a shared control, on states
+    // smaller and larger than the prefetch distance of the AVX kernels
+    const run = (n: number, width: number, threshold: number) => {
+      const sim = new Simulator(true, 7)
+      sim.setFusionLimits(width, width)
+      sim.setPrefetchThreshold(threshold)
+      const eng = new MainEngine(sim, [])
+      const qureg = eng.allocateQureg(n)
+      new All(H).or(qureg)
+      for (let i = 0; i < 2 * n; ++i) {
+        new Rx(0.3 * (i + 1)).or(qureg[i % n])
+        CNOT.or(tuple(qureg[i % n], qureg[(i + 3) % n]))
+        new Rz(-0.7 * i).or(qureg[(i + 1) % n])
+      }
+      Control(eng, qureg[n - 1], () => {
+        new Rx(0.4).or(qureg[0])
+        new Rz(1.1).or(qureg[1])
+        CNOT.or(tuple(qureg[0], qureg[2]))
+      })
+      eng.flush()
+      return sim.cheat()[1]
+    }
+    const sizes = [5, 9, 12]
+    sizes.forEach((n) => {
+      for (let width = 1; width <= 5; ++width) {
+        expectStatesClose(run(n, width, 0), run(n, width, Infinity), 1 << n)
+      }
+    })
+    const sim = new Simulator(true)
+    sim.setPrefetchThreshold()
+    expect(() => sim.setPrefetchThreshold(-1)).to.throw()
+  })
+
+  itNative('should test_simulator_fusion_reordering', () => {
+    const run = (fusion: boolean) => {
+      const sim = new Simulator(fusion, 7)
+      const eng = new MainEngine(sim, [])
+      const qureg = eng.allocateQureg(10)
+      new All(H).or(qureg)
+      for (let layer = 0; layer < 3; ++layer) {
+        for (let i = 0; i < 10; ++i) {
+          // diagonal gates and gates sharing controls commute
+          new Rz(0.2 * (i + layer)).or(qureg[i])
+          CNOT.or(tuple(qureg[i], qureg[(i + 1 + layer) % 10]))
+          S.or(qureg[(i + 5) % 10])
+          Toffoli.or(tuple(qureg[i], qureg[(i + 7) % 10], qureg[(i + 2) % 10]))
+          new Rx(0.1 * i).or(qureg[(i + 3) % 10])
+        }
+      }
+      eng.flush()
+      return sim.cheat()[1]
+    }
+    expectStatesClose(run(true), run(false), 1024)
+  })
+
+  itNative('should test_simulator_krylov_time_evolution', () => {
+    const op = new QubitOperator('X0').mul(1.3)
+    op.iadd(new QubitOperator('Z0 Z1').mul(0.7))
+    op.iadd(new QubitOperator('Y1 X2').mul(-0.9))
+    op.iadd(new QubitOperator('X2 Y3').mul(0.5))
+    op.iadd(new QubitOperator('Z3').mul(-0.4))
+    op.iadd(new QubitOperator([]).mul(0.2))
+    const terms = Object.keys(op.terms).map(k => stringToArray(k))
+    // routed to the Lanczos propagator instead of one rotation per term
+    expect(pauliTermsCommute(terms)).to.equal(false)
+    const time = 2.5
+    const run = (setup: (sim: Simulator) => void) => {
+      const sim = new Simulator(false, 7)
+      const eng = new MainEngine(sim, [])
+      const qureg = eng.allocateQureg(4)
+      qureg.forEach((qb, i) => {
+        new Rx(0.3 + 0.4 * i).or(qb)
+        new Ry(1.1 - 0.2 * i).or(qb)
+      })
+      eng.flush()
+      const [map, init] = sim.cheat()
+      const before = convertNativeMatrix(math.flatten(math.clone(init)))
+      setup(sim)
+      new TimeEvolution(time, op).or(qureg)
+      eng.flush()
+      const after = math.clone(sim.cheat()[1])
+      // dense reference exp(-i time H), most significant bit first
+      const mc = math.complex
+      const paulis = {
+        X: [[0, 1], [1, 0]], Y: [[0, mc(0, -1)], [mc(0, 1), 0]], Z: [[1, 0], [0, -1]]
+      }
+      let hamiltonian: any = 0
+      Object.keys(op.terms).forEach((k) => {
+        const factors: any[] = [0, 1, 2, 3].map(() => math.identity(2))
+        stringToArray(k).forEach(([idx, pauli]) => {
+          factors[map[qureg[idx].id]] = math.matrix(paulis[pauli])
+        })
+        factors.reverse()
+        const product = factors.reduce((res, f) => math.kron(res, f))
+        hamiltonian = math.add(hamiltonian, math.multiply(product, op.terms[k]))
+      })
+      const expected = math.multiply(math.expm(math.multiply(hamiltonian, mc(0, -time))), before)
+      expectStatesClose(after, expected, 16, 1e-9)
+    }
+    run(() => {})
+    run(sim => sim.setKrylovDim(6))
+    // 3 vectors of 16 amplitudes: the basis is rebuilt for the final sum
+    run(sim => sim.setScratchBudget(3 * 16 * 16))
+    expect(() => run(sim => sim.setScratchBudget(2 * 16 * 16))).to.throw()
+    expect(() => new Simulator(false, 7).setKrylovDim(5)).to.throw()
+    expect(() => new Simulator(false, 7).setKrylovDim(65)).to.throw()
+  })
+
+  itNative('should test_simulator_pauli_rotation', () => {
+    const mixed = new QubitOperator('X0 Y1 Z2').mul(0.8)
+    mixed.iadd(new QubitOperator('Y0 X1 Z2').mul(-0.6))
+    mixed.iadd(new QubitOperator('Y3').mul(0.4))
+    mixed.iadd(new QubitOperator([]).mul(0.3))
+    // an operator of only the identity becomes a (controlled) phase gate
+    const ops = [mixed, new QubitOperator('Y1 Y3').mul(1.2), new QubitOperator([]).mul(-0.7)]
+    const time = 1.7
+    const prepare = () => {
+      const sim = new Simulator(false, 3)
+      const eng = new MainEngine(sim, [])
+      const qureg = eng.allocateQureg(6)
+      qureg.forEach((qb, i) => {
+        new Rx(0.5 + 0.3 * i).or(qb)
+        new Ry(0.2 - 0.35 * i).or(qb)
+      })
+      eng.flush()
+      return { sim, eng, qureg }
+    }
+    ops.forEach((op) => {
+      const terms = Object.keys(op.terms).map(k => [stringToArray(k), op.terms[k]])
+      // commuting terms are applied as one Pauli rotation each
+      expect(pauliTermsCommute(terms.map(([term]) => term))).to.equal(true)
+      const controls = [[], [4], [4, 5]]
+      controls.forEach((ctrl) => {
+        const rotated = prepare()
+        const system = rotated.qureg.slice(0, 4)
+        const ctrlQubits = ctrl.map(i => rotated.qureg[i])
+        Control(rotated.eng, ctrlQubits, () => new TimeEvolution(time, op).or(system))
+        rotated.eng.flush()
+        // the same evolution through the Krylov propagator
+        const evolved = prepare()
+        const ids = evolved.qureg.slice(0, 4).map(qb => qb.id)
+        const ctrlIds = ctrl.map(i => evolved.qureg[i].id)
+        const native = (evolved.sim as any)._simulator
+        native.emulateTimeEvolution(terms, time, ids, ctrlIds)
+        expectStatesClose(rotated.sim.cheat()[1], evolved.sim.cheat()[1], 64)
+      })
+    })
+  })
+
+  itNative('should test_simulator_scratch_budget', () => {
+    const sim = new Simulator(true, 7)
+    const eng = new MainEngine(sim, [])
+    const qureg = eng.allocateQureg(4)
+    H.or(qureg[0])
+    CNOT.or(tuple(qureg[0], qureg[1]))
+    const op = new QubitOperator('X0 X1')
+    expect(sim.getExpectationValue(op, qureg)).to.be.closeTo(1, 1e-12)
+    // the copy of the state needs 16 amplitudes
+    sim.setScratchBudget(16 * 16 - 1)
+    expect(() => sim.getExpectationValue(op, qureg)).to.throw()
+    sim.setScratchBudget(16 * 16)
+    expect(sim.getExpectationValue(op, qureg)).to.be.closeTo(1, 1e-12)
+    expect(() => sim.setScratchBudget(-1)).to.throw()
+    sim.setScratchBudget()
+    sim.releaseScratch()
+    expect(sim.getExpectationValue(op, qureg)).to.be.closeTo(1, 1e-12)
+  })
+})
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import { expect } from 'chai'
+import { MainEngine } from '@/cengines/main'
+import CPPSimulatorBackend from '@/backends/simulators/cppsim'
+import { PoolJobRecorder, SimulatorPool } from '@/backends/simulators/simulatorpool'
+import { Simulator } from '@/backends/simulators/simulator'
+import { H, Measure, Rx, Ry } from '@/ops/gates'
+import { All } from '@/ops/metagates'
+import { CNOT } from '@/ops/shortcuts'
+import { tuple } from '@/libs/util'
+
+const native = CPPSimulatorBackend && CPPSimulatorBackend.SimulatorPool
+const itNative = native ? it : it.skip
+
+function circuit(eng: MainEngine, theta: number) {
+  const qureg = eng.allocateQureg(3)
+  H.or(qureg[0])
+  new Ry(theta).or(qureg[1])
+  CNOT.or(tuple(qureg[1], qureg[2]))
+  new Rx(2 * theta).or(qureg[0])
+  eng.flush()
+  return qureg
+}
+
+describe('simulator pool test', () => {
+  it('should test_recorder', () => {
+    const recorder = new PoolJobRecorder()
+    const eng = new MainEngine(recorder, [])
+    const qureg = circuit(eng, 0.5)
+    new All(Measure).or(qureg)
+    eng.flush()
+    const job = recorder.job(10, true)
+    expect(job.numQubits).to.equal(3)
+    expect(job.gates.length).to.equal(4)
+    expect(job.gates[2].ids).to.deep.equal([2])
+    expect(job.gates[2].controls).to.deep.equal([1])
+    expect(job.measure).to.deep.equal([0, 1, 2])
+    recorder.reset()
+    expect(recorder.job().gates.length).to.equal(0)
+  })
+
+  itNative('should test_pool_matches_simulator', async () => {
+    const angles = [0, 0.3, 1.2, 2.5, Math.PI, 0.7, 1.9, 3.3]
+    const jobs = angles.map((theta) => {
+      const recorder = new PoolJobRecorder()
+      circuit(new MainEngine(recorder, []), theta)
+      return recorder.job(50, true)
+    })
+    const pool = new SimulatorPool(2, 1)
+    const results = await pool.run(jobs)
+    expect(pool.pending).to.equal(0)
+
+    angles.forEach((theta, i) => {
+      const sim = new Simulator(false, 1)
+      const qureg = circuit(new MainEngine(sim, []), theta)
+      for (let k = 0; k < 8; ++k) {
+        const bits = [k & 1, (k >> 1) & 1, (k >> 2) & 1].join('')
+        expect(results[i].probabilities[k]).to.be.closeTo(sim.getProbability(bits, qureg), 1e-12)
+      }
+      expect(results[i].samples.length).to.equal(0)
+    })
+  })
+
+  itNative('should test_pool_sampling', async () => {
+    const pool = new SimulatorPool(0, 3)
+    const bell = {
+      numQubits: 2,
+      gates: [
+        { matrix: [[Math.SQRT1_2, Math.SQRT1_2], [Math.SQRT1_2, -Math.SQRT1_2]], ids: [0], controls: [] },
+        { matrix: [[0, 1], [1, 0]], ids: [1], controls: [0] }
+      ],
+      measure: [0, 1],
+      shots: 200
+    }
+    const result = await pool.submit(bell)
+    expect(result.samples.length).to.equal(200)
+    result.samples.forEach(s => expect([0, 3]).to.include(s))
+    expect(result.probabilities.length).to.equal(0)
+  })
+
+  itNative('should test_pool_rejects_invalid_job', async () => {
+    const pool = new SimulatorPool(1, 1)
+    let error: Error | undefined
+    try {
+      await pool.submit({ numQubits: 1, gates: [{ matrix: [[0, 1], [1, 0]], ids: [3], controls: [] }] })
+    } catch (e) {
+      error = e
+    }
+    expect(error).to.not.equal(undefined)
+
+    // duplicate or too many measured qubits are rejected before sampling
+    const invalid = [[0, 0], [0, 1, 2]]
+    for (const measure of invalid) {
+      error = undefined
+      try {
+        await pool.submit({ numQubits: 2, gates: [], measure, shots: 1 })
+      } catch (e) {
+        error = e
+      }
+      expect(error).to.not.equal(undefined)
+    }
+  })
+
+  itNative('should test_pool_wide_gates', async () => {
+    // a 6-qubit gate (generic kernel) which flips qubit 0
+    const matrix: number[][] = []
+    for (let i = 0; i < 64; ++i) {
+      matrix.push(Array.from({ length: 64 }, (_, j) => ((i ^ 1) === j ? 1 : 0)))
+    }
+    const pool = new SimulatorPool(1, 1)
+    const result = await pool.submit({
+      numQubits: 6, gates: [{ matrix, ids: [0, 1, 2, 3, 4, 5], controls: [] }], measure: [0], shots: 5
+    })
+    expect(result.samples).to.deep.equal([1, 1, 1, 1, 1])
+  })
+})
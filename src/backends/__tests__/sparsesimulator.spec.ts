@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import { expect } from 'chai'
+import { MainEngine } from '@/cengines/main'
+import CPPSimulatorBackend from '@/backends/simulators/cppsim'
+import { SparseSimulator } from '@/backends/simulators/sparsesimulator'
+import { Simulator } from '@/backends/simulators/simulator'
+import {
+  H, Measure, Rx, Ry, Rz, X
+} from '@/ops/gates'
+import { All } from '@/ops/metagates'
+import { CNOT, Toffoli } from '@/ops/shortcuts'
+import QubitOperator from '@/ops/qubitoperator'
+import { tuple } from '@/libs/util'
+
+const native = CPPSimulatorBackend && CPPSimulatorBackend.SparseSimulator
+const itNative = native ? it : it.skip
+
+describe('sparse simulator test', () => {
+  itNative('should test_sparse_oracle_many_qubits', () => {
+    const n = 16
+    const sim = new SparseSimulator(1)
+    const eng = new MainEngine(sim, [])
+    const x = eng.allocateQureg(n)
+    const y = eng.allocateQureg(n)
+    const z = eng.allocateQureg(n - 1)
+    new All(H).or(x.slice(0, 4))
+    // y = x, z[i] = x[i] & x[i + 1]
+    for (let i = 0; i < n; ++i) {
+      CNOT.or(tuple(x[i], y[i]))
+    }
+    for (let i = 0; i + 1 < n; ++i) {
+      Toffoli.or(tuple(x[i], y[i + 1], z[i]))
+    }
+    X.or(y[n - 1])
+    eng.flush()
+    expect(sim.getProbability('1', [z[0]])).to.be.closeTo(0.25, 1e-12)
+    expect(sim.getProbability('1', [y[n - 1]])).to.be.closeTo(1, 1e-12)
+
+    new All(Measure).or(x)
+    new All(Measure).or(y)
+    new All(Measure).or(z)
+    eng.flush()
+    for (let i = 0; i < n; ++i) {
+      expect(y[i].toBoolean()).to.equal(i === n - 1 ? !x[i].toBoolean() : x[i].toBoolean())
+    }
+    for (let i = 0; i + 1 < n; ++i) {
+      expect(z[i].toBoolean()).to.equal(x[i].toBoolean() && x[i + 1].toBoolean())
+    }
+  })
+
+  itNative('should test_sparse_matches_simulator', () => {
+    const sparse = new SparseSimulator(1)
+    const dense = new Simulator(false, 1)
+    const engs = [new MainEngine(sparse, []), new MainEngine(dense, [])]
+    const regs = engs.map(eng => eng.allocateQureg(4))
+    regs.forEach((qureg) => {
+      new Ry(0.3).or(qureg[0])
+      CNOT.or(tuple(qureg[0], qureg[1]))
+      Toffoli.or(tuple(qureg[0], qureg[1], qureg[3]))
+      new Rz(0.7).or(qureg[3])
+      new Rx(1.1).or(qureg[2])
+    })
+    engs.forEach(eng => eng.flush())
+    for (let i = 0; i < 16; ++i) {
+      const bits = [0, 1, 2, 3].map(k => String((i >> k) & 1)).join('')
+      const a = sparse.getAmplitude(bits, regs[0])
+      const b = dense.getAmplitude(bits, regs[1])
+      expect(a.re).to.be.closeTo(b.re, 1e-12)
+      expect(a.im).to.be.closeTo(b.im, 1e-12)
+    }
+    expect(sparse.getExpectationValue(new QubitOperator('Z0'), regs[0]))
+      .to.be.closeTo(dense.getExpectationValue(new QubitOperator('Z0'), regs[1]), 1e-12)
+    engs.forEach((eng, i) => new All(Measure).or(regs[i]))
+  })
+
+  itNative('should test_sparse_expectation_many_qubits', () => {
+    const sim = new SparseSimulator(1)
+    const eng = new MainEngine(sim, [])
+    const qureg = eng.allocateQureg(40)
+    H.or(qureg[0])
+    CNOT.or(tuple(qureg[0], qureg[39]))
+    eng.flush()
+    expect(sim.getExpectationValue(new QubitOperator('Z0 Z39'), qureg)).to.be.closeTo(1, 1e-12)
+    expect(sim.getExpectationValue(new QubitOperator('X0 X39'), qureg)).to.be.closeTo(1, 1e-12)
+    expect(sim.getExpectationValue(new QubitOperator('Z0'), qureg)).to.be.closeTo(0, 1e-12)
+    sim.applyQubitOperator(new QubitOperator('X5'), qureg)
+    expect(sim.getProbability('1', [qureg[5]])).to.be.closeTo(1, 1e-12)
+    // a dense copy of 2^40 amplitudes is out of reach
+    expect(() => sim.cheat()).to.throw()
+    X.or(qureg[5])
+    new All(Measure).or(qureg)
+  })
+})
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import { expect } from 'chai'
+import { MainEngine } from '@/cengines/main'
+import { DummyEngine } from '@/cengines/testengine'
+import CPPSimulatorBackend from '@/backends/simulators/cppsim'
+import { StabilizerSimulator, cliffordGateName } from '@/backends/simulators/stabilizersimulator'
+import {
+  H, Measure, Rx, S, Swap, T, X, Y, Z
+} from '@/ops/gates'
+import { All, DaggeredGate } from '@/ops/metagates'
+import { CNOT, Toffoli } from '@/ops/shortcuts'
+import { tuple } from '@/libs/util'
+import Command from '@/ops/command'
+import { IGate, IQubit } from '@/interfaces'
+
+describe('stabilizer simulator test', () => {
+  it('should test_clifford_gate_name', () => {
+    const eng = new MainEngine(new DummyEngine(), [])
+    const qubits = eng.allocateQureg(3)
+    const cmd = (gate: IGate, targets: IQubit[], controls: IQubit[] = []) => new Command(eng, gate, targets.map(q => [q]), controls)
+
+    expect(cliffordGateName(cmd(H, [qubits[0]]))).to.equal('H')
+    expect(cliffordGateName(cmd(S, [qubits[0]]))).to.equal('S')
+    expect(cliffordGateName(cmd(new DaggeredGate(S), [qubits[0]]))).to.equal('Sdag')
+    expect(cliffordGateName(cmd(X, [qubits[0]], [qubits[1]]))).to.equal('X')
+    expect(cliffordGateName(cmd(Z, [qubits[0]], [qubits[1]]))).to.equal('Z')
+    expect(cliffordGateName(cmd(Swap, [qubits[0], qubits[1]]))).to.equal('Swap')
+    expect(cliffordGateName(cmd(X, [qubits[0]], [qubits[1], qubits[2]]))).to.equal(undefined)
+    expect(cliffordGateName(cmd(H, [qubits[0]], [qubits[1]]))).to.equal(undefined)
+    expect(cliffordGateName(cmd(T, [qubits[0]]))).to.equal(undefined)
+    expect(cliffordGateName(cmd(new Rx(0.3), [qubits[0]]))).to.equal(undefined)
+  })
+
+  const native = CPPSimulatorBackend && CPPSimulatorBackend.StabilizerSimulator
+  const itNative = native ? it : it.skip
+
+  itNative('should test_stabilizer_is_available', () => {
+    const sim = new StabilizerSimulator(1)
+    const backend = new DummyEngine(true)
+    const eng = new MainEngine(backend, [sim])
+    const qubits = eng.allocateQureg(3)
+    CNOT.or(tuple(qubits[0], qubits[1]))
+    Toffoli.or(tuple(qubits[0], qubits[1], qubits[2]))
+    T.or(qubits[0])
+    const available = backend.receivedCommands.map(cmd => sim.isAvailable(cmd))
+    expect(available).to.deep.equal([true, true, true, true, false, false])
+  })
+
+  itNative('should test_stabilizer_ghz', () => {
+    const sim = new StabilizerSimulator(7)
+    const eng = new MainEngine(sim, [])
+    const n = 500
+    const qureg = eng.allocateQureg(n)
+    H.or(qureg[0])
+    for (let i = 1; i < n; ++i) {
+      CNOT.or(tuple(qureg[i - 1], qureg[i]))
+    }
+    new All(Measure).or(qureg)
+    eng.flush()
+    const first = qureg[0].toBoolean()
+    qureg.forEach(qb => expect(qb.toBoolean()).to.equal(first))
+  })
+
+  itNative('should test_stabilizer_deterministic_gates', () => {
+    const sim = new StabilizerSimulator(3)
+    const eng = new MainEngine(sim, [])
+    const [a, b] = eng.allocateQureg(2)
+    // HZH = X, SS = Z, Y = iXZ
+    H.or(a)
+    Z.or(a)
+    H.or(a)
+    H.or(b)
+    S.or(b)
+    S.or(b)
+    H.or(b)
+    Y.or(b)
+    Swap.or(tuple(a, b))
+    Measure.or(a)
+    Measure.or(b)
+    eng.flush()
+    expect(a.toBoolean()).to.equal(false)
+    expect(b.toBoolean()).to.equal(true)
+
+    X.or(b)
+    eng.deallocateQubit(a)
+    eng.deallocateQubit(b)
+    const c = eng.allocateQubit()
+    H.or(c)
+    expect(() => eng.deallocateQubit(c[0])).to.throw()
+  })
+})
@@ -25,6 +25,20 @@ export * as Simulator from './simulators/simulator'
 
 export * as ClassicalSimulator from './simulators/classicalsimulator'
 
+export * as StabilizerSimulator from './simulators/stabilizersimulator'
+
+export * as MPSSimulator from './simulators/mpssimulator'
+
+export * as SparseSimulator from './simulators/sparsesimulator'
+
+export * as ReversibleSimulator from './simulators/reversiblesimulator'
+
+export * as BatchSimulator from './simulators/batchsimulator'
+
+export * as ParametrizedCircuit from './simulators/parametrizedcircuit'
+
+export * as SimulatorPool from './simulators/simulatorpool'
+
 export * as CommandPrinter from './printer'
 
 export * as ResourceCounter from './resource'
@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import assert from 'assert'
+import math from 'mathjs'
+import { BasicEngine } from '@/cengines/basics'
+import CPPSimulatorBackend from './cppsim'
+import {
+  Allocate,
+  AllocateQubitGate,
+  Deallocate,
+  DeallocateQubitGate,
+  FlushGate,
+  Measure,
+  MeasureGate
+} from '@/ops/gates'
+import BatchedGate from '@/ops/batchedgate'
+import { BasicQubit } from '@/meta/qubit'
+import { LogicalQubitIDTag } from '@/meta/tag'
+import { stringToArray } from '@/ops/qubitoperator'
+import { instanceOf } from '@/libs/util'
+import { len, stringToBitArray } from '@/libs/polyfill'
+import { ICommand, IMathGate, IQubit, IQubitOperator, IQureg } from '@/interfaces'
+
+/**
+ * @desc
+BatchSimulator is a compiler engine which simulates `batchSize` copies of
+the same circuit at once with C++-based kernels, e.g. one VQE/QAOA ansatz
+at many points of a parameter sweep. The states are stored interleaved, so
+every command is dispatched and every gate is applied once for the whole
+batch.
+
+  Gates with a matrix act on all states alike (and are fused like in the
+Simulator); a BatchedGate applies its i-th gate to state i. Results are
+returned per state: see getExpectationValues, getProbabilities,
+getAmplitudes and getMeasurementResults. Measurements are sampled for each
+state independently; the result of state 0 is reported to the main engine.
+
+    @example
+
+const sim = new BatchSimulator(angles.length)
+const eng = new MainEngine(sim, [])
+const qureg = eng.allocateQureg(2)
+new BatchedGate(angles.map(theta => new Ry(theta))).or(qureg[0])
+CNOT.or(tuple(qureg[0], qureg[1]))
+eng.flush()
+sim.getExpectationValues(new QubitOperator('Z0 Z1'), qureg) // one value per angle
+
+  Note:
+The batch simulator requires the C++ extension; there is no Javascript
+fallback.
+ */
+export class BatchSimulator extends BasicEngine {
+  private _simulator: any;
+  private _batchSize: number;
+  private _measurements: { [key: number]: boolean[] };
+
+  /**
+    @param batchSize Number of states which are simulated together.
+    @param rnd_seed Random seed of the measurement outcomes.
+   */
+  constructor(batchSize: number, rnd_seed?: number) {
+    super()
+    if (!CPPSimulatorBackend || !CPPSimulatorBackend.BatchSimulator) {
+      throw new Error('BatchSimulator requires the C++ extension.')
+    }
+    if (!rnd_seed) {
+      rnd_seed = Math.floor(Math.random() * 4294967295)
+    }
+    const S = CPPSimulatorBackend.BatchSimulator
+    this._simulator = new S(batchSize, rnd_seed)
+    this._batchSize = batchSize
+    this._measurements = {}
+  }
+
+  get batchSize() {
+    return this._batchSize
+  }
+
+  /**
+  Specialized implementation of isAvailable: The batch simulator can deal
+with all arbitrarily-controlled gates which provide a gate-matrix (via
+gate.matrix) and act on 5 or less qubits (not counting the control qubits),
+and with BatchedGates made of such gates (one per state of the batch).
+
+  @param cmd Command for which to check availability
+
+  @return true if it can be simulated and false otherwise.
+   */
+  isAvailable(cmd: ICommand) {
+    if (instanceOf(cmd.gate, [MeasureGate, AllocateQubitGate, DeallocateQubitGate, FlushGate])) {
+      return true
+    }
+    const gates = cmd.gate instanceof BatchedGate ? cmd.gate.gates : [cmd.gate]
+    if (cmd.gate instanceof BatchedGate && gates.length !== this._batchSize) {
+      return false
+    }
+    try {
+      return gates.every((gate) => {
+        const [row, col] = (gate as IMathGate).matrix.size()
+        return row <= 2 ** 5 && col <= 2 ** 5
+      })
+    } catch (e) {
+      return false
+    }
+  }
+
+  /**
+    Converts a qureg from logical to mapped qubits if there is a mapper.
+    @param qureg Logical quantum bits
+  */
+  convertLogicalToMappedQureg(qureg: IQureg) {
+    const { mapper } = this.main
+    if (mapper) {
+      const mapped_qureg: IQubit[] = []
+      qureg.forEach((qubit) => {
+        const v = mapper.currentMapping![qubit.id]
+        if (typeof v === 'undefined') {
+          throw new Error(`Unknown qubit id. Please make sure you have called eng.flush().`);
+        }
+        mapped_qureg.push(new BasicQubit(qubit.engine, v))
+      })
+      return mapped_qureg
+    }
+    return qureg
+  }
+
+  /**
+  Expectation value of `qubitOperator` in every state of the batch.
+
+    @param qubitOperator Operator to measure.
+    @param qureg Quantum bits to measure.
+
+    @throws {Error} If `qubitOperator` acts on more qubits than present in the `qureg` argument.
+   */
+  getExpectationValues(qubitOperator: IQubitOperator, qureg: IQureg): number[] {
+    qureg = this.convertLogicalToMappedQureg(qureg)
+    const operator: any[] = []
+    const num_qubits = qureg.length
+    Object.keys(qubitOperator.terms).forEach((term) => {
+      const keys = stringToArray(term)
+      if (term !== '' && keys[keys.length - 1][0] >= num_qubits) {
+        throw new Error('qubit_operator acts on more qubits than contained in the qureg.')
+      }
+      operator.push([keys, qubitOperator.terms[term]])
+    })
+    return this._simulator.getExpectationValue(operator, qureg.map(qb => qb.id))
+  }
+
+  /**
+  Probability of the outcome `bitString` in every state of the batch.
+   */
+  getProbabilities(bitString: string, qureg: IQureg): number[] {
+    qureg = this.convertLogicalToMappedQureg(qureg)
+    const bit_string = stringToBitArray(bitString)
+    return this._simulator.getProbability(bit_string, qureg.map(qb => qb.id))
+  }
+
+  /**
+  Amplitude of `bitString` in every state of the batch. `qureg` must
+contain all allocated qubits.
+   */
+  getAmplitudes(bitString: string, qureg: IQureg) {
+    qureg = this.convertLogicalToMappedQureg(qureg)
+    const bit_string = stringToBitArray(bitString)
+    return this._simulator.getAmplitude(bit_string, qureg.map(qb => qb.id))
+  }
+
+  /**
+  Outcomes of the last measurement of `qubit`, one per state of the batch.
+   */
+  getMeasurementResults(qubit: IQubit): boolean[] {
+    const results = this._measurements[qubit.id]
+    if (typeof results === 'undefined') {
+      throw new Error(`Qubit ${qubit.id} has not been measured.`)
+    }
+    return results
+  }
+
+  /**
+  Handle all commands, i.e., call the member functions of the C++-
+batch simulator object corresponding to measurement, allocation/
+deallocation, and (controlled, batched) gates.
+
+    @throws Error If a gate acts on more than 5 qubits (which should never happen due to isAvailable).
+   */
+  handle(cmd: ICommand) {
+    if (cmd.gate.equal(Measure)) {
+      assert(cmd.controlCount === 0)
+      const ids: number[] = []
+      cmd.qubits.forEach(qr => qr.forEach(qb => ids.push(qb.id)))
+      const out: number[][] = this._simulator.measureQubits(ids)
+      let i = 0
+      cmd.qubits.forEach((qr) => {
+        qr.forEach((qb) => {
+          // Check if a mapper assigned a different logical id
+          let logical_id_tag: LogicalQubitIDTag | undefined
+          cmd.tags.forEach((tag) => {
+            if (tag instanceof LogicalQubitIDTag) {
+              logical_id_tag = tag
+            }
+          })
+          if (logical_id_tag) {
+            qb = new BasicQubit(qb.engine, (logical_id_tag as LogicalQubitIDTag).logicalQubitID)
+          }
+          const k = i
+          this._measurements[qb.id] = out.map(outcome => Boolean(outcome[k]))
+          this.main.setMeasurementResult!(qb, Boolean(out[0][k]))
+          i += 1
+        })
+      })
+    } else if (cmd.gate.equal(Allocate)) {
+      this._simulator.allocateQubit(cmd.qubits[0][0].id)
+    } else if (cmd.gate.equal(Deallocate)) {
+      this._simulator.deallocateQubit(cmd.qubits[0][0].id)
+    } else {
+      const ids: number[] = []
+      cmd.qubits.forEach(qr => qr.forEach(qb => ids.push(qb.id)))
+      const ctrls = cmd.controlQubits.map(qb => qb.id)
+      const gates = cmd.gate instanceof BatchedGate ? cmd.gate.gates : [cmd.gate]
+      const matrices = gates.map((gate) => {
+        const { matrix } = gate as IMathGate
+        if (2 ** ids.length !== len(matrix) || ids.length > 5) {
+          throw new Error(`BatchSimulator: Error applying ${gate.toString()} gate: ${math.log(len(matrix), 2)}-qubit gate applied to ${ids.length} qubits.`)
+        }
+        return (math.clone(matrix) as any)._data
+      })
+      if (cmd.gate instanceof BatchedGate) {
+        this._simulator.applyBatchedGate(matrices, ids, ctrls)
+      } else {
+        this._simulator.applyControlledGate(matrices[0], ids, ctrls)
+      }
+    }
+  }
+
+  receive(commandList: ICommand[]) {
+    commandList.forEach((cmd) => {
+      if (!(cmd.gate instanceof FlushGate)) {
+        this.handle(cmd)
+      } else {
+        this._simulator.run()
+      }
+      if (!this.isLastEngine) {
+        this.send([cmd])
+      }
+    })
+  }
+}
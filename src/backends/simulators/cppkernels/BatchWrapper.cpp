@@ -0,0 +1,258 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Wrapper.hpp"
+#include "BatchWrapper.hpp"
+
+Nan::Persistent<v8::Function> BatchWrapper::constructor;
+
+BatchWrapper::BatchWrapper(unsigned batch, int seed) {
+    _simulator = new BatchSimulator(batch, seed);
+}
+
+BatchWrapper::~BatchWrapper() {
+    delete _simulator;
+}
+
+void BatchWrapper::Init(v8::Local<v8::Object> exports) {
+    Nan::HandleScope scope;
+
+    // Prepare constructor template
+    v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New("BatchSimulator").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+    // Prototype
+    Nan::SetPrototypeMethod(tpl, "allocateQubit", allocateQubit);
+    Nan::SetPrototypeMethod(tpl, "deallocateQubit", deallocateQubit);
+    Nan::SetPrototypeMethod(tpl, "measureQubits", measureQubits);
+    Nan::SetPrototypeMethod(tpl, "applyControlledGate", applyControlledGate);
+    Nan::SetPrototypeMethod(tpl, "applyBatchedGate", applyBatchedGate);
+    Nan::SetPrototypeMethod(tpl, "getExpectationValue", getExpectationValue);
+    Nan::SetPrototypeMethod(tpl, "getProbability", getProbability);
+    Nan::SetPrototypeMethod(tpl, "getAmplitude", getAmplitude);
+    Nan::SetPrototypeMethod(tpl, "run", run);
+
+    auto ctx = Nan::GetCurrentContext();
+    constructor.Reset(tpl->GetFunction(ctx).ToLocalChecked());
+    exports->Set(ctx, Nan::New("BatchSimulator").ToLocalChecked(), tpl->GetFunction(ctx).ToLocalChecked());
+}
+
+// new BatchSimulator(batchSize, seed)
+void BatchWrapper::New(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+    auto isolate = info.GetIsolate();
+    auto context = isolate->GetCurrentContext();
+    if (info.IsConstructCall()) {
+        unsigned batch = info[0]->IsUndefined() ? 1 : info[0]->Uint32Value(context).FromJust();
+        auto seed = info[1]->IsUndefined() ? 0 : info[1]->NumberValue(context).FromJust();
+        try {
+            BatchWrapper* obj = new BatchWrapper(batch, seed);
+            obj->Wrap(info.This());
+            info.GetReturnValue().Set(info.This());
+        } catch (std::runtime_error &error) {
+            Nan::ThrowError(error.what());
+        }
+    } else {
+        // Invoked as plain function `BatchSimulator(...)`, turn into construct call.
+        const int argc = 2;
+        v8::Local<v8::Value> argv[argc] = { info[0], info[1] };
+        v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+        info.GetReturnValue().Set(cons->NewInstance(context, argc, argv).ToLocalChecked());
+    }
+}
+
+void BatchWrapper::allocateQubit(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+    auto ctx = Nan::GetCurrentContext();
+    BatchWrapper* obj = ObjectWrap::Unwrap<BatchWrapper>(info.Holder());
+    auto id = info[0]->Uint32Value(ctx).FromJust();
+
+    try {
+        obj->_simulator->allocate_qubit(id);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void BatchWrapper::deallocateQubit(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    BatchWrapper* obj = ObjectWrap::Unwrap<BatchWrapper>(info.Holder());
+    auto id = info[0]->Uint32Value(ctx).FromJust();
+
+    try {
+        obj->_simulator->deallocate_qubit(id);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void BatchWrapper::measureQubits(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    BatchWrapper* obj = ObjectWrap::Unwrap<BatchWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+
+    v8::Local<v8::Array> jsArray = v8::Local<v8::Array>::Cast(info[0]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(jsArray, ids);
+
+    try {
+        auto result = obj->_simulator->measure_qubits_return(ids);
+
+        Local<Array> ret = Array::New(isolate, result.size());
+        for (size_t b = 0; b < result.size(); ++b) {
+            Local<Array> outcome = Array::New(isolate, result[b].size());
+            for (size_t i = 0; i < result[b].size(); ++i) {
+                outcome->Set(ctx, i, Number::New(isolate, result[b][i]));
+            }
+            ret->Set(ctx, b, outcome);
+        }
+        info.GetReturnValue().Set(ret);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void BatchWrapper::applyControlledGate(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    BatchWrapper* obj = ObjectWrap::Unwrap<BatchWrapper>(info.Holder());
+    Isolate *isolate = info.GetIsolate();
+    auto mat = Local<Array>::Cast(info[0]);
+    MatrixType m;
+    jsToMatrix(isolate, mat, m);
+
+    auto idsArray = v8::Local<v8::Array>::Cast(info[1]);
+    auto controlArray = v8::Local<v8::Array>::Cast(info[2]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(idsArray, ids);
+
+    std::vector<unsigned int> ctrl;
+    jsToArray<unsigned int>(controlArray, ctrl);
+
+    try {
+        obj->_simulator->apply_controlled_gate(m, ids, ctrl);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+// applyBatchedGate(matrices, ids, ctrl): matrices[b] is applied to state b
+void BatchWrapper::applyBatchedGate(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    BatchWrapper* obj = ObjectWrap::Unwrap<BatchWrapper>(info.Holder());
+    Isolate *isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+    auto mats = Local<Array>::Cast(info[0]);
+    std::vector<MatrixType> ms(mats->Length());
+    for (uint32_t b = 0; b < mats->Length(); ++b) {
+        auto mat = Local<Array>::Cast(mats->Get(ctx, b).ToLocalChecked());
+        jsToMatrix(isolate, mat, ms[b]);
+    }
+
+    auto idsArray = v8::Local<v8::Array>::Cast(info[1]);
+    auto controlArray = v8::Local<v8::Array>::Cast(info[2]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(idsArray, ids);
+
+    std::vector<unsigned int> ctrl;
+    jsToArray<unsigned int>(controlArray, ctrl);
+
+    try {
+        obj->_simulator->apply_batched_gate(ms, ids, ctrl);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void BatchWrapper::getExpectationValue(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    BatchWrapper* obj = ObjectWrap::Unwrap<BatchWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+    Local<Array> terms = Local<Array>::Cast(info[0]);
+    Simulator::TermsDict termsDict;
+    jsToTermDictionary(isolate, terms, termsDict);
+
+    Local<Array> a2 = Local<Array>::Cast(info[1]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(a2, ids);
+
+    try {
+        auto result = obj->_simulator->get_expectation_value(termsDict, ids);
+        Local<Array> ret = Array::New(isolate, result.size());
+        for (size_t b = 0; b < result.size(); ++b) {
+            ret->Set(ctx, b, Number::New(isolate, result[b]));
+        }
+        info.GetReturnValue().Set(ret);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void BatchWrapper::getProbability(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    BatchWrapper* obj = ObjectWrap::Unwrap<BatchWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+    Local<Array> i1 = Local<Array>::Cast(info[0]);
+    std::vector<bool> bitString;
+    jsToArray<bool>(i1, bitString);
+
+    Local<Array> i2 = Local<Array>::Cast(info[1]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(i2, ids);
+
+    try {
+        auto result = obj->_simulator->get_probability(bitString, ids);
+        Local<Array> ret = Array::New(isolate, result.size());
+        for (size_t b = 0; b < result.size(); ++b) {
+            ret->Set(ctx, b, Number::New(isolate, result[b]));
+        }
+        info.GetReturnValue().Set(ret);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void BatchWrapper::getAmplitude(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    BatchWrapper* obj = ObjectWrap::Unwrap<BatchWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+    Local<Array> i1 = Local<Array>::Cast(info[0]);
+    std::vector<bool> bitString;
+    jsToArray<bool>(i1, bitString);
+
+    Local<Array> i2 = Local<Array>::Cast(info[1]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(i2, ids);
+
+    try {
+        auto result = obj->_simulator->get_amplitude(bitString, ids);
+        auto re = String::NewFromUtf8(isolate, "re").ToLocalChecked();
+        auto im = String::NewFromUtf8(isolate, "im").ToLocalChecked();
+        Local<Array> ret = Array::New(isolate, result.size());
+        for (size_t b = 0; b < result.size(); ++b) {
+            Local<Object> amplitude = Object::New(isolate);
+            amplitude->Set(ctx, re, Number::New(isolate, result[b].real()));
+            amplitude->Set(ctx, im, Number::New(isolate, result[b].imag()));
+            ret->Set(ctx, b, amplitude);
+        }
+        info.GetReturnValue().Set(ret);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void BatchWrapper::run(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    BatchWrapper* obj = ObjectWrap::Unwrap<BatchWrapper>(info.Holder());
+    try {
+        obj->_simulator->run();
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
@@ -0,0 +1,56 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BATCH_WRAPPER_HPP_
+#define BATCH_WRAPPER_HPP_
+
+#include <nan.h>
+#include "batch.hpp"
+
+// JS binding of BatchSimulator, exported as `BatchSimulator`. Results
+// (measurements, expectation values, probabilities, amplitudes) are arrays
+// with one entry per state of the batch.
+class BatchWrapper : public Nan::ObjectWrap {
+public:
+    static void Init(v8::Local<v8::Object> exports);
+private:
+    explicit BatchWrapper(unsigned batch, int seed = 1);
+    ~BatchWrapper();
+
+    static void New(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void allocateQubit(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void deallocateQubit(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void measureQubits(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void applyControlledGate(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void applyBatchedGate(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void getExpectationValue(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void getProbability(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void getAmplitude(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void run(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static Nan::Persistent<v8::Function> constructor;
+
+    BatchSimulator *_simulator;
+};
+
+#endif
@@ -0,0 +1,114 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Wrapper.hpp"
+#include "CompiledWrapper.hpp"
+
+Nan::Persistent<v8::Function> CompiledWrapper::constructor;
+Nan::Persistent<v8::FunctionTemplate> CompiledWrapper::tmpl;
+
+CompiledWrapper::CompiledWrapper(CompiledCircuit *circuit) : _circuit(circuit) {
+}
+
+CompiledWrapper::~CompiledWrapper() {
+    delete _circuit;
+}
+
+void CompiledWrapper::Init(v8::Local<v8::Object> exports) {
+    Nan::HandleScope scope;
+
+    // Prepare constructor template
+    v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New("CompiledCircuit").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+    // Prototype
+    Nan::SetPrototypeMethod(tpl, "numBlocks", numBlocks);
+    Nan::SetPrototypeMethod(tpl, "numParameters", numParameters);
+    Nan::SetPrototypeMethod(tpl, "save", save);
+
+    auto ctx = Nan::GetCurrentContext();
+    tmpl.Reset(tpl);
+    constructor.Reset(tpl->GetFunction(ctx).ToLocalChecked());
+    exports->Set(ctx, Nan::New("CompiledCircuit").ToLocalChecked(), tpl->GetFunction(ctx).ToLocalChecked());
+}
+
+CompiledCircuit* CompiledWrapper::unwrap(v8::Local<v8::Value> value) {
+    if (!value->IsObject() || !Nan::New(tmpl)->HasInstance(value))
+        return nullptr;
+    auto obj = value->ToObject(Nan::GetCurrentContext()).ToLocalChecked();
+    return ObjectWrap::Unwrap<CompiledWrapper>(obj)->_circuit;
+}
+
+// new CompiledCircuit(gates, params = []) or new CompiledCircuit(path)
+void CompiledWrapper::New(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+    auto isolate = info.GetIsolate();
+    auto context = isolate->GetCurrentContext();
+    if (info.IsConstructCall() && info[0]->IsString()) {
+        String::Utf8Value path(isolate, info[0]);
+        try {
+            CompiledWrapper* obj = new CompiledWrapper(new CompiledCircuit(load_compiled_circuit(*path)));
+            obj->Wrap(info.This());
+            info.GetReturnValue().Set(info.This());
+        } catch (std::runtime_error &error) {
+            Nan::ThrowError(error.what());
+        }
+    } else if (info.IsConstructCall()) {
+        Local<Array> gates = Local<Array>::Cast(info[0]);
+        std::vector<CircuitGate> circuit;
+        jsToCircuit(isolate, gates, circuit);
+
+        std::vector<double> params;
+        if (info[1]->IsArray()) {
+            Local<Array> a1 = Local<Array>::Cast(info[1]);
+            for (uint32_t i = 0; i < a1->Length(); ++i) {
+                params.push_back(a1->Get(context, i).ToLocalChecked()->NumberValue(context).FromJust());
+            }
+        }
+        try {
+            CompiledWrapper* obj = new CompiledWrapper(new CompiledCircuit(std::move(circuit), params));
+            obj->Wrap(info.This());
+            info.GetReturnValue().Set(info.This());
+        } catch (std::runtime_error &error) {
+            Nan::ThrowError(error.what());
+        }
+    } else {
+        // Invoked as plain function `CompiledCircuit(...)`, turn into construct call.
+        const int argc = 2;
+        v8::Local<v8::Value> argv[argc] = { info[0], info[1] };
+        v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+        info.GetReturnValue().Set(cons->NewInstance(context, argc, argv).ToLocalChecked());
+    }
+}
+
+void CompiledWrapper::numBlocks(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    CompiledWrapper* obj = ObjectWrap::Unwrap<CompiledWrapper>(info.Holder());
+    info.GetReturnValue().Set(Number::New(info.GetIsolate(), obj->_circuit->blocks().size()));
+}
+
+void CompiledWrapper::numParameters(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    CompiledWrapper* obj = ObjectWrap::Unwrap<CompiledWrapper>(info.Holder());
+    info.GetReturnValue().Set(Number::New(info.GetIsolate(), obj->_circuit->num_parameters()));
+}
+
+void CompiledWrapper::save(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    CompiledWrapper* obj = ObjectWrap::Unwrap<CompiledWrapper>(info.Holder());
+    String::Utf8Value path(info.GetIsolate(), info[0]);
+
+    try {
+        save_compiled_circuit(*obj->_circuit, *path);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
@@ -0,0 +1,50 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef COMPILED_WRAPPER_HPP_
+#define COMPILED_WRAPPER_HPP_
+
+#include <nan.h>
+#include "simulator.hpp"
+#include "circuitfile.hpp"
+
+// JS binding of CompiledCircuit, exported as `CompiledCircuit`. It is
+// built from the same gate descriptors as getExpectationGradient (or
+// loaded from a file written by save(), see circuitfile.hpp) and replayed
+// with Simulator.applyCompiled.
+class CompiledWrapper : public Nan::ObjectWrap {
+public:
+    static void Init(v8::Local<v8::Object> exports);
+
+    // the compiled circuit of a CompiledCircuit object, nullptr for other values
+    static CompiledCircuit* unwrap(v8::Local<v8::Value> value);
+private:
+    explicit CompiledWrapper(CompiledCircuit *circuit);
+    ~CompiledWrapper();
+
+    static void New(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void numBlocks(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void numParameters(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void save(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static Nan::Persistent<v8::Function> constructor;
+    static Nan::Persistent<v8::FunctionTemplate> tmpl;
+
+    CompiledCircuit *_circuit;
+};
+
+#endif
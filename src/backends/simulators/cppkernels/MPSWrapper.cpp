@@ -0,0 +1,228 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Wrapper.hpp"
+#include "MPSWrapper.hpp"
+
+Nan::Persistent<v8::Function> MPSWrapper::constructor;
+
+MPSWrapper::MPSWrapper(int seed, unsigned maxBondDimension) {
+    _simulator = new MPSSimulator(seed, maxBondDimension);
+}
+
+MPSWrapper::~MPSWrapper() {
+    delete _simulator;
+}
+
+void MPSWrapper::Init(v8::Local<v8::Object> exports) {
+    Nan::HandleScope scope;
+
+    // Prepare constructor template
+    v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New("MPSSimulator").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+    // Prototype
+    Nan::SetPrototypeMethod(tpl, "allocateQubit", allocateQubit);
+    Nan::SetPrototypeMethod(tpl, "deallocateQubit", deallocateQubit);
+    Nan::SetPrototypeMethod(tpl, "getClassicalValue", getClassicalValue);
+    Nan::SetPrototypeMethod(tpl, "isClassical", isClassical);
+    Nan::SetPrototypeMethod(tpl, "measureQubits", measureQubits);
+    Nan::SetPrototypeMethod(tpl, "applyControlledGate", applyControlledGate);
+    Nan::SetPrototypeMethod(tpl, "getAmplitude", getAmplitude);
+    Nan::SetPrototypeMethod(tpl, "getBondDimensions", getBondDimensions);
+    Nan::SetPrototypeMethod(tpl, "getTruncationError", getTruncationError);
+    Nan::SetPrototypeMethod(tpl, "setMaxBondDimension", setMaxBondDimension);
+    Nan::SetPrototypeMethod(tpl, "run", run);
+
+    auto ctx = Nan::GetCurrentContext();
+    constructor.Reset(tpl->GetFunction(ctx).ToLocalChecked());
+    exports->Set(ctx, Nan::New("MPSSimulator").ToLocalChecked(), tpl->GetFunction(ctx).ToLocalChecked());
+}
+
+// new MPSSimulator(seed, maxBondDimension = 64)
+void MPSWrapper::New(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+    auto isolate = info.GetIsolate();
+    auto context = isolate->GetCurrentContext();
+    if (info.IsConstructCall()) {
+        auto seed = info[0]->IsUndefined() ? 0 : info[0]->NumberValue(context).FromJust();
+        unsigned maxBond = info[1]->IsUndefined() ? 64 : info[1]->Uint32Value(context).FromJust();
+        try {
+            MPSWrapper* obj = new MPSWrapper(seed, maxBond);
+            obj->Wrap(info.This());
+            info.GetReturnValue().Set(info.This());
+        } catch (std::runtime_error &error) {
+            Nan::ThrowError(error.what());
+        }
+    } else {
+        // Invoked as plain function `MPSSimulator(...)`, turn into construct call.
+        const int argc = 2;
+        v8::Local<v8::Value> argv[argc] = { info[0], info[1] };
+        v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+        info.GetReturnValue().Set(cons->NewInstance(context, argc, argv).ToLocalChecked());
+    }
+}
+
+void MPSWrapper::allocateQubit(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+    auto ctx = Nan::GetCurrentContext();
+    MPSWrapper* obj = ObjectWrap::Unwrap<MPSWrapper>(info.Holder());
+    auto id = info[0]->Uint32Value(ctx).FromJust();
+
+    try {
+        obj->_simulator->allocate_qubit(id);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void MPSWrapper::deallocateQubit(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    MPSWrapper* obj = ObjectWrap::Unwrap<MPSWrapper>(info.Holder());
+    auto id = info[0]->Uint32Value(ctx).FromJust();
+
+    try {
+        obj->_simulator->deallocate_qubit(id);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void MPSWrapper::getClassicalValue(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    MPSWrapper* obj = ObjectWrap::Unwrap<MPSWrapper>(info.Holder());
+    auto id = info[0]->Uint32Value(ctx).FromJust();
+    double calc = info[1]->IsUndefined() ? 1.e-12 : info[1]->NumberValue(ctx).FromJust();
+
+    try {
+        info.GetReturnValue().Set(obj->_simulator->get_classical_value(id, calc));
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void MPSWrapper::isClassical(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    MPSWrapper* obj = ObjectWrap::Unwrap<MPSWrapper>(info.Holder());
+    auto id = info[0]->Uint32Value(ctx).FromJust();
+    double calc = info[1]->IsUndefined() ? 1.e-12 : info[1]->NumberValue(ctx).FromJust();
+
+    try {
+        info.GetReturnValue().Set(obj->_simulator->is_classical(id, calc));
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void MPSWrapper::measureQubits(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    MPSWrapper* obj = ObjectWrap::Unwrap<MPSWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+
+    v8::Local<v8::Array> jsArray = v8::Local<v8::Array>::Cast(info[0]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(jsArray, ids);
+
+    try {
+        auto result = obj->_simulator->measure_qubits_return(ids);
+
+        Local<Array> ret = Array::New(isolate, result.size());
+        for (size_t i = 0; i < result.size(); ++i) {
+            ret->Set(ctx, i, Number::New(isolate, result[i]));
+        }
+        info.GetReturnValue().Set(ret);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void MPSWrapper::applyControlledGate(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    MPSWrapper* obj = ObjectWrap::Unwrap<MPSWrapper>(info.Holder());
+    Isolate *isolate = info.GetIsolate();
+    auto mat = Local<Array>::Cast(info[0]);
+    MatrixType m;
+    jsToMatrix(isolate, mat, m);
+
+    auto idsArray = v8::Local<v8::Array>::Cast(info[1]);
+    auto controlArray = v8::Local<v8::Array>::Cast(info[2]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(idsArray, ids);
+
+    std::vector<unsigned int> ctrl;
+    jsToArray<unsigned int>(controlArray, ctrl);
+
+    try {
+        obj->_simulator->apply_controlled_gate(m, ids, ctrl);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void MPSWrapper::getAmplitude(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+
+    MPSWrapper* obj = ObjectWrap::Unwrap<MPSWrapper>(info.Holder());
+    Local<Array> i1 = Local<Array>::Cast(info[0]);
+    std::vector<bool> bitString;
+    jsToArray<bool>(i1, bitString);
+
+    Local<Array> i2 = Local<Array>::Cast(info[1]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(i2, ids);
+
+    try {
+        auto result = obj->_simulator->get_amplitude(bitString, ids);
+
+        Local<Object> ret = Object::New(isolate);
+        ret->Set(ctx, String::NewFromUtf8(isolate, "re").ToLocalChecked(), Number::New(isolate, result.real()));
+        ret->Set(ctx, String::NewFromUtf8(isolate, "im").ToLocalChecked(), Number::New(isolate, result.imag()));
+        info.GetReturnValue().Set(ret);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void MPSWrapper::getBondDimensions(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+    MPSWrapper* obj = ObjectWrap::Unwrap<MPSWrapper>(info.Holder());
+
+    auto dims = obj->_simulator->bond_dimensions();
+    Local<Array> ret = Array::New(isolate, dims.size());
+    for (size_t i = 0; i < dims.size(); ++i) {
+        ret->Set(ctx, i, Number::New(isolate, dims[i]));
+    }
+    info.GetReturnValue().Set(ret);
+}
+
+void MPSWrapper::getTruncationError(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    MPSWrapper* obj = ObjectWrap::Unwrap<MPSWrapper>(info.Holder());
+    info.GetReturnValue().Set(obj->_simulator->truncation_error());
+}
+
+void MPSWrapper::setMaxBondDimension(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    MPSWrapper* obj = ObjectWrap::Unwrap<MPSWrapper>(info.Holder());
+
+    try {
+        obj->_simulator->set_max_bond_dimension(info[0]->Uint32Value(ctx).FromJust());
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void MPSWrapper::run(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    MPSWrapper* obj = ObjectWrap::Unwrap<MPSWrapper>(info.Holder());
+    obj->_simulator->run();
+}
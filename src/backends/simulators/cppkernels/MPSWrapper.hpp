@@ -0,0 +1,60 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPS_WRAPPER_HPP_
+#define MPS_WRAPPER_HPP_
+
+#include <nan.h>
+#include "mps.hpp"
+
+// JS binding of MPSSimulator, exported as `MPSSimulator`. Mirrors the
+// Simulator binding and adds access to the bond dimensions and the
+// accumulated truncation error.
+class MPSWrapper : public Nan::ObjectWrap {
+public:
+    static void Init(v8::Local<v8::Object> exports);
+private:
+    explicit MPSWrapper(int seed = 1, unsigned maxBondDimension = 64);
+    ~MPSWrapper();
+
+    static void New(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void allocateQubit(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void deallocateQubit(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void getClassicalValue(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void isClassical(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void measureQubits(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void applyControlledGate(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void getAmplitude(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void getBondDimensions(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void getTruncationError(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void setMaxBondDimension(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void run(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static Nan::Persistent<v8::Function> constructor;
+
+    MPSSimulator *_simulator;
+};
+
+#endif
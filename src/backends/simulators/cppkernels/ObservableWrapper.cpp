@@ -0,0 +1,85 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Wrapper.hpp"
+#include "ObservableWrapper.hpp"
+
+Nan::Persistent<v8::Function> ObservableWrapper::constructor;
+Nan::Persistent<v8::FunctionTemplate> ObservableWrapper::tmpl;
+
+ObservableWrapper::ObservableWrapper(Observable *observable) : _observable(observable) {
+}
+
+ObservableWrapper::~ObservableWrapper() {
+    delete _observable;
+}
+
+void ObservableWrapper::Init(v8::Local<v8::Object> exports) {
+    Nan::HandleScope scope;
+
+    // Prepare constructor template
+    v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New("Observable").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+    // Prototype
+    Nan::SetPrototypeMethod(tpl, "numTerms", numTerms);
+    Nan::SetPrototypeMethod(tpl, "numQubits", numQubits);
+
+    auto ctx = Nan::GetCurrentContext();
+    tmpl.Reset(tpl);
+    constructor.Reset(tpl->GetFunction(ctx).ToLocalChecked());
+    exports->Set(ctx, Nan::New("Observable").ToLocalChecked(), tpl->GetFunction(ctx).ToLocalChecked());
+}
+
+Observable* ObservableWrapper::unwrap(v8::Local<v8::Value> value) {
+    if (!value->IsObject() || !Nan::New(tmpl)->HasInstance(value))
+        return nullptr;
+    auto obj = value->ToObject(Nan::GetCurrentContext()).ToLocalChecked();
+    return ObjectWrap::Unwrap<ObservableWrapper>(obj)->_observable;
+}
+
+// new Observable(terms), terms: [[[[position, 'X' | 'Y' | 'Z'], ...], coefficient], ...]
+void ObservableWrapper::New(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+    auto isolate = info.GetIsolate();
+    auto context = isolate->GetCurrentContext();
+    if (info.IsConstructCall()) {
+        Local<Array> terms = Local<Array>::Cast(info[0]);
+        Simulator::TermsDict termsDict;
+        jsToTermDictionary(isolate, terms, termsDict);
+        try {
+            ObservableWrapper* obj = new ObservableWrapper(new Observable(termsDict));
+            obj->Wrap(info.This());
+            info.GetReturnValue().Set(info.This());
+        } catch (std::runtime_error &error) {
+            Nan::ThrowError(error.what());
+        }
+    } else {
+        // Invoked as plain function `Observable(...)`, turn into construct call.
+        const int argc = 1;
+        v8::Local<v8::Value> argv[argc] = { info[0] };
+        v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+        info.GetReturnValue().Set(cons->NewInstance(context, argc, argv).ToLocalChecked());
+    }
+}
+
+void ObservableWrapper::numTerms(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    ObservableWrapper* obj = ObjectWrap::Unwrap<ObservableWrapper>(info.Holder());
+    info.GetReturnValue().Set(Number::New(info.GetIsolate(), obj->_observable->size()));
+}
+
+void ObservableWrapper::numQubits(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    ObservableWrapper* obj = ObjectWrap::Unwrap<ObservableWrapper>(info.Holder());
+    info.GetReturnValue().Set(Number::New(info.GetIsolate(), obj->_observable->num_qubits()));
+}
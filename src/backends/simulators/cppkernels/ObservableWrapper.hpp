@@ -0,0 +1,47 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef OBSERVABLE_WRAPPER_HPP_
+#define OBSERVABLE_WRAPPER_HPP_
+
+#include <nan.h>
+#include "simulator.hpp"
+
+// JS binding of Observable, exported as `Observable`. It is built from the
+// same terms as getExpectationValue and passed to it instead of the terms,
+// which skips converting them on every call.
+class ObservableWrapper : public Nan::ObjectWrap {
+public:
+    static void Init(v8::Local<v8::Object> exports);
+
+    // the observable of an Observable object, nullptr for other values
+    static Observable* unwrap(v8::Local<v8::Value> value);
+private:
+    explicit ObservableWrapper(Observable *observable);
+    ~ObservableWrapper();
+
+    static void New(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void numTerms(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void numQubits(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static Nan::Persistent<v8::Function> constructor;
+    static Nan::Persistent<v8::FunctionTemplate> tmpl;
+
+    Observable *_observable;
+};
+
+#endif
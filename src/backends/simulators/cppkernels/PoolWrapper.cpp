@@ -0,0 +1,187 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Wrapper.hpp"
+#include "PoolWrapper.hpp"
+
+Nan::Persistent<v8::Function> PoolWrapper::constructor;
+
+PoolWrapper::PoolWrapper(unsigned threads, int seed) : _resource("SimulatorPool") {
+    _async = new uv_async_t;
+    uv_async_init(Nan::GetCurrentEventLoop(), _async, complete);
+    _async->data = this;
+    // only keep the event loop alive while jobs are pending
+    uv_unref(reinterpret_cast<uv_handle_t*>(_async));
+
+    _pool = new SimulatorPool(threads, seed, [this](SimulatorPool::Result &result) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _done.push_back(std::move(result));
+        }
+        uv_async_send(_async);
+    });
+}
+
+PoolWrapper::~PoolWrapper() {
+    delete _pool;
+    for (auto &item : _callbacks)
+        delete item.second;
+    uv_close(reinterpret_cast<uv_handle_t*>(_async), [](uv_handle_t *handle) {
+        delete reinterpret_cast<uv_async_t*>(handle);
+    });
+}
+
+void PoolWrapper::Init(v8::Local<v8::Object> exports) {
+    Nan::HandleScope scope;
+
+    // Prepare constructor template
+    v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New("SimulatorPool").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+    // Prototype
+    Nan::SetPrototypeMethod(tpl, "submit", submit);
+    Nan::SetPrototypeMethod(tpl, "pending", pending);
+    Nan::SetPrototypeMethod(tpl, "numThreads", numThreads);
+
+    auto ctx = Nan::GetCurrentContext();
+    constructor.Reset(tpl->GetFunction(ctx).ToLocalChecked());
+    exports->Set(ctx, Nan::New("SimulatorPool").ToLocalChecked(), tpl->GetFunction(ctx).ToLocalChecked());
+}
+
+// new SimulatorPool(threads = 0, seed), threads = 0 uses all cores
+void PoolWrapper::New(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+    auto isolate = info.GetIsolate();
+    auto context = isolate->GetCurrentContext();
+    if (info.IsConstructCall()) {
+        unsigned threads = info[0]->IsUndefined() ? 0 : info[0]->Uint32Value(context).FromJust();
+        auto seed = info[1]->IsUndefined() ? 0 : info[1]->NumberValue(context).FromJust();
+        try {
+            PoolWrapper* obj = new PoolWrapper(threads, seed);
+            obj->Wrap(info.This());
+            info.GetReturnValue().Set(info.This());
+        } catch (std::runtime_error &error) {
+            Nan::ThrowError(error.what());
+        }
+    } else {
+        // Invoked as plain function `SimulatorPool(...)`, turn into construct call.
+        const int argc = 2;
+        v8::Local<v8::Value> argv[argc] = { info[0], info[1] };
+        v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+        info.GetReturnValue().Set(cons->NewInstance(context, argc, argv).ToLocalChecked());
+    }
+}
+
+// submit(numQubits, [[matrix, ids, controls], ...], measuredIds, shots, probabilities, callback)
+// returns the job id; callback(error, {id, samples, probabilities}) is called
+// on the main thread.
+void PoolWrapper::submit(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    PoolWrapper* obj = ObjectWrap::Unwrap<PoolWrapper>(info.Holder());
+    Isolate *isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+
+    if (!info[5]->IsFunction()) {
+        Nan::ThrowTypeError("SimulatorPool: submit expects a callback.");
+        return;
+    }
+
+    SimulatorPool::Job job;
+    job.num_qubits = info[0]->Uint32Value(ctx).FromJust();
+    auto gates = Local<Array>::Cast(info[1]);
+    job.gates.resize(gates->Length());
+    for (uint32_t i = 0; i < gates->Length(); ++i) {
+        auto gate = Local<Array>::Cast(gates->Get(ctx, i).ToLocalChecked());
+        auto mat = Local<Array>::Cast(gate->Get(ctx, 0).ToLocalChecked());
+        auto ids = Local<Array>::Cast(gate->Get(ctx, 1).ToLocalChecked());
+        auto ctrl = Local<Array>::Cast(gate->Get(ctx, 2).ToLocalChecked());
+        jsToMatrix(isolate, mat, job.gates[i].matrix);
+        jsToArray<unsigned int>(ids, job.gates[i].ids);
+        jsToArray<unsigned int>(ctrl, job.gates[i].ctrl);
+    }
+    auto measured = Local<Array>::Cast(info[2]);
+    jsToArray<unsigned int>(measured, job.measured);
+    job.shots = info[3]->IsUndefined() ? 0 : info[3]->Uint32Value(ctx).FromJust();
+    job.probabilities = info[4]->BooleanValue(isolate);
+
+    if (obj->_callbacks.empty()) {
+        obj->Ref();
+        uv_ref(reinterpret_cast<uv_handle_t*>(obj->_async));
+    }
+    // the callback is registered before the job can complete: results are
+    // only picked up on this thread
+    auto id = obj->_pool->submit(std::move(job));
+    obj->_callbacks[id] = new Nan::Callback(Local<Function>::Cast(info[5]));
+    info.GetReturnValue().Set(Number::New(isolate, id));
+}
+
+void PoolWrapper::pending(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    PoolWrapper* obj = ObjectWrap::Unwrap<PoolWrapper>(info.Holder());
+    info.GetReturnValue().Set(Number::New(info.GetIsolate(), obj->_callbacks.size()));
+}
+
+void PoolWrapper::numThreads(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    PoolWrapper* obj = ObjectWrap::Unwrap<PoolWrapper>(info.Holder());
+    info.GetReturnValue().Set(Number::New(info.GetIsolate(), obj->_pool->num_threads()));
+}
+
+// runs on the main thread whenever workers have signalled completed jobs
+void PoolWrapper::complete(uv_async_t *handle) {
+    Nan::HandleScope scope;
+    auto isolate = Isolate::GetCurrent();
+    auto ctx = isolate->GetCurrentContext();
+    auto obj = static_cast<PoolWrapper*>(handle->data);
+
+    std::vector<SimulatorPool::Result> done;
+    {
+        std::lock_guard<std::mutex> lock(obj->_mutex);
+        done.swap(obj->_done);
+    }
+    // uv_async_send coalesces, so results may already have been handled
+    if (done.empty())
+        return;
+    for (auto &result : done) {
+        auto it = obj->_callbacks.find(result.id);
+        if (it == obj->_callbacks.end())
+            continue;
+        std::unique_ptr<Nan::Callback> callback(it->second);
+        obj->_callbacks.erase(it);
+
+        v8::Local<v8::Value> argv[2];
+        if (!result.error.empty()) {
+            argv[0] = Nan::Error(result.error.c_str());
+            argv[1] = Nan::Undefined();
+        } else {
+            Local<Object> ret = Object::New(isolate);
+            Local<Array> samples = Array::New(isolate, result.samples.size());
+            for (size_t i = 0; i < result.samples.size(); ++i) {
+                samples->Set(ctx, i, Number::New(isolate, result.samples[i]));
+            }
+            Local<Array> probabilities = Array::New(isolate, result.probabilities.size());
+            for (size_t i = 0; i < result.probabilities.size(); ++i) {
+                probabilities->Set(ctx, i, Number::New(isolate, result.probabilities[i]));
+            }
+            ret->Set(ctx, String::NewFromUtf8(isolate, "id").ToLocalChecked(), Number::New(isolate, result.id));
+            ret->Set(ctx, String::NewFromUtf8(isolate, "samples").ToLocalChecked(), samples);
+            ret->Set(ctx, String::NewFromUtf8(isolate, "probabilities").ToLocalChecked(), probabilities);
+            argv[0] = Nan::Null();
+            argv[1] = ret;
+        }
+        callback->Call(2, argv, &obj->_resource);
+    }
+    // callbacks may have submitted new jobs
+    if (obj->_callbacks.empty()) {
+        uv_unref(reinterpret_cast<uv_handle_t*>(obj->_async));
+        obj->Unref();
+    }
+}
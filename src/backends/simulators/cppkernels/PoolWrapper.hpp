@@ -0,0 +1,54 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef POOL_WRAPPER_HPP_
+#define POOL_WRAPPER_HPP_
+
+#include <nan.h>
+#include <map>
+#include "pool.hpp"
+
+// JS binding of SimulatorPool, exported as `SimulatorPool`. submit() takes a
+// job description and a node-style callback which is invoked on the main
+// thread once the job has finished; results are handed over from the
+// workers through a uv_async_t. The object (and the event loop) is kept
+// alive while jobs are pending.
+class PoolWrapper : public Nan::ObjectWrap {
+public:
+    static void Init(v8::Local<v8::Object> exports);
+private:
+    explicit PoolWrapper(unsigned threads = 0, int seed = 1);
+    ~PoolWrapper();
+
+    static void New(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void submit(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void pending(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void numThreads(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void complete(uv_async_t *handle);
+
+    static Nan::Persistent<v8::Function> constructor;
+
+    SimulatorPool *_pool;
+    uv_async_t *_async;
+    Nan::AsyncResource _resource;
+    std::mutex _mutex;
+    std::vector<SimulatorPool::Result> _done; // guarded by _mutex
+    std::map<std::size_t, Nan::Callback*> _callbacks;
+};
+
+#endif
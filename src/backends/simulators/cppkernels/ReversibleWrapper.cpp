@@ -0,0 +1,301 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Wrapper.hpp"
+#include "ReversibleWrapper.hpp"
+
+Nan::Persistent<v8::Function> ReversibleWrapper::constructor;
+
+ReversibleWrapper::ReversibleWrapper(unsigned patterns) {
+    _simulator = new ReversibleSimulator(patterns);
+}
+
+ReversibleWrapper::~ReversibleWrapper() {
+    delete _simulator;
+}
+
+void ReversibleWrapper::Init(v8::Local<v8::Object> exports) {
+    Nan::HandleScope scope;
+
+    // Prepare constructor template
+    v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New("ReversibleSimulator").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+    // Prototype
+    Nan::SetPrototypeMethod(tpl, "allocateQubit", allocateQubit);
+    Nan::SetPrototypeMethod(tpl, "deallocateQubit", deallocateQubit);
+    Nan::SetPrototypeMethod(tpl, "getClassicalValue", getClassicalValue);
+    Nan::SetPrototypeMethod(tpl, "measureQubits", measureQubits);
+    Nan::SetPrototypeMethod(tpl, "applyOps", applyOps);
+    Nan::SetPrototypeMethod(tpl, "emulateMath", emulateMath);
+    Nan::SetPrototypeMethod(tpl, "emulateMathOperation", emulateMathOperation);
+    Nan::SetPrototypeMethod(tpl, "readRegister", readRegister);
+    Nan::SetPrototypeMethod(tpl, "writeRegister", writeRegister);
+    Nan::SetPrototypeMethod(tpl, "readRegisterPatterns", readRegisterPatterns);
+    Nan::SetPrototypeMethod(tpl, "writeRegisterPatterns", writeRegisterPatterns);
+    Nan::SetPrototypeMethod(tpl, "run", run);
+
+    auto ctx = Nan::GetCurrentContext();
+    constructor.Reset(tpl->GetFunction(ctx).ToLocalChecked());
+    exports->Set(ctx, Nan::New("ReversibleSimulator").ToLocalChecked(), tpl->GetFunction(ctx).ToLocalChecked());
+}
+
+// new ReversibleSimulator(patterns = 1)
+void ReversibleWrapper::New(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+    auto isolate = info.GetIsolate();
+    auto context = isolate->GetCurrentContext();
+    if (info.IsConstructCall()) {
+        unsigned patterns = info[0]->IsUndefined() ? 1 : info[0]->Uint32Value(context).FromJust();
+        try {
+            ReversibleWrapper* obj = new ReversibleWrapper(patterns);
+            obj->Wrap(info.This());
+            info.GetReturnValue().Set(info.This());
+        } catch (std::runtime_error &error) {
+            Nan::ThrowError(error.what());
+        }
+    } else {
+        // Invoked as plain function `ReversibleSimulator(...)`, turn into construct call.
+        const int argc = 1;
+        v8::Local<v8::Value> argv[argc] = { info[0] };
+        v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+        info.GetReturnValue().Set(cons->NewInstance(context, argc, argv).ToLocalChecked());
+    }
+}
+
+void ReversibleWrapper::allocateQubit(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+    auto ctx = Nan::GetCurrentContext();
+    ReversibleWrapper* obj = ObjectWrap::Unwrap<ReversibleWrapper>(info.Holder());
+    auto id = info[0]->Uint32Value(ctx).FromJust();
+
+    try {
+        obj->_simulator->allocate_qubit(id);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void ReversibleWrapper::deallocateQubit(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    ReversibleWrapper* obj = ObjectWrap::Unwrap<ReversibleWrapper>(info.Holder());
+    auto id = info[0]->Uint32Value(ctx).FromJust();
+
+    try {
+        obj->_simulator->deallocate_qubit(id);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+// getClassicalValue(id, pattern = 0)
+void ReversibleWrapper::getClassicalValue(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    ReversibleWrapper* obj = ObjectWrap::Unwrap<ReversibleWrapper>(info.Holder());
+    auto id = info[0]->Uint32Value(ctx).FromJust();
+    unsigned pattern = info[1]->IsUndefined() ? 0 : info[1]->Uint32Value(ctx).FromJust();
+
+    try {
+        info.GetReturnValue().Set(obj->_simulator->get_classical_value(id, pattern));
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void ReversibleWrapper::measureQubits(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    ReversibleWrapper* obj = ObjectWrap::Unwrap<ReversibleWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+
+    v8::Local<v8::Array> jsArray = v8::Local<v8::Array>::Cast(info[0]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(jsArray, ids);
+
+    try {
+        auto result = obj->_simulator->measure_qubits_return(ids);
+
+        Local<Array> ret = Array::New(isolate, result.size());
+        for (size_t i = 0; i < result.size(); ++i) {
+            ret->Set(ctx, i, Number::New(isolate, result[i]));
+        }
+        info.GetReturnValue().Set(ret);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+// applyOps(ops), see ReversibleSimulator::OpCode for the encoding
+void ReversibleWrapper::applyOps(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    ReversibleWrapper* obj = ObjectWrap::Unwrap<ReversibleWrapper>(info.Holder());
+    auto opsArray = v8::Local<v8::Array>::Cast(info[0]);
+    std::vector<unsigned int> ops;
+    ops.reserve(opsArray->Length());
+    jsToArray<unsigned int>(opsArray, ops);
+
+    try {
+        obj->_simulator->apply_ops(ops);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void ReversibleWrapper::emulateMath(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    ReversibleWrapper* obj = ObjectWrap::Unwrap<ReversibleWrapper>(info.Holder());
+    Local<Function> cbFunc = Local<Function>::Cast(info[0]);
+    Nan::Callback cb(cbFunc);
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+
+    auto f = [&](std::vector<int>& x) {
+        const int argc = 1;
+        v8::Local<v8::Value> args1[argc];
+        Local<Array> arg = Array::New(isolate, x.size());
+        for (size_t i = 0; i < x.size(); ++i) {
+            arg->Set(ctx, i, Number::New(isolate, x[i]));
+        }
+        args1[0] = arg;
+
+        Local<Array> result = Local<Array>::Cast(cb.Call(argc, args1));
+        std::vector<int> ret;
+        ret.reserve(result->Length());
+        jsToArray<int>(result, ret);
+        x = std::move(ret);
+    };
+    v8::Local<v8::Array> quregArray = v8::Local<v8::Array>::Cast(info[1]);
+    QuRegs regs;
+    jsToQuRegs(isolate, quregArray, regs);
+
+    Local<Array> ctrlArray = Local<Array>::Cast(info[2]);
+    std::vector<unsigned int> ctrls;
+    jsToArray<unsigned int>(ctrlArray, ctrls);
+
+    try {
+        obj->_simulator->emulate_math(f, regs, ctrls);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void ReversibleWrapper::emulateMathOperation(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    ReversibleWrapper* obj = ObjectWrap::Unwrap<ReversibleWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+
+    // descriptor: [kind, a, N], see MathOperation::Kind
+    Local<Array> opArray = Local<Array>::Cast(info[0]);
+    std::vector<double> desc;
+    for (uint32_t i = 0; i < opArray->Length(); ++i)
+        desc.push_back(opArray->Get(ctx, i).ToLocalChecked()->NumberValue(ctx).FromJust());
+    desc.resize(3, 0.);
+
+    Local<Array> quregArray = Local<Array>::Cast(info[1]);
+    QuRegs regs;
+    jsToQuRegs(isolate, quregArray, regs);
+
+    Local<Array> ctrlArray = Local<Array>::Cast(info[2]);
+    std::vector<unsigned int> ctrls;
+    jsToArray<unsigned int>(ctrlArray, ctrls);
+
+    try {
+        MathOperation op(static_cast<unsigned>(desc[0]), static_cast<std::int64_t>(desc[1]),
+                         static_cast<std::int64_t>(desc[2]));
+        obj->_simulator->emulate_math_operation(op, regs, ctrls);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+// readRegister(ids, pattern = 0)
+void ReversibleWrapper::readRegister(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    ReversibleWrapper* obj = ObjectWrap::Unwrap<ReversibleWrapper>(info.Holder());
+    auto idsArray = v8::Local<v8::Array>::Cast(info[0]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(idsArray, ids);
+    unsigned pattern = info[1]->IsUndefined() ? 0 : info[1]->Uint32Value(ctx).FromJust();
+
+    try {
+        auto value = obj->_simulator->read_register(ids, pattern);
+        info.GetReturnValue().Set(static_cast<double>(value));
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+// writeRegister(ids, value, pattern = 0)
+void ReversibleWrapper::writeRegister(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    ReversibleWrapper* obj = ObjectWrap::Unwrap<ReversibleWrapper>(info.Holder());
+    auto idsArray = v8::Local<v8::Array>::Cast(info[0]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(idsArray, ids);
+    auto value = static_cast<std::uint64_t>(info[1]->NumberValue(ctx).FromJust());
+    unsigned pattern = info[2]->IsUndefined() ? 0 : info[2]->Uint32Value(ctx).FromJust();
+
+    try {
+        obj->_simulator->write_register(ids, value, pattern);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void ReversibleWrapper::readRegisterPatterns(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+    ReversibleWrapper* obj = ObjectWrap::Unwrap<ReversibleWrapper>(info.Holder());
+    auto idsArray = v8::Local<v8::Array>::Cast(info[0]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(idsArray, ids);
+
+    try {
+        auto values = obj->_simulator->read_register_patterns(ids);
+        Local<Array> ret = Array::New(isolate, values.size());
+        for (size_t i = 0; i < values.size(); ++i) {
+            ret->Set(ctx, i, Number::New(isolate, static_cast<double>(values[i])));
+        }
+        info.GetReturnValue().Set(ret);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void ReversibleWrapper::writeRegisterPatterns(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    ReversibleWrapper* obj = ObjectWrap::Unwrap<ReversibleWrapper>(info.Holder());
+    auto idsArray = v8::Local<v8::Array>::Cast(info[0]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(idsArray, ids);
+
+    auto valueArray = v8::Local<v8::Array>::Cast(info[1]);
+    std::vector<std::uint64_t> values;
+    values.reserve(valueArray->Length());
+    for (uint32_t i = 0; i < valueArray->Length(); ++i) {
+        auto v = valueArray->Get(ctx, i).ToLocalChecked()->NumberValue(ctx).FromJust();
+        values.push_back(static_cast<std::uint64_t>(v));
+    }
+
+    try {
+        obj->_simulator->write_register_patterns(ids, values);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void ReversibleWrapper::run(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    ReversibleWrapper* obj = ObjectWrap::Unwrap<ReversibleWrapper>(info.Holder());
+    try {
+        obj->_simulator->run();
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
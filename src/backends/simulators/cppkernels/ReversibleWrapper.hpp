@@ -0,0 +1,62 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef REVERSIBLE_WRAPPER_HPP_
+#define REVERSIBLE_WRAPPER_HPP_
+
+#include <nan.h>
+#include "reversible.hpp"
+
+// JS binding of ReversibleSimulator, exported as `ReversibleSimulator`.
+// Gates are passed in batches (applyOps), and registers can be read and
+// written per pattern or for all patterns at once.
+class ReversibleWrapper : public Nan::ObjectWrap {
+public:
+    static void Init(v8::Local<v8::Object> exports);
+private:
+    explicit ReversibleWrapper(unsigned patterns = 1);
+    ~ReversibleWrapper();
+
+    static void New(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void allocateQubit(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void deallocateQubit(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void getClassicalValue(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void measureQubits(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void applyOps(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void emulateMath(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void emulateMathOperation(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void readRegister(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void writeRegister(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void readRegisterPatterns(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void writeRegisterPatterns(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void run(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static Nan::Persistent<v8::Function> constructor;
+
+    ReversibleSimulator *_simulator;
+};
+
+#endif
@@ -0,0 +1,170 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "StabilizerWrapper.hpp"
+
+using namespace v8;
+
+static void jsToIds(Local<Value> value, std::vector<unsigned int> &ids) {
+    auto ctx = Nan::GetCurrentContext();
+    auto jsArray = Local<Array>::Cast(value);
+    ids.reserve(jsArray->Length());
+    for (uint32_t i = 0; i < jsArray->Length(); i++) {
+        Local<Value> elem;
+        jsArray->Get(ctx, i).ToLocal(&elem);
+        ids.push_back(elem->Uint32Value(ctx).FromJust());
+    }
+}
+
+Nan::Persistent<v8::Function> StabilizerWrapper::constructor;
+
+StabilizerWrapper::StabilizerWrapper(int seed) {
+    _simulator = new StabilizerSimulator(seed);
+}
+
+StabilizerWrapper::~StabilizerWrapper() {
+    delete _simulator;
+}
+
+void StabilizerWrapper::Init(v8::Local<v8::Object> exports) {
+    Nan::HandleScope scope;
+
+    // Prepare constructor template
+    v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New("StabilizerSimulator").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+    // Prototype
+    Nan::SetPrototypeMethod(tpl, "allocateQubit", allocateQubit);
+    Nan::SetPrototypeMethod(tpl, "deallocateQubit", deallocateQubit);
+    Nan::SetPrototypeMethod(tpl, "getClassicalValue", getClassicalValue);
+    Nan::SetPrototypeMethod(tpl, "isClassical", isClassical);
+    Nan::SetPrototypeMethod(tpl, "measureQubits", measureQubits);
+    Nan::SetPrototypeMethod(tpl, "applyControlledGate", applyControlledGate);
+    Nan::SetPrototypeMethod(tpl, "run", run);
+
+    auto ctx = Nan::GetCurrentContext();
+    constructor.Reset(tpl->GetFunction(ctx).ToLocalChecked());
+    exports->Set(ctx, Nan::New("StabilizerSimulator").ToLocalChecked(), tpl->GetFunction(ctx).ToLocalChecked());
+}
+
+void StabilizerWrapper::New(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+    auto isolate = info.GetIsolate();
+    auto context = isolate->GetCurrentContext();
+    if (info.IsConstructCall()) {
+        // Invoked as constructor: `new StabilizerSimulator(...)`
+        auto value = info[0]->IsUndefined() ? 0 : info[0]->NumberValue(context).FromJust();
+        StabilizerWrapper* obj = new StabilizerWrapper(value);
+        obj->Wrap(info.This());
+        info.GetReturnValue().Set(info.This());
+    } else {
+        // Invoked as plain function `StabilizerSimulator(...)`, turn into construct call.
+        const int argc = 1;
+        v8::Local<v8::Value> argv[argc] = { info[0] };
+        v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+        info.GetReturnValue().Set(cons->NewInstance(context, argc, argv).ToLocalChecked());
+    }
+}
+
+void StabilizerWrapper::allocateQubit(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+    auto ctx = Nan::GetCurrentContext();
+    StabilizerWrapper* obj = ObjectWrap::Unwrap<StabilizerWrapper>(info.Holder());
+    auto id = info[0]->Uint32Value(ctx).FromJust();
+
+    try {
+        obj->_simulator->allocate_qubit(id);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void StabilizerWrapper::deallocateQubit(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    StabilizerWrapper* obj = ObjectWrap::Unwrap<StabilizerWrapper>(info.Holder());
+    auto id = info[0]->Uint32Value(ctx).FromJust();
+
+    try {
+        obj->_simulator->deallocate_qubit(id);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void StabilizerWrapper::getClassicalValue(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    StabilizerWrapper* obj = ObjectWrap::Unwrap<StabilizerWrapper>(info.Holder());
+    auto id = info[0]->Uint32Value(ctx).FromJust();
+
+    try {
+        info.GetReturnValue().Set(obj->_simulator->get_classical_value(id));
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void StabilizerWrapper::isClassical(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    StabilizerWrapper* obj = ObjectWrap::Unwrap<StabilizerWrapper>(info.Holder());
+    auto id = info[0]->Uint32Value(ctx).FromJust();
+
+    try {
+        info.GetReturnValue().Set(obj->_simulator->is_classical(id));
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void StabilizerWrapper::measureQubits(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    StabilizerWrapper* obj = ObjectWrap::Unwrap<StabilizerWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+    std::vector<unsigned int> ids;
+    jsToIds(info[0], ids);
+
+    try {
+        auto result = obj->_simulator->measure_qubits_return(ids);
+
+        Local<Array> ret = Array::New(isolate, result.size());
+        for (size_t i = 0; i < result.size(); ++i) {
+            ret->Set(ctx, i, Number::New(isolate, result[i]));
+        }
+        info.GetReturnValue().Set(ret);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+// applyControlledGate(gate: string, ids: number[], ctrl: number[])
+void StabilizerWrapper::applyControlledGate(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    StabilizerWrapper* obj = ObjectWrap::Unwrap<StabilizerWrapper>(info.Holder());
+    Isolate *isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+    String::Utf8Value gate(isolate, info[0]->ToString(ctx).ToLocalChecked());
+
+    std::vector<unsigned int> ids;
+    jsToIds(info[1], ids);
+    std::vector<unsigned int> ctrl;
+    jsToIds(info[2], ctrl);
+
+    try {
+        obj->_simulator->apply_controlled_gate(*gate, ids, ctrl);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+void StabilizerWrapper::run(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    StabilizerWrapper* obj = ObjectWrap::Unwrap<StabilizerWrapper>(info.Holder());
+    obj->_simulator->run();
+}
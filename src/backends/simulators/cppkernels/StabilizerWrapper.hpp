@@ -0,0 +1,52 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STABILIZER_WRAPPER_HPP_
+#define STABILIZER_WRAPPER_HPP_
+
+#include <nan.h>
+#include "stabilizer.hpp"
+
+// JS binding of StabilizerSimulator, exported as `StabilizerSimulator`.
+// Mirrors the Simulator binding, except that applyControlledGate takes the
+// name of a Clifford gate instead of its matrix.
+class StabilizerWrapper : public Nan::ObjectWrap {
+public:
+    static void Init(v8::Local<v8::Object> exports);
+private:
+    explicit StabilizerWrapper(int seed = 1);
+    ~StabilizerWrapper();
+
+    static void New(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void allocateQubit(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void deallocateQubit(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void getClassicalValue(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void isClassical(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void measureQubits(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void applyControlledGate(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void run(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static Nan::Persistent<v8::Function> constructor;
+
+    StabilizerSimulator *_simulator;
+};
+
+#endif
@@ -2,8 +2,8 @@
 // Created by Isaac on 2018/8/5.
 //
 #include "Wrapper.hpp"
-
-using MatrixType = std::vector<Simulator::StateVector>;
+#include "CompiledWrapper.hpp"
+#include "ObservableWrapper.hpp"
 
 std::ostream& operator<<(std::ostream &os, Simulator::StateVector &vec) {
     os << "[";
@@ -89,28 +89,32 @@ std::ostream& operator<<(std::ostream &os, QuRegs &vec) {
 
 // implementation
 
-Nan::Persistent<v8::Function> Wrapper::constructor;
+template <class Sim>
+Nan::Persistent<v8::Function> SimulatorWrapper<Sim>::constructor;
 
-Wrapper::Wrapper(int seed) {
-    _simulator = new Simulator(seed);
+template <class Sim>
+SimulatorWrapper<Sim>::SimulatorWrapper(int seed, bool split) {
+    _simulator = new Sim(seed, split ? Simulator::SPLIT : Simulator::INTERLEAVED);
 #if DEBUG
     _logfile.open("./log.txt");
 #endif
 }
 
-Wrapper::~Wrapper() {
+template <class Sim>
+SimulatorWrapper<Sim>::~SimulatorWrapper() {
     delete _simulator;
 #if DEBUG
     _logfile.close();
 #endif
 }
 
-void Wrapper::Init(v8::Local<v8::Object> exports) {
+template <class Sim>
+void SimulatorWrapper<Sim>::Init(v8::Local<v8::Object> exports, const char *name) {
     Nan::HandleScope scope;
 
     // Prepare constructor template
     v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(New);
-    tpl->SetClassName(Nan::New("Simulator").ToLocalChecked());
+    tpl->SetClassName(Nan::New(name).ToLocalChecked());
     tpl->InstanceTemplate()->SetInternalFieldCount(1);
 
     // Prototype
@@ -121,35 +125,53 @@ void Wrapper::Init(v8::Local<v8::Object> exports) {
     Nan::SetPrototypeMethod(tpl, "measureQubits", measureQubits);
     Nan::SetPrototypeMethod(tpl, "applyControlledGate", applyControlledGate);
     Nan::SetPrototypeMethod(tpl, "emulateMath", emulateMath);
+    Nan::SetPrototypeMethod(tpl, "emulateMathOperation", emulateMathOperation);
+    Nan::SetPrototypeMethod(tpl, "emulateMathTable", emulateMathTable);
     Nan::SetPrototypeMethod(tpl, "getExpectationValue", getExpectationValue);
+    Nan::SetPrototypeMethod(tpl, "getExpectationGradient", getExpectationGradient);
+    Nan::SetPrototypeMethod(tpl, "applyCompiled", applyCompiled);
     Nan::SetPrototypeMethod(tpl, "applyQubitOperator", applyQubitOperator);
     Nan::SetPrototypeMethod(tpl, "emulateTimeEvolution", emulateTimeEvolution);
+    Nan::SetPrototypeMethod(tpl, "applyPauliRotation", applyPauliRotation);
+    Nan::SetPrototypeMethod(tpl, "applyQFT", applyQFT);
+    Nan::SetPrototypeMethod(tpl, "applyUniformlyControlledRotation", applyUniformlyControlledRotation);
     Nan::SetPrototypeMethod(tpl, "getProbability", getProbability);
     Nan::SetPrototypeMethod(tpl, "getAmplitude", getAmplitude);
     Nan::SetPrototypeMethod(tpl, "setWavefunction", setWavefunction);
+    Nan::SetPrototypeMethod(tpl, "prepareState", prepareState);
+    Nan::SetPrototypeMethod(tpl, "applyPhaseOracle", applyPhaseOracle);
     Nan::SetPrototypeMethod(tpl, "collapseWavefunction", collapseWavefunction);
+    Nan::SetPrototypeMethod(tpl, "setFusionLimits", setFusionLimits);
+    Nan::SetPrototypeMethod(tpl, "autotuneFusion", autotuneFusion);
+    Nan::SetPrototypeMethod(tpl, "setScratchBudget", setScratchBudget);
+    Nan::SetPrototypeMethod(tpl, "releaseScratch", releaseScratch);
+    Nan::SetPrototypeMethod(tpl, "setKrylovDim", setKrylovDim);
+    Nan::SetPrototypeMethod(tpl, "setPrefetchThreshold", setPrefetchThreshold);
     Nan::SetPrototypeMethod(tpl, "run", run);
     Nan::SetPrototypeMethod(tpl, "cheat", cheat);
 
     auto ctx = Nan::GetCurrentContext();
     constructor.Reset(tpl->GetFunction(ctx).ToLocalChecked());
-    exports->Set(ctx, Nan::New("Simulator").ToLocalChecked(), tpl->GetFunction(ctx).ToLocalChecked());
+    exports->Set(ctx, Nan::New(name).ToLocalChecked(), tpl->GetFunction(ctx).ToLocalChecked());
 }
 
 
-void Wrapper::New(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+template <class Sim>
+void SimulatorWrapper<Sim>::New(const Nan::FunctionCallbackInfo<v8::Value>& info) {
     auto isolate = info.GetIsolate();
     auto context = isolate->GetCurrentContext();
     if (info.IsConstructCall()) {
         // Invoked as constructor: `new MyObject(...)`
         auto value = info[0]->IsUndefined() ? 0 : info[0]->NumberValue(context).FromJust();
-        Wrapper* obj = new Wrapper(value);
+        // optional 2nd argument: keep the state in split real/imaginary planes
+        bool split = info[1]->BooleanValue(isolate);
+        SimulatorWrapper* obj = new SimulatorWrapper(value, split);
         obj->Wrap(info.This());
         info.GetReturnValue().Set(info.This());
     } else {
         // Invoked as plain function `MyObject(...)`, turn into construct call.
-        const int argc = 1;
-        v8::Local<v8::Value> argv[argc] = { info[0] };
+        const int argc = 2;
+        v8::Local<v8::Value> argv[argc] = { info[0], info[1] };
         v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
         #if NODE_MAJOR_VERSION == 10
         auto result = cons->NewInstance(context, argc, argv).ToLocalChecked();
@@ -160,9 +182,10 @@ void Wrapper::New(const Nan::FunctionCallbackInfo<v8::Value>& info) {
     }
 }
 
-void Wrapper::allocateQubit(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+template <class Sim>
+void SimulatorWrapper<Sim>::allocateQubit(const Nan::FunctionCallbackInfo<v8::Value>& info) {
     auto ctx = Nan::GetCurrentContext();
-    Wrapper* obj = ObjectWrap::Unwrap<Wrapper>(info.Holder());
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
     auto id = info[0]->Uint32Value(ctx).FromJust();
 
     try {
@@ -175,8 +198,9 @@ void Wrapper::allocateQubit(const Nan::FunctionCallbackInfo<v8::Value>& info) {
 #endif
 }
 
-void Wrapper::deallocateQubit(const Nan::FunctionCallbackInfo<v8::Value> &info) {
-    Wrapper* obj = ObjectWrap::Unwrap<Wrapper>(info.Holder());
+template <class Sim>
+void SimulatorWrapper<Sim>::deallocateQubit(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
     auto ctx = Nan::GetCurrentContext();
     unsigned int id = info[0]->Uint32Value(ctx).FromJust();
 
@@ -193,9 +217,10 @@ void Wrapper::deallocateQubit(const Nan::FunctionCallbackInfo<v8::Value> &info)
 #endif
 }
 
-void Wrapper::getClassicalValue(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+template <class Sim>
+void SimulatorWrapper<Sim>::getClassicalValue(const Nan::FunctionCallbackInfo<v8::Value> &info) {
     auto ctx = Nan::GetCurrentContext();
-    Wrapper* obj = ObjectWrap::Unwrap<Wrapper>(info.Holder());
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
     unsigned int id = info[0]->Uint32Value(ctx).FromJust();
     double calc = info[1]->NumberValue(ctx).FromJust();
 
@@ -213,9 +238,10 @@ void Wrapper::getClassicalValue(const Nan::FunctionCallbackInfo<v8::Value> &info
     }
 }
 
-void Wrapper::isClassical(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+template <class Sim>
+void SimulatorWrapper<Sim>::isClassical(const Nan::FunctionCallbackInfo<v8::Value> &info) {
     auto ctx = Nan::GetCurrentContext();
-    Wrapper* obj = ObjectWrap::Unwrap<Wrapper>(info.Holder());
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
     unsigned int id = info[0]->Uint32Value(ctx).FromJust();
     double calc = info[1]->NumberValue(ctx).FromJust();
     try {
@@ -232,17 +258,6 @@ void Wrapper::isClassical(const Nan::FunctionCallbackInfo<v8::Value> &info) {
     }
 }
 
-template <typename T, typename V>
-void jsToArray(Local<Array> &jsArray, V &ids) {
-    auto ctx = Nan::GetCurrentContext();
-    for (uint32_t i = 0; i < jsArray->Length(); i++) {
-        Local<Value> elem;
-        jsArray->Get(ctx, i).ToLocal(&elem);
-        T numVal = elem->Int32Value(ctx).FromJust();
-        ids.push_back(numVal);
-    }
-}
-
 template <typename T>
 void arrayToJS(Isolate* isolate, Local<Array> &ret, T &result) {
     auto ctx = isolate->GetCurrentContext();
@@ -251,6 +266,17 @@ void arrayToJS(Isolate* isolate, Local<Array> &ret, T &result) {
     }
 }
 
+void jsToTerm(Isolate *isolate, Local<Array> &a, Simulator::Term &t) {
+    auto ctx = isolate->GetCurrentContext();
+    for (uint32_t j = 0; j < a->Length(); ++j) {
+        auto aLooper = Local<Array>::Cast(a->Get(ctx, j).ToLocalChecked());
+        auto gate = aLooper->Get(ctx, 1).ToLocalChecked()->ToString(ctx).ToLocalChecked();
+        String::Utf8Value value(isolate, gate);
+        auto c = (*value)[0];
+        t.push_back(std::make_pair((unsigned)aLooper->Get(ctx, 0).ToLocalChecked()->Uint32Value(ctx).FromJust(), c));
+    }
+}
+
 void jsToTermDictionary(Isolate *isolate, Local<Array> &terms, Simulator::TermsDict &dict) {
     auto ctx = isolate->GetCurrentContext();
     for (uint32_t i = 0; i < terms->Length(); ++i) {
@@ -260,17 +286,34 @@ void jsToTermDictionary(Isolate *isolate, Local<Array> &terms, Simulator::TermsD
 
         auto a = Local<Array>::Cast(pair->Get(ctx, 0).ToLocalChecked());
         Simulator::Term t;
-        for (uint32_t j = 0; j < a->Length(); ++j) {
-            auto aLooper = Local<Array>::Cast(a->Get(ctx, j).ToLocalChecked());
-            auto gate = aLooper->Get(ctx, 1).ToLocalChecked()->ToString(ctx).ToLocalChecked();
-            String::Utf8Value value(isolate, gate);
-            auto c = (*value)[0];
-            t.push_back(std::make_pair((unsigned)aLooper->Get(ctx, 0).ToLocalChecked()->Uint32Value(ctx).FromJust(), c));
-        }
+        jsToTerm(isolate, a, t);
         dict.push_back(std::make_pair(t, pair->Get(ctx, 1).ToLocalChecked()->NumberValue(ctx).FromJust()));
     }
 }
 
+// gates: [[kind, ids, controls, param, scale, matrix | term], ...], see CircuitGate
+void jsToCircuit(Isolate *isolate, Local<Array> &gates, std::vector<CircuitGate> &circuit) {
+    auto ctx = isolate->GetCurrentContext();
+    circuit.resize(gates->Length());
+    for (uint32_t i = 0; i < gates->Length(); ++i) {
+        auto gate = Local<Array>::Cast(gates->Get(ctx, i).ToLocalChecked());
+        auto &g = circuit[i];
+        g.kind = static_cast<CircuitGate::Kind>(gate->Get(ctx, 0).ToLocalChecked()->Uint32Value(ctx).FromJust());
+        auto ids = Local<Array>::Cast(gate->Get(ctx, 1).ToLocalChecked());
+        auto ctrl = Local<Array>::Cast(gate->Get(ctx, 2).ToLocalChecked());
+        jsToArray<unsigned int>(ids, g.ids);
+        jsToArray<unsigned int>(ctrl, g.ctrl);
+        g.param = gate->Get(ctx, 3).ToLocalChecked()->Int32Value(ctx).FromJust();
+        g.scale = gate->Get(ctx, 4).ToLocalChecked()->NumberValue(ctx).FromJust();
+        auto payload = Local<Array>::Cast(gate->Get(ctx, 5).ToLocalChecked());
+        if (g.kind == CircuitGate::MATRIX) {
+            jsToMatrix(isolate, payload, g.matrix);
+        } else if (g.kind == CircuitGate::PAULI) {
+            jsToTerm(isolate, payload, g.term);
+        }
+    }
+}
+
 void jsToComplexTermDictionary(Isolate *isolate, Local<Array> &terms, Simulator::ComplexTermsDict &dict) {
     auto re = String::NewFromUtf8(isolate, "re").ToLocalChecked();
     auto im = String::NewFromUtf8(isolate, "im").ToLocalChecked();
@@ -282,12 +325,7 @@ void jsToComplexTermDictionary(Isolate *isolate, Local<Array> &terms, Simulator:
 
         auto a = Local<Array>::Cast(pair->Get(ctx, 0).ToLocalChecked());
         Simulator::Term t;
-        for (uint32_t j = 0; j < a->Length(); ++j) {
-            auto aLooper = Local<Array>::Cast(a->Get(ctx, j).ToLocalChecked());
-            auto g = aLooper->Get(ctx, 1).ToLocalChecked()->ToString(ctx).ToLocalChecked();
-            String::Utf8Value value(isolate, g);
-            t.push_back(std::make_pair((unsigned)aLooper->Get(ctx, 0).ToLocalChecked()->Uint32Value(ctx).FromJust(), (*value)[0]));
-        }
+        jsToTerm(isolate, a, t);
 
         Local<Value> coefficient;
         pair->Get(ctx, 1).ToLocal(&coefficient);
@@ -352,8 +390,9 @@ void stateVectorToJS(Isolate* isolate, Simulator::StateVector &vec, Local<Array>
     }
 }
 
-void Wrapper::measureQubits(const Nan::FunctionCallbackInfo<v8::Value> &info) {
-    Wrapper* obj = ObjectWrap::Unwrap<Wrapper>(info.Holder());
+template <class Sim>
+void SimulatorWrapper<Sim>::measureQubits(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
     auto isolate = info.GetIsolate();
 
     v8::Local<v8::Array> jsArray = v8::Local<v8::Array>::Cast(info[0]);
@@ -388,8 +427,9 @@ void jsToMatrix(Isolate *iso, Local<Array> &array, MatrixType &m) {
     }
 }
 
-void Wrapper::applyControlledGate(const Nan::FunctionCallbackInfo<v8::Value> &info) {
-    Wrapper* obj = ObjectWrap::Unwrap<Wrapper>(info.Holder());
+template <class Sim>
+void SimulatorWrapper<Sim>::applyControlledGate(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
     Isolate *isolate = info.GetIsolate();
     auto mat = Local<Array>::Cast(info[0]);
     MatrixType m;
@@ -413,12 +453,23 @@ void Wrapper::applyControlledGate(const Nan::FunctionCallbackInfo<v8::Value> &in
 #endif
 }
 
-void Wrapper::emulateMath(const Nan::FunctionCallbackInfo<v8::Value> &info) {
-    Wrapper* obj = ObjectWrap::Unwrap<Wrapper>(info.Holder());
+void jsToQuRegs(Isolate *iso, Local<Array> &array, QuRegs &regs) {
+    auto ctx = iso->GetCurrentContext();
+    regs.reserve(array->Length());
+    for (uint32_t i = 0; i < array->Length(); ++i) {
+        auto qr = Local<Array>::Cast(array->Get(ctx, i).ToLocalChecked());
+        std::vector<unsigned int> item;
+        jsToArray<unsigned int>(qr, item);
+        regs.push_back(item);
+    }
+}
+
+template <class Sim>
+void SimulatorWrapper<Sim>::emulateMath(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
     Local<Function> cbFunc = Local<Function>::Cast(info[0]);
     Nan::Callback cb(cbFunc);
     auto isolate = info.GetIsolate();
-    auto ctx = isolate->GetCurrentContext();
 
     auto f = [&](std::vector<int>& x) {
         const int argc = 1;
@@ -428,19 +479,14 @@ void Wrapper::emulateMath(const Nan::FunctionCallbackInfo<v8::Value> &info) {
         args1[0] = arg;
 
         Local<Array> result = Local<Array>::Cast(cb.Call(argc, args1));
-        std::vector<int> ret(result->Length());
+        std::vector<int> ret;
+        ret.reserve(result->Length());
         jsToArray<int>(result, ret);
         x = std::move(ret);
     };
     v8::Local<v8::Array> quregArray = v8::Local<v8::Array>::Cast(info[1]);
-    QuRegs regs(quregArray->Length());
-    for (uint32_t i = 0; i < quregArray->Length(); ++i) {
-        auto val = quregArray->Get(ctx, i).ToLocalChecked();
-        auto qr = Local<Array>::Cast(val);
-        std::vector<unsigned int> item;
-        jsToArray<unsigned int>(qr, item);
-        regs.push_back(item);
-    }
+    QuRegs regs;
+    jsToQuRegs(isolate, quregArray, regs);
 
     Local<Array> ctrlArray = Local<Array>::Cast(info[2]);
     std::vector<unsigned int> ctrls;
@@ -456,12 +502,87 @@ void Wrapper::emulateMath(const Nan::FunctionCallbackInfo<v8::Value> &info) {
 #endif
 }
 
-void Wrapper::getExpectationValue(const Nan::FunctionCallbackInfo<v8::Value> &info) {
-    Wrapper* obj = ObjectWrap::Unwrap<Wrapper>(info.Holder());
+template <class Sim>
+void SimulatorWrapper<Sim>::emulateMathOperation(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
     auto isolate = info.GetIsolate();
-    Local<Array> terms = Local<Array>::Cast(info[0]);
+    auto ctx = isolate->GetCurrentContext();
+
+    // descriptor: [kind, a, N], see MathOperation::Kind
+    Local<Array> opArray = Local<Array>::Cast(info[0]);
+    std::vector<double> desc;
+    for (uint32_t i = 0; i < opArray->Length(); ++i)
+        desc.push_back(opArray->Get(ctx, i).ToLocalChecked()->NumberValue(ctx).FromJust());
+    desc.resize(3, 0.);
+
+    Local<Array> quregArray = Local<Array>::Cast(info[1]);
+    QuRegs regs;
+    jsToQuRegs(isolate, quregArray, regs);
+
+    Local<Array> ctrlArray = Local<Array>::Cast(info[2]);
+    std::vector<unsigned int> ctrls;
+    jsToArray<unsigned int>(ctrlArray, ctrls);
+
+    try {
+        MathOperation op(static_cast<unsigned>(desc[0]), static_cast<std::int64_t>(desc[1]),
+                         static_cast<std::int64_t>(desc[2]));
+        obj->_simulator->emulate_math_operation(op, regs, ctrls);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+#if DEBUG
+    obj->_logfile << "emulateMathOperation: op: " << desc[0] << " ids: " << regs << " ctrls: " << ctrls << std::endl;
+#endif
+}
+
+template <class Sim>
+void SimulatorWrapper<Sim>::emulateMathTable(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+
+    // table[k] is the packed output for the packed register input k
+    Simulator::MathTable table;
+    if (info[0]->IsUint32Array()) {
+        Nan::TypedArrayContents<uint32_t> contents(info[0]);
+        table.assign(*contents, *contents + contents.length());
+    } else {
+        Local<Array> tableArray = Local<Array>::Cast(info[0]);
+        table.reserve(tableArray->Length());
+        for (uint32_t i = 0; i < tableArray->Length(); ++i)
+            table.push_back(tableArray->Get(ctx, i).ToLocalChecked()->Uint32Value(ctx).FromJust());
+    }
+
+    Local<Array> quregArray = Local<Array>::Cast(info[1]);
+    QuRegs regs;
+    jsToQuRegs(isolate, quregArray, regs);
+
+    Local<Array> ctrlArray = Local<Array>::Cast(info[2]);
+    std::vector<unsigned int> ctrls;
+    jsToArray<unsigned int>(ctrlArray, ctrls);
+
+    try {
+        obj->_simulator->emulate_math_table(table, regs, ctrls);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+#if DEBUG
+    obj->_logfile << "emulateMathTable: size: " << table.size() << " ids: " << regs << " ctrls: " << ctrls << std::endl;
+#endif
+}
+
+// getExpectationValue(terms | observable, ids), observable: an Observable
+// prepared from the terms
+template <class Sim>
+void SimulatorWrapper<Sim>::getExpectationValue(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+    auto observable = ObservableWrapper::unwrap(info[0]);
     Simulator::TermsDict termsDict;
-    jsToTermDictionary(isolate, terms, termsDict);
+    if (!observable) {
+        Local<Array> terms = Local<Array>::Cast(info[0]);
+        jsToTermDictionary(isolate, terms, termsDict);
+    }
 
     Local<Array> a2 = Local<Array>::Cast(info[1]);
     std::vector<unsigned int> ids;
@@ -469,9 +590,13 @@ void Wrapper::getExpectationValue(const Nan::FunctionCallbackInfo<v8::Value> &in
 
     try {
 #if DEBUG
-        obj->_logfile << "getExpectationValue: terms: " << termsDict << " ids: " << ids << std::endl;
+        if (observable)
+            obj->_logfile << "getExpectationValue: observable: " << observable->size() << " terms ids: " << ids << std::endl;
+        else
+            obj->_logfile << "getExpectationValue: terms: " << termsDict << " ids: " << ids << std::endl;
 #endif
-        auto result = obj->_simulator->get_expectation_value(termsDict, ids);
+        auto result = observable ? obj->_simulator->get_expectation_value(*observable, ids)
+                                 : obj->_simulator->get_expectation_value(termsDict, ids);
         info.GetReturnValue().Set(result);
     } catch (std::runtime_error &error) {
 #if DEBUG
@@ -481,8 +606,94 @@ void Wrapper::getExpectationValue(const Nan::FunctionCallbackInfo<v8::Value> &in
     }
 }
 
-void Wrapper::applyQubitOperator(const Nan::FunctionCallbackInfo<v8::Value> &info) {
-    Wrapper* obj = ObjectWrap::Unwrap<Wrapper>(info.Holder());
+// getExpectationGradient(gates, params, terms, ids) -> {value, gradient}
+template <class Sim>
+void SimulatorWrapper<Sim>::getExpectationGradient(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+    Local<Array> gates = Local<Array>::Cast(info[0]);
+    std::vector<CircuitGate> circuit;
+    jsToCircuit(isolate, gates, circuit);
+
+    Local<Array> a1 = Local<Array>::Cast(info[1]);
+    std::vector<double> params;
+    for (uint32_t i = 0; i < a1->Length(); ++i) {
+        params.push_back(a1->Get(ctx, i).ToLocalChecked()->NumberValue(ctx).FromJust());
+    }
+
+    Local<Array> terms = Local<Array>::Cast(info[2]);
+    Simulator::TermsDict termsDict;
+    jsToTermDictionary(isolate, terms, termsDict);
+
+    Local<Array> a3 = Local<Array>::Cast(info[3]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(a3, ids);
+
+    try {
+#if DEBUG
+        obj->_logfile << "getExpectationGradient: gates: " << circuit.size() << " params: " << params.size() << " terms: " << termsDict << " ids: " << ids << std::endl;
+#endif
+        std::vector<double> gradient;
+        auto value = obj->_simulator->get_expectation_gradient(circuit, params, termsDict, ids, gradient);
+
+        Local<Array> grad = Array::New(isolate, gradient.size());
+        for (size_t i = 0; i < gradient.size(); ++i) {
+            grad->Set(ctx, i, Number::New(isolate, gradient[i]));
+        }
+        Local<Object> ret = Object::New(isolate);
+        ret->Set(ctx, String::NewFromUtf8(isolate, "value").ToLocalChecked(), Number::New(isolate, value));
+        ret->Set(ctx, String::NewFromUtf8(isolate, "gradient").ToLocalChecked(), grad);
+        info.GetReturnValue().Set(ret);
+    } catch (std::runtime_error &error) {
+#if DEBUG
+        obj->_logfile << " exception" << error.what();
+#endif
+        Nan::ThrowError(error.what());
+    }
+}
+
+// applyCompiled(compiledCircuit, params, reset = false) -> measurement outcomes
+template <class Sim>
+void SimulatorWrapper<Sim>::applyCompiled(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+    auto circuit = CompiledWrapper::unwrap(info[0]);
+    if (!circuit) {
+        Nan::ThrowTypeError("applyCompiled(): Expected a CompiledCircuit.");
+        return;
+    }
+
+    Local<Array> a1 = Local<Array>::Cast(info[1]);
+    std::vector<double> params;
+    for (uint32_t i = 0; i < a1->Length(); ++i) {
+        params.push_back(a1->Get(ctx, i).ToLocalChecked()->NumberValue(ctx).FromJust());
+    }
+    bool reset = info[2]->BooleanValue(isolate);
+
+    try {
+#if DEBUG
+        obj->_logfile << "applyCompiled: blocks: " << circuit->blocks().size() << " params: " << params.size() << " reset: " << reset << std::endl;
+#endif
+        auto outcomes = obj->_simulator->apply_compiled(*circuit, params, reset);
+
+        Local<Array> ret = Array::New(isolate, outcomes.size());
+        for (size_t i = 0; i < outcomes.size(); ++i) {
+            ret->Set(ctx, i, Number::New(isolate, outcomes[i]));
+        }
+        info.GetReturnValue().Set(ret);
+    } catch (std::runtime_error &error) {
+#if DEBUG
+        obj->_logfile << " exception" << error.what();
+#endif
+        Nan::ThrowError(error.what());
+    }
+}
+
+template <class Sim>
+void SimulatorWrapper<Sim>::applyQubitOperator(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
     Isolate *isolate = info.GetIsolate();
     Local<Array> terms = Local<Array>::Cast(info[0]);
     Simulator::ComplexTermsDict termsDict;
@@ -502,8 +713,9 @@ void Wrapper::applyQubitOperator(const Nan::FunctionCallbackInfo<v8::Value> &inf
 #endif
 }
 
-void Wrapper::emulateTimeEvolution(const Nan::FunctionCallbackInfo<v8::Value> &info) {
-    Wrapper* obj = ObjectWrap::Unwrap<Wrapper>(info.Holder());
+template <class Sim>
+void SimulatorWrapper<Sim>::emulateTimeEvolution(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
     auto isolate = info.GetIsolate();
     auto ctx = isolate->GetCurrentContext();
 
@@ -528,8 +740,85 @@ void Wrapper::emulateTimeEvolution(const Nan::FunctionCallbackInfo<v8::Value> &i
     }
 }
 
-void Wrapper::getProbability(const Nan::FunctionCallbackInfo<v8::Value> &info) {
-    Wrapper* obj = ObjectWrap::Unwrap<Wrapper>(info.Holder());
+template <class Sim>
+void SimulatorWrapper<Sim>::applyPauliRotation(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+
+    auto a1 = Local<Array>::Cast(info[0]);
+    Simulator::Term term;
+    jsToTerm(isolate, a1, term);
+    Simulator::calc_type theta = info[1]->NumberValue(ctx).FromJust();
+    auto a3 = Local<Array>::Cast(info[2]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(a3, ids);
+    auto a4 = Local<Array>::Cast(info[3]);
+    std::vector<unsigned int> ctrl;
+    jsToArray<unsigned int>(a4, ctrl);
+#if DEBUG
+    obj->_logfile << "applyPauliRotation: term: " << term << " theta: " << theta << " ids: " << ids << " ctrl: " << ctrl << std::endl;
+#endif
+    try {
+        obj->_simulator->apply_pauli_rotation(term, theta, ids, ctrl);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+template <class Sim>
+void SimulatorWrapper<Sim>::applyQFT(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+
+    auto a1 = Local<Array>::Cast(info[0]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(a1, ids);
+    auto a2 = Local<Array>::Cast(info[1]);
+    std::vector<unsigned int> ctrl;
+    jsToArray<unsigned int>(a2, ctrl);
+    bool inverse = info[2]->BooleanValue(isolate);
+#if DEBUG
+    obj->_logfile << "applyQFT: ids: " << ids << " ctrl: " << ctrl << " inverse: " << inverse << std::endl;
+#endif
+    try {
+        obj->_simulator->apply_qft(ids, ctrl, inverse);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+template <class Sim>
+void SimulatorWrapper<Sim>::applyUniformlyControlledRotation(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+
+    String::Utf8Value axis(isolate, info[0]->ToString(ctx).ToLocalChecked());
+    auto a2 = Local<Array>::Cast(info[1]);
+    std::vector<Simulator::calc_type> angles;
+    for (uint32_t i = 0; i < a2->Length(); i++)
+        angles.push_back(a2->Get(ctx, i).ToLocalChecked()->NumberValue(ctx).FromJust());
+    auto a3 = Local<Array>::Cast(info[2]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(a3, ids);
+    unsigned int target = info[3]->Uint32Value(ctx).FromJust();
+    auto a5 = Local<Array>::Cast(info[4]);
+    std::vector<unsigned int> ctrl;
+    jsToArray<unsigned int>(a5, ctrl);
+#if DEBUG
+    obj->_logfile << "applyUniformlyControlledRotation: axis: " << *axis << " #angles: " << angles.size() << " ids: " << ids << " target: " << target << " ctrl: " << ctrl << std::endl;
+#endif
+    try {
+        obj->_simulator->apply_uniformly_controlled_rotation((*axis)[0], angles, ids, target, ctrl);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+template <class Sim>
+void SimulatorWrapper<Sim>::getProbability(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
     Local<Array> i1 = Local<Array>::Cast(info[0]);
     std::vector<bool> bitString;
     jsToArray<bool>(i1, bitString);
@@ -553,11 +842,12 @@ void Wrapper::getProbability(const Nan::FunctionCallbackInfo<v8::Value> &info) {
     }
 }
 
-void Wrapper::getAmplitude(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+template <class Sim>
+void SimulatorWrapper<Sim>::getAmplitude(const Nan::FunctionCallbackInfo<v8::Value> &info) {
     auto isolate = info.GetIsolate();
     auto ctx = isolate->GetCurrentContext();
 
-    Wrapper* obj = ObjectWrap::Unwrap<Wrapper>(info.Holder());
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
     Local<Array> i1 = Local<Array>::Cast(info[0]);
     std::vector<bool> bitString;
     jsToArray<bool>(i1, bitString);
@@ -590,8 +880,9 @@ void Wrapper::getAmplitude(const Nan::FunctionCallbackInfo<v8::Value> &info) {
     }
 }
 
-void Wrapper::setWavefunction(const Nan::FunctionCallbackInfo<v8::Value> &info) {
-    Wrapper* obj = ObjectWrap::Unwrap<Wrapper>(info.Holder());
+template <class Sim>
+void SimulatorWrapper<Sim>::setWavefunction(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
     auto isolate = info.GetIsolate();
     Local<Array> i1 = Local<Array>::Cast(info[0]);
     Simulator::StateVector vec;
@@ -612,8 +903,83 @@ void Wrapper::setWavefunction(const Nan::FunctionCallbackInfo<v8::Value> &info)
 #endif
 }
 
-void Wrapper::collapseWavefunction(const Nan::FunctionCallbackInfo<v8::Value> &info) {
-    Wrapper* obj = ObjectWrap::Unwrap<Wrapper>(info.Holder());
+template <class Sim>
+void SimulatorWrapper<Sim>::prepareState(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+
+    Local<Array> i1 = Local<Array>::Cast(info[0]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(i1, ids);
+
+    // Float64Array: 2^n real amplitudes or 2^n interleaved (re, im) pairs
+    Simulator::StateVector amplitudes;
+    if (info[1]->IsFloat64Array()) {
+        Nan::TypedArrayContents<double> contents(info[1]);
+        auto data = *contents;
+        if (contents.length() == (2UL << ids.size())) {
+            for (size_t i = 0; i < contents.length(); i += 2)
+                amplitudes.push_back(Simulator::complex_type(data[i], data[i + 1]));
+        } else {
+            amplitudes.assign(data, data + contents.length());
+        }
+    } else {
+        Local<Array> i2 = Local<Array>::Cast(info[1]);
+        jsToStateVector(isolate, i2, amplitudes);
+    }
+#if DEBUG
+    obj->_logfile << "prepareState: ids: " << ids << " #amplitudes: " << amplitudes.size() << std::endl;
+#endif
+    try {
+        obj->_simulator->prepare_state(ids, amplitudes);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+template <class Sim>
+void SimulatorWrapper<Sim>::applyPhaseOracle(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+
+    Local<Array> i1 = Local<Array>::Cast(info[0]);
+    std::vector<unsigned int> ids;
+    jsToArray<unsigned int>(i1, ids);
+    Local<Array> i3 = Local<Array>::Cast(info[2]);
+    std::vector<unsigned int> ctrl;
+    jsToArray<unsigned int>(i3, ctrl);
+
+    try {
+        // Uint8Array: truth table (2^n entries) or packed bitmap (2^n bits),
+        // otherwise a list of the marked register values
+        PhaseOracleBitmap bitmap;
+        std::size_t size = 1UL << ids.size();
+        if (info[1]->IsUint8Array()) {
+            Nan::TypedArrayContents<uint8_t> contents(info[1]);
+            if (contents.length() == size)
+                bitmap = pack_truth_table(*contents, size);
+            else
+                bitmap.assign(*contents, *contents + contents.length());
+        } else {
+            Local<Array> i2 = Local<Array>::Cast(info[1]);
+            std::vector<std::size_t> marked;
+            for (uint32_t i = 0; i < i2->Length(); ++i)
+                marked.push_back(i2->Get(ctx, i).ToLocalChecked()->IntegerValue(ctx).FromJust());
+            bitmap = pack_marked_states(marked, ids.size());
+        }
+#if DEBUG
+        obj->_logfile << "applyPhaseOracle: ids: " << ids << " ctrl: " << ctrl << std::endl;
+#endif
+        obj->_simulator->apply_phase_oracle(ids, bitmap, ctrl);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+template <class Sim>
+void SimulatorWrapper<Sim>::collapseWavefunction(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
 
     Local<Array> i2 = Local<Array>::Cast(info[0]);
     std::vector<unsigned int> ids;
@@ -632,8 +998,117 @@ void Wrapper::collapseWavefunction(const Nan::FunctionCallbackInfo<v8::Value> &i
     }
 }
 
-void Wrapper::run(const Nan::FunctionCallbackInfo<v8::Value> &info) {
-    Wrapper* obj = ObjectWrap::Unwrap<Wrapper>(info.Holder());
+template <class Sim>
+void SimulatorWrapper<Sim>::setFusionLimits(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
+    auto min = info[0]->Uint32Value(ctx).FromJust();
+    auto max = info[1]->Uint32Value(ctx).FromJust();
+#if DEBUG
+    obj->_logfile << "setFusionLimits: " << min << " " << max << std::endl;
+#endif
+    try {
+        obj->_simulator->set_fusion_limits(min, max);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+template <class Sim>
+void SimulatorWrapper<Sim>::autotuneFusion(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto isolate = info.GetIsolate();
+    auto ctx = isolate->GetCurrentContext();
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
+    unsigned num_qubits = info[0]->IsUndefined() ? 20 : info[0]->Uint32Value(ctx).FromJust();
+    try {
+        auto limits = obj->_simulator->autotune_fusion(num_qubits);
+#if DEBUG
+        obj->_logfile << "autotuneFusion: " << num_qubits << " result: " << limits.first << " " << limits.second << std::endl;
+#endif
+        Local<Array> ret = Array::New(isolate, 2);
+        ret->Set(ctx, 0, Number::New(isolate, limits.first));
+        ret->Set(ctx, 1, Number::New(isolate, limits.second));
+        info.GetReturnValue().Set(ret);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+// setScratchBudget(bytes), no limit if bytes is undefined or Infinity
+template <class Sim>
+void SimulatorWrapper<Sim>::setScratchBudget(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
+    double bytes = info[0]->IsUndefined() ? std::numeric_limits<double>::infinity() : info[0]->NumberValue(ctx).FromJust();
+    if (!(bytes >= 0.)) {
+        Nan::ThrowError("setScratchBudget(): Expected a non-negative number of bytes.");
+        return;
+    }
+    std::size_t budget = std::numeric_limits<std::size_t>::max();
+    if (bytes < static_cast<double>(budget))
+        budget = static_cast<std::size_t>(bytes);
+#if DEBUG
+    obj->_logfile << "setScratchBudget: " << budget << std::endl;
+#endif
+    try {
+        obj->_simulator->set_scratch_budget(budget);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+template <class Sim>
+void SimulatorWrapper<Sim>::releaseScratch(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
+    try {
+        obj->_simulator->release_scratch();
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+template <class Sim>
+void SimulatorWrapper<Sim>::setKrylovDim(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
+    auto m = info[0]->Uint32Value(ctx).FromJust();
+#if DEBUG
+    obj->_logfile << "setKrylovDim: " << m << std::endl;
+#endif
+    try {
+        obj->_simulator->set_krylov_dim(m);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+// setPrefetchThreshold(bytes), the default (see cachesize.hpp) if bytes is
+// undefined, no prefetches if bytes is Infinity
+template <class Sim>
+void SimulatorWrapper<Sim>::setPrefetchThreshold(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    auto ctx = Nan::GetCurrentContext();
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
+    double bytes = info[0]->IsUndefined() ? static_cast<double>(prefetch_threshold()) : info[0]->NumberValue(ctx).FromJust();
+    if (!(bytes >= 0.)) {
+        Nan::ThrowError("setPrefetchThreshold(): Expected a non-negative number of bytes.");
+        return;
+    }
+    std::size_t threshold = std::numeric_limits<std::size_t>::max();
+    if (bytes < static_cast<double>(threshold))
+        threshold = static_cast<std::size_t>(bytes);
+#if DEBUG
+    obj->_logfile << "setPrefetchThreshold: " << threshold << std::endl;
+#endif
+    try {
+        obj->_simulator->set_prefetch_threshold(threshold);
+    } catch (std::runtime_error &error) {
+        Nan::ThrowError(error.what());
+    }
+}
+
+template <class Sim>
+void SimulatorWrapper<Sim>::run(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
     try {
         obj->_simulator->run();
     } catch (std::runtime_error &error) {
@@ -644,11 +1119,12 @@ void Wrapper::run(const Nan::FunctionCallbackInfo<v8::Value> &info) {
 #endif
 }
 
-void Wrapper::cheat(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+template <class Sim>
+void SimulatorWrapper<Sim>::cheat(const Nan::FunctionCallbackInfo<v8::Value> &info) {
     auto isolate = info.GetIsolate();
     auto ctx = isolate->GetCurrentContext();
 
-    Wrapper* obj = ObjectWrap::Unwrap<Wrapper>(info.Holder());
+    SimulatorWrapper* obj = ObjectWrap::Unwrap<SimulatorWrapper>(info.Holder());
 
     try {
         auto result = obj->_simulator->cheat();
@@ -674,3 +1150,6 @@ void Wrapper::cheat(const Nan::FunctionCallbackInfo<v8::Value> &info) {
         Nan::ThrowError(error.what());
     }
 }
+
+template class SimulatorWrapper<Simulator>;
+template class SimulatorWrapper<SparseSimulator>;
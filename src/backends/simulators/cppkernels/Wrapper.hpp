@@ -1,19 +1,41 @@
 
 #include <nan.h>
 #include "simulator.hpp"
+#include "sparse.hpp"
 #include <iostream>
 #include <fstream>
 
 using namespace v8;
 using QuRegs = std::vector<std::vector<unsigned>>;
-
-class Wrapper : public Nan::ObjectWrap {
+using MatrixType = std::vector<Simulator::StateVector>;
+
+// JS -> C++ conversions, shared with the other simulator bindings
+template <typename T, typename V>
+void jsToArray(Local<Array> &jsArray, V &ids) {
+    auto ctx = Nan::GetCurrentContext();
+    for (uint32_t i = 0; i < jsArray->Length(); i++) {
+        Local<Value> elem;
+        jsArray->Get(ctx, i).ToLocal(&elem);
+        T numVal = elem->Int32Value(ctx).FromJust();
+        ids.push_back(numVal);
+    }
+}
+
+void jsToMatrix(Isolate *iso, Local<Array> &array, MatrixType &m);
+void jsToQuRegs(Isolate *iso, Local<Array> &array, QuRegs &regs);
+void jsToTermDictionary(Isolate *isolate, Local<Array> &terms, Simulator::TermsDict &dict);
+void jsToCircuit(Isolate *isolate, Local<Array> &gates, std::vector<CircuitGate> &circuit);
+
+// Binding of the state-vector simulators; Sim is Simulator or
+// SparseSimulator, which share their interface.
+template <class Sim>
+class SimulatorWrapper : public Nan::ObjectWrap {
 public:
-    static void Init(v8::Local<v8::Object> exports);
+    static void Init(v8::Local<v8::Object> exports, const char *name = "Simulator");
     using complex_type = std::complex<double>;
 private:
-    explicit Wrapper(int seed = 1);
-    ~Wrapper();
+    explicit SimulatorWrapper(int seed = 1, bool split = false);
+    ~SimulatorWrapper();
 
     static void New(const Nan::FunctionCallbackInfo<v8::Value>& info);
 
@@ -31,27 +53,60 @@ private:
 
     static void emulateMath(const Nan::FunctionCallbackInfo<v8::Value>& info);
 
+    static void emulateMathOperation(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void emulateMathTable(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
     static void getExpectationValue(const Nan::FunctionCallbackInfo<v8::Value>& info);
 
+    static void getExpectationGradient(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void applyCompiled(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
     static void applyQubitOperator(const Nan::FunctionCallbackInfo<v8::Value>& info);
 
     static void emulateTimeEvolution(const Nan::FunctionCallbackInfo<v8::Value>& info);
 
+    static void applyPauliRotation(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void applyQFT(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void applyUniformlyControlledRotation(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
     static void getProbability(const Nan::FunctionCallbackInfo<v8::Value>& info);
 
     static void getAmplitude(const Nan::FunctionCallbackInfo<v8::Value>& info);
 
     static void setWavefunction(const Nan::FunctionCallbackInfo<v8::Value>& info);
 
+    static void prepareState(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void applyPhaseOracle(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
     static void collapseWavefunction(const Nan::FunctionCallbackInfo<v8::Value>& info);
 
+    static void setFusionLimits(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void autotuneFusion(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void setScratchBudget(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void releaseScratch(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void setKrylovDim(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
+    static void setPrefetchThreshold(const Nan::FunctionCallbackInfo<v8::Value>& info);
+
     static void run(const Nan::FunctionCallbackInfo<v8::Value>& info);
 
     static void cheat(const Nan::FunctionCallbackInfo<v8::Value>& info);
 
     static Nan::Persistent<v8::Function> constructor;
 
-    Simulator *_simulator;
+    Sim *_simulator;
 public:
     std::ofstream _logfile;
 };
+
+using Wrapper = SimulatorWrapper<Simulator>;
+using SparseWrapper = SimulatorWrapper<SparseSimulator>;
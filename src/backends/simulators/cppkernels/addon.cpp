@@ -1,9 +1,24 @@
 #include <nan.h>
 #include "Wrapper.hpp"
+#include "StabilizerWrapper.hpp"
+#include "MPSWrapper.hpp"
+#include "ReversibleWrapper.hpp"
+#include "BatchWrapper.hpp"
+#include "PoolWrapper.hpp"
+#include "CompiledWrapper.hpp"
+#include "ObservableWrapper.hpp"
 #include "2dmapper.hpp"
 
 void InitAll(v8::Local<v8::Object> exports) {
   Wrapper::Init(exports);
+  SparseWrapper::Init(exports, "SparseSimulator");
+  StabilizerWrapper::Init(exports);
+  MPSWrapper::Init(exports);
+  ReversibleWrapper::Init(exports);
+  BatchWrapper::Init(exports);
+  PoolWrapper::Init(exports);
+  CompiledWrapper::Init(exports);
+  ObservableWrapper::Init(exports);
   twodMapperInit(exports);
 }
 
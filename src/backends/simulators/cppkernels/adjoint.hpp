@@ -0,0 +1,131 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ADJOINT_HPP_
+#define ADJOINT_HPP_
+
+// Adjoint differentiation of parametrized circuits. Included by
+// simulator.hpp, whose gate kernels are used for the matrix gates.
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <stdexcept>
+#include "circuit.hpp"
+
+// CircuitGate in bit locations of the state vector
+struct LocatedGate{
+    CircuitGate::Kind kind;
+    Fusion::Matrix matrix, inverse;
+    std::vector<unsigned> locs;
+    std::size_t ctrlmask, phasemask; // phasemask: basis states picking up the phase of R, PH
+    PauliString pauli;               // RX, RY, RZ, PAULI: U = exp(-i factor theta pauli)
+    double factor;
+    PauliSum generator;
+    int param;
+    double scale;
+
+    double angle(std::vector<double> const& params) const {
+        return param < 0 ? scale : scale * params[param];
+    }
+};
+
+// psi <- U(theta) psi, or U(theta)^dagger psi if dagger is set (matrices
+// with software prefetches if prefetch, see cachesize.hpp)
+template <class V>
+void apply_located_gate(V& psi, LocatedGate const& g, double theta, bool dagger, bool prefetch){
+    switch (g.kind){
+        case CircuitGate::MATRIX: {
+            auto const& m = dagger ? g.inverse : g.matrix;
+            auto const& ids = g.locs;
+            auto ctrlmask = g.ctrlmask;
+            switch (ids.size()){
+                case 1:
+                    #pragma omp parallel
+                    kernel(psi, ids[0], m, ctrlmask, prefetch);
+                    break;
+                case 2:
+                    #pragma omp parallel
+                    kernel(psi, ids[1], ids[0], m, ctrlmask, prefetch);
+                    break;
+                case 3:
+                    #pragma omp parallel
+                    kernel(psi, ids[2], ids[1], ids[0], m, ctrlmask, prefetch);
+                    break;
+                case 4:
+                    #pragma omp parallel
+                    kernel(psi, ids[3], ids[2], ids[1], ids[0], m, ctrlmask, prefetch);
+                    break;
+                case 5:
+                    #pragma omp parallel
+                    kernel(psi, ids[4], ids[3], ids[2], ids[1], ids[0], m, ctrlmask, prefetch);
+                    break;
+            }
+            break;
+        }
+        case CircuitGate::R:
+        case CircuitGate::PH: {
+            auto phase = std::polar(1., dagger ? -theta : theta);
+            auto mask = g.phasemask;
+            #pragma omp parallel for schedule(static)
+            for (std::size_t j = 0; j < psi.size(); ++j)
+                if ((j & mask) == mask)
+                    psi[j] *= phase;
+            break;
+        }
+        default:
+            apply_pauli_rotation(psi, g.pauli, (dagger ? -theta : theta) * g.factor, g.ctrlmask);
+    }
+}
+
+// Returns <psi|H|psi> for psi = U_N ... U_1 psi0 and stores its derivatives
+// with respect to params in gradient.
+//
+// After the forward pass, psi and lambda = H psi are moved back through the
+// circuit together. Before gate k is undone,
+//     d<H>/dtheta_k = 2 Re <lambda|dU_k|psi_{k-1}> = 2 Im <lambda|P_ctrl G_k|psi>,
+// so every gate costs one pass to undo it on each vector and, if it is
+// parametrized, one pass for the inner product. Only psi and lambda are kept:
+// psi holds psi0 on entry and is overwritten, lambda is a vector of the same
+// size whose contents do not matter.
+template <class V>
+double adjoint_gradient(V& psi, V& lambda, std::vector<LocatedGate> const& gates,
+                        std::vector<double> const& params, PauliSum const& observable,
+                        std::vector<double>& gradient, bool prefetch){
+    gradient.assign(params.size(), 0.);
+    std::vector<double> angles(gates.size());
+    std::size_t first = gates.size(); // first parametrized gate
+    for (std::size_t k = 0; k < gates.size(); ++k){
+        angles[k] = gates[k].angle(params);
+        if (gates[k].param >= 0 && first == gates.size())
+            first = k;
+        apply_located_gate(psi, gates[k], angles[k], false, prefetch);
+    }
+
+    double expectation = std::real(observable.expectation(psi));
+    observable.apply(psi, lambda);
+
+    for (std::size_t k = gates.size(); k-- > first;){
+        auto const& g = gates[k];
+        if (g.param >= 0)
+            gradient[g.param] += 2. * g.scale * std::imag(g.generator.inner(lambda, psi, g.ctrlmask));
+        if (k > first){
+            apply_located_gate(psi, g, angles[k], true, prefetch);
+            apply_located_gate(lambda, g, angles[k], true, prefetch);
+        }
+    }
+    return expectation;
+}
+
+#endif
@@ -0,0 +1,354 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BATCH_HPP_
+#define BATCH_HPP_
+
+#include <vector>
+#include <complex>
+#include <map>
+#include <random>
+#include <functional>
+#include <stdexcept>
+#include "intrin/alignedallocator.hpp"
+#include "fusion.hpp"
+#include "pauli.hpp"
+
+// Simulates B copies of the same register at once, e.g. one circuit at B
+// points of a parameter sweep. Amplitude x of state b is stored at
+// vec_[x * B + b], so every gate runs once over the basis states and the
+// innermost loop (over the batch) is contiguous and vectorizes.
+//
+// Gates with the same matrix for all states are fused like in Simulator;
+// apply_batched_gate takes one matrix per state. Measurements, expectation
+// values and probabilities are evaluated for each state separately.
+class BatchSimulator{
+public:
+    using calc_type = double;
+    using complex_type = std::complex<calc_type>;
+    using StateVector = std::vector<complex_type, aligned_allocator<complex_type,64>>;
+    using Map = std::map<unsigned, unsigned>;
+    using RndEngine = std::mt19937;
+    using Term = std::vector<std::pair<unsigned, char>>;
+    using TermsDict = std::vector<std::pair<Term, calc_type>>;
+
+    BatchSimulator(unsigned batch, unsigned seed = 1) : B_(batch), N_(0), vec_(batch, 1.),
+                                                       fusion_qubits_min_(4),
+                                                       fusion_qubits_max_(5), rnd_eng_(seed) {
+        if (batch == 0)
+            throw(std::runtime_error("BatchSimulator: The batch size must be positive."));
+        std::uniform_real_distribution<double> dist(0., 1.);
+        rng_ = std::bind(dist, std::ref(rnd_eng_));
+    }
+
+    unsigned batch_size() const { return B_; }
+
+    void allocate_qubit(unsigned id){
+        if (map_.count(id) != 0)
+            throw(std::runtime_error(
+                "AllocateQubit: ID already exists. Qubit IDs should be unique."));
+        run();
+        map_[id] = N_++;
+        auto newvec = StateVector(B_ << N_);
+        #pragma omp parallel for schedule(static)
+        for (std::size_t i = 0; i < newvec.size(); ++i)
+            newvec[i] = (i < vec_.size())?vec_[i]:0.;
+        vec_ = std::move(newvec);
+    }
+
+    // value of the qubit in every state of the batch; throws unless the
+    // qubit is classical in all of them
+    std::vector<bool> get_classical_values(unsigned id, calc_type tol = 1.e-12){
+        run();
+        std::size_t delta = 1UL << position(id);
+        std::vector<char> up(B_, 0), down(B_, 0);
+        for (std::size_t i = 0; i < (1UL << N_); ++i){
+            auto& side = (i & delta) ? down : up;
+            for (unsigned b = 0; b < B_; ++b)
+                side[b] |= std::norm(vec_[i * B_ + b]) > tol;
+        }
+        std::vector<bool> values(B_);
+        for (unsigned b = 0; b < B_; ++b){
+            if (up[b] == down[b])
+                throw(std::runtime_error("Error: Qubit has not been measured / uncomputed! There is most likely a bug in your code."));
+            values[b] = down[b];
+        }
+        return values;
+    }
+
+    void deallocate_qubit(unsigned id){
+        auto values = get_classical_values(id);
+        unsigned pos = position(id);
+        std::size_t delta = 1UL << pos;
+        StateVector newvec(B_ << (N_ - 1));
+        #pragma omp parallel for schedule(static)
+        for (std::size_t j = 0; j < (1UL << (N_ - 1)); ++j){
+            std::size_t i = ((j >> pos) << (pos + 1)) | (j & (delta - 1));
+            for (unsigned b = 0; b < B_; ++b)
+                newvec[j * B_ + b] = vec_[(i | (values[b] ? delta : 0)) * B_ + b];
+        }
+        vec_ = std::move(newvec);
+        for (auto& p : map_)
+            if (p.second > pos)
+                p.second--;
+        map_.erase(id);
+        N_--;
+    }
+
+    // measures the qubits in every state independently; entry [b][i] is the
+    // outcome of qubit ids[i] in state b
+    std::vector<std::vector<bool>> measure_qubits_return(std::vector<unsigned> const& ids){
+        run();
+        std::size_t mask = 0;
+        for (auto id : ids)
+            mask |= 1UL << position(id);
+
+        std::vector<std::vector<bool>> res(B_, std::vector<bool>(ids.size()));
+        std::vector<std::size_t> val(B_, 0);
+        std::vector<calc_type> norm(B_, 0.);
+        for (unsigned b = 0; b < B_; ++b){
+            // pick entry at random with probability |entry|^2
+            calc_type P = 0., rnd = rng_();
+            std::size_t pick = 0;
+            while (P < rnd && pick < (1UL << N_))
+                P += std::norm(vec_[(pick++) * B_ + b]);
+            pick--;
+            for (unsigned i = 0; i < ids.size(); ++i)
+                res[b][i] = (pick >> map_[ids[i]]) & 1;
+            val[b] = pick & mask;
+        }
+        // set bad entries to 0 and re-normalize
+        for (std::size_t i = 0; i < (1UL << N_); ++i)
+            for (unsigned b = 0; b < B_; ++b){
+                if ((i & mask) != val[b])
+                    vec_[i * B_ + b] = 0.;
+                else
+                    norm[b] += std::norm(vec_[i * B_ + b]);
+            }
+        for (auto& n : norm)
+            n = 1. / std::sqrt(n);
+        #pragma omp parallel for schedule(static)
+        for (std::size_t i = 0; i < (1UL << N_); ++i)
+            for (unsigned b = 0; b < B_; ++b)
+                vec_[i * B_ + b] *= norm[b];
+        return res;
+    }
+
+    // same gate for all states, fused with the gates before it if possible
+    template <class M>
+    void apply_controlled_gate(M const& m, std::vector<unsigned> ids,
+                               std::vector<unsigned> ctrl){
+        auto fused_gates = fused_gates_;
+        fused_gates.insert(m, ids, ctrl);
+
+        if (fused_gates.num_qubits() >= fusion_qubits_min_
+                && fused_gates.num_qubits() <= fusion_qubits_max_){
+            fused_gates_ = fused_gates;
+            run();
+        }
+        else if (fused_gates.num_qubits() > fusion_qubits_max_
+                 || (fused_gates.num_qubits() - ids.size()) > fused_gates_.num_qubits()){
+            run();
+            fused_gates_.insert(m, ids, ctrl);
+        }
+        else
+            fused_gates_ = fused_gates;
+    }
+
+    // ms[b] is applied to state b
+    template <class M>
+    void apply_batched_gate(std::vector<M> const& ms, std::vector<unsigned> const& ids,
+                            std::vector<unsigned> const& ctrl){
+        if (ms.size() != B_)
+            throw(std::runtime_error("apply_batched_gate(): Expected one matrix per state of the batch."));
+        run();
+        std::size_t dim = 1UL << ids.size();
+        std::vector<complex_type> m(dim * dim * B_);
+        for (unsigned b = 0; b < B_; ++b){
+            if (ms[b].size() != dim)
+                throw(std::runtime_error("apply_batched_gate(): Matrix size does not match the number of qubits."));
+            for (std::size_t r = 0; r < dim; ++r)
+                for (std::size_t c = 0; c < dim; ++c)
+                    m[(r * dim + c) * B_ + b] = ms[b][r][c];
+        }
+        apply<true>(m, positions(ids), get_control_mask(ctrl));
+    }
+
+    // <psi_b| H |psi_b> for every state b
+    std::vector<calc_type> get_expectation_value(TermsDict const& td, std::vector<unsigned> const& ids){
+        run();
+        std::vector<calc_type> expectation(B_, 0.);
+        for (auto const& term : td){
+            Term t = term.first;
+            for (auto& local_op : t)
+                local_op.first = position(ids.at(local_op.first));
+            PauliString p(t);
+            std::vector<calc_type> delta(B_, 0.);
+            #pragma omp parallel
+            {
+                std::vector<calc_type> local(B_, 0.);
+                #pragma omp for schedule(static)
+                for (std::size_t i = 0; i < (1UL << N_); ++i){
+                    // P|i> = phase (-1)^(i & zmask) |i ^ xmask>
+                    complex_type ph = parity(i & p.zmask) ? -p.phase : p.phase;
+                    complex_type const* a = &vec_[(i ^ p.xmask) * B_];
+                    complex_type const* v = &vec_[i * B_];
+                    for (unsigned b = 0; b < B_; ++b)
+                        local[b] += std::real(std::conj(a[b]) * ph * v[b]);
+                }
+                #pragma omp critical
+                for (unsigned b = 0; b < B_; ++b)
+                    delta[b] += local[b];
+            }
+            for (unsigned b = 0; b < B_; ++b)
+                expectation[b] += term.second * delta[b];
+        }
+        return expectation;
+    }
+
+    std::vector<calc_type> get_probability(std::vector<bool> const& bit_string,
+                                           std::vector<unsigned> const& ids){
+        run();
+        std::size_t mask = 0, bit_str = 0;
+        for (unsigned i = 0; i < ids.size(); ++i){
+            mask |= 1UL << position(ids[i]);
+            bit_str |= (bit_string[i] ? 1UL : 0UL) << position(ids[i]);
+        }
+        std::vector<calc_type> probability(B_, 0.);
+        for (std::size_t i = 0; i < (1UL << N_); ++i)
+            if ((i & mask) == bit_str)
+                for (unsigned b = 0; b < B_; ++b)
+                    probability[b] += std::norm(vec_[i * B_ + b]);
+        return probability;
+    }
+
+    std::vector<complex_type> get_amplitude(std::vector<bool> const& bit_string,
+                                            std::vector<unsigned> const& ids){
+        run();
+        std::size_t chk = 0, index = 0;
+        for (unsigned i = 0; i < ids.size(); ++i){
+            if (map_.count(ids[i]) == 0)
+                break;
+            chk |= 1UL << map_[ids[i]];
+            index |= (bit_string[i] ? 1UL : 0UL) << map_[ids[i]];
+        }
+        if (chk + 1 != (1UL << N_))
+            throw(std::runtime_error("The second argument to get_amplitude() must be a permutation of all allocated qubits. Please make sure you have called eng.flush()."));
+        return std::vector<complex_type>(vec_.begin() + index * B_, vec_.begin() + (index + 1) * B_);
+    }
+
+    void run(){
+        if (fused_gates_.size() < 1)
+            return;
+
+        Fusion::Matrix fm;
+        Fusion::IndexVector ids, ctrls;
+        fused_gates_.perform_fusion(fm, ids, ctrls);
+        fused_gates_ = Fusion();
+
+        std::size_t dim = fm.size();
+        std::vector<complex_type> m(dim * dim);
+        for (std::size_t r = 0; r < dim; ++r)
+            for (std::size_t c = 0; c < dim; ++c)
+                m[r * dim + c] = fm[r][c];
+        apply<false>(m, positions(ids), get_control_mask(ctrls));
+    }
+
+private:
+    unsigned position(unsigned id) const {
+        auto it = map_.find(id);
+        if (it == map_.end())
+            throw(std::runtime_error("BatchSimulator: Unknown qubit id. Please make sure you have called eng.flush()."));
+        return it->second;
+    }
+
+    std::vector<unsigned> positions(std::vector<unsigned> const& ids) const {
+        std::vector<unsigned> pos(ids.size());
+        for (unsigned i = 0; i < ids.size(); ++i)
+            pos[i] = position(ids[i]);
+        return pos;
+    }
+
+    std::size_t get_control_mask(std::vector<unsigned> const& ctrls){
+        std::size_t ctrlmask = 0;
+        for (auto c : ctrls)
+            ctrlmask |= 1UL << position(c);
+        return ctrlmask;
+    }
+
+    // applies a 2^k x 2^k matrix to the bits pos (matrix index bit j is
+    // bit pos[j]); entry (r, c) is m[r * dim + c], or m[(r * dim + c) * B + b]
+    // for state b if PerBatch
+    template <bool PerBatch>
+    void apply(std::vector<complex_type> const& m, std::vector<unsigned> const& pos,
+               std::size_t ctrlmask){
+        std::size_t dim = 1UL << pos.size();
+        std::vector<std::size_t> offset(dim, 0);
+        for (std::size_t i = 0; i < dim; ++i)
+            for (unsigned j = 0; j < pos.size(); ++j)
+                offset[i] |= ((i >> j) & 1UL) << pos[j];
+        std::vector<unsigned> sorted(pos);
+        std::sort(sorted.begin(), sorted.end());
+
+        #pragma omp parallel
+        {
+            StateVector in(dim * B_);
+            #pragma omp for schedule(static)
+            for (std::size_t k = 0; k < (1UL << (N_ - pos.size())); ++k){
+                // insert zeros at the target bits
+                std::size_t i = k;
+                for (auto p : sorted)
+                    i = ((i >> p) << (p + 1)) | (i & ((1UL << p) - 1));
+                if ((i & ctrlmask) != ctrlmask)
+                    continue;
+                for (std::size_t c = 0; c < dim; ++c)
+                    std::copy_n(&vec_[(i | offset[c]) * B_], B_, &in[c * B_]);
+                for (std::size_t r = 0; r < dim; ++r){
+                    // plain real arithmetic, std::complex products do not vectorize
+                    calc_type* out = reinterpret_cast<calc_type*>(&vec_[(i | offset[r]) * B_]);
+                    for (unsigned b = 0; b < 2 * B_; ++b)
+                        out[b] = 0.;
+                    for (std::size_t c = 0; c < dim; ++c){
+                        calc_type const* v = reinterpret_cast<calc_type const*>(&in[c * B_]);
+                        if (PerBatch){
+                            calc_type const* mrc = reinterpret_cast<calc_type const*>(&m[(r * dim + c) * B_]);
+                            for (unsigned b = 0; b < 2 * B_; b += 2){
+                                out[b] += mrc[b] * v[b] - mrc[b + 1] * v[b + 1];
+                                out[b + 1] += mrc[b] * v[b + 1] + mrc[b + 1] * v[b];
+                            }
+                        }
+                        else{
+                            calc_type mr = std::real(m[r * dim + c]), mi = std::imag(m[r * dim + c]);
+                            for (unsigned b = 0; b < 2 * B_; b += 2){
+                                out[b] += mr * v[b] - mi * v[b + 1];
+                                out[b + 1] += mr * v[b + 1] + mi * v[b];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    unsigned B_; // batch size
+    unsigned N_; // #qubits
+    StateVector vec_;
+    Map map_;
+    Fusion fused_gates_;
+    unsigned fusion_qubits_min_, fusion_qubits_max_;
+    RndEngine rnd_eng_;
+    std::function<double()> rng_;
+};
+
+#endif
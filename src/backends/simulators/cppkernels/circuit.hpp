@@ -0,0 +1,263 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CIRCUIT_HPP_
+#define CIRCUIT_HPP_
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <stdexcept>
+#include "fusion.hpp"
+#include "fusionplanner.hpp"
+#include "pauli.hpp"
+
+// A gate of a parametrized circuit on simulator qubit ids. Gates other than
+// MATRIX are rotations
+//     U(theta) = exp(-i theta G),    theta = scale * params[param]
+// (theta = scale if param < 0) with the generators
+//     RX, RY, RZ: X/2, Y/2, Z/2         (the Rx, Ry, Rz gates)
+//     R:          -|1><1|               (diag(1, exp(i theta)))
+//     PH:         -1                    (global phase, matters if controlled)
+//     PAULI:      the Pauli string term (exp(-i theta P), e.g. TimeEvolution)
+// MEASURE is a measurement point of the qubits ids.
+struct CircuitGate{
+    enum Kind{ MATRIX = 0, RX, RY, RZ, R, PH, PAULI, MEASURE };
+
+    Kind kind = MATRIX;
+    Fusion::Matrix matrix; // MATRIX only
+    std::vector<unsigned> ids, ctrl;
+    std::vector<std::pair<unsigned, char>> term; // PAULI: (index into ids, 'X' | 'Y' | 'Z')
+    int param = -1;
+    double scale = 0.;
+
+    double angle(std::vector<double> const& params) const {
+        return param < 0 ? scale : scale * params[param];
+    }
+
+    // matrix of the gate (without controls) at angle theta, bit j of the
+    // matrix index belongs to ids[j]
+    Fusion::Matrix get_matrix(double theta) const {
+        using complex_type = std::complex<double>;
+        double c = std::cos(0.5 * theta), s = std::sin(0.5 * theta);
+        complex_type I(0., 1.);
+        switch (kind){
+            case RX: return {{c, -I * s}, {-I * s, c}};
+            case RY: return {{c, -s}, {s, c}};
+            case RZ: return {{std::polar(1., -0.5 * theta), 0.}, {0., std::polar(1., 0.5 * theta)}};
+            case R: return {{1., 0.}, {0., std::polar(1., theta)}};
+            case PH: return {{std::polar(1., theta), 0.}, {0., std::polar(1., theta)}};
+            case PAULI: {
+                // cos(theta) - i sin(theta) P
+                PauliString p(term);
+                std::size_t n = 1UL << ids.size();
+                Fusion::Matrix m(n, Fusion::Matrix::value_type(n, 0.));
+                complex_type mis = -I * std::sin(theta) * p.phase;
+                for (std::size_t x = 0; x < n; ++x){
+                    m[x][x] += std::cos(theta);
+                    m[x ^ p.xmask][x] += parity(x & p.zmask) ? -mis : mis;
+                }
+                return m;
+            }
+            default: return matrix;
+        }
+    }
+
+    // throws if the gate is malformed or uses a parameter >= num_params
+    void check(std::size_t num_params) const {
+        if (kind == MEASURE){
+            if (ids.empty() || param >= 0 || !ctrl.empty())
+                throw(std::runtime_error("CircuitGate: Measurements need qubits and take no parameters or controls."));
+            return;
+        }
+        if (ids.empty() || ids.size() > 5)
+            throw(std::runtime_error("CircuitGate: Gates act on 1 to 5 qubits."));
+        if (param >= static_cast<int>(num_params))
+            throw(std::runtime_error("CircuitGate: Parameter index out of range."));
+        switch (kind){
+            case MATRIX:
+                if (param >= 0)
+                    throw(std::runtime_error("CircuitGate: Matrix gates cannot be parametrized."));
+                if (matrix.size() != (1UL << ids.size()))
+                    throw(std::runtime_error("CircuitGate: Matrix size does not match the number of qubits."));
+                break;
+            case RX: case RY: case RZ: case R: case PH:
+                if (ids.size() != 1)
+                    throw(std::runtime_error("CircuitGate: Rotation gates act on a single qubit."));
+                break;
+            case PAULI:
+                for (auto const& local_op : term)
+                    if (local_op.first >= ids.size())
+                        throw(std::runtime_error("CircuitGate: Pauli term refers to an unknown qubit."));
+                break;
+            default:
+                throw(std::runtime_error("CircuitGate: Unknown gate kind."));
+        }
+    }
+};
+
+// A circuit together with its fusion plan: the gates are grouped into the
+// blocks FusionPlanner forms (see Simulator::apply_controlled_gate), and the
+// fused matrix of every block is cached, so replaying the circuit only
+// applies the blocks. Blocks containing parametrized gates are fused again
+// when one of their angles changes; all other blocks are fused once.
+// Measurements end the current block and form a block of their own.
+class CompiledCircuit{
+public:
+    struct Block{
+        std::vector<std::size_t> gates; // indices into the circuit
+        std::vector<double> angles;     // angles the matrix was fused with
+        bool parametrized = false;
+        bool measure = false;           // measures ids, no matrix
+        Fusion::Matrix matrix;
+        Fusion::IndexVector ids, ctrls;
+    };
+
+    CompiledCircuit(std::vector<CircuitGate> gates, std::vector<double> params = {},
+                    unsigned fusion_qubits_max = 5)
+        : gates_(std::move(gates)), num_params_(0) {
+        for (auto const& g : gates_)
+            num_params_ = std::max(num_params_, static_cast<std::size_t>(g.param + 1));
+        for (auto const& g : gates_)
+            g.check(num_params_);
+        params.resize(num_params_, 0.);
+
+        // the segments between measurements are planned like the lookahead
+        // window of Simulator::apply_controlled_gate, as a whole
+        std::vector<FusionPlanner::Footprint> footprints;
+        std::vector<std::size_t> segment;
+        for (std::size_t k = 0; k <= gates_.size(); ++k){
+            if (k < gates_.size() && gates_[k].kind != CircuitGate::MEASURE){
+                auto const& g = gates_[k];
+                // parametrized gates at a generic angle, so that their
+                // footprint holds for all parameters
+                auto m = g.get_matrix(g.param >= 0 ? 1. : g.angle(params));
+                footprints.push_back(FusionPlanner::footprint(m, g.ids, g.ctrl));
+                segment.push_back(k);
+                continue;
+            }
+            for (auto const& planned : FusionPlanner::plan(footprints, fusion_qubits_max)){
+                Fusion fused;
+                std::vector<std::size_t> members;
+                for (auto i : planned){
+                    auto const& g = gates_[segment[i]];
+                    fused.insert(g.get_matrix(g.angle(params)), g.ids, g.ctrl);
+                    members.push_back(segment[i]);
+                }
+                close_block(fused, members, params);
+            }
+            footprints.clear();
+            segment.clear();
+            if (k == gates_.size())
+                break;
+            Block block;
+            block.gates = {k};
+            block.angles = {0.};
+            block.measure = true;
+            block.ids = gates_[k].ids;
+            blocks_.push_back(std::move(block));
+        }
+    }
+
+    // a circuit with a precomputed plan, e.g. loaded from a file (see
+    // circuitfile.hpp); throws if the plan does not fit the gates
+    CompiledCircuit(std::vector<CircuitGate> gates, std::vector<Block> blocks)
+        : gates_(std::move(gates)), blocks_(std::move(blocks)), num_params_(0) {
+        for (auto const& g : gates_)
+            num_params_ = std::max(num_params_, static_cast<std::size_t>(g.param + 1));
+        for (auto const& g : gates_)
+            g.check(num_params_);
+        for (auto& block : blocks_){
+            if (block.gates.empty() || block.angles.size() != block.gates.size())
+                throw(std::runtime_error("CompiledCircuit: Invalid block."));
+            block.parametrized = false;
+            for (auto k : block.gates){
+                if (k >= gates_.size())
+                    throw(std::runtime_error("CompiledCircuit: Block refers to an unknown gate."));
+                block.parametrized |= gates_[k].param >= 0;
+                if ((gates_[k].kind == CircuitGate::MEASURE) != block.measure)
+                    throw(std::runtime_error("CompiledCircuit: Measurements must form blocks of their own."));
+            }
+            if (block.measure){
+                if (block.gates.size() != 1 || block.ids != gates_[block.gates[0]].ids)
+                    throw(std::runtime_error("CompiledCircuit: Invalid measurement block."));
+            }
+            else if (block.ids.empty() || block.ids.size() > 5
+                     || block.matrix.size() != (1UL << block.ids.size()))
+                throw(std::runtime_error("CompiledCircuit: Block matrix does not match its qubits."));
+            else
+                for (auto const& row : block.matrix)
+                    if (row.size() != block.matrix.size())
+                        throw(std::runtime_error("CompiledCircuit: Block matrix is not square."));
+        }
+    }
+
+    // re-fuses the parametrized blocks whose angles differ from params
+    void update(std::vector<double> const& params){
+        if (params.size() < num_params_)
+            throw(std::runtime_error("CompiledCircuit: Too few parameters."));
+        for (auto& block : blocks_){
+            if (!block.parametrized)
+                continue;
+            bool changed = false;
+            for (std::size_t i = 0; i < block.gates.size(); ++i){
+                double theta = gates_[block.gates[i]].angle(params);
+                changed |= theta != block.angles[i];
+                block.angles[i] = theta;
+            }
+            if (changed)
+                fuse(block);
+        }
+    }
+
+    std::vector<Block> const& blocks() const { return blocks_; }
+
+    std::vector<CircuitGate> const& gates() const { return gates_; }
+
+    std::size_t num_parameters() const { return num_params_; }
+
+private:
+    void close_block(Fusion& fused, std::vector<std::size_t>& members,
+                     std::vector<double> const& params){
+        if (fused.size() > 0){
+            Block block;
+            block.gates = members;
+            for (auto k : members){
+                block.angles.push_back(gates_[k].angle(params));
+                block.parametrized |= gates_[k].param >= 0;
+            }
+            fused.perform_fusion(block.matrix, block.ids, block.ctrls);
+            blocks_.push_back(std::move(block));
+        }
+        members.clear();
+    }
+
+    void fuse(Block& block){
+        Fusion fused;
+        for (std::size_t i = 0; i < block.gates.size(); ++i){
+            auto const& g = gates_[block.gates[i]];
+            fused.insert(g.get_matrix(block.angles[i]), g.ids, g.ctrl);
+        }
+        Fusion::Matrix m;
+        Fusion::IndexVector ids, ctrls;
+        fused.perform_fusion(m, ids, ctrls);
+        block.matrix = std::move(m);
+    }
+
+    std::vector<CircuitGate> gates_;
+    std::vector<Block> blocks_;
+    std::size_t num_params_;
+};
+
+#endif
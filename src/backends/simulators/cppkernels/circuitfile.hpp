@@ -0,0 +1,279 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CIRCUITFILE_HPP_
+#define CIRCUITFILE_HPP_
+
+// Binary file format of compiled circuits, so that repeated jobs can load
+// the fused command stream instead of running the compiler engines again.
+//
+// All values are stored in host byte order; the header records it and files
+// of the other byte order are rejected. Version 1:
+//
+//   header:  char[8] "QJSCIRC", uint32 version, uint32 0x01020304,
+//            uint64 #gates, uint64 #blocks
+//   gate:    uint32 kind, int32 param, float64 scale,
+//            uint32 #ids, uint32 #ctrl, uint32 #term, uint32 matrix dim,
+//            uint32 ids[], uint32 ctrl[], (uint32 index, uint32 op)[term],
+//            (float64 re, float64 im)[dim * dim]          (row-major)
+//   block:   uint32 flags (1: measure), uint32 #gates, uint32 #ids,
+//            uint32 #ctrls, uint32 matrix dim,
+//            uint64 gates[], float64 angles[#gates], uint32 ids[],
+//            uint32 ctrls[], (float64 re, float64 im)[dim * dim]
+//
+// Files are mapped into memory (mmap) for loading; the matrices are copied
+// into the aligned layout the kernels expect.
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include "circuit.hpp"
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace circuitfile{
+
+const char magic[8] = {'Q', 'J', 'S', 'C', 'I', 'R', 'C', '\0'};
+const std::uint32_t version = 1;
+const std::uint32_t byte_order = 0x01020304;
+
+class Writer{
+public:
+    template <class T>
+    void put(T value){
+        auto p = reinterpret_cast<char const*>(&value);
+        buf_.insert(buf_.end(), p, p + sizeof(T));
+    }
+
+    void put_ids(std::vector<unsigned> const& ids){
+        for (auto id : ids)
+            put<std::uint32_t>(id);
+    }
+
+    void put_matrix(Fusion::Matrix const& m){
+        for (auto const& row : m)
+            for (auto const& v : row){
+                put<double>(v.real());
+                put<double>(v.imag());
+            }
+    }
+
+    std::vector<char> const& data() const { return buf_; }
+
+private:
+    std::vector<char> buf_;
+};
+
+class Reader{
+public:
+    Reader(char const* data, std::size_t size) : data_(data), size_(size), pos_(0) {}
+
+    template <class T>
+    T get(){
+        T value;
+        take(&value, sizeof(T));
+        return value;
+    }
+
+    std::vector<unsigned> get_ids(std::size_t n){
+        check(n * sizeof(std::uint32_t));
+        std::vector<unsigned> ids(n);
+        for (auto& id : ids)
+            id = get<std::uint32_t>();
+        return ids;
+    }
+
+    Fusion::Matrix get_matrix(std::size_t dim){
+        if (dim > 32)
+            throw(std::runtime_error("load_compiled_circuit(): Corrupt file (matrix too large)."));
+        check(dim * dim * 2 * sizeof(double));
+        Fusion::Matrix m(dim, Fusion::Matrix::value_type(dim));
+        for (auto& row : m)
+            for (auto& v : row){
+                double re = get<double>();
+                v = Fusion::Complex(re, get<double>());
+            }
+        return m;
+    }
+
+    void take(void* out, std::size_t n){
+        check(n);
+        std::memcpy(out, data_ + pos_, n);
+        pos_ += n;
+    }
+
+    bool done() const { return pos_ == size_; }
+
+private:
+    void check(std::size_t n) const {
+        if (n > size_ - pos_)
+            throw(std::runtime_error("load_compiled_circuit(): Corrupt file (unexpected end)."));
+    }
+
+    char const* data_;
+    std::size_t size_, pos_;
+};
+
+inline CompiledCircuit parse(char const* data, std::size_t size){
+    Reader in(data, size);
+    char m[8];
+    in.take(m, sizeof(m));
+    if (std::memcmp(m, magic, sizeof(m)) != 0)
+        throw(std::runtime_error("load_compiled_circuit(): Not a compiled circuit file."));
+    if (in.get<std::uint32_t>() != version)
+        throw(std::runtime_error("load_compiled_circuit(): Unsupported file version."));
+    if (in.get<std::uint32_t>() != byte_order)
+        throw(std::runtime_error("load_compiled_circuit(): File was written with a different byte order."));
+    auto num_gates = in.get<std::uint64_t>();
+    auto num_blocks = in.get<std::uint64_t>();
+    if (num_gates > size || num_blocks > size)
+        throw(std::runtime_error("load_compiled_circuit(): Corrupt file (counts)."));
+
+    std::vector<CircuitGate> gates(num_gates);
+    for (auto& g : gates){
+        auto kind = in.get<std::uint32_t>();
+        if (kind > CircuitGate::MEASURE)
+            throw(std::runtime_error("load_compiled_circuit(): Corrupt file (gate kind)."));
+        g.kind = static_cast<CircuitGate::Kind>(kind);
+        g.param = in.get<std::int32_t>();
+        g.scale = in.get<double>();
+        auto nids = in.get<std::uint32_t>();
+        auto nctrl = in.get<std::uint32_t>();
+        auto nterm = in.get<std::uint32_t>();
+        auto dim = in.get<std::uint32_t>();
+        g.ids = in.get_ids(nids);
+        g.ctrl = in.get_ids(nctrl);
+        auto term = in.get_ids(2 * std::size_t(nterm));
+        for (std::size_t i = 0; i < nterm; ++i){
+            auto op = term[2 * i + 1];
+            if (term[2 * i] >= nids || (op != 'X' && op != 'Y' && op != 'Z'))
+                throw(std::runtime_error("load_compiled_circuit(): Corrupt file (Pauli term)."));
+            g.term.push_back(std::make_pair(term[2 * i], static_cast<char>(op)));
+        }
+        g.matrix = in.get_matrix(dim);
+    }
+
+    std::vector<CompiledCircuit::Block> blocks(num_blocks);
+    for (auto& b : blocks){
+        auto flags = in.get<std::uint32_t>();
+        b.measure = flags & 1;
+        auto ngates = in.get<std::uint32_t>();
+        auto nids = in.get<std::uint32_t>();
+        auto nctrls = in.get<std::uint32_t>();
+        auto dim = in.get<std::uint32_t>();
+        if (ngates > num_gates)
+            throw(std::runtime_error("load_compiled_circuit(): Corrupt file (block)."));
+        for (std::size_t i = 0; i < ngates; ++i)
+            b.gates.push_back(in.get<std::uint64_t>());
+        for (std::size_t i = 0; i < ngates; ++i)
+            b.angles.push_back(in.get<double>());
+        b.ids = in.get_ids(nids);
+        b.ctrls = in.get_ids(nctrls);
+        b.matrix = in.get_matrix(dim);
+    }
+    if (!in.done())
+        throw(std::runtime_error("load_compiled_circuit(): Corrupt file (trailing data)."));
+    return CompiledCircuit(std::move(gates), std::move(blocks));
+}
+
+} // namespace circuitfile
+
+inline void save_compiled_circuit(CompiledCircuit const& circuit, std::string const& path){
+    using namespace circuitfile;
+    Writer out;
+    for (auto c : magic)
+        out.put<char>(c);
+    out.put<std::uint32_t>(version);
+    out.put<std::uint32_t>(byte_order);
+    out.put<std::uint64_t>(circuit.gates().size());
+    out.put<std::uint64_t>(circuit.blocks().size());
+    for (auto const& g : circuit.gates()){
+        out.put<std::uint32_t>(g.kind);
+        out.put<std::int32_t>(g.param);
+        out.put<double>(g.scale);
+        out.put<std::uint32_t>(g.ids.size());
+        out.put<std::uint32_t>(g.ctrl.size());
+        out.put<std::uint32_t>(g.term.size());
+        out.put<std::uint32_t>(g.kind == CircuitGate::MATRIX ? g.matrix.size() : 0);
+        out.put_ids(g.ids);
+        out.put_ids(g.ctrl);
+        for (auto const& local_op : g.term){
+            out.put<std::uint32_t>(local_op.first);
+            out.put<std::uint32_t>(static_cast<unsigned char>(local_op.second));
+        }
+        if (g.kind == CircuitGate::MATRIX)
+            out.put_matrix(g.matrix);
+    }
+    for (auto const& b : circuit.blocks()){
+        out.put<std::uint32_t>(b.measure ? 1 : 0);
+        out.put<std::uint32_t>(b.gates.size());
+        out.put<std::uint32_t>(b.ids.size());
+        out.put<std::uint32_t>(b.ctrls.size());
+        out.put<std::uint32_t>(b.matrix.size());
+        for (auto k : b.gates)
+            out.put<std::uint64_t>(k);
+        for (auto a : b.angles)
+            out.put<double>(a);
+        out.put_ids(b.ids);
+        out.put_ids(b.ctrls);
+        out.put_matrix(b.matrix);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(out.data().data(), out.data().size());
+    if (!file)
+        throw(std::runtime_error("save_compiled_circuit(): Could not write " + path + "."));
+}
+
+inline CompiledCircuit load_compiled_circuit(std::string const& path){
+#if defined(_WIN32)
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw(std::runtime_error("load_compiled_circuit(): Could not open " + path + "."));
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return circuitfile::parse(data.data(), data.size());
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw(std::runtime_error("load_compiled_circuit(): Could not open " + path + "."));
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0){
+        close(fd);
+        throw(std::runtime_error("load_compiled_circuit(): Could not read " + path + "."));
+    }
+    std::size_t size = st.st_size;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        throw(std::runtime_error("load_compiled_circuit(): Could not map " + path + "."));
+    try {
+        auto circuit = circuitfile::parse(static_cast<char const*>(data), size);
+        munmap(data, size);
+        return circuit;
+    } catch (...){
+        munmap(data, size);
+        throw;
+    }
+#endif
+}
+
+#endif
@@ -0,0 +1,277 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FUSION_PLANNER_HPP_
+#define FUSION_PLANNER_HPP_
+
+#include <vector>
+#include <complex>
+#include <algorithm>
+#include <iterator>
+#include "fusion.hpp"
+#include "kernelk.hpp"
+
+// Groups a window of gates into fused blocks, reordering gates which
+// commute. Two gates commute if both act block-diagonally on every qubit
+// they share (a control, or a target whose value the matrix never changes),
+// e.g. diagonal gates, gates which only share controls, or gates on
+// disjoint qubits. The gates are scheduled along the dependency DAG of the
+// non-commuting pairs, so a gate which commutes with everything queued no
+// longer ends a block. A block is grown with the ready gate which saves the
+// most sweep time, given the cost of one sweep per fused width (costs[w]),
+// as long as the fused sweep is cheaper than applying the gate on its own
+// and the block fits into max_qubits. Growing on ties is planned as well,
+// and the cheaper of the two plans is used.
+class FusionPlanner{
+public:
+    using Index = Fusion::Index;
+    using IndexVector = Fusion::IndexVector;
+    using Matrix = Fusion::Matrix;
+
+    // the qubits of a gate (sorted)
+    struct Footprint{
+        IndexVector ids, ctrl;
+        IndexVector qubits;   // ids and ctrl
+        IndexVector diagonal; // the qubits the gate acts block-diagonally on
+    };
+
+    static Footprint footprint(Matrix const& m, IndexVector const& ids, IndexVector const& ctrl){
+        Footprint f;
+        f.ids = ids;
+        f.ctrl = ctrl;
+        std::sort(f.ctrl.begin(), f.ctrl.end());
+        f.diagonal = f.ctrl;
+        for (unsigned j = 0; j < ids.size(); ++j){
+            std::size_t bit = 1UL << j;
+            bool diagonal = true;
+            for (std::size_t r = 0; r < m.size() && diagonal; ++r)
+                for (std::size_t c = 0; c < m.size(); ++c)
+                    if (((r ^ c) & bit) && m[r][c] != std::complex<double>(0.)){
+                        diagonal = false;
+                        break;
+                    }
+            if (diagonal)
+                f.diagonal.push_back(ids[j]);
+        }
+        std::sort(f.diagonal.begin(), f.diagonal.end());
+        f.qubits = f.ctrl;
+        f.qubits.insert(f.qubits.end(), ids.begin(), ids.end());
+        std::sort(f.qubits.begin(), f.qubits.end());
+        return f;
+    }
+
+    static bool commute(Footprint const& a, Footprint const& b){
+        IndexVector shared;
+        std::set_intersection(a.qubits.begin(), a.qubits.end(), b.qubits.begin(), b.qubits.end(),
+                              std::back_inserter(shared));
+        for (auto q : shared)
+            if (!std::binary_search(a.diagonal.begin(), a.diagonal.end(), q)
+                    || !std::binary_search(b.diagonal.begin(), b.diagonal.end(), q))
+                return false;
+        return true;
+    }
+
+    using Costs = std::vector<double>;
+
+    // one sweep of width w costs max(1, 2^(w-4)): widths up to 4 are bound
+    // by memory bandwidth, wider ones by the multiply-adds
+    static Costs default_costs(){
+        Costs costs(kernel_max_qubits + 1, 1.);
+        for (unsigned w = 5; w <= kernel_max_qubits; ++w)
+            costs[w] = 2. * costs[w - 1];
+        return costs;
+    }
+
+    // Blocks of indices into gates, in the order they are to be applied.
+    // Gates on more than max_qubits qubits form blocks of their own.
+    static std::vector<IndexVector> plan(std::vector<Footprint> const& gates, unsigned max_qubits,
+                                         Costs const& costs = default_costs()){
+        std::size_t n = gates.size();
+        std::vector<std::vector<std::size_t>> successors(n);
+        std::vector<std::size_t> pending(n, 0); // #unscheduled predecessors
+        for (std::size_t i = 0; i < n; ++i)
+            for (std::size_t j = 0; j < i; ++j)
+                if (!commute(gates[j], gates[i])){
+                    successors[j].push_back(i);
+                    ++pending[i];
+                }
+
+        // Growing a block by a gate which costs the same either way (e.g.
+        // to max_qubits if the cost doubles at that width) is a tie for the
+        // block, but may leave fewer gates for it to absorb than two
+        // narrower sweeps would, so both are planned and the cheaper plan
+        // is kept (the one growing on ties if they cost the same)
+        auto grown = schedule(gates, successors, pending, max_qubits, costs, true);
+        auto strict = schedule(gates, successors, pending, max_qubits, costs, false);
+        return total_cost(gates, strict, costs) < total_cost(gates, grown, costs) ? strict : grown;
+    }
+
+    // Number of qubits the fused matrix of a block acts on: its targets and
+    // the controls which are not shared by all of its gates (see Fusion)
+    static unsigned num_qubits(std::vector<Footprint> const& gates, IndexVector const& block){
+        Shape shape;
+        for (auto g : block)
+            shape = shape.add(gates[g]);
+        return shape.width();
+    }
+
+    void insert(Matrix matrix, IndexVector const& ids, IndexVector const& ctrl){
+        footprints_.push_back(footprint(matrix, ids, ctrl));
+        matrices_.push_back(std::move(matrix));
+    }
+
+    std::size_t size() const {
+        return footprints_.size();
+    }
+
+    // the cost of one sweep per fused width (see default_costs)
+    void set_costs(Costs costs){
+        costs_ = std::move(costs);
+    }
+
+    Costs const& get_costs() const {
+        return costs_;
+    }
+
+    // Removes the first planned blocks from the queue and returns them
+    // fused: all of them if min_qubits is 0, otherwise the first block and
+    // the following ones which act on at least min_qubits qubits. The other
+    // gates stay queued, in planned order.
+    std::vector<Fusion> take(unsigned max_qubits, unsigned min_qubits){
+        auto blocks = plan(footprints_, max_qubits, costs_);
+        std::size_t count = 1;
+        if (min_qubits == 0)
+            count = blocks.size();
+        else
+            while (count < blocks.size() && num_qubits(footprints_, blocks[count]) >= min_qubits)
+                ++count;
+        std::vector<Fusion> fused(std::min(count, blocks.size()));
+        for (std::size_t b = 0; b < fused.size(); ++b)
+            for (auto g : blocks[b])
+                fused[b].insert(matrices_[g], footprints_[g].ids, footprints_[g].ctrl);
+
+        std::vector<Footprint> footprints;
+        std::vector<Matrix> matrices;
+        for (std::size_t b = fused.size(); b < blocks.size(); ++b)
+            for (auto g : blocks[b]){
+                footprints.push_back(std::move(footprints_[g]));
+                matrices.push_back(std::move(matrices_[g]));
+            }
+        footprints_ = std::move(footprints);
+        matrices_ = std::move(matrices);
+        return fused;
+    }
+
+private:
+    static double cost(Costs const& costs, unsigned width){
+        return costs[std::min<std::size_t>(width, costs.size() - 1)];
+    }
+
+    static double total_cost(std::vector<Footprint> const& gates, std::vector<IndexVector> const& blocks,
+                             Costs const& costs){
+        double total = 0.;
+        for (auto const& block : blocks)
+            total += cost(costs, num_qubits(gates, block));
+        return total;
+    }
+
+    // Greedy schedule along the dependency DAG: a block is grown with the
+    // ready gate which adds the least to its cost compared to a sweep of
+    // its own, if that is a saving (or no loss, if grow_on_ties)
+    static std::vector<IndexVector> schedule(std::vector<Footprint> const& gates,
+                                             std::vector<std::vector<std::size_t>> const& successors,
+                                             std::vector<std::size_t> pending, unsigned max_qubits,
+                                             Costs const& costs, bool grow_on_ties){
+        std::vector<std::size_t> ready;
+        for (std::size_t i = 0; i < gates.size(); ++i)
+            if (pending[i] == 0)
+                ready.push_back(i);
+
+        // ready stays sorted, i.e. in arrival order
+        std::vector<IndexVector> blocks;
+        while (!ready.empty()){
+            Shape shape;
+            IndexVector block;
+            std::size_t best = 0; // the earliest gate starts a block
+            while (true){
+                std::size_t g = ready[best];
+                ready.erase(ready.begin() + best);
+                shape = shape.add(gates[g]);
+                block.push_back(g);
+                for (auto s : successors[g])
+                    if (--pending[s] == 0)
+                        ready.insert(std::lower_bound(ready.begin(), ready.end(), s), s);
+                if (shape.width() > max_qubits)
+                    break;
+
+                // earliest gate on ties
+                double current = cost(costs, shape.width()), best_extra = 0.;
+                best = ready.size();
+                for (std::size_t r = 0; r < ready.size(); ++r){
+                    unsigned width = shape.add(gates[ready[r]]).width();
+                    if (width > max_qubits)
+                        continue;
+                    double extra = cost(costs, width) - current - cost(costs, Shape().add(gates[ready[r]]).width());
+                    if (extra < best_extra || (grow_on_ties && extra == 0. && best == ready.size())){
+                        best = r;
+                        best_extra = extra;
+                    }
+                }
+                if (best == ready.size())
+                    break;
+            }
+            blocks.push_back(std::move(block));
+        }
+        return blocks;
+    }
+
+    // targets and controls of a (partial) block
+    struct Shape{
+        IndexVector targets, all_ctrls, common_ctrls;
+        bool empty = true;
+
+        Shape add(Footprint const& f) const {
+            Shape s;
+            s.empty = false;
+            IndexVector ids(f.ids);
+            std::sort(ids.begin(), ids.end());
+            std::set_union(targets.begin(), targets.end(), ids.begin(), ids.end(),
+                           std::back_inserter(s.targets));
+            std::set_union(all_ctrls.begin(), all_ctrls.end(), f.ctrl.begin(), f.ctrl.end(),
+                           std::back_inserter(s.all_ctrls));
+            if (empty)
+                s.common_ctrls = f.ctrl;
+            else
+                std::set_intersection(common_ctrls.begin(), common_ctrls.end(), f.ctrl.begin(),
+                                      f.ctrl.end(), std::back_inserter(s.common_ctrls));
+            return s;
+        }
+
+        unsigned width() const {
+            IndexVector merged;
+            std::set_difference(all_ctrls.begin(), all_ctrls.end(), common_ctrls.begin(),
+                                common_ctrls.end(), std::back_inserter(merged));
+            IndexVector qubits;
+            std::set_union(targets.begin(), targets.end(), merged.begin(), merged.end(),
+                           std::back_inserter(qubits));
+            return qubits.size();
+        }
+    };
+
+    std::vector<Footprint> footprints_;
+    std::vector<Matrix> matrices_;
+    Costs costs_ = default_costs();
+};
+
+#endif
@@ -0,0 +1,58 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CACHESIZE_HPP_
+#define CACHESIZE_HPP_
+
+#include <cstddef>
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#elif defined(__unix__)
+#include <unistd.h>
+#endif
+
+// size of the last-level cache in bytes (32 MiB if it cannot be detected)
+inline std::size_t last_level_cache_size(){
+    std::size_t size = 0;
+#if defined(__APPLE__)
+    std::size_t len = sizeof(size);
+    if (sysctlbyname("hw.l3cachesize", &size, &len, nullptr, 0) != 0 || size == 0){
+        len = sizeof(size);
+        if (sysctlbyname("hw.l2cachesize", &size, &len, nullptr, 0) != 0)
+            size = 0;
+    }
+#elif defined(_SC_LEVEL3_CACHE_SIZE)
+    long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE), l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    size = l3 > 0 ? l3 : (l2 > 0 ? l2 : 0);
+#endif
+    return size > 0 ? size : (std::size_t(32) << 20);
+}
+
+// States of more than this many bytes are swept with software prefetches:
+// they do not fit into the last-level cache, and the hardware prefetchers
+// lose track of the 2^k strided streams of a k-qubit kernel, in particular
+// if the gate acts on low qubits and the contiguous runs are short.
+// PREFETCH_THRESHOLD (in bytes) overrides the default of four times the
+// last-level cache; Simulator::set_prefetch_threshold() changes it at run
+// time (the portable kernels never prefetch).
+inline std::size_t prefetch_threshold(){
+#ifdef PREFETCH_THRESHOLD
+    return PREFETCH_THRESHOLD;
+#else
+    static std::size_t const threshold = 4 * last_level_cache_size();
+    return threshold;
+#endif
+}
+
+#endif
@@ -17,6 +17,7 @@
 
 #include <immintrin.h>
 #include <complex>
+#include <cstddef>
 
 #ifndef _mm256_set_m128d
 #define _mm256_set_m128d(hi,lo) _mm256_insertf128_pd(_mm256_castpd128_pd256(lo), (hi), 0x1)
@@ -121,4 +122,16 @@ template <class U>
 inline __m256d load(U const*p1, U const*p2){
     return _mm256_loadu2_m128d((double const*)p2, (double const*)p1);
 }
+
+// distance (in amplitudes) the prefetching kernels load ahead
+static const std::size_t prefetch_distance = 256;
+
+// load2(&psi[i]), which also prefetches psi[i + prefetch_distance] (wrapped
+// around at the end of the state) if Prefetch
+template <bool Prefetch, class V>
+inline __m256d load2(V &psi, std::size_t i){
+    if (Prefetch)
+        _mm_prefetch((char const*)&psi[(i + prefetch_distance) & (psi.size() - 1)], _MM_HINT_T0);
+    return load2(&psi[i]);
+}
 #endif
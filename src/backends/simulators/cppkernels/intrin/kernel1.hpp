@@ -12,21 +12,21 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-template <class V, class M>
+template <bool Prefetch, class V, class M>
 inline void kernel_core(V &psi, std::size_t I, std::size_t d0, M const& m, M const& mt)
 {
     __m256d v[2];
 
-    v[0] = load2(&psi[I]);
-    v[1] = load2(&psi[I + d0]);
+    v[0] = load2<Prefetch>(psi, I);
+    v[1] = load2<Prefetch>(psi, I + d0);
 
     _mm256_storeu2_m128d((double*)&psi[I + d0], (double*)&psi[I], add(mul(v[0], m[0], mt[0]), mul(v[1], m[1], mt[1])));
 
 }
 
-// bit indices id[.] are given from high to low (e.g. control first for CNOT)
-template <class V, class M>
-void kernel(V &psi, unsigned id0, M const& m, std::size_t ctrlmask)
+// the sweep of kernel(), with software prefetches if Prefetch
+template <bool Prefetch, class V, class M>
+void kernel_sweep(V &psi, unsigned id0, M const& m, std::size_t ctrlmask)
 {
     std::size_t n = psi.size();
     std::size_t d0 = 1UL << id0;
@@ -46,7 +46,7 @@ void kernel(V &psi, unsigned id0, M const& m, std::size_t ctrlmask)
         #pragma omp for collapse(LOOP_COLLAPSE1) schedule(static)
         for (std::size_t i0 = 0; i0 < n; i0 += 2 * dsorted[0]){
             for (std::size_t i1 = 0; i1 < dsorted[0]; ++i1){
-                kernel_core(psi, i0 + i1, d0, mm, mmt);
+                kernel_core<Prefetch>(psi, i0 + i1, d0, mm, mmt);
             }
         }
     }
@@ -55,9 +55,19 @@ void kernel(V &psi, unsigned id0, M const& m, std::size_t ctrlmask)
         for (std::size_t i0 = 0; i0 < n; i0 += 2 * dsorted[0]){
             for (std::size_t i1 = 0; i1 < dsorted[0]; ++i1){
                 if (((i0 + i1)&ctrlmask) == ctrlmask)
-                    kernel_core(psi, i0 + i1, d0, mm, mmt);
+                    kernel_core<Prefetch>(psi, i0 + i1, d0, mm, mmt);
             }
         }
     }
 }
 
+// bit indices id[.] are given from high to low (e.g. control first for CNOT);
+// software prefetches if prefetch (see prefetch_threshold() in cachesize.hpp)
+template <class V, class M>
+void kernel(V &psi, unsigned id0, M const& m, std::size_t ctrlmask, bool prefetch)
+{
+    if (prefetch)
+        kernel_sweep<true>(psi, id0, m, ctrlmask);
+    else
+        kernel_sweep<false>(psi, id0, m, ctrlmask);
+}
@@ -12,24 +12,24 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-template <class V, class M>
+template <bool Prefetch, class V, class M>
 inline void kernel_core(V &psi, std::size_t I, std::size_t d0, std::size_t d1, M const& m, M const& mt)
 {
     __m256d v[4];
 
-    v[0] = load2(&psi[I]);
-    v[1] = load2(&psi[I + d0]);
-    v[2] = load2(&psi[I + d1]);
-    v[3] = load2(&psi[I + d0 + d1]);
+    v[0] = load2<Prefetch>(psi, I);
+    v[1] = load2<Prefetch>(psi, I + d0);
+    v[2] = load2<Prefetch>(psi, I + d1);
+    v[3] = load2<Prefetch>(psi, I + d0 + d1);
 
     _mm256_storeu2_m128d((double*)&psi[I + d0], (double*)&psi[I], add(mul(v[0], m[0], mt[0]), add(mul(v[1], m[1], mt[1]), add(mul(v[2], m[2], mt[2]), mul(v[3], m[3], mt[3])))));
     _mm256_storeu2_m128d((double*)&psi[I + d0 + d1], (double*)&psi[I + d1], add(mul(v[0], m[4], mt[4]), add(mul(v[1], m[5], mt[5]), add(mul(v[2], m[6], mt[6]), mul(v[3], m[7], mt[7])))));
 
 }
 
-// bit indices id[.] are given from high to low (e.g. control first for CNOT)
-template <class V, class M>
-void kernel(V &psi, unsigned id1, unsigned id0, M const& m, std::size_t ctrlmask)
+// the sweep of kernel(), with software prefetches if Prefetch
+template <bool Prefetch, class V, class M>
+void kernel_sweep(V &psi, unsigned id1, unsigned id0, M const& m, std::size_t ctrlmask)
 {
     std::size_t n = psi.size();
     std::size_t d0 = 1UL << id0;
@@ -52,7 +52,7 @@ void kernel(V &psi, unsigned id1, unsigned id0, M const& m, std::size_t ctrlmask
         for (std::size_t i0 = 0; i0 < n; i0 += 2 * dsorted[0]){
             for (std::size_t i1 = 0; i1 < dsorted[0]; i1 += 2 * dsorted[1]){
                 for (std::size_t i2 = 0; i2 < dsorted[1]; ++i2){
-                    kernel_core(psi, i0 + i1 + i2, d0, d1, mm, mmt);
+                    kernel_core<Prefetch>(psi, i0 + i1 + i2, d0, d1, mm, mmt);
                 }
             }
         }
@@ -63,10 +63,20 @@ void kernel(V &psi, unsigned id1, unsigned id0, M const& m, std::size_t ctrlmask
             for (std::size_t i1 = 0; i1 < dsorted[0]; i1 += 2 * dsorted[1]){
                 for (std::size_t i2 = 0; i2 < dsorted[1]; ++i2){
                     if (((i0 + i1 + i2)&ctrlmask) == ctrlmask)
-                        kernel_core(psi, i0 + i1 + i2, d0, d1, mm, mmt);
+                        kernel_core<Prefetch>(psi, i0 + i1 + i2, d0, d1, mm, mmt);
                 }
             }
         }
     }
 }
 
+// bit indices id[.] are given from high to low (e.g. control first for CNOT);
+// software prefetches if prefetch (see prefetch_threshold() in cachesize.hpp)
+template <class V, class M>
+void kernel(V &psi, unsigned id1, unsigned id0, M const& m, std::size_t ctrlmask, bool prefetch)
+{
+    if (prefetch)
+        kernel_sweep<true>(psi, id1, id0, m, ctrlmask);
+    else
+        kernel_sweep<false>(psi, id1, id0, m, ctrlmask);
+}
@@ -12,15 +12,15 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-template <class V, class M>
+template <bool Prefetch, class V, class M>
 inline void kernel_core(V &psi, std::size_t I, std::size_t d0, std::size_t d1, std::size_t d2, M const& m, M const& mt)
 {
     __m256d v[4];
 
-    v[0] = load2(&psi[I]);
-    v[1] = load2(&psi[I + d0]);
-    v[2] = load2(&psi[I + d1]);
-    v[3] = load2(&psi[I + d0 + d1]);
+    v[0] = load2<Prefetch>(psi, I);
+    v[1] = load2<Prefetch>(psi, I + d0);
+    v[2] = load2<Prefetch>(psi, I + d1);
+    v[3] = load2<Prefetch>(psi, I + d0 + d1);
 
     __m256d tmp[4];
 
@@ -29,10 +29,10 @@ inline void kernel_core(V &psi, std::size_t I, std::size_t d0, std::size_t d1, s
     tmp[2] = add(mul(v[0], m[8], mt[8]), add(mul(v[1], m[9], mt[9]), add(mul(v[2], m[10], mt[10]), mul(v[3], m[11], mt[11]))));
     tmp[3] = add(mul(v[0], m[12], mt[12]), add(mul(v[1], m[13], mt[13]), add(mul(v[2], m[14], mt[14]), mul(v[3], m[15], mt[15]))));
 
-    v[0] = load2(&psi[I + d2]);
-    v[1] = load2(&psi[I + d0 + d2]);
-    v[2] = load2(&psi[I + d1 + d2]);
-    v[3] = load2(&psi[I + d0 + d1 + d2]);
+    v[0] = load2<Prefetch>(psi, I + d2);
+    v[1] = load2<Prefetch>(psi, I + d0 + d2);
+    v[2] = load2<Prefetch>(psi, I + d1 + d2);
+    v[3] = load2<Prefetch>(psi, I + d0 + d1 + d2);
 
     _mm256_storeu2_m128d((double*)&psi[I + d0], (double*)&psi[I], add(tmp[0], add(mul(v[0], m[16], mt[16]), add(mul(v[1], m[17], mt[17]), add(mul(v[2], m[18], mt[18]), mul(v[3], m[19], mt[19]))))));
     _mm256_storeu2_m128d((double*)&psi[I + d0 + d1], (double*)&psi[I + d1], add(tmp[1], add(mul(v[0], m[20], mt[20]), add(mul(v[1], m[21], mt[21]), add(mul(v[2], m[22], mt[22]), mul(v[3], m[23], mt[23]))))));
@@ -41,9 +41,9 @@ inline void kernel_core(V &psi, std::size_t I, std::size_t d0, std::size_t d1, s
 
 }
 
-// bit indices id[.] are given from high to low (e.g. control first for CNOT)
-template <class V, class M>
-void kernel(V &psi, unsigned id2, unsigned id1, unsigned id0, M const& m, std::size_t ctrlmask)
+// the sweep of kernel(), with software prefetches if Prefetch
+template <bool Prefetch, class V, class M>
+void kernel_sweep(V &psi, unsigned id2, unsigned id1, unsigned id0, M const& m, std::size_t ctrlmask)
 {
     std::size_t n = psi.size();
     std::size_t d0 = 1UL << id0;
@@ -68,7 +68,7 @@ void kernel(V &psi, unsigned id2, unsigned id1, unsigned id0, M const& m, std::s
             for (std::size_t i1 = 0; i1 < dsorted[0]; i1 += 2 * dsorted[1]){
                 for (std::size_t i2 = 0; i2 < dsorted[1]; i2 += 2 * dsorted[2]){
                     for (std::size_t i3 = 0; i3 < dsorted[2]; ++i3){
-                        kernel_core(psi, i0 + i1 + i2 + i3, d0, d1, d2, mm, mmt);
+                        kernel_core<Prefetch>(psi, i0 + i1 + i2 + i3, d0, d1, d2, mm, mmt);
                     }
                 }
             }
@@ -81,7 +81,7 @@ void kernel(V &psi, unsigned id2, unsigned id1, unsigned id0, M const& m, std::s
                 for (std::size_t i2 = 0; i2 < dsorted[1]; i2 += 2 * dsorted[2]){
                     for (std::size_t i3 = 0; i3 < dsorted[2]; ++i3){
                         if (((i0 + i1 + i2 + i3)&ctrlmask) == ctrlmask)
-                            kernel_core(psi, i0 + i1 + i2 + i3, d0, d1, d2, mm, mmt);
+                            kernel_core<Prefetch>(psi, i0 + i1 + i2 + i3, d0, d1, d2, mm, mmt);
                     }
                 }
             }
@@ -89,3 +89,13 @@ void kernel(V &psi, unsigned id2, unsigned id1, unsigned id0, M const& m, std::s
     }
 }
 
+// bit indices id[.] are given from high to low (e.g. control first for CNOT);
+// software prefetches if prefetch (see prefetch_threshold() in cachesize.hpp)
+template <class V, class M>
+void kernel(V &psi, unsigned id2, unsigned id1, unsigned id0, M const& m, std::size_t ctrlmask, bool prefetch)
+{
+    if (prefetch)
+        kernel_sweep<true>(psi, id2, id1, id0, m, ctrlmask);
+    else
+        kernel_sweep<false>(psi, id2, id1, id0, m, ctrlmask);
+}
@@ -20,6 +20,7 @@
 #include <algorithm>
 #include "cintrin.hpp"
 #include "alignedallocator.hpp"
+#include "cachesize.hpp"
 
 #define LOOP_COLLAPSE1 2
 #define LOOP_COLLAPSE2 3
@@ -0,0 +1,132 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KERNELK_HPP_
+#define KERNELK_HPP_
+
+#include <vector>
+#include <complex>
+#include <cstddef>
+#include <algorithm>
+
+// Dense kernel for fused matrices on more qubits than the unrolled kernels
+// handle (6 to kernel_max_qubits). The 2^k amplitudes of kernelk_batch
+// groups are gathered into separate real and imaginary buffers, multiplied
+// by the matrix in one pass over it (a small matrix-matrix product), and
+// scattered back.
+static const unsigned kernel_max_qubits = 10;
+static const unsigned kernelk_batch = 16;
+
+namespace kernelk_detail{
+
+// k with zeros inserted at the bit locations sorted[0] < sorted[1] < ...
+inline std::size_t insert_zeros(std::size_t k, std::vector<unsigned> const& sorted){
+    for (auto loc : sorted){
+        std::size_t low = k & ((1UL << loc) - 1);
+        k = ((k ^ low) << 1) | low;
+    }
+    return k;
+}
+
+// amplitude access for the interleaved and the split layout
+template <class V>
+struct Interleaved{
+    V& psi;
+    std::size_t size() const { return psi.size(); }
+    void get(std::size_t i, double& re, double& im) const { re = std::real(psi[i]); im = std::imag(psi[i]); }
+    void set(std::size_t i, double re, double im) const { psi[i] = typename V::value_type(re, im); }
+};
+
+template <class P>
+struct Split{
+    P& re_;
+    P& im_;
+    std::size_t size() const { return re_.size(); }
+    void get(std::size_t i, double& re, double& im) const { re = re_[i]; im = im_[i]; }
+    void set(std::size_t i, double re, double im) const { re_[i] = re; im_[i] = im; }
+};
+
+template <class A, class M>
+void apply(A const& psi, std::vector<unsigned> const& ids, M const& m, std::size_t ctrlmask){
+    constexpr unsigned B = kernelk_batch;
+    std::size_t const D = std::size_t(1) << ids.size();
+    std::vector<double> mr(D * D), mi(D * D);
+    for (std::size_t r = 0; r < D; ++r)
+        for (std::size_t c = 0; c < D; ++c){
+            mr[r * D + c] = std::real(m[r][c]);
+            mi[r * D + c] = std::imag(m[r][c]);
+        }
+    std::vector<std::size_t> off(D, 0);
+    for (std::size_t x = 0; x < D; ++x)
+        for (unsigned j = 0; j < ids.size(); ++j)
+            off[x] |= ((x >> j) & 1UL) << ids[j];
+
+    // groups only run over the basis states which satisfy the control mask
+    std::vector<unsigned> fixed(ids);
+    for (unsigned b = 0; (ctrlmask >> b) != 0; ++b)
+        if ((ctrlmask >> b) & 1UL)
+            fixed.push_back(b);
+    std::sort(fixed.begin(), fixed.end());
+    std::size_t ngroups = psi.size() >> fixed.size();
+    std::size_t nbatches = (ngroups + B - 1) / B;
+
+    #pragma omp parallel
+    {
+        std::vector<double> xr(D * B), xi(D * B);
+        std::size_t base[B];
+        #pragma omp for schedule(static)
+        for (std::size_t t = 0; t < nbatches; ++t){
+            std::size_t nb = std::min<std::size_t>(B, ngroups - t * B);
+            for (std::size_t b = 0; b < nb; ++b)
+                base[b] = insert_zeros(t * B + b, fixed) | ctrlmask;
+            for (std::size_t x = 0; x < D; ++x)
+                for (std::size_t b = 0; b < nb; ++b)
+                    psi.get(base[b] + off[x], xr[x * B + b], xi[x * B + b]);
+            for (std::size_t r = 0; r < D; ++r){
+                double ar[B] = {}, ai[B] = {};
+                double const* cr = &mr[r * D];
+                double const* ci = &mi[r * D];
+                for (std::size_t x = 0; x < D; ++x){
+                    double const* vr = &xr[x * B];
+                    double const* vi = &xi[x * B];
+                    #pragma omp simd
+                    for (unsigned b = 0; b < B; ++b){
+                        ar[b] += cr[x] * vr[b] - ci[x] * vi[b];
+                        ai[b] += cr[x] * vi[b] + ci[x] * vr[b];
+                    }
+                }
+                for (std::size_t b = 0; b < nb; ++b)
+                    psi.set(base[b] + off[r], ar[b], ai[b]);
+            }
+        }
+    }
+}
+
+}
+
+// psi <- m psi on the bit locations ids (ids[j] <-> bit j of the row and
+// column index of m, at most kernel_max_qubits of them) for the basis states
+// which satisfy the control mask
+template <class V, class M>
+void kernel_k(V& psi, std::vector<unsigned> const& ids, M const& m, std::size_t ctrlmask){
+    kernelk_detail::apply(kernelk_detail::Interleaved<V>{psi}, ids, m, ctrlmask);
+}
+
+// the same for a state in split real and imaginary planes
+template <class P, class M>
+void kernel_k_split(P& re, P& im, std::vector<unsigned> const& ids, M const& m, std::size_t ctrlmask){
+    kernelk_detail::apply(kernelk_detail::Split<P>{re, im}, ids, m, ctrlmask);
+}
+
+#endif
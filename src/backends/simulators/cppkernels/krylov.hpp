@@ -0,0 +1,250 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KRYLOV_HPP_
+#define KRYLOV_HPP_
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+// Bounds of the Krylov dimension m: the error estimate of a step of size tau
+// is O(tau^(m-1)) and has to fall below tol * tau / |t|, so for smaller m the
+// steps get too short (and too many) at the default tolerance.
+static const unsigned min_krylov_dim = 6;
+static const unsigned max_krylov_dim = 64;
+
+// Lanczos propagator for exp(-i t H)|v> with Hermitian H.
+//
+// Every step builds an (at most) m-dimensional Krylov basis of H around the
+// current state, diagonalizes the small tridiagonal projection of H and picks
+// the largest step size tau for which the a-posteriori error estimate
+//     beta * b_m * |e_m^T exp(-i tau T_m) e_1|
+// stays below tol * tau / |t| (or round-off). The step size only enters the
+// small projected problem, so shrinking it costs no applications of H. If no
+// step size above 1e-12 |t| meets the tolerance (e.g. for a non-Hermitian
+// operator), evolve throws.
+//
+// The caller provides the basis vectors (of the size of the state), which are
+// reused for all steps: either m + 1 of them, or only 3 if memory is short.
+// The recursion itself only needs the last three basis vectors; with 3 of
+// them, the basis is built a second time for the final linear combination,
+// which doubles the applications of H.
+template <class V>
+class Lanczos{
+public:
+    using complex_type = std::complex<double>;
+
+    Lanczos(std::vector<V>& basis, unsigned m)
+        : basis_(basis), m_(m), full_(basis.size() > m) {}
+
+    // v <- exp(-i time H) v, where apply(in, out) computes out = H in
+    template <class Op>
+    void evolve(Op const& apply, V& v, double time, double tol = 1.e-12){
+        double T = std::abs(time);
+        double sgn = time < 0. ? -1. : 1.;
+        double t_done = 0., tau = T;
+
+        while (t_done < T){
+            double beta = std::sqrt(norm2(v));
+            if (beta == 0.)
+                return;
+            auto& v0 = basis_[0];
+            #pragma omp parallel for schedule(static)
+            for (std::size_t j = 0; j < v.size(); ++j)
+                v0[j] = v[j] / beta;
+
+            // Lanczos recursion
+            std::vector<double> a, b;
+            bool happy = false;
+            unsigned k = 0;
+            for (; k < m_; ++k){
+                auto const& vk = vec(k);
+                auto const& vprev = vec(k > 0 ? k - 1 : 0);
+                auto& w = vec(k + 1);
+                apply(vk, w);
+                double ak = 0.;
+                #pragma omp parallel for reduction(+:ak) schedule(static)
+                for (std::size_t j = 0; j < w.size(); ++j)
+                    ak += std::real(std::conj(vk[j]) * w[j]);
+                double bprev = k > 0 ? b[k - 1] : 0.;
+                double bk = 0.;
+                #pragma omp parallel for reduction(+:bk) schedule(static)
+                for (std::size_t j = 0; j < w.size(); ++j){
+                    w[j] -= ak * vk[j];
+                    if (k > 0)
+                        w[j] -= bprev * vprev[j];
+                    bk += std::norm(w[j]);
+                }
+                bk = std::sqrt(bk);
+                a.push_back(ak);
+                b.push_back(bk);
+                if (bk <= 1.e-12 * (std::abs(ak) + bprev)){
+                    happy = true; // invariant subspace, exact for any tau
+                    ++k;
+                    break;
+                }
+                #pragma omp parallel for schedule(static)
+                for (std::size_t j = 0; j < w.size(); ++j)
+                    w[j] /= bk;
+            }
+
+            std::vector<double> lambda, Q;
+            eigen_tridiagonal(a, b, k, lambda, Q);
+
+            // y = exp(-i sgn tau T_k) e_1 in the Krylov basis
+            std::vector<complex_type> y(k);
+            auto propagate = [&](double dt){
+                for (unsigned l = 0; l < k; ++l){
+                    y[l] = 0.;
+                    for (unsigned p = 0; p < k; ++p)
+                        y[l] += Q[l * k + p] * Q[p] * std::exp(complex_type(0., -sgn * dt * lambda[p]));
+                }
+                return happy ? 0. : beta * b[k - 1] * std::abs(y[k - 1]);
+            };
+
+            // the estimate cannot get below round-off, so neither can the
+            // accepted local error
+            double floor = 64. * std::numeric_limits<double>::epsilon() * beta;
+            tau = std::min(tau, T - t_done);
+            bool shrunk = false;
+            while (propagate(tau) > std::max(tol * tau / T, floor)){
+                if (tau <= 1.e-12 * T)
+                    throw(std::runtime_error("Lanczos::evolve(): No step size meets the error tolerance."));
+                tau *= 0.5;
+                shrunk = true;
+            }
+
+            if (full_){
+                #pragma omp parallel for schedule(static)
+                for (std::size_t j = 0; j < v.size(); ++j){
+                    complex_type res = 0.;
+                    for (unsigned l = 0; l < k; ++l)
+                        res += basis_[l][j] * y[l];
+                    v[j] = beta * res;
+                }
+            }
+            else
+                combine(apply, v, beta, a, b, y);
+            t_done += tau;
+            if (happy)
+                tau = T;
+            else if (!shrunk)
+                tau *= 2.;
+        }
+    }
+
+private:
+    static double norm2(V const& v){
+        double n = 0.;
+        #pragma omp parallel for reduction(+:n) schedule(static)
+        for (std::size_t j = 0; j < v.size(); ++j)
+            n += std::norm(v[j]);
+        return n;
+    }
+
+    // eigenvalues lambda and (row-major) eigenvectors Q of the symmetric
+    // tridiagonal k x k matrix with diagonal a and off-diagonal b (cyclic
+    // Jacobi, k is small)
+    static void eigen_tridiagonal(std::vector<double> const& a, std::vector<double> const& b,
+                                  unsigned k, std::vector<double>& lambda,
+                                  std::vector<double>& Q){
+        std::vector<double> A(k * k, 0.);
+        Q.assign(k * k, 0.);
+        for (unsigned i = 0; i < k; ++i){
+            A[i * k + i] = a[i];
+            Q[i * k + i] = 1.;
+            if (i + 1 < k)
+                A[i * k + i + 1] = A[(i + 1) * k + i] = b[i];
+        }
+        for (unsigned sweep = 0; sweep < 100; ++sweep){
+            double off = 0.;
+            for (unsigned p = 0; p < k; ++p)
+                for (unsigned q = p + 1; q < k; ++q)
+                    off += A[p * k + q] * A[p * k + q];
+            if (off < 1.e-30)
+                break;
+            for (unsigned p = 0; p < k; ++p){
+                for (unsigned q = p + 1; q < k; ++q){
+                    double apq = A[p * k + q];
+                    if (apq == 0.)
+                        continue;
+                    double theta = (A[q * k + q] - A[p * k + p]) / (2. * apq);
+                    double t = (theta >= 0. ? 1. : -1.) / (std::abs(theta) + std::sqrt(theta * theta + 1.));
+                    double c = 1. / std::sqrt(t * t + 1.), s = t * c;
+                    for (unsigned r = 0; r < k; ++r){
+                        double arp = A[r * k + p], arq = A[r * k + q];
+                        A[r * k + p] = c * arp - s * arq;
+                        A[r * k + q] = s * arp + c * arq;
+                    }
+                    for (unsigned r = 0; r < k; ++r){
+                        double apr = A[p * k + r], aqr = A[q * k + r];
+                        A[p * k + r] = c * apr - s * aqr;
+                        A[q * k + r] = s * apr + c * aqr;
+                    }
+                    for (unsigned r = 0; r < k; ++r){
+                        double qrp = Q[r * k + p], qrq = Q[r * k + q];
+                        Q[r * k + p] = c * qrp - s * qrq;
+                        Q[r * k + q] = s * qrp + c * qrq;
+                    }
+                }
+            }
+        }
+        lambda.resize(k);
+        for (unsigned i = 0; i < k; ++i)
+            lambda[i] = A[i * k + i];
+    }
+
+    // basis vector v_k (kept in a ring of 3 vectors if memory is short)
+    V& vec(unsigned k){
+        return basis_[full_ ? k : k % 3];
+    }
+
+    // v <- beta sum_l y_l v_l, rebuilding v_1, ..., v_{k-1} from v_0 = v / beta
+    // with the coefficients a, b of the recursion
+    template <class Op>
+    void combine(Op const& apply, V& v, double beta, std::vector<double> const& a,
+                 std::vector<double> const& b, std::vector<complex_type> const& y){
+        auto& v0 = basis_[0];
+        #pragma omp parallel for schedule(static)
+        for (std::size_t j = 0; j < v.size(); ++j){
+            v0[j] = v[j] / beta;
+            v[j] = beta * y[0] * v0[j];
+        }
+        for (unsigned l = 0; l + 1 < y.size(); ++l){
+            auto const& vl = vec(l);
+            auto const& vprev = vec(l > 0 ? l - 1 : 0);
+            auto& w = vec(l + 1);
+            apply(vl, w);
+            complex_type c = beta * y[l + 1];
+            #pragma omp parallel for schedule(static)
+            for (std::size_t j = 0; j < w.size(); ++j){
+                w[j] -= a[l] * vl[j];
+                if (l > 0)
+                    w[j] -= b[l - 1] * vprev[j];
+                w[j] /= b[l];
+                v[j] += c * w[j];
+            }
+        }
+    }
+
+    std::vector<V>& basis_;
+    unsigned m_;
+    bool full_; // basis_ holds all m + 1 basis vectors
+};
+
+#endif
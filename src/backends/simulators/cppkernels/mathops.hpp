@@ -0,0 +1,76 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MATH_OPS_HPP_
+#define MATH_OPS_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+// Native counterparts of the BasicMathGate functions in libs/math. A
+// MathOperation is a plain descriptor (kind + constants) which can be
+// evaluated on every thread without calling back into JavaScript.
+//
+// The register value is handed in and out exactly like the JS math functions
+// do it: one integer, low bit first. Results are truncated to the register
+// width by Simulator::emulate_math.
+class MathOperation{
+public:
+    enum Kind{
+        AddConstant = 0,            // (x)       -> (x + a)
+        AddConstantModN = 1,        // (x)       -> ((x + a) mod N)
+        MultiplyByConstantModN = 2  // (x)       -> ((a * x) % N)
+    };
+
+    MathOperation(unsigned kind, std::int64_t a = 0, std::int64_t N = 0)
+        : kind_(static_cast<Kind>(kind)), a_(a), N_(N) {
+        if (kind > MultiplyByConstantModN)
+            throw(std::runtime_error("MathOperation: Unknown operation kind."));
+        if ((kind == AddConstantModN || kind == MultiplyByConstantModN) && N <= 0)
+            throw(std::runtime_error("MathOperation: Modulus N must be positive."));
+    }
+
+    template <class T>
+    void operator()(std::vector<T>& x) const {
+        switch (kind_){
+            case AddConstant:
+                x[0] = static_cast<T>(x[0] + a_);
+                break;
+            case AddConstantModN:
+                x[0] = static_cast<T>(mod(x[0] + a_, N_));
+                break;
+            case MultiplyByConstantModN:
+                // truncated remainder like (a * x) % N in the JS gate, which
+                // is negative for a < 0
+                x[0] = static_cast<T>((a_ * static_cast<std::int64_t>(x[0])) % N_);
+                break;
+        }
+    }
+
+    Kind kind() const { return kind_; }
+    std::int64_t a() const { return a_; }
+
+private:
+    // non-negative remainder, matches math.mod in AddConstantModN
+    static std::int64_t mod(std::int64_t x, std::int64_t N){
+        auto r = x % N;
+        return r < 0 ? r + N : r;
+    }
+
+    Kind kind_;
+    std::int64_t a_, N_;
+};
+
+#endif
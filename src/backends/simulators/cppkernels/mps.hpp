@@ -0,0 +1,507 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPS_HPP_
+#define MPS_HPP_
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <map>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+// Singular value decomposition M = U diag(S) Vh of a row-major m x n complex
+// matrix by one-sided (Hestenes) Jacobi rotations. U is m x k, Vh is k x n
+// with k = min(m, n), singular values are sorted in descending order.
+inline void svd(std::vector<std::complex<double>> const& M, std::size_t m, std::size_t n,
+                std::vector<std::complex<double>>& U, std::vector<double>& S,
+                std::vector<std::complex<double>>& Vh){
+    using complex_type = std::complex<double>;
+    // orthogonalize the columns of A (r x c, r >= c), accumulating V (c x c)
+    bool trans = m < n;
+    std::size_t r = trans ? n : m, c = trans ? m : n;
+    std::vector<complex_type> A(r * c), V(c * c, 0.);
+    for (std::size_t i = 0; i < r; ++i)
+        for (std::size_t j = 0; j < c; ++j)
+            A[i * c + j] = trans ? std::conj(M[j * n + i]) : M[i * n + j];
+    for (std::size_t j = 0; j < c; ++j)
+        V[j * c + j] = 1.;
+
+    for (unsigned sweep = 0; sweep < 60; ++sweep){
+        bool rotated = false;
+        for (std::size_t p = 0; p + 1 < c; ++p){
+            for (std::size_t q = p + 1; q < c; ++q){
+                double alpha = 0., beta = 0.;
+                complex_type gamma = 0.;
+                for (std::size_t i = 0; i < r; ++i){
+                    alpha += std::norm(A[i * c + p]);
+                    beta += std::norm(A[i * c + q]);
+                    gamma += std::conj(A[i * c + p]) * A[i * c + q];
+                }
+                double g = std::abs(gamma);
+                if (g <= 1.e-15 * std::sqrt(alpha * beta) || g == 0.)
+                    continue;
+                rotated = true;
+                // rotate (a_p, e^{-i phi} a_q) by the real Jacobi rotation
+                complex_type phase = std::conj(gamma) / g;
+                double zeta = (beta - alpha) / (2. * g);
+                double t = (zeta >= 0. ? 1. : -1.) / (std::abs(zeta) + std::sqrt(1. + zeta * zeta));
+                double cs = 1. / std::sqrt(1. + t * t), sn = cs * t;
+                for (std::size_t i = 0; i < r; ++i){
+                    auto ap = A[i * c + p], aq = A[i * c + q] * phase;
+                    A[i * c + p] = cs * ap - sn * aq;
+                    A[i * c + q] = sn * ap + cs * aq;
+                }
+                for (std::size_t i = 0; i < c; ++i){
+                    auto vp = V[i * c + p], vq = V[i * c + q] * phase;
+                    V[i * c + p] = cs * vp - sn * vq;
+                    V[i * c + q] = sn * vp + cs * vq;
+                }
+            }
+        }
+        if (!rotated)
+            break;
+    }
+
+    std::vector<double> sigma(c, 0.);
+    for (std::size_t j = 0; j < c; ++j){
+        for (std::size_t i = 0; i < r; ++i)
+            sigma[j] += std::norm(A[i * c + j]);
+        sigma[j] = std::sqrt(sigma[j]);
+    }
+    std::vector<std::size_t> order(c);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&](std::size_t a, std::size_t b){ return sigma[a] > sigma[b]; });
+
+    // A V = U_A S, i.e. M = U_A S V^dagger (or M^dagger = U_A S V^dagger)
+    S.resize(c);
+    U.assign(m * c, 0.);
+    Vh.assign(c * n, 0.);
+    for (std::size_t k = 0; k < c; ++k){
+        std::size_t j = order[k];
+        S[k] = sigma[j];
+        double inv = sigma[j] > 0. ? 1. / sigma[j] : 0.;
+        for (std::size_t i = 0; i < r; ++i){
+            auto u = A[i * c + j] * inv;
+            if (trans) // Vh = U_A^dagger
+                Vh[k * n + i] = std::conj(u);
+            else
+                U[i * c + k] = u;
+        }
+        for (std::size_t i = 0; i < c; ++i){
+            auto v = V[i * c + j];
+            if (trans) // U = V
+                U[i * c + k] = v;
+            else
+                Vh[k * n + i] = std::conj(v);
+        }
+    }
+}
+
+// Matrix-product-state simulator for (mostly) nearest-neighbour circuits.
+//
+// Qubits are sites of an open chain, ordered by qubit id, so that the
+// positions handed out by a LinearMapper are the sites of the chain. Site p
+// is a tensor A[l][s][r] with bond dimensions dl x 2 x dr; the state is kept
+// in mixed-canonical form around the site center_.
+//
+// Two-qubit gates contract the two sites, apply the gate and split them
+// again by an SVD which keeps at most max_bond_ singular values. The weight
+// of the discarded singular values is added to truncation_error_ (it is an
+// upper bound of 1 - fidelity to first order). Gates on qubits which are
+// not neighbours are routed through the chain with swaps and back.
+class MPSSimulator{
+public:
+    using calc_type = double;
+    using complex_type = std::complex<calc_type>;
+    using Tensor = std::vector<complex_type>;
+    using RndEngine = std::mt19937;
+
+    MPSSimulator(unsigned seed = 1, unsigned max_bond = 64)
+        : center_(0), max_bond_(max_bond), cutoff_(1.e-14),
+          truncation_error_(0.), rnd_eng_(seed) {
+        if (max_bond == 0)
+            throw(std::runtime_error("MPSSimulator: Maximal bond dimension must be positive."));
+        std::uniform_real_distribution<double> dist(0., 1.);
+        rng_ = std::bind(dist, std::ref(rnd_eng_));
+    }
+
+    void allocate_qubit(unsigned id){
+        auto it = std::lower_bound(ids_.begin(), ids_.end(), id);
+        if (it != ids_.end() && *it == id)
+            throw(std::runtime_error(
+                "AllocateQubit: ID already exists. Qubit IDs should be unique."));
+        std::size_t p = it - ids_.begin();
+        // |0> on the new site, identity on the bond it is inserted into
+        std::size_t D = p < sites_.size() ? sites_[p].dl : (p > 0 ? sites_[p - 1].dr : 1);
+        Site site{D, D, Tensor(D * 2 * D, 0.)};
+        for (std::size_t l = 0; l < D; ++l)
+            site.a[(l * 2) * D + l] = 1.;
+        sites_.insert(sites_.begin() + p, std::move(site));
+        ids_.insert(it, id);
+        if (center_ >= p && sites_.size() > 1)
+            ++center_;
+    }
+
+    void deallocate_qubit(unsigned id){
+        std::size_t p = position(id);
+        if (!is_classical(id))
+            throw(std::runtime_error("Error: Qubit has not been measured / uncomputed! There is most likely a bug in your code."));
+        unsigned value = probability_one(p) > 0.5 ? 1 : 0;
+
+        // absorb the projected site into a neighbour, which becomes the center
+        Site const& s = sites_[p];
+        if (p + 1 < sites_.size()){
+            absorb_left(slice(s, value), s.dl, s.dr, sites_[p + 1]);
+            center_ = p;
+        }
+        else if (p > 0){
+            absorb_right(sites_[p - 1], slice(s, value), s.dl, s.dr);
+            center_ = p - 1;
+        }
+        else
+            center_ = 0;
+        sites_.erase(sites_.begin() + p);
+        ids_.erase(ids_.begin() + p);
+    }
+
+    bool is_classical(unsigned id, calc_type tol = 1.e-12){
+        calc_type p1 = probability_one(position(id));
+        return p1 < tol || 1. - p1 < tol;
+    }
+
+    bool get_classical_value(unsigned id, calc_type tol = 1.e-12){
+        calc_type p1 = probability_one(position(id));
+        if (p1 >= tol && 1. - p1 >= tol)
+            throw(std::runtime_error("MPSSimulator: Qubit is not in a classical state."));
+        return p1 > 0.5;
+    }
+
+    void measure_qubits(std::vector<unsigned> const& ids, std::vector<bool> &res){
+        res = std::vector<bool>(ids.size());
+        for (unsigned i = 0; i < ids.size(); ++i){
+            std::size_t p = position(ids[i]);
+            calc_type p1 = probability_one(p);
+            bool r = rng_() < p1;
+            res[i] = r;
+            // project and re-normalize the center
+            calc_type scale = 1. / std::sqrt(r ? p1 : 1. - p1);
+            Site& s = sites_[p];
+            for (std::size_t l = 0; l < s.dl; ++l)
+                for (std::size_t k = 0; k < 2; ++k)
+                    for (std::size_t j = 0; j < s.dr; ++j)
+                        s.a[(l * 2 + k) * s.dr + j] *= (k == r) ? scale : 0.;
+        }
+    }
+
+    std::vector<bool> measure_qubits_return(std::vector<unsigned> const& ids){
+        std::vector<bool> ret;
+        measure_qubits(ids, ret);
+        return ret;
+    }
+
+    // m acts on ids (ids[0] is the lowest bit of the matrix index); ids and
+    // ctrl together may contain at most two qubits
+    template <class M>
+    void apply_controlled_gate(M const& m, std::vector<unsigned> const& ids,
+                               std::vector<unsigned> const& ctrl){
+        if (ids.size() + ctrl.size() > 2 || ids.empty())
+            throw(std::runtime_error("MPSSimulator: Only gates acting on at most two qubits (including controls) are supported."));
+        if (m.size() != (1UL << ids.size()))
+            throw(std::runtime_error("MPSSimulator: Gate matrix does not match the number of qubits."));
+
+        if (ctrl.empty() && ids.size() == 1){
+            apply_one_site(position(ids[0]), m);
+            return;
+        }
+
+        // 4 x 4 gate on (q0, q1), q0 being the low bit
+        unsigned q0 = ids[0], q1 = ids.size() == 2 ? ids[1] : ctrl[0];
+        Tensor G(16, 0.);
+        for (unsigned i = 0; i < 4; ++i)
+            for (unsigned j = 0; j < 4; ++j){
+                if (ids.size() == 2)
+                    G[i * 4 + j] = m[i][j];
+                else if ((i >> 1) != (j >> 1))
+                    continue;
+                else // controlled single-qubit gate
+                    G[i * 4 + j] = (i >> 1) ? complex_type(m[i & 1][j & 1]) : complex_type(i == j ? 1. : 0.);
+            }
+        std::size_t pa = position(q0), pb = position(q1);
+        if (pa == pb)
+            throw(std::runtime_error("MPSSimulator: Gate acts twice on the same qubit."));
+        if (pa > pb){
+            auto swapbits = [](unsigned i){ return ((i & 1) << 1) | (i >> 1); };
+            Tensor H(16);
+            for (unsigned i = 0; i < 4; ++i)
+                for (unsigned j = 0; j < 4; ++j)
+                    H[i * 4 + j] = G[swapbits(i) * 4 + swapbits(j)];
+            G = std::move(H);
+            std::swap(pa, pb);
+        }
+
+        Tensor const SWAP = {1., 0., 0., 0.,
+                             0., 0., 1., 0.,
+                             0., 1., 0., 0.,
+                             0., 0., 0., 1.};
+        for (std::size_t k = pb; k > pa + 1; --k)
+            apply_two_site(k - 1, SWAP);
+        apply_two_site(pa, G);
+        for (std::size_t k = pa + 1; k < pb; ++k)
+            apply_two_site(k, SWAP);
+    }
+
+    // amplitude of the basis state given by bit_string; ids must contain
+    // all qubits
+    complex_type get_amplitude(std::vector<bool> const& bit_string,
+                               std::vector<unsigned> const& ids){
+        if (ids.size() != sites_.size() || bit_string.size() != ids.size())
+            throw(std::runtime_error("get_amplitude(): Please provide the bit string of all qubits."));
+        std::vector<unsigned> bits(sites_.size(), 2);
+        for (std::size_t i = 0; i < ids.size(); ++i)
+            bits[position(ids[i])] = bit_string[i];
+        if (std::count(bits.begin(), bits.end(), 2u))
+            throw(std::runtime_error("get_amplitude(): Please provide the bit string of all qubits."));
+
+        Tensor v(1, 1.);
+        for (std::size_t p = 0; p < sites_.size(); ++p){
+            Site const& s = sites_[p];
+            Tensor w(s.dr, 0.);
+            for (std::size_t l = 0; l < s.dl; ++l)
+                for (std::size_t r = 0; r < s.dr; ++r)
+                    w[r] += v[l] * s.a[(l * 2 + bits[p]) * s.dr + r];
+            v = std::move(w);
+        }
+        return v.empty() ? complex_type(1.) : v[0];
+    }
+
+    // bond dimensions between neighbouring sites
+    std::vector<unsigned> bond_dimensions() const {
+        std::vector<unsigned> dims;
+        for (std::size_t p = 0; p + 1 < sites_.size(); ++p)
+            dims.push_back(static_cast<unsigned>(sites_[p].dr));
+        return dims;
+    }
+
+    calc_type truncation_error() const { return truncation_error_; }
+
+    unsigned max_bond_dimension() const { return max_bond_; }
+
+    void set_max_bond_dimension(unsigned max_bond){
+        if (max_bond == 0)
+            throw(std::runtime_error("MPSSimulator: Maximal bond dimension must be positive."));
+        max_bond_ = max_bond;
+    }
+
+    // gates are applied immediately, kept for interface compatibility
+    void run(){}
+
+private:
+    struct Site{
+        std::size_t dl, dr;
+        Tensor a; // a[(l * 2 + s) * dr + r]
+    };
+
+    std::size_t position(unsigned id) const {
+        auto it = std::lower_bound(ids_.begin(), ids_.end(), id);
+        if (it == ids_.end() || *it != id)
+            throw(std::runtime_error("MPSSimulator: Unknown qubit id. Please make sure you have called eng.flush()."));
+        return it - ids_.begin();
+    }
+
+    static Tensor slice(Site const& s, unsigned k){
+        Tensor M(s.dl * s.dr);
+        for (std::size_t l = 0; l < s.dl; ++l)
+            for (std::size_t r = 0; r < s.dr; ++r)
+                M[l * s.dr + r] = s.a[(l * 2 + k) * s.dr + r];
+        return M;
+    }
+
+    // s <- M s, M is rows x cols with cols == s.dl
+    static void absorb_left(Tensor const& M, std::size_t rows, std::size_t cols, Site& s){
+        Tensor a(rows * 2 * s.dr, 0.);
+        for (std::size_t l = 0; l < rows; ++l)
+            for (std::size_t k = 0; k < cols; ++k){
+                auto f = M[l * cols + k];
+                if (f == 0.)
+                    continue;
+                for (std::size_t j = 0; j < 2 * s.dr; ++j)
+                    a[l * 2 * s.dr + j] += f * s.a[k * 2 * s.dr + j];
+            }
+        s.a = std::move(a);
+        s.dl = rows;
+    }
+
+    // s <- s M, M is rows x cols with rows == s.dr
+    static void absorb_right(Site& s, Tensor const& M, std::size_t rows, std::size_t cols){
+        Tensor a(s.dl * 2 * cols, 0.);
+        for (std::size_t i = 0; i < s.dl * 2; ++i)
+            for (std::size_t k = 0; k < rows; ++k){
+                auto f = s.a[i * rows + k];
+                if (f == 0.)
+                    continue;
+                for (std::size_t r = 0; r < cols; ++r)
+                    a[i * cols + r] += f * M[k * cols + r];
+            }
+        s.a = std::move(a);
+        s.dr = cols;
+    }
+
+    // number of singular values to keep; the discarded weight is added to
+    // the truncation error and the kept ones are rescaled to the old norm
+    std::size_t truncate(std::vector<double>& S, std::size_t max_keep){
+        double total = 0., kept = 0.;
+        for (auto s : S)
+            total += s * s;
+        std::size_t k = 0;
+        while (k < S.size() && k < max_keep && S[k] > cutoff_ * S[0]){
+            kept += S[k] * S[k];
+            ++k;
+        }
+        k = std::max<std::size_t>(k, 1);
+        if (kept > 0. && kept < total){
+            truncation_error_ += (total - kept) / total;
+            double scale = std::sqrt(total / kept);
+            for (std::size_t i = 0; i < k; ++i)
+                S[i] *= scale;
+        }
+        return k;
+    }
+
+    void move_center(std::size_t to){
+        Tensor U, Vh;
+        std::vector<double> S;
+        while (center_ < to){
+            Site& s = sites_[center_];
+            svd(s.a, s.dl * 2, s.dr, U, S, Vh);
+            std::size_t c = S.size(), k = truncate(S, c);
+            Tensor SV(k * s.dr);
+            for (std::size_t i = 0; i < k; ++i)
+                for (std::size_t j = 0; j < s.dr; ++j)
+                    SV[i * s.dr + j] = S[i] * Vh[i * s.dr + j];
+            std::size_t old_dr = s.dr;
+            s.a.resize(s.dl * 2 * k);
+            for (std::size_t i = 0; i < s.dl * 2; ++i)
+                for (std::size_t j = 0; j < k; ++j)
+                    s.a[i * k + j] = U[i * c + j];
+            s.dr = k;
+            absorb_left(SV, k, old_dr, sites_[center_ + 1]);
+            ++center_;
+        }
+        while (center_ > to){
+            Site& s = sites_[center_];
+            svd(s.a, s.dl, 2 * s.dr, U, S, Vh);
+            std::size_t c = S.size(), k = truncate(S, c);
+            Tensor US(s.dl * k);
+            for (std::size_t i = 0; i < s.dl; ++i)
+                for (std::size_t j = 0; j < k; ++j)
+                    US[i * k + j] = U[i * c + j] * S[j];
+            std::size_t old_dl = s.dl;
+            s.a.assign(Vh.begin(), Vh.begin() + k * 2 * s.dr);
+            s.dl = k;
+            absorb_right(sites_[center_ - 1], US, old_dl, k);
+            --center_;
+        }
+    }
+
+    calc_type probability_one(std::size_t p){
+        move_center(p);
+        Site const& s = sites_[p];
+        calc_type p0 = 0., p1 = 0.;
+        for (std::size_t l = 0; l < s.dl; ++l)
+            for (std::size_t r = 0; r < s.dr; ++r){
+                p0 += std::norm(s.a[(l * 2) * s.dr + r]);
+                p1 += std::norm(s.a[(l * 2 + 1) * s.dr + r]);
+            }
+        return p1 / (p0 + p1);
+    }
+
+    // unitaries on the physical index keep the canonical form
+    template <class M>
+    void apply_one_site(std::size_t p, M const& m){
+        Site& s = sites_[p];
+        for (std::size_t l = 0; l < s.dl; ++l)
+            for (std::size_t r = 0; r < s.dr; ++r){
+                auto& a0 = s.a[(l * 2) * s.dr + r];
+                auto& a1 = s.a[(l * 2 + 1) * s.dr + r];
+                complex_type v0 = a0, v1 = a1;
+                a0 = complex_type(m[0][0]) * v0 + complex_type(m[0][1]) * v1;
+                a1 = complex_type(m[1][0]) * v0 + complex_type(m[1][1]) * v1;
+            }
+    }
+
+    // G (4 x 4, index sL + 2 sR) on the sites p and p + 1
+    void apply_two_site(std::size_t p, Tensor const& G){
+        move_center(p);
+        Site& A = sites_[p];
+        Site& B = sites_[p + 1];
+        std::size_t dl = A.dl, dm = A.dr, dr = B.dr;
+
+        // theta[(l * 2 + sL) * (2 * dr) + sR * dr + r]
+        Tensor theta(dl * 2 * 2 * dr, 0.);
+        for (std::size_t l = 0; l < dl; ++l)
+            for (unsigned sl = 0; sl < 2; ++sl)
+                for (std::size_t k = 0; k < dm; ++k){
+                    auto f = A.a[(l * 2 + sl) * dm + k];
+                    if (f == 0.)
+                        continue;
+                    for (std::size_t j = 0; j < 2 * dr; ++j)
+                        theta[(l * 2 + sl) * 2 * dr + j] += f * B.a[k * 2 * dr + j];
+                }
+        Tensor out(theta.size(), 0.);
+        for (std::size_t l = 0; l < dl; ++l)
+            for (unsigned i = 0; i < 4; ++i)
+                for (unsigned j = 0; j < 4; ++j){
+                    auto g = G[i * 4 + j];
+                    if (g == 0.)
+                        continue;
+                    std::size_t dst = (l * 2 + (i & 1)) * 2 * dr + (i >> 1) * dr;
+                    std::size_t src = (l * 2 + (j & 1)) * 2 * dr + (j >> 1) * dr;
+                    for (std::size_t r = 0; r < dr; ++r)
+                        out[dst + r] += g * theta[src + r];
+                }
+
+        Tensor U, Vh;
+        std::vector<double> S;
+        svd(out, dl * 2, 2 * dr, U, S, Vh);
+        std::size_t c = S.size(), k = truncate(S, max_bond_);
+        A.a.resize(dl * 2 * k);
+        for (std::size_t i = 0; i < dl * 2; ++i)
+            for (std::size_t j = 0; j < k; ++j)
+                A.a[i * k + j] = U[i * c + j];
+        A.dr = k;
+        B.a.resize(k * 2 * dr);
+        for (std::size_t i = 0; i < k; ++i)
+            for (std::size_t j = 0; j < 2 * dr; ++j)
+                B.a[i * 2 * dr + j] = S[i] * Vh[i * 2 * dr + j];
+        B.dl = k;
+        center_ = p + 1;
+    }
+
+    std::vector<Site> sites_;
+    std::vector<unsigned> ids_; // qubit id of every site, sorted
+    std::size_t center_; // orthogonality center
+    unsigned max_bond_;
+    calc_type cutoff_; // relative cutoff for singular values
+    calc_type truncation_error_; // accumulated discarded weight
+    RndEngine rnd_eng_;
+    std::function<double()> rng_;
+};
+
+#endif
@@ -30,7 +30,7 @@ inline void kernel_core(V &psi, std::size_t I, std::size_t d0, std::size_t d1, M
 
 // bit indices id[.] are given from high to low (e.g. control first for CNOT)
 template <class V, class M>
-void kernel(V &psi, unsigned id1, unsigned id0, M const& m, std::size_t ctrlmask)
+void kernel(V &psi, unsigned id1, unsigned id0, M const& m, std::size_t ctrlmask, bool /*prefetch*/)
 {
     std::size_t n = psi.size();
     std::size_t d0 = 1UL << id0;
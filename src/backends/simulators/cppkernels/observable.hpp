@@ -0,0 +1,71 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef OBSERVABLE_HPP_
+#define OBSERVABLE_HPP_
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include "pauli.hpp"
+
+// A real linear combination of Pauli strings, prepared once for repeated
+// expectation values: the terms are parsed into masks and grouped by flip
+// mask (see PauliSum) over the positions of the register they are measured
+// on. The operator over the bit locations of the simulator is cached for the
+// last register layout, so a query on the same qubits only sweeps the state.
+class Observable{
+public:
+    using Term = std::vector<std::pair<unsigned, char>>;
+    using TermsDict = std::vector<std::pair<Term, double>>;
+
+    explicit Observable(TermsDict const& td) : num_qubits_(0) {
+        for (auto const& term : td){
+            for (auto const& local_op : term.first){
+                if (local_op.first >= 8 * sizeof(std::size_t))
+                    throw(std::runtime_error("Observable: Term acts on qubit " + std::to_string(local_op.first)
+                        + ", which exceeds the maximum register size."));
+                num_qubits_ = std::max(num_qubits_, local_op.first + 1);
+            }
+            local_.add(PauliString(term.first), term.second);
+        }
+        located_ = local_;
+        for (unsigned k = 0; k < num_qubits_; ++k)
+            bits_.push_back(k);
+    }
+
+    // number of register positions the terms act on
+    unsigned num_qubits() const { return num_qubits_; }
+
+    std::size_t size() const { return local_.size(); }
+
+    // the operator with position k of the register at bit location bits[k]
+    PauliSum const& locate(std::vector<unsigned> const& bits){
+        if (bits != bits_){
+            located_ = local_.permuted(bits);
+            bits_ = bits;
+        }
+        return located_;
+    }
+
+private:
+    unsigned num_qubits_;
+    PauliSum local_, located_;
+    std::vector<unsigned> bits_; // layout of located_
+};
+
+#endif
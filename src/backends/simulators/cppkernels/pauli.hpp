@@ -0,0 +1,220 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PAULI_HPP_
+#define PAULI_HPP_
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+inline unsigned parity(std::size_t x){
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_parityll(x);
+#else
+    unsigned p = 0;
+    for (; x; x &= x - 1)
+        p ^= 1;
+    return p;
+#endif
+}
+
+// moves bit k of x to bit bits[k]
+inline std::size_t permute_bits(std::size_t x, std::vector<unsigned> const& bits){
+    std::size_t y = 0;
+    for (unsigned k = 0; x; ++k, x >>= 1)
+        if (x & 1)
+            y |= 1UL << bits[k];
+    return y;
+}
+
+// A Pauli string acts on basis states as
+//     P|x> = i^#Y (-1)^popcount(x & zmask) |x ^ xmask>,
+// where xmask holds the bit locations of X and Y and zmask those of Y and Z.
+class PauliString{
+public:
+    using complex_type = std::complex<double>;
+
+    PauliString() : xmask(0), zmask(0), phase(1.) {}
+
+    // term: pairs of (bit location, 'X' | 'Y' | 'Z')
+    explicit PauliString(std::vector<std::pair<unsigned, char>> const& term)
+        : xmask(0), zmask(0), phase(1.) {
+        for (auto const& local_op : term){
+            std::size_t bit = 1UL << local_op.first;
+            switch (local_op.second){
+                case 'X': xmask ^= bit; break;
+                case 'Y': xmask ^= bit; zmask ^= bit; phase *= complex_type(0., 1.); break;
+                case 'Z': zmask ^= bit; break;
+                default:
+                    throw(std::runtime_error("PauliString: Unknown local operator (must be X, Y or Z)."));
+            }
+        }
+    }
+
+    std::size_t xmask, zmask;
+    complex_type phase;
+};
+
+// psi <- exp(-i theta P) psi = (cos(theta) - i sin(theta) P) psi on the basis
+// states which satisfy the control mask, in a single pass over the pairs
+// (j, j ^ xmask)
+template <class V>
+void apply_pauli_rotation(V& psi, PauliString const& p, double theta, std::size_t ctrlmask){
+    using complex_type = std::complex<double>;
+    std::size_t n = psi.size();
+    double c = std::cos(theta);
+    complex_type mis = complex_type(0., -std::sin(theta)) * p.phase;
+
+    if (p.xmask == 0){ // diagonal: every amplitude picks up exp(-+i theta)
+        complex_type ph[] = {c + mis, c - mis};
+        #pragma omp parallel for schedule(static)
+        for (std::size_t j = 0; j < n; ++j)
+            if ((j & ctrlmask) == ctrlmask)
+                psi[j] *= ph[parity(j & p.zmask)];
+        return;
+    }
+
+    unsigned h = 0; // highest flipped bit, enumerate j with that bit cleared
+    while (p.xmask >> (h + 1))
+        ++h;
+    std::size_t low = (1UL << h) - 1;
+    #pragma omp parallel for schedule(static)
+    for (std::size_t i = 0; i < n / 2; ++i){
+        std::size_t j0 = ((i & ~low) << 1) | (i & low);
+        if ((j0 & ctrlmask) != ctrlmask)
+            continue;
+        std::size_t j1 = j0 ^ p.xmask;
+        auto v0 = psi[j0], v1 = psi[j1];
+        psi[j0] = c * v0 + (parity(j1 & p.zmask) ? -mis : mis) * v1;
+        psi[j1] = c * v1 + (parity(j0 & p.zmask) ? -mis : mis) * v0;
+    }
+}
+
+// Weighted sum of Pauli strings, grouped by flip mask so that every group
+// needs a single gather per amplitude.
+class PauliSum{
+public:
+    using complex_type = std::complex<double>;
+    struct Term{
+        std::size_t zmask;
+        complex_type coeff; // includes the i^#Y phase
+    };
+    struct Group{
+        std::size_t xmask;
+        std::vector<Term> terms;
+    };
+
+    void add(PauliString const& p, complex_type coeff){
+        auto it = std::find_if(groups_.begin(), groups_.end(),
+                               [&](Group const& g){ return g.xmask == p.xmask; });
+        if (it == groups_.end()){
+            groups_.push_back(Group{p.xmask, {}});
+            it = groups_.end() - 1;
+        }
+        it->terms.push_back(Term{p.zmask, coeff * p.phase});
+        norm1_ += std::abs(coeff);
+        ++size_;
+    }
+
+    std::size_t size() const { return size_; }
+
+    // sum of |coefficients|, an upper bound of the operator norm
+    double norm1() const { return norm1_; }
+
+    std::vector<Group> const& groups() const { return groups_; }
+
+    // the same operator with bit k of every mask moved to bits[k]
+    PauliSum permuted(std::vector<unsigned> const& bits) const {
+        PauliSum p(*this);
+        for (auto& g : p.groups_){
+            g.xmask = permute_bits(g.xmask, bits);
+            for (auto& t : g.terms)
+                t.zmask = permute_bits(t.zmask, bits);
+        }
+        return p;
+    }
+
+    // out = P_ctrl H in, where P_ctrl projects onto the basis states which
+    // satisfy the control mask
+    template <class V>
+    void apply(V const& in, V& out, std::size_t ctrlmask = 0) const {
+        #pragma omp parallel for schedule(static)
+        for (std::size_t j = 0; j < in.size(); ++j){
+            complex_type res = 0.;
+            if ((j & ctrlmask) == ctrlmask)
+                res = row(in, j);
+            out[j] = res;
+        }
+    }
+
+    // <v|H|v>, one sweep per group: each sweep reads two streams (j and
+    // j ^ xmask) instead of one stream per group for every amplitude
+    template <class V>
+    complex_type expectation(V const& v) const {
+        double re = 0., im = 0.;
+        for (auto const& g : groups_){
+            #pragma omp parallel for reduction(+:re,im) schedule(static)
+            for (std::size_t j = 0; j < v.size(); ++j){
+                std::size_t src = j ^ g.xmask;
+                complex_type c = 0.;
+                for (auto const& t : g.terms)
+                    c += parity(src & t.zmask) ? -t.coeff : t.coeff;
+                auto e = std::conj(v[j]) * c * v[src];
+                re += std::real(e);
+                im += std::imag(e);
+            }
+        }
+        return complex_type(re, im);
+    }
+
+    // <u|P_ctrl H|v>
+    template <class V>
+    complex_type inner(V const& u, V const& v, std::size_t ctrlmask = 0) const {
+        double re = 0., im = 0.;
+        #pragma omp parallel for reduction(+:re,im) schedule(static)
+        for (std::size_t j = 0; j < v.size(); ++j){
+            if ((j & ctrlmask) != ctrlmask)
+                continue;
+            auto c = std::conj(u[j]) * row(v, j);
+            re += std::real(c);
+            im += std::imag(c);
+        }
+        return complex_type(re, im);
+    }
+
+private:
+    // (H v)[j]
+    template <class V>
+    complex_type row(V const& v, std::size_t j) const {
+        complex_type res = 0.;
+        for (auto const& g : groups_){
+            std::size_t src = j ^ g.xmask;
+            complex_type c = 0.;
+            for (auto const& t : g.terms)
+                c += parity(src & t.zmask) ? -t.coeff : t.coeff;
+            res += c * v[src];
+        }
+        return res;
+    }
+
+    std::vector<Group> groups_;
+    double norm1_ = 0.;
+    std::size_t size_ = 0;
+};
+
+#endif
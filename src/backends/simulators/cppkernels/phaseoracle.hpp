@@ -0,0 +1,66 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PHASE_ORACLE_HPP_
+#define PHASE_ORACLE_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include "registerbits.hpp"
+
+// Phase oracles mark register values x in a packed bitmap: x is marked if
+// bit x & 7 of byte x >> 3 is set.
+using PhaseOracleBitmap = std::vector<std::uint8_t>;
+
+// bitmap of a truth table with one (zero / nonzero) entry per register value
+inline PhaseOracleBitmap pack_truth_table(std::uint8_t const* table, std::size_t size){
+    PhaseOracleBitmap bitmap((size + 7) / 8, 0);
+    for (std::size_t x = 0; x < size; ++x)
+        if (table[x])
+            bitmap[x >> 3] |= 1U << (x & 7);
+    return bitmap;
+}
+
+// bitmap of a list of marked values of an n-qubit register
+inline PhaseOracleBitmap pack_marked_states(std::vector<std::size_t> const& marked, unsigned n){
+    PhaseOracleBitmap bitmap(((1UL << n) + 7) / 8, 0);
+    for (auto x : marked){
+        if (x >> n)
+            throw(std::runtime_error("pack_marked_states(): Marked state out of range."));
+        bitmap[x >> 3] |= 1U << (x & 7);
+    }
+    return bitmap;
+}
+
+// psi <- -psi for the basis states whose value of the register at bit
+// locations locs is marked in the bitmap and which satisfy the control mask,
+// in a single pass over the state vector
+template <class V>
+void apply_phase_oracle(V& psi, std::vector<unsigned> const& locs, PhaseOracleBitmap const& bitmap,
+                        std::size_t ctrlmask){
+    if (bitmap.size() != ((1UL << locs.size()) + 7) / 8)
+        throw(std::runtime_error("apply_phase_oracle(): The bitmap must have one bit per register value."));
+    RegisterBits reg(locs);
+    #pragma omp parallel for schedule(static)
+    for (std::size_t i = 0; i < psi.size(); ++i){
+        if ((i & ctrlmask) != ctrlmask)
+            continue;
+        std::size_t x = reg.value(i);
+        if ((bitmap[x >> 3] >> (x & 7)) & 1U)
+            psi[i] = -psi[i];
+    }
+}
+
+#endif
@@ -0,0 +1,251 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef POOL_HPP_
+#define POOL_HPP_
+
+#include "simulator.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+
+// Runs many small, independent circuits concurrently: one Simulator per job
+// and one job per worker thread at a time. Parallelism comes from running
+// jobs side by side, so every worker restricts OpenMP to a single thread
+// (spawning a full team for a 2^12 vector costs more than it saves).
+//
+// Each worker has its own queue. Submitted jobs are spread round robin; a
+// worker whose queue runs dry steals from the back of the others' queues.
+// on_complete is called on the worker thread as soon as a job is done.
+class SimulatorPool{
+public:
+    using Matrix = std::vector<Simulator::StateVector>;
+
+    struct Gate{
+        Matrix matrix;
+        std::vector<unsigned> ids, ctrl; // qubit indices in [0, num_qubits)
+    };
+
+    struct Job{
+        unsigned num_qubits = 0;
+        std::vector<Gate> gates;
+        std::vector<unsigned> measured; // qubits sampled at the end (low bit first)
+        unsigned shots = 0;
+        bool probabilities = false; // return all 2^n probabilities
+    };
+
+    struct Result{
+        std::size_t id;
+        std::vector<std::uint64_t> samples;
+        std::vector<double> probabilities;
+        std::string error; // empty on success
+    };
+
+    using Callback = std::function<void(Result&)>;
+
+    SimulatorPool(unsigned num_threads, unsigned seed, Callback on_complete)
+        : seed_(seed), on_complete_(on_complete), queued_(0), unfinished_(0),
+          next_id_(0), stop_(false) {
+        if (num_threads == 0)
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < num_threads; ++i)
+            queues_.emplace_back(new Queue());
+        for (unsigned i = 0; i < num_threads; ++i)
+            workers_.emplace_back(&SimulatorPool::work, this, i);
+    }
+
+    ~SimulatorPool(){
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& w : workers_)
+            w.join();
+    }
+
+    unsigned num_threads() const { return workers_.size(); }
+
+    // number of submitted jobs which have not completed yet
+    std::size_t pending() const { return unfinished_; }
+
+    // queues the job and returns its id (the id of the Result)
+    std::size_t submit(Job job){
+        std::size_t id;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            id = next_id_++;
+            unfinished_++;
+        }
+        Queue& q = *queues_[id % queues_.size()];
+        {
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.jobs.emplace_back(id, std::move(job));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queued_++;
+        }
+        cv_.notify_one();
+        return id;
+    }
+
+    // blocks until all submitted jobs have completed
+    void wait(){
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this]{ return unfinished_ == 0; });
+    }
+
+private:
+    using Entry = std::pair<std::size_t, Job>;
+
+    struct Queue{
+        std::mutex mutex;
+        std::deque<Entry> jobs;
+    };
+
+    // own queue first (oldest job), then the newest job of another worker
+    bool take(unsigned w, Entry& entry){
+        for (unsigned k = 0; k < queues_.size(); ++k){
+            Queue& q = *queues_[(w + k) % queues_.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.jobs.empty())
+                continue;
+            if (k == 0){
+                entry = std::move(q.jobs.front());
+                q.jobs.pop_front();
+            }
+            else{
+                entry = std::move(q.jobs.back());
+                q.jobs.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void work(unsigned w){
+#ifdef _OPENMP
+        omp_set_num_threads(1);
+#endif
+        while (true){
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this]{ return stop_ || queued_ > 0; });
+                if (stop_)
+                    return;
+                queued_--;
+            }
+            // a job is reserved for this worker, but another worker may
+            // have taken it from the queue it was put in
+            Entry entry;
+            while (!take(w, entry))
+                std::this_thread::yield();
+
+            Result result = execute(entry.first, entry.second);
+            on_complete_(result);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                unfinished_--;
+            }
+            idle_.notify_all();
+        }
+    }
+
+    Result execute(std::size_t id, Job const& job){
+        Result result;
+        result.id = id;
+        try {
+            if (job.num_qubits > 30)
+                throw(std::runtime_error("SimulatorPool: Jobs are limited to 30 qubits."));
+            // before the 2^|measured| marginal distribution is allocated
+            if (job.measured.size() > job.num_qubits)
+                throw(std::runtime_error("SimulatorPool: More measured qubits than allocated."));
+            check_qubits(job.measured, job.num_qubits);
+            check_distinct(job.measured);
+            Simulator sim(seed_ + static_cast<unsigned>(id));
+            for (unsigned q = 0; q < job.num_qubits; ++q)
+                sim.allocate_qubit(q);
+            for (auto const& gate : job.gates){
+                check_qubits(gate.ids, job.num_qubits);
+                check_qubits(gate.ctrl, job.num_qubits);
+                if (gate.ids.size() > kernel_max_qubits)
+                    throw(std::runtime_error("SimulatorPool: Too many target qubits."));
+                if (gate.matrix.size() != (1UL << gate.ids.size()))
+                    throw(std::runtime_error("SimulatorPool: Matrix size does not match the number of target qubits."));
+                sim.apply_controlled_gate(gate.matrix, gate.ids, gate.ctrl);
+            }
+            auto const& vec = std::get<1>(sim.cheat());
+
+            if (job.probabilities){
+                result.probabilities.resize(vec.size());
+                for (std::size_t i = 0; i < vec.size(); ++i)
+                    result.probabilities[i] = std::norm(vec[i]);
+            }
+            if (job.shots > 0){
+                // marginal distribution of the measured qubits
+                std::vector<double> cumulative(1UL << job.measured.size(), 0.);
+                for (std::size_t i = 0; i < vec.size(); ++i){
+                    std::size_t k = 0;
+                    for (unsigned j = 0; j < job.measured.size(); ++j)
+                        k |= ((i >> job.measured[j]) & 1UL) << j;
+                    cumulative[k] += std::norm(vec[i]);
+                }
+                for (std::size_t k = 1; k < cumulative.size(); ++k)
+                    cumulative[k] += cumulative[k - 1];
+
+                Simulator::RndEngine rnd_eng(seed_ + static_cast<unsigned>(id));
+                std::uniform_real_distribution<double> dist(0., cumulative.back());
+                result.samples.resize(job.shots);
+                for (auto& s : result.samples){
+                    auto it = std::upper_bound(cumulative.begin(), cumulative.end(), dist(rnd_eng));
+                    s = std::min<std::size_t>(it - cumulative.begin(), cumulative.size() - 1);
+                }
+            }
+        } catch (std::exception const& error){
+            // also std::bad_alloc: nothing may escape the worker thread
+            result.error = error.what();
+        }
+        return result;
+    }
+
+    static void check_qubits(std::vector<unsigned> const& ids, unsigned num_qubits){
+        for (auto id : ids)
+            if (id >= num_qubits)
+                throw(std::runtime_error("SimulatorPool: Qubit index out of range."));
+    }
+
+    static void check_distinct(std::vector<unsigned> ids){
+        std::sort(ids.begin(), ids.end());
+        if (std::adjacent_find(ids.begin(), ids.end()) != ids.end())
+            throw(std::runtime_error("SimulatorPool: Measured qubits must be distinct."));
+    }
+
+    unsigned seed_;
+    Callback on_complete_;
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable cv_, idle_;
+    std::size_t queued_, unfinished_, next_id_;
+    bool stop_;
+};
+
+#endif
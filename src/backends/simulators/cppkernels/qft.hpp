@@ -0,0 +1,150 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef QFT_HPP_
+#define QFT_HPP_
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <algorithm>
+#include "registerbits.hpp"
+
+// Quantum Fourier transform of a register with the same result as its
+// decomposition into H and controlled R gates
+// (setups/decompositions/qft2crandhadamard.ts). With register qubit k at bit
+// location locs[k]:
+//     for q = n-1, ..., 0:  H on qubit q, then the phase exp(i pi low / 2^q)
+//                           on its |1> half, low = value of the qubits < q.
+// Each step is one butterfly pass over the state vector, i.e. a radix-2
+// decimation-in-frequency FFT over the register's bits (with bit-reversed
+// output, as there are no swaps in the decomposition). Consecutive passes on
+// qubits located below qft_block_bits are done one block of
+// 2^qft_block_bits amplitudes at a time, so the block stays in cache for all
+// of them.
+static const unsigned qft_block_bits = 12;
+
+namespace qft_detail{
+
+using complex_type = std::complex<double>;
+
+// k with a zero inserted at bit location loc
+inline std::size_t insert_zero(std::size_t k, unsigned loc){
+    std::size_t low = k & ((1UL << loc) - 1);
+    return ((k ^ low) << 1) | low;
+}
+
+// exp(i pi l / 2^q) for 0 <= l < 2^q from two tables of about 2^(q/2) entries
+class Twiddles{
+public:
+    explicit Twiddles(unsigned q) : shift_((q + 1) / 2), mask_((1UL << shift_) - 1),
+                                    lo_(1UL << shift_), hi_(1UL << (q - shift_)) {
+        double const scale = std::acos(-1.) / std::ldexp(1., q);
+        for (std::size_t l = 0; l < lo_.size(); ++l)
+            lo_[l] = std::polar(1., scale * l);
+        for (std::size_t h = 0; h < hi_.size(); ++h)
+            hi_[h] = std::polar(1., scale * std::ldexp(static_cast<double>(h), shift_));
+    }
+
+    complex_type operator()(std::size_t l) const {
+        return hi_[l >> shift_] * lo_[l & mask_];
+    }
+
+private:
+    unsigned shift_;
+    std::size_t mask_;
+    std::vector<complex_type> lo_, hi_;
+};
+
+// H followed by the phase w on the |1> half of the pair (i0, i0 | bit), or
+// the inverse of both
+template <class V>
+inline void butterfly(V& psi, std::size_t i0, std::size_t bit, complex_type w, bool inverse){
+    static const double s = 1. / std::sqrt(2.);
+    auto a0 = psi[i0];
+    auto a1 = psi[i0 | bit];
+    if (inverse){
+        a1 *= std::conj(w);
+        psi[i0] = (a0 + a1) * s;
+        psi[i0 | bit] = (a0 - a1) * s;
+    }
+    else{
+        psi[i0] = (a0 + a1) * s;
+        psi[i0 | bit] = (a0 - a1) * (s * w);
+    }
+}
+
+}
+
+// psi <- QFT psi (or QFT^dagger psi) on the register at bit locations locs,
+// for the basis states which satisfy the control mask
+template <class V>
+void apply_qft(V& psi, std::vector<unsigned> const& locs, bool inverse, std::size_t ctrlmask){
+    using namespace qft_detail;
+    unsigned n = locs.size();
+    if (n == 0)
+        return;
+    std::size_t size = psi.size();
+    unsigned nbits = 0;
+    while ((1UL << nbits) < size)
+        ++nbits;
+    unsigned block_bits = std::min(qft_block_bits, nbits);
+    std::size_t blockmask = (1UL << block_bits) - 1;
+    RegisterBits reg(locs);
+
+    // QFT^dagger undoes the passes in reverse order
+    std::vector<unsigned> order(n);
+    for (unsigned j = 0; j < n; ++j)
+        order[j] = inverse ? j : n - 1 - j;
+
+    for (unsigned j = 0; j < n;){
+        if (locs[order[j]] >= block_bits){
+            unsigned q = order[j++];
+            unsigned loc = locs[q];
+            Twiddles w(q);
+            #pragma omp parallel for schedule(static)
+            for (std::size_t k = 0; k < size / 2; ++k){
+                std::size_t i = insert_zero(k, loc);
+                if ((i & ctrlmask) == ctrlmask)
+                    butterfly(psi, i, 1UL << loc, w(reg.low(i, q)), inverse);
+            }
+            continue;
+        }
+
+        // all following passes within a block
+        unsigned end = j;
+        std::vector<Twiddles> w;
+        while (end < n && locs[order[end]] < block_bits)
+            w.emplace_back(order[end++]);
+        std::size_t outer_ctrl = ctrlmask & ~blockmask;
+        #pragma omp parallel for schedule(static)
+        for (std::size_t b = 0; b < (size >> block_bits); ++b){
+            std::size_t base = b << block_bits;
+            if ((base & outer_ctrl) != outer_ctrl)
+                continue;
+            for (unsigned p = j; p < end; ++p){
+                unsigned q = order[p];
+                unsigned loc = locs[q];
+                for (std::size_t k = 0; k < (blockmask + 1) / 2; ++k){
+                    std::size_t i = base | insert_zero(k, loc);
+                    if ((i & ctrlmask) == ctrlmask)
+                        butterfly(psi, i, 1UL << loc, w[p - j](reg.low(i, q)), inverse);
+                }
+            }
+        }
+        j = end;
+    }
+}
+
+#endif
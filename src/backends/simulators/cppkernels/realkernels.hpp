@@ -0,0 +1,140 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef REAL_KERNELS_HPP_
+#define REAL_KERNELS_HPP_
+
+#include <complex>
+#include <cstddef>
+#include <algorithm>
+#include "split/kernels.hpp"
+
+// Kernels for fused matrices with real entries (products of H, X, Ry, CNOT,
+// Toffoli, ...). Such a matrix acts on the real and the imaginary parts of
+// the amplitudes independently, so the kernels apply it to planes of doubles
+// with one multiply-add per entry instead of a complex multiply-accumulate.
+// The planes are the two of the split layout, or the interleaved state
+// itself, read as doubles: its real and imaginary parts are bit 0 of the
+// index, and bit location b of the state is bit b + 1 of the index.
+namespace real_detail{
+
+// m (given as its transpose mt) applied to the C consecutive groups of 2^K
+// entries starting at I of every plane. Short groups (with the lowest gate
+// bit below 2) are vectorized over the rows of m instead.
+template <unsigned K, unsigned C, unsigned NP>
+inline void core(double* const (&planes)[NP], std::size_t I, std::size_t const* off,
+                 double const (&mt)[1U << K][1U << K], std::size_t lowctrl){
+    constexpr unsigned D = 1U << K;
+    double w[NP][D][C];
+    for (unsigned p = 0; p < NP; ++p)
+        for (unsigned x = 0; x < D; ++x)
+            for (unsigned l = 0; l < C; ++l)
+                w[p][x][l] = planes[p][I + off[x] + l];
+    if (C >= 4){
+        for (unsigned r = 0; r < D; ++r){
+            double a[NP][C] = {};
+            for (unsigned x = 0; x < D; ++x){
+                double const c = mt[x][r];
+                for (unsigned p = 0; p < NP; ++p){
+                    #pragma omp simd
+                    for (unsigned l = 0; l < C; ++l)
+                        a[p][l] += c * w[p][x][l];
+                }
+            }
+            for (unsigned p = 0; p < NP; ++p)
+                for (unsigned l = 0; l < C; ++l)
+                    if (((I + l) & lowctrl) == lowctrl)
+                        planes[p][I + off[r] + l] = a[p][l];
+        }
+    }
+    else{
+        for (unsigned p = 0; p < NP; ++p)
+            for (unsigned l = 0; l < C; ++l){
+                if (((I + l) & lowctrl) != lowctrl)
+                    continue;
+                double a[D] = {};
+                for (unsigned x = 0; x < D; ++x){
+                    double const c = w[p][x][l];
+                    #pragma omp simd
+                    for (unsigned r = 0; r < D; ++r)
+                        a[r] += mt[x][r] * c;
+                }
+                for (unsigned r = 0; r < D; ++r)
+                    planes[p][I + off[r] + l] = a[r];
+            }
+    }
+}
+
+template <unsigned K, unsigned C, unsigned NP>
+inline void sweep(double* const (&planes)[NP], std::size_t size, unsigned const* sorted,
+                  std::size_t const* off, double const (&mt)[1U << K][1U << K],
+                  std::size_t ctrlmask){
+    std::size_t run = 1UL << sorted[0];
+    std::size_t lowctrl = ctrlmask & (run - 1);
+    std::size_t highctrl = ctrlmask & ~(run - 1);
+    std::size_t nruns = (size >> K) / run;
+    #pragma omp for schedule(static)
+    for (std::size_t h = 0; h < nruns; ++h){
+        std::size_t base = split_detail::insert_zeros<K>(h * run, sorted);
+        if ((base & highctrl) != highctrl)
+            continue;
+        for (std::size_t l = 0; l < run; l += C)
+            core<K, C>(planes, base + l, off, mt, lowctrl);
+    }
+}
+
+}
+
+// true if all entries of m are real
+template <class M>
+bool is_real_matrix(M const& m){
+    for (auto const& row : m)
+        for (auto const& entry : row)
+            if (std::imag(entry) != 0.)
+                return false;
+    return true;
+}
+
+// planes[p] <- Re(m) planes[p] for each of the NP planes of size doubles, on
+// the bit locations ids (ids[j] <-> bit j of the row and column index of m)
+// and for the indices which satisfy the control mask. Has to be called from
+// within a parallel region.
+template <unsigned K, unsigned NP, class M>
+void kernel_real(double* const (&planes)[NP], std::size_t size, unsigned const* ids,
+                 M const& m, std::size_t ctrlmask){
+    using namespace real_detail;
+    constexpr unsigned D = 1U << K;
+    double mt[D][D];
+    for (unsigned r = 0; r < D; ++r)
+        for (unsigned c = 0; c < D; ++c)
+            mt[c][r] = std::real(m[r][c]);
+    std::size_t off[D];
+    for (unsigned x = 0; x < D; ++x){
+        off[x] = 0;
+        for (unsigned j = 0; j < K; ++j)
+            off[x] |= static_cast<std::size_t>((x >> j) & 1U) << ids[j];
+    }
+    unsigned sorted[K];
+    std::copy(ids, ids + K, sorted);
+    std::sort(sorted, sorted + K);
+
+    switch (std::min(sorted[0], 3U)){
+        case 0: sweep<K, 1>(planes, size, sorted, off, mt, ctrlmask); break;
+        case 1: sweep<K, 2>(planes, size, sorted, off, mt, ctrlmask); break;
+        case 2: sweep<K, 4>(planes, size, sorted, off, mt, ctrlmask); break;
+        default: sweep<K, split_chunk>(planes, size, sorted, off, mt, ctrlmask); break;
+    }
+}
+
+#endif
@@ -0,0 +1,52 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef REGISTER_BITS_HPP_
+#define REGISTER_BITS_HPP_
+
+#include <vector>
+#include <cstddef>
+
+// Value of a register (qubit k at bit location locs[k], k = 0 least
+// significant) in a basis state of the state vector. Registers on
+// consecutive bit locations take a single shift and mask.
+class RegisterBits{
+public:
+    explicit RegisterBits(std::vector<unsigned> const& locs) : locs_(locs), contiguous_(true) {
+        for (std::size_t k = 1; k < locs.size(); ++k)
+            contiguous_ = contiguous_ && locs[k] == locs[0] + k;
+    }
+
+    // value of the qubits 0, ..., q-1 of the register in basis state i
+    std::size_t low(std::size_t i, unsigned q) const {
+        if (q == 0)
+            return 0;
+        if (contiguous_)
+            return (i >> locs_[0]) & ((1UL << q) - 1);
+        std::size_t v = 0;
+        for (unsigned k = 0; k < q; ++k)
+            v |= ((i >> locs_[k]) & 1UL) << k;
+        return v;
+    }
+
+    std::size_t value(std::size_t i) const {
+        return low(i, locs_.size());
+    }
+
+private:
+    std::vector<unsigned> locs_;
+    bool contiguous_;
+};
+
+#endif
@@ -0,0 +1,314 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef REVERSIBLE_HPP_
+#define REVERSIBLE_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <map>
+#include <cstdint>
+#include <stdexcept>
+#include "mathops.hpp"
+
+// Simulator for classical reversible circuits (X, CNOT, Toffoli, Swap and
+// math operations) which evaluates the circuit on many input patterns at
+// once. The state is bit-sliced: every bit owns one 256-bit word per 256
+// patterns, and pattern p lives at bit p % 256 of word p / 256. A (multi-)
+// controlled NOT is then one xor/and per word, whatever the patterns are.
+//
+// With a single pattern this is a plain classical simulator; pattern 0 holds
+// the state which measurements report.
+class ReversibleSimulator{
+public:
+    // 256 patterns as four 64-bit lanes; the operators are plain loops over
+    // the lanes, which the compiler turns into single AVX2 instructions
+    // where they are available
+    struct Word{
+        static const unsigned bits = 256;
+        static const unsigned lanes = bits / 64;
+
+        std::uint64_t lane[lanes];
+
+        Word(){ fill(0); }
+        explicit Word(bool set){ fill(set ? ~std::uint64_t(0) : 0); }
+
+        bool get(unsigned b) const { return (lane[b / 64] >> (b % 64)) & 1; }
+        void set(unsigned b, bool v){
+            std::uint64_t m = std::uint64_t(1) << (b % 64);
+            lane[b / 64] = v ? (lane[b / 64] | m) : (lane[b / 64] & ~m);
+        }
+
+        Word operator~() const { Word r; for (unsigned k = 0; k < lanes; ++k) r.lane[k] = ~lane[k]; return r; }
+        Word& operator&=(Word const& o){ for (unsigned k = 0; k < lanes; ++k) lane[k] &= o.lane[k]; return *this; }
+        Word& operator|=(Word const& o){ for (unsigned k = 0; k < lanes; ++k) lane[k] |= o.lane[k]; return *this; }
+        Word& operator^=(Word const& o){ for (unsigned k = 0; k < lanes; ++k) lane[k] ^= o.lane[k]; return *this; }
+        friend Word operator&(Word a, Word const& b){ return a &= b; }
+        friend Word operator|(Word a, Word const& b){ return a |= b; }
+        friend Word operator^(Word a, Word const& b){ return a ^= b; }
+
+    private:
+        void fill(std::uint64_t v){ for (unsigned k = 0; k < lanes; ++k) lane[k] = v; }
+    };
+    using Map = std::map<unsigned, unsigned>;
+    using QuRegs = std::vector<std::vector<unsigned>>;
+
+    // operation codes of apply_ops
+    enum OpCode{
+        NOT = 0, // [NOT, #targets, #controls, targets..., controls...]
+        SWAP = 1 // [SWAP, 2, #controls, a, b, controls...]
+    };
+
+    ReversibleSimulator(unsigned patterns = 1) : patterns_(patterns), words_((patterns + Word::bits - 1) / Word::bits) {
+        if (patterns == 0)
+            throw(std::runtime_error("ReversibleSimulator: At least one input pattern is required."));
+    }
+
+    unsigned num_patterns() const { return patterns_; }
+
+    void allocate_qubit(unsigned id){
+        if (map_.count(id) != 0)
+            throw(std::runtime_error(
+                "AllocateQubit: ID already exists. Qubit IDs should be unique."));
+        unsigned pos = map_.size();
+        map_[id] = pos;
+        bits_.resize(bits_.size() + words_);
+    }
+
+    void deallocate_qubit(unsigned id){
+        unsigned pos = position(id);
+        bits_.erase(bits_.begin() + pos * words_, bits_.begin() + (pos + 1) * words_);
+        for (auto& p : map_)
+            if (p.second > pos)
+                p.second--;
+        map_.erase(id);
+    }
+
+    bool get_classical_value(unsigned id, unsigned pattern = 0){
+        check_pattern(pattern);
+        return slice(id)[pattern / Word::bits].get(pattern % Word::bits);
+    }
+
+    // measurements are no-ops, they report the bits of pattern 0
+    std::vector<bool> measure_qubits_return(std::vector<unsigned> const& ids){
+        std::vector<bool> ret(ids.size());
+        for (unsigned i = 0; i < ids.size(); ++i)
+            ret[i] = get_classical_value(ids[i]);
+        return ret;
+    }
+
+    // flips all targets in the patterns where all controls are 1
+    void apply_x(std::vector<unsigned> const& ids, std::vector<unsigned> const& ctrl){
+        std::vector<Word*> t(ids.size()), c(ctrl.size());
+        for (unsigned i = 0; i < ids.size(); ++i)
+            t[i] = slice(ids[i]);
+        for (unsigned i = 0; i < ctrl.size(); ++i)
+            c[i] = slice(ctrl[i]);
+        apply_x(t, c);
+    }
+
+    void apply_swap(unsigned a, unsigned b, std::vector<unsigned> const& ctrl){
+        std::vector<Word*> c(ctrl.size());
+        for (unsigned i = 0; i < ctrl.size(); ++i)
+            c[i] = slice(ctrl[i]);
+        apply_swap(slice(a), slice(b), c);
+    }
+
+    // runs a whole batch of NOT/SWAP operations, encoded as described in
+    // OpCode, without a round trip per gate
+    void apply_ops(std::vector<unsigned> const& ops){
+        std::vector<Word*> t, c;
+        std::size_t i = 0;
+        while (i < ops.size()){
+            if (i + 3 > ops.size() || i + 3 + ops[i + 1] + ops[i + 2] > ops.size())
+                throw(std::runtime_error("apply_ops(): Truncated operation list."));
+            unsigned code = ops[i], nt = ops[i + 1], nc = ops[i + 2];
+            t.resize(nt);
+            c.resize(nc);
+            for (unsigned k = 0; k < nt; ++k)
+                t[k] = slice(ops[i + 3 + k]);
+            for (unsigned k = 0; k < nc; ++k)
+                c[k] = slice(ops[i + 3 + nt + k]);
+            if (code == NOT)
+                apply_x(t, c);
+            else if (code == SWAP && nt == 2)
+                apply_swap(t[0], t[1], c);
+            else
+                throw(std::runtime_error("apply_ops(): Unknown operation."));
+            i += 3 + nt + nc;
+        }
+    }
+
+    // f is called once per pattern which satisfies the controls
+    template <class F>
+    void emulate_math(F const& f, QuRegs const& quregs, std::vector<unsigned> const& ctrl){
+        auto regs = slices(quregs);
+        auto cm = control_mask(ctrl);
+        std::vector<int> x(regs.size());
+        for (unsigned p = 0; p < patterns_; ++p){
+            unsigned w = p / Word::bits, b = p % Word::bits;
+            if (!cm[w].get(b))
+                continue;
+            for (unsigned r = 0; r < regs.size(); ++r){
+                x[r] = 0;
+                for (unsigned i = 0; i < regs[r].size(); ++i)
+                    x[r] |= static_cast<int>(regs[r][i][w].get(b)) << i;
+            }
+            f(x);
+            for (unsigned r = 0; r < regs.size(); ++r)
+                for (unsigned i = 0; i < regs[r].size(); ++i)
+                    regs[r][i][w].set(b, (x[r] >> i) & 1);
+        }
+    }
+
+    // the addition runs bit-sliced (ripple carry on whole words), the
+    // modular operations are evaluated pattern by pattern
+    void emulate_math_operation(MathOperation const& op, QuRegs const& quregs,
+                                std::vector<unsigned> const& ctrl){
+        if (quregs.size() != 1)
+            throw(std::runtime_error("emulate_math_operation(): The operation acts on a single quantum register."));
+        auto regs = slices(quregs);
+        auto cm = control_mask(ctrl);
+        switch (op.kind()){
+            case MathOperation::AddConstant: {
+                auto a = static_cast<std::uint64_t>(op.a());
+                bool negative = op.a() < 0;
+                add(regs[0], [&](unsigned i, unsigned){
+                    return Word(i < 64 ? ((a >> i) & 1) : negative);
+                }, cm);
+                break;
+            }
+            default:
+                emulate_math(op, quregs, ctrl);
+        }
+    }
+
+    // value of a register (low bit first) in one pattern
+    std::uint64_t read_register(std::vector<unsigned> const& ids, unsigned pattern = 0){
+        check_pattern(pattern);
+        std::uint64_t value = 0;
+        for (unsigned i = 0; i < ids.size(); ++i)
+            value |= std::uint64_t(slice(ids[i])[pattern / Word::bits].get(pattern % Word::bits)) << i;
+        return value;
+    }
+
+    void write_register(std::vector<unsigned> const& ids, std::uint64_t value, unsigned pattern = 0){
+        check_pattern(pattern);
+        for (unsigned i = 0; i < ids.size(); ++i)
+            slice(ids[i])[pattern / Word::bits].set(pattern % Word::bits, (value >> i) & 1);
+    }
+
+    // values of a register in all patterns
+    std::vector<std::uint64_t> read_register_patterns(std::vector<unsigned> const& ids){
+        std::vector<std::uint64_t> values(patterns_, 0);
+        for (unsigned i = 0; i < ids.size(); ++i){
+            Word const* s = slice(ids[i]);
+            for (unsigned p = 0; p < patterns_; ++p)
+                values[p] |= std::uint64_t(s[p / Word::bits].get(p % Word::bits)) << i;
+        }
+        return values;
+    }
+
+    // loads one value per pattern into a register, e.g. all inputs of a test
+    void write_register_patterns(std::vector<unsigned> const& ids, std::vector<std::uint64_t> const& values){
+        if (values.size() != patterns_)
+            throw(std::runtime_error("write_register_patterns(): Expected one value per pattern."));
+        for (unsigned i = 0; i < ids.size(); ++i){
+            Word* s = slice(ids[i]);
+            for (unsigned w = 0; w < words_; ++w)
+                s[w] = Word();
+            for (unsigned p = 0; p < patterns_; ++p)
+                s[p / Word::bits].set(p % Word::bits, (values[p] >> i) & 1);
+        }
+    }
+
+    void run(){}
+
+private:
+    unsigned position(unsigned id) const {
+        auto it = map_.find(id);
+        if (it == map_.end())
+            throw(std::runtime_error("ReversibleSimulator: Unknown qubit id. Please make sure you have called eng.flush()."));
+        return it->second;
+    }
+
+    Word* slice(unsigned id){ return &bits_[position(id) * words_]; }
+
+    std::vector<std::vector<Word*>> slices(QuRegs const& quregs){
+        std::vector<std::vector<Word*>> regs(quregs.size());
+        for (unsigned r = 0; r < quregs.size(); ++r)
+            for (auto id : quregs[r])
+                regs[r].push_back(slice(id));
+        return regs;
+    }
+
+    void check_pattern(unsigned pattern) const {
+        if (pattern >= patterns_)
+            throw(std::runtime_error("ReversibleSimulator: Pattern index out of range."));
+    }
+
+    // patterns in which all controls are 1 (unused bits of the last word
+    // are included, they are never read)
+    std::vector<Word> control_mask(std::vector<unsigned> const& ctrl){
+        std::vector<Word> cm(words_, Word(true));
+        for (auto id : ctrl){
+            Word const* s = slice(id);
+            for (unsigned w = 0; w < words_; ++w)
+                cm[w] &= s[w];
+        }
+        return cm;
+    }
+
+    void apply_x(std::vector<Word*> const& t, std::vector<Word*> const& c){
+        for (unsigned w = 0; w < words_; ++w){
+            Word m(true);
+            for (auto s : c)
+                m &= s[w];
+            for (auto s : t)
+                s[w] ^= m;
+        }
+    }
+
+    void apply_swap(Word* a, Word* b, std::vector<Word*> const& c){
+        for (unsigned w = 0; w < words_; ++w){
+            Word m(true);
+            for (auto s : c)
+                m &= s[w];
+            Word d = (a[w] ^ b[w]) & m;
+            a[w] ^= d;
+            b[w] ^= d;
+        }
+    }
+
+    // y += x modulo 2^|y| in the patterns selected by cm; x(i, w) returns
+    // word w of bit i of the addend
+    template <class X>
+    void add(std::vector<Word*> const& y, X const& x, std::vector<Word> const& cm){
+        for (unsigned w = 0; w < words_; ++w){
+            Word carry;
+            for (unsigned i = 0; i < y.size(); ++i){
+                Word a = y[i][w], b = x(i, w);
+                Word s = a ^ b ^ carry;
+                carry = (a & b) | (carry & (a ^ b));
+                y[i][w] = (a & ~cm[w]) | (s & cm[w]);
+            }
+        }
+    }
+
+    unsigned patterns_, words_;
+    Map map_;
+    std::vector<Word> bits_; // words_ words per allocated bit
+};
+
+#endif
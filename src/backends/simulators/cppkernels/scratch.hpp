@@ -0,0 +1,127 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SCRATCH_HPP_
+#define SCRATCH_HPP_
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+// Pool of scratch vectors for the temporaries of the Simulator operations
+// (copies of the state, the Krylov basis of the time evolution, ...).
+// Buffers are handed out in leases which give them back when they go out of
+// scope, so repeated calls reuse memory which is already mapped instead of
+// allocating (and page-faulting) fresh state vectors every time. The total
+// size of all buffers is limited by a budget in bytes: a request which does
+// not fit throws before anything is allocated.
+template <class V>
+class ScratchArena{
+public:
+    // buffers of the same size; their contents are unspecified
+    class Lease{
+    public:
+        Lease(ScratchArena& arena, std::vector<V> buffers)
+            : arena_(&arena), buffers_(std::move(buffers)) {}
+
+        Lease(Lease&& other) : arena_(other.arena_), buffers_(std::move(other.buffers_)) {
+            other.buffers_.clear();
+        }
+
+        Lease(Lease const&) = delete;
+        Lease& operator=(Lease const&) = delete;
+
+        ~Lease(){
+            for (auto& buffer : buffers_)
+                arena_->idle_.push_back(std::move(buffer));
+        }
+
+        V& operator[](std::size_t i){ return buffers_[i]; }
+        V& operator*(){ return buffers_[0]; }
+        std::vector<V>& buffers(){ return buffers_; }
+
+    private:
+        ScratchArena* arena_;
+        std::vector<V> buffers_;
+    };
+
+    ScratchArena() : budget_(std::numeric_limits<std::size_t>::max()), held_(0) {}
+
+    // count buffers of size elements each; what names the operation in the
+    // error message
+    Lease acquire(std::size_t size, std::size_t count, char const* what){
+        std::vector<V> buffers;
+        for (auto it = idle_.begin(); it != idle_.end() && buffers.size() < count;){
+            if (it->size() == size){
+                buffers.push_back(std::move(*it));
+                it = idle_.erase(it);
+            }
+            else
+                ++it;
+        }
+        std::size_t missing = (count - buffers.size()) * bytes(size), idle = 0;
+        for (auto const& buffer : idle_)
+            idle += bytes(buffer.size());
+        if (held_ - idle + missing > budget_){
+            for (auto& buffer : buffers)
+                idle_.push_back(std::move(buffer));
+            throw(std::runtime_error(std::string(what) + ": Needs " + std::to_string(count * bytes(size))
+                + " bytes of scratch memory, which exceeds the scratch budget of "
+                + std::to_string(budget_) + " bytes."));
+        }
+        // idle buffers of other sizes make room for the new ones
+        while (held_ + missing > budget_){
+            held_ -= bytes(idle_.back().size());
+            idle_.pop_back();
+        }
+        while (buffers.size() < count)
+            buffers.emplace_back(size);
+        held_ += missing;
+        return Lease(*this, std::move(buffers));
+    }
+
+    // frees idle buffers until all buffers fit into budget bytes
+    void set_budget(std::size_t budget){
+        budget_ = budget;
+        while (held_ > budget_ && !idle_.empty()){
+            held_ -= bytes(idle_.back().size());
+            idle_.pop_back();
+        }
+    }
+
+    std::size_t get_budget() const { return budget_; }
+
+    // bytes held in buffers, leased or idle
+    std::size_t held() const { return held_; }
+
+    // frees all idle buffers
+    void release(){
+        for (auto const& buffer : idle_)
+            held_ -= bytes(buffer.size());
+        idle_.clear();
+    }
+
+private:
+    static std::size_t bytes(std::size_t size){
+        return size * sizeof(typename V::value_type);
+    }
+
+    std::size_t budget_, held_;
+    std::vector<V> idle_;
+};
+
+#endif
@@ -25,13 +25,34 @@
 #endif
 
 #include "intrin/alignedallocator.hpp"
+#include "intrin/cachesize.hpp"
+#include "split/kernels.hpp"
+#include "split/layout.hpp"
+#include "realkernels.hpp"
+#include "kernelk.hpp"
 #include "fusion.hpp"
+#include "fusionplanner.hpp"
+#include "mathops.hpp"
+#include "pauli.hpp"
+#include "observable.hpp"
+#include "krylov.hpp"
+#include "registerbits.hpp"
+#include "qft.hpp"
+#include "uniformlycontrolled.hpp"
+#include "phaseoracle.hpp"
+#include "adjoint.hpp"
+#include "scratch.hpp"
 #include <map>
 #include <cassert>
 #include <algorithm>
 #include <tuple>
 #include <random>
 #include <functional>
+#include <stdexcept>
+#include <chrono>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 class Simulator{
@@ -44,15 +65,38 @@ public:
     using Term = std::vector<std::pair<unsigned, char>>;
     using TermsDict = std::vector<std::pair<Term, calc_type>>;
     using ComplexTermsDict = std::vector<std::pair<Term, complex_type>>;
+    using QuRegs = std::vector<std::vector<unsigned>>;
+    using MathTable = std::vector<std::size_t>;
+
+    // real or imaginary plane of the split layout, a view into the buffer of
+    // vec_ (see split/layout.hpp)
+    struct Plane{
+        calc_type* p;
+        std::size_t n;
+        calc_type& operator[](std::size_t i) const { return p[i]; }
+        std::size_t size() const { return n; }
+        calc_type* data() const { return p; }
+    };
+
+    // Memory layout of the state: interleaved complex amplitudes, or separate
+    // real and imaginary planes for the fused gates (split/kernels.hpp).
+    // With SPLIT, the state is converted to the planes (in place, within the
+    // buffer of vec_) when a fused gate is applied and stays there for
+    // measurements and probabilities; all other operations convert it back
+    // first. Every conversion streams over the state about twice.
+    enum Layout{ INTERLEAVED, SPLIT };
 
-    Simulator(unsigned seed = 1) : N_(0), vec_(1,0.), fusion_qubits_min_(4),
-                                   fusion_qubits_max_(5), rnd_eng_(seed) {
+    Simulator(unsigned seed = 1, Layout layout = INTERLEAVED)
+        : N_(0), vec_(1,0.), layout_(layout), split_(false), re_{nullptr, 0}, im_{nullptr, 0},
+          fusion_qubits_min_(4), fusion_qubits_max_(5), fusion_window_(32), krylov_dim_(10),
+          prefetch_threshold_(prefetch_threshold()), rnd_eng_(seed) {
         vec_[0]=1.; // all-zero initial state
         std::uniform_real_distribution<double> dist(0., 1.);
         rng_ = std::bind(dist, std::ref(rnd_eng_));
     }
 
     void allocate_qubit(unsigned id){
+        to_interleaved();
         if (map_.count(id) == 0){
             map_[id] = N_++;
             auto newvec = StateVector(1UL << N_);
@@ -67,7 +111,7 @@ public:
     }
 
     bool get_classical_value(unsigned id, calc_type tol = 1.e-12){
-        run();
+        flush();
         unsigned pos = map_[id];
         std::size_t delta = (1UL << pos);
 
@@ -84,7 +128,7 @@ public:
     }
 
     bool is_classical(unsigned id, calc_type tol = 1.e-12){
-        run();
+        flush();
         unsigned pos = map_[id];
         std::size_t delta = (1UL << pos);
 
@@ -101,7 +145,7 @@ public:
     }
 
     void collapse_vector(unsigned id, bool value = false, bool shrink = false){
-        run();
+        flush();
         unsigned pos = map_[id];
         std::size_t delta = (1UL << pos);
 
@@ -141,8 +185,16 @@ public:
 
         // pick entry at random with probability |entry|^2
         std::size_t pick = 0;
-        while (P < rnd && pick < vec_.size())
-            P += std::norm(vec_[pick++]);
+        if (split_){
+            while (P < rnd && pick < re_.size()){
+                P += re_[pick] * re_[pick] + im_[pick] * im_[pick];
+                ++pick;
+            }
+        }
+        else{
+            while (P < rnd && pick < vec_.size())
+                P += std::norm(vec_[pick++]);
+        }
 
         pick--;
         // determine result vector (boolean values for each qubit)
@@ -156,20 +208,8 @@ public:
             mask |= (1UL << positions[i]);
             val |= (static_cast<std::size_t>(r&1) << positions[i]);
         }
-        // set bad entries to 0
-        calc_type N = 0.;
-        #pragma omp parallel for reduction(+:N) schedule(static)
-        for (std::size_t i = 0; i < vec_.size(); ++i){
-            if ((i & mask) != val)
-                vec_[i] = 0.;
-            else
-                N += std::norm(vec_[i]);
-        }
-        // re-normalize
-        N = 1./std::sqrt(N);
-        #pragma omp parallel for schedule(static)
-        for (std::size_t i = 0; i < vec_.size(); ++i)
-            vec_[i] *= N;
+        // set bad entries to 0 and re-normalize
+        project(mask, val, 1./std::sqrt(get_weight(mask, val)));
     }
 
     std::vector<bool> measure_qubits_return(std::vector<unsigned> const& ids){
@@ -179,7 +219,7 @@ public:
     }
 
     void deallocate_qubit(unsigned id){
-        run();
+        flush();
         assert(map_.count(id) == 1);
         if (!is_classical(id))
             throw(std::runtime_error("Error: Qubit has not been measured / uncomputed! There is most likely a bug in your code."));
@@ -191,34 +231,38 @@ public:
     template <class M>
     void apply_controlled_gate(M const& m, std::vector<unsigned> ids,
                                std::vector<unsigned> ctrl){
-        auto fused_gates = fused_gates_;
-        fused_gates.insert(m, ids, ctrl);
-
-        if (fused_gates.num_qubits() >= fusion_qubits_min_
-                && fused_gates.num_qubits() <= fusion_qubits_max_){
-            fused_gates_ = fused_gates;
-            run();
-        }
-        else if (fused_gates.num_qubits() > fusion_qubits_max_
-                 || (fused_gates.num_qubits() - ids.size()) > fused_gates_.num_qubits()){
-            run();
-            fused_gates_.insert(m, ids, ctrl);
-        }
-        else
-            fused_gates_ = fused_gates;
+        if (ids.size() > kernel_max_qubits)
+            throw(std::runtime_error("apply_controlled_gate(): Gates act on at most 10 qubits."));
+        planner_.insert(m, ids, ctrl);
+        // once the window is full, apply the blocks which are wide enough;
+        // the narrow ones stay queued to absorb the gates which follow
+        if (planner_.size() >= fusion_window_)
+            apply_blocks(planner_.take(fusion_qubits_max_, fusion_qubits_min_));
     }
 
     template <class F, class QuReg>
     void emulate_math(F const& f, QuReg quregs, std::vector<unsigned> ctrl,
                       unsigned num_threads=1){
-        run();
+        flush();
+        unsigned nbits = 0;
+        for (auto const& qr : quregs)
+            nbits += qr.size();
+        // f only depends on the register values: if there are fewer of them
+        // than amplitudes, call f once per value and permute natively
+        if (nbits < N_){
+            emulate_math_table(tabulate_math(f, quregs), quregs, ctrl);
+            return;
+        }
+
         auto ctrlmask = get_control_mask(ctrl);
 
         for (unsigned i = 0; i < quregs.size(); ++i)
             for (unsigned j = 0; j < quregs[i].size(); ++j)
                 quregs[i][j] = map_[quregs[i][j]];
 
-        StateVector newvec(vec_.size(), 0.);
+        auto scratch = scratch_.acquire(vec_.size(), 1, "emulate_math()");
+        auto& newvec = *scratch;
+        zero_state(newvec);
         std::vector<int> res(quregs.size());
 
         #pragma omp parallel for schedule(static) firstprivate(res) num_threads(num_threads)
@@ -242,13 +286,93 @@ public:
             else
                 newvec[i] += vec_[i];
         }
-        vec_ = std::move(newvec);
+        std::swap(vec_, newvec);
+    }
+
+    // evaluates f once for every value of the concatenated registers (register
+    // 0 in the lowest bits); entry k holds the packed output for input k
+    template <class F, class QuReg>
+    MathTable tabulate_math(F const& f, QuReg const& quregs){
+        unsigned nbits = 0;
+        for (auto const& qr : quregs)
+            nbits += qr.size();
+
+        MathTable table(1UL << nbits);
+        std::vector<int> res(quregs.size());
+        for (std::size_t k = 0; k < table.size(); ++k){
+            unsigned offset = 0;
+            for (unsigned qr_i = 0; qr_i < quregs.size(); ++qr_i){
+                res[qr_i] = (k >> offset) & ((1UL << quregs[qr_i].size()) - 1);
+                offset += quregs[qr_i].size();
+            }
+            f(res);
+            std::size_t out = 0;
+            offset = 0;
+            for (unsigned qr_i = 0; qr_i < quregs.size(); ++qr_i){
+                out |= (static_cast<std::size_t>(res[qr_i]) & ((1UL << quregs[qr_i].size()) - 1)) << offset;
+                offset += quregs[qr_i].size();
+            }
+            table[k] = out;
+        }
+        return table;
+    }
+
+    // applies the classical function given by a table (see tabulate_math) to
+    // all basis states which satisfy the control mask
+    template <class QuReg>
+    void emulate_math_table(MathTable const& table, QuReg quregs,
+                            std::vector<unsigned> const& ctrl){
+        flush();
+        std::vector<unsigned> pos;
+        for (auto const& qr : quregs)
+            for (auto id : qr)
+                pos.push_back(map_[id]);
+        if (table.size() != (1UL << pos.size()))
+            throw(std::runtime_error("emulate_math_table(): Table size does not match the quantum registers."));
+        auto ctrlmask = get_control_mask(ctrl);
+
+        // reversible functions only permute the basis states and can be
+        // applied without a second state vector
+        if (permute_in_place(table, pos, ctrlmask))
+            return;
+
+        auto scratch = scratch_.acquire(vec_.size(), 1, "emulate_math_table()");
+        auto& newvec = *scratch;
+        zero_state(newvec);
+
+        #pragma omp parallel for schedule(static)
+        for (std::size_t i = 0; i < vec_.size(); ++i){
+            if ((ctrlmask&i) == ctrlmask){
+                std::size_t in = 0;
+                for (unsigned b = 0; b < pos.size(); ++b)
+                    in |= ((i >> pos[b])&1UL) << b;
+                auto out = table[in];
+                auto new_i = i;
+                for (unsigned b = 0; b < pos.size(); ++b)
+                    new_i = (new_i & ~(1UL << pos[b])) | (((out >> b)&1UL) << pos[b]);
+                newvec[new_i] += vec_[i];
+            }
+            else
+                newvec[i] += vec_[i];
+        }
+        std::swap(vec_, newvec);
+    }
+
+    // same as emulate_math, but the function is one of the native math
+    // operations and may therefore be evaluated on all threads
+    void emulate_math_operation(MathOperation const& op, QuRegs const& quregs,
+                                std::vector<unsigned> const& ctrl){
+        if (quregs.size() != 1)
+            throw(std::runtime_error("emulate_math_operation(): The operation acts on a single quantum register."));
+        emulate_math(op, quregs, ctrl, max_threads());
     }
 
     calc_type get_expectation_value(TermsDict const& td, std::vector<unsigned> const& ids){
-        run();
+        flush();
         calc_type expectation = 0.;
-        auto current_state = vec_;
+        auto scratch = scratch_.acquire(vec_.size(), 1, "get_expectation_value()");
+        auto& current_state = *scratch;
+        copy_state(vec_, current_state);
         for (auto const& term : td){
             auto const& coefficient = term.second;
             apply_term(term.first, ids, {});
@@ -262,15 +386,54 @@ public:
                 delta += a1 * a2 - b1 * b2;
             }
             expectation += coefficient * delta;
-            vec_ = current_state;
+            copy_state(current_state, vec_);
         }
         return expectation;
     }
 
+    // <H> for an operator prepared with Observable, whose register
+    // positions are the qubits ids
+    calc_type get_expectation_value(Observable& observable, std::vector<unsigned> const& ids){
+        if (ids.size() < observable.num_qubits())
+            throw(std::runtime_error("get_expectation_value(): The observable acts on more qubits than contained in the qureg."));
+        std::vector<unsigned> bits(observable.num_qubits());
+        for (unsigned k = 0; k < bits.size(); ++k){
+            auto it = map_.find(ids[k]);
+            if (it == map_.end())
+                throw(std::runtime_error("get_expectation_value(): Unknown qubit id(s). Try calling eng.flush() before invoking this function."));
+            bits[k] = it->second;
+        }
+        flush();
+        return std::real(observable.locate(bits).expectation(vec_));
+    }
+
+    // <H> after applying the parametrized circuit to the current state, and
+    // its derivatives with respect to params by adjoint differentiation (see
+    // adjoint.hpp). The state of the simulator is not changed.
+    calc_type get_expectation_gradient(std::vector<CircuitGate> const& circuit,
+                                       std::vector<calc_type> const& params,
+                                       TermsDict const& td, std::vector<unsigned> const& ids,
+                                       std::vector<calc_type>& gradient){
+        flush();
+        std::vector<LocatedGate> gates;
+        gates.reserve(circuit.size());
+        for (auto const& gate : circuit)
+            gates.push_back(locate_gate(gate, params.size()));
+        PauliSum H;
+        for (auto const& term : td)
+            H.add(get_pauli_string(term.first, ids), term.second);
+        auto scratch = scratch_.acquire(vec_.size(), 2, "get_expectation_gradient()");
+        copy_state(vec_, scratch[0]);
+        return adjoint_gradient(scratch[0], scratch[1], gates, params, H, gradient, prefetch_state());
+    }
+
     void apply_qubit_operator(ComplexTermsDict const& td, std::vector<unsigned> const& ids){
-        run();
-        auto new_state = StateVector(vec_.size(), 0.);
-        auto current_state = vec_;
+        flush();
+        auto scratch = scratch_.acquire(vec_.size(), 2, "apply_qubit_operator()");
+        auto& new_state = scratch[0];
+        auto& current_state = scratch[1];
+        zero_state(new_state);
+        copy_state(vec_, current_state);
         for (auto const& term : td){
             auto const& coefficient = term.second;
             apply_term(term.first, ids, {});
@@ -280,7 +443,7 @@ public:
                 vec_[i] = current_state[i];
             }
         }
-        vec_ = std::move(new_state);
+        std::swap(vec_, new_state);
     }
 
     calc_type get_probability(std::vector<bool> const& bit_string,
@@ -293,17 +456,12 @@ public:
             mask |= 1UL << map_[ids[i]];
             bit_str |= (bit_string[i]?1UL:0UL) << map_[ids[i]];
         }
-        calc_type probability = 0.;
-        #pragma omp parallel for reduction(+:probability) schedule(static)
-        for (std::size_t i = 0; i < vec_.size(); ++i)
-            if ((i & mask) == bit_str)
-                probability += std::norm(vec_[i]);
-        return probability;
+        return get_weight(mask, bit_str);
     }
 
     complex_type const& get_amplitude(std::vector<bool> const& bit_string,
                                       std::vector<unsigned> const& ids){
-        run();
+        flush();
         std::size_t chk = 0;
         std::size_t index = 0;
         for (unsigned i = 0; i < ids.size(); ++i){
@@ -317,62 +475,78 @@ public:
         return vec_[index];
     }
 
+    // exp(-i time H) on the qubits ids (controlled on ctrl), computed with
+    // the Lanczos propagator from krylov.hpp
     void emulate_time_evolution(TermsDict const& tdict, calc_type const& time,
                                 std::vector<unsigned> const& ids,
                                 std::vector<unsigned> const& ctrl){
-        run();
+        flush();
         complex_type I(0., 1.);
-        calc_type tr = 0., op_nrm = 0.;
-        TermsDict td;
-        for (unsigned i = 0; i < tdict.size(); ++i){
-            if (tdict[i].first.size() == 0)
-                tr += tdict[i].second;
-            else{
-                td.push_back(tdict[i]);
-                op_nrm += std::abs(tdict[i].second);
-            }
+        calc_type tr = 0.;
+        PauliSum H;
+        for (auto const& term : tdict){
+            if (term.first.size() == 0)
+                tr += term.second;
+            else
+                H.add(get_pauli_string(term.first, ids), term.second);
         }
-        unsigned s = std::abs(time) * op_nrm + 1.;
-        complex_type correction = std::exp(-time * I * tr / (double)s);
-        auto output_state = vec_;
         auto ctrlmask = get_control_mask(ctrl);
-        for (unsigned i = 0; i < s; ++i){
-            calc_type nrm_change = 1.;
-            for (unsigned k = 0; nrm_change > 1.e-12; ++k){
-                auto coeff = (-time * I) / double(s * (k + 1));
-                auto current_state = vec_;
-                auto update = StateVector(vec_.size(), 0.);
-                for (auto const& tup : td){
-                    apply_term(tup.first, ids, {});
-                    #pragma omp parallel for schedule(static)
-                    for (std::size_t j = 0; j < vec_.size(); ++j){
-                        update[j] += vec_[j] * tup.second;
-                        vec_[j] = current_state[j];
-                    }
-                }
-                nrm_change = 0.;
-                #pragma omp parallel for reduction(+:nrm_change) schedule(static)
-                for (std::size_t j = 0; j < vec_.size(); ++j){
-                    update[j] *= coeff;
-                    vec_[j] = update[j];
-                    if ((j & ctrlmask) == ctrlmask){
-                        output_state[j] += update[j];
-                        nrm_change += std::norm(update[j]);
-                    }
-                }
-                nrm_change = std::sqrt(nrm_change);
-            }
-            #pragma omp parallel for schedule(static)
-            for (std::size_t j = 0; j < vec_.size(); ++j){
-                if ((j & ctrlmask) == ctrlmask)
-                    output_state[j] *= correction;
-                vec_[j] = output_state[j];
-            }
+        if (H.size() > 0){
+            // all m + 1 basis vectors, or 3 of them if the scratch budget
+            // does not hold more (see Lanczos)
+            std::size_t fit = scratch_.get_budget() / (vec_.size() * sizeof(complex_type));
+            auto basis = scratch_.acquire(vec_.size(), fit > krylov_dim_ ? krylov_dim_ + 1 : 3,
+                                          "emulate_time_evolution()");
+            Lanczos<StateVector> lanczos(basis.buffers(), krylov_dim_);
+            lanczos.evolve([&](StateVector const& in, StateVector& out){
+                H.apply(in, out, ctrlmask);
+            }, vec_, time);
+        }
+        complex_type correction = std::exp(-time * I * tr);
+        #pragma omp parallel for schedule(static)
+        for (std::size_t j = 0; j < vec_.size(); ++j){
+            if ((j & ctrlmask) == ctrlmask)
+                vec_[j] *= correction;
         }
     }
 
+    // exp(-i theta P) for the Pauli string P given by term (acting on ids)
+    void apply_pauli_rotation(Term const& term, calc_type theta,
+                              std::vector<unsigned> const& ids,
+                              std::vector<unsigned> const& ctrl){
+        flush();
+        ::apply_pauli_rotation(vec_, get_pauli_string(term, ids), theta, get_control_mask(ctrl));
+    }
+
+    // (inverse) QFT of the register ids in a few passes instead of its
+    // ~n^2/2 H and controlled R gates, see qft.hpp
+    void apply_qft(std::vector<unsigned> const& ids, std::vector<unsigned> const& ctrl,
+                   bool inverse = false){
+        flush();
+        if (!check_ids(ids) || !check_ids(ctrl))
+            throw(std::runtime_error("apply_qft(): Unknown qubit id. Please make sure all qubits have been allocated previously (call eng.flush())."));
+        std::vector<unsigned> locs;
+        for (auto id : ids)
+            locs.push_back(map_[id]);
+        ::apply_qft(vec_, locs, inverse, get_control_mask(ctrl));
+    }
+
+    // Ry / Rz (axis 'Y' / 'Z') by angles[k] on target if the qubits ids are
+    // in state k, see uniformlycontrolled.hpp
+    void apply_uniformly_controlled_rotation(char axis, std::vector<calc_type> const& angles,
+                                             std::vector<unsigned> const& ids, unsigned target,
+                                             std::vector<unsigned> const& ctrl){
+        flush();
+        if (!check_ids(ids) || !check_ids({target}) || !check_ids(ctrl))
+            throw(std::runtime_error("apply_uniformly_controlled_rotation(): Unknown qubit id. Please make sure all qubits have been allocated previously (call eng.flush())."));
+        std::vector<unsigned> locs;
+        for (auto id : ids)
+            locs.push_back(map_[id]);
+        ::apply_uniformly_controlled_rotation(vec_, axis, angles, locs, map_[target], get_control_mask(ctrl));
+    }
+
     void set_wavefunction(StateVector const& wavefunction, std::vector<unsigned> const& ordering){
-        run();
+        flush();
         // make sure there are 2^n amplitudes for n qubits
         assert(wavefunction.size() == (1UL << ordering.size()));
         // check that all qubits have been allocated previously
@@ -387,6 +561,65 @@ public:
             vec_[i] = wavefunction[i];
     }
 
+    // Flips the sign of the basis states in which the register ids has a
+    // value marked in the bitmap, see phaseoracle.hpp
+    void apply_phase_oracle(std::vector<unsigned> const& ids, PhaseOracleBitmap const& bitmap,
+                            std::vector<unsigned> const& ctrl){
+        flush();
+        if (ids.empty() || !check_ids(ids) || !check_ids(ctrl))
+            throw(std::runtime_error("apply_phase_oracle(): Unknown qubit id(s) provided. Try calling eng.flush() before invoking this function."));
+        std::vector<unsigned> locs;
+        for (auto id : ids)
+            locs.push_back(map_[id]);
+        ::apply_phase_oracle(vec_, locs, bitmap, get_control_mask(ctrl));
+    }
+
+    // Prepares the qubits ids, which must be in |0...0>, in the state with the
+    // given amplitudes (ids[0] least significant), i.e. psi <- rest (x)
+    // amplitudes, without decomposing StatePreparation into rotations.
+    void prepare_state(std::vector<unsigned> const& ids, StateVector const& amplitudes){
+        flush();
+        if (!check_ids(ids))
+            throw(std::runtime_error("prepare_state(): Unknown qubit id(s) provided. Try calling eng.flush() before invoking this function."));
+        if (amplitudes.size() != (1UL << ids.size()))
+            throw(std::runtime_error("prepare_state(): Expected 2^#qubits amplitudes."));
+        std::vector<unsigned> locs;
+        std::size_t mask = 0;
+        for (auto id : ids){
+            if ((mask >> map_[id]) & 1UL)
+                throw(std::runtime_error("prepare_state(): Qubit ids must be unique."));
+            locs.push_back(map_[id]);
+            mask |= 1UL << map_[id];
+        }
+        calc_type norm = 0.;
+        for (auto const& a : amplitudes)
+            norm += std::norm(a);
+        if (std::abs(norm - 1.) > 1.e-10)
+            throw(std::runtime_error("prepare_state(): The amplitudes must be normalized."));
+
+        calc_type excited = 0.;
+        #pragma omp parallel for reduction(+:excited) schedule(static)
+        for (std::size_t i = 0; i < vec_.size(); ++i)
+            if (i & mask)
+                excited += std::norm(vec_[i]);
+        if (excited > 1.e-12)
+            throw(std::runtime_error("prepare_state(): The qubits must be in state |0...0>."));
+
+        RegisterBits reg(locs);
+        // every amplitude i with nonzero register value x is psi[i & ~mask] * a[x];
+        // psi[i & ~mask] itself is only scaled once they have all been written
+        #pragma omp parallel for schedule(static)
+        for (std::size_t i = 0; i < vec_.size(); ++i){
+            if (!(i & mask))
+                continue;
+            vec_[i] = vec_[i & ~mask] * amplitudes[reg.value(i)];
+        }
+        #pragma omp parallel for schedule(static)
+        for (std::size_t i = 0; i < vec_.size(); ++i)
+            if (!(i & mask))
+                vec_[i] *= amplitudes[0];
+    }
+
     void collapse_wavefunction(std::vector<unsigned> const& ids, std::vector<bool> const& values){
         run();
         assert(ids.size() == values.size());
@@ -397,75 +630,516 @@ public:
             mask |= (1UL << map_[ids[i]]);
             val |= ((values[i]?1UL:0UL) << map_[ids[i]]);
         }
-        // set bad entries to 0 and compute probability of outcome to renormalize
-        calc_type N = 0.;
-        #pragma omp parallel for reduction(+:N) schedule(static)
-        for (std::size_t i = 0; i < vec_.size(); ++i){
-            if ((i & mask) == val)
-                N += std::norm(vec_[i]);
-        }
+        // compute probability of outcome to renormalize
+        calc_type N = get_weight(mask, val);
         if (N < 1.e-12)
             throw(std::runtime_error("collapse_wavefunction(): Invalid collapse! Probability is ~0."));
-        // re-normalize (if possible)
-        N = 1./std::sqrt(N);
-        #pragma omp parallel for schedule(static)
-        for (std::size_t i = 0; i < vec_.size(); ++i){
-            if ((i & mask) != val)
-                vec_[i] = 0.;
+        // set bad entries to 0 and re-normalize (if possible)
+        project(mask, val, 1./std::sqrt(N));
+    }
+
+    void run(){
+        apply_blocks(planner_.take(fusion_qubits_max_, 0));
+    }
+
+    // Replays a compiled circuit on the current state (or on |0...0> if
+    // reset is set) and returns the outcomes of its measurements in order.
+    // Only blocks whose angles changed are fused again.
+    std::vector<bool> apply_compiled(CompiledCircuit& circuit, std::vector<calc_type> const& params,
+                                     bool reset = false){
+        run();
+        circuit.update(params);
+        if (reset){
+            project(~std::size_t(0), 0, 0.);
+            if (split_)
+                re_[0] = 1.;
             else
-                vec_[i] *= N;
+                vec_[0] = 1.;
+        }
+        std::vector<bool> outcomes;
+        Fusion::IndexVector ids;
+        for (auto const& block : circuit.blocks()){
+            if (!check_ids(block.ids) || !check_ids(block.ctrls))
+                throw(std::runtime_error("apply_compiled(): Unknown qubit id(s) in the circuit. Try calling eng.flush() before invoking this function."));
+            if (block.measure){
+                auto res = measure_qubits_return(block.ids);
+                outcomes.insert(outcomes.end(), res.begin(), res.end());
+                continue;
+            }
+            ids.resize(block.ids.size());
+            for (std::size_t i = 0; i < ids.size(); ++i)
+                ids[i] = map_[block.ids[i]];
+            apply_fused_matrix(block.matrix, ids, get_control_mask(block.ctrls));
         }
+        return outcomes;
     }
 
-    void run(){
-        if (fused_gates_.size() < 1)
+    // Once the lookahead window is full, planned blocks are applied if they
+    // act on at least min qubits; gates are not fused beyond max qubits (at
+    // most kernel_max_qubits)
+    void set_fusion_limits(unsigned min, unsigned max){
+        check_fusion_limits(min, max);
+        run();
+        fusion_qubits_min_ = min;
+        fusion_qubits_max_ = max;
+    }
+
+    std::pair<unsigned, unsigned> get_fusion_limits() const{
+        return std::make_pair(fusion_qubits_min_, fusion_qubits_max_);
+    }
+
+    // largest scratch state of autotune_fusion(): 256 MiB (interleaved), past
+    // the last-level cache and the prefetch threshold of common hosts, so
+    // the kernels are timed streaming from memory like on large states
+    static const unsigned autotune_max_qubits = 24;
+
+    static void check_fusion_limits(unsigned min, unsigned max){
+        if (min < 1 || min > max || max > kernel_max_qubits)
+            throw(std::runtime_error("set_fusion_limits(): Expected 1 <= min <= max <= 10."));
+    }
+
+    // Times a fused gate of each width (best of two) on a scratch state of num_qubits
+    // qubits (in this simulator's layout) and sets the fusion limits to the
+    // width with the least time per qubit it covers, i.e. with the fewest
+    // sweeps over the state per gate. Widths are tried up to
+    // kernel_max_qubits, or until a width is more than twice as expensive
+    // per qubit as the best one so far. The timings become the fusion costs.
+    // The scratch state is leased from the scratch arena, so it counts
+    // against the scratch budget.
+    std::pair<unsigned, unsigned> autotune_fusion(unsigned num_qubits = 20){
+        if (num_qubits < kernel_max_qubits || num_qubits > autotune_max_qubits)
+            throw(std::runtime_error("autotune_fusion(): Expected 10 to 24 qubits."));
+        auto state = scratch_.acquire(std::size_t(1) << num_qubits, 1, "autotune_fusion()");
+        calc_type amplitude = 1. / std::sqrt(static_cast<calc_type>(state[0].size()));
+        #pragma omp parallel for schedule(static)
+        for (std::size_t i = 0; i < state[0].size(); ++i)
+            state[0][i] = amplitude;
+        Simulator scratch(1, layout_);
+        scratch.N_ = num_qubits;
+        scratch.prefetch_threshold_ = prefetch_threshold_;
+        // the buffer goes back to the arena however the timing ends
+        struct Swap{
+            StateVector& a;
+            StateVector& b;
+            ~Swap(){ std::swap(a, b); }
+        } lend{scratch.vec_, state[0]};
+        std::swap(scratch.vec_, state[0]);
+        std::uniform_real_distribution<double> angle(0., 6.283185307179586);
+        double best = 0.;
+        unsigned width = 1, measured = 0;
+        FusionPlanner::Costs costs(kernel_max_qubits + 1, 0.);
+        for (unsigned k = 1; k <= kernel_max_qubits; ++k){
+            std::size_t D = std::size_t(1) << k;
+            Fusion::Matrix m(D, Fusion::Matrix::value_type(D));
+            for (auto& row : m)
+                for (auto& entry : row)
+                    entry = std::polar(1. / std::sqrt(static_cast<double>(D)), angle(scratch.rnd_eng_));
+            Fusion::IndexVector ids(k);
+            for (unsigned j = 0; j < k; ++j)
+                ids[j] = (j * num_qubits) / k;
+            scratch.apply_fused_matrix(m, ids, 0); // warm-up
+            double per_qubit = 0.;
+            for (unsigned rep = 0; rep < 2; ++rep){
+                auto start = std::chrono::steady_clock::now();
+                scratch.apply_fused_matrix(m, ids, 0);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                per_qubit = (rep == 0) ? elapsed.count() / k : std::min(per_qubit, elapsed.count() / k);
+            }
+            costs[k] = per_qubit * k;
+            measured = k;
+            if (k == 1 || per_qubit < best){
+                best = per_qubit;
+                width = k;
+            }
+            else if (per_qubit > 2. * best)
+                break;
+        }
+        // widths which were not timed cost at least twice the next narrower one
+        costs[0] = costs[1];
+        for (unsigned k = measured + 1; k <= kernel_max_qubits; ++k)
+            costs[k] = 2. * costs[k - 1];
+        set_fusion_limits(std::max(width, 2U) - 1, width);
+        set_fusion_costs(costs);
+        return get_fusion_limits();
+    }
+
+    // the cost of one sweep per fused width, which decides how far the
+    // planner fuses gates within the fusion limits (see FusionPlanner)
+    void set_fusion_costs(FusionPlanner::Costs const& costs){
+        if (costs.size() != kernel_max_qubits + 1)
+            throw(std::runtime_error("set_fusion_costs(): Expected a cost for every width up to 10."));
+        run();
+        planner_.set_costs(costs);
+    }
+
+    FusionPlanner::Costs const& get_fusion_costs() const{
+        return planner_.get_costs();
+    }
+
+    // Limits the scratch memory of the operations which need temporary state
+    // vectors (expectation values, qubit operators, time evolution, math
+    // emulation). The buffers are kept for later calls; operations which
+    // would exceed the budget throw before they start.
+    void set_scratch_budget(std::size_t bytes){
+        scratch_.set_budget(bytes);
+    }
+
+    std::size_t get_scratch_budget() const{
+        return scratch_.get_budget();
+    }
+
+    // frees the scratch buffers which are kept for later calls
+    void release_scratch(){
+        scratch_.release();
+    }
+
+    // Dimension m of the Krylov basis of emulate_time_evolution (10 by
+    // default). The propagator keeps m + 1 scratch state vectors, or only 3
+    // if the scratch budget does not hold m + 1 of them, at the price of
+    // twice the applications of the Hamiltonian. A smaller m needs shorter
+    // (and more) steps.
+    void set_krylov_dim(unsigned m){
+        check_krylov_dim(m);
+        krylov_dim_ = m;
+    }
+
+    unsigned get_krylov_dim() const{
+        return krylov_dim_;
+    }
+
+    static void check_krylov_dim(unsigned m){
+        if (m < min_krylov_dim || m > max_krylov_dim)
+            throw(std::runtime_error("set_krylov_dim(): Expected 6 <= m <= 64."));
+    }
+
+    // States of more than bytes are swept with software prefetches by the
+    // AVX kernels (see cachesize.hpp for the default)
+    void set_prefetch_threshold(std::size_t bytes){
+        prefetch_threshold_ = bytes;
+    }
+
+    std::size_t get_prefetch_threshold() const{
+        return prefetch_threshold_;
+    }
+
+    std::tuple<Map, StateVector&> cheat(){
+        flush();
+        return make_tuple(map_, std::ref(vec_));
+    }
+
+    ~Simulator(){
+    }
+
+private:
+    // applies the pending gates and moves the state to vec_ (for all
+    // operations without a version for the split layout)
+    void flush(){
+        run();
+        to_interleaved();
+    }
+
+    void to_interleaved(){
+        if (!split_)
             return;
+        planes_to_interleaved(reinterpret_cast<calc_type*>(vec_.data()), vec_.size());
+        re_ = im_ = Plane{nullptr, 0};
+        split_ = false;
+    }
+
+    void to_split(){
+        if (split_)
+            return;
+        auto data = reinterpret_cast<calc_type*>(vec_.data());
+        interleaved_to_planes(data, vec_.size());
+        re_ = Plane{data, vec_.size()};
+        im_ = Plane{data + vec_.size(), vec_.size()};
+        split_ = true;
+    }
+
+    // sum of |amplitude|^2 over the basis states i with (i & mask) == val
+    calc_type get_weight(std::size_t mask, std::size_t val){
+        calc_type N = 0.;
+        if (split_){
+            #pragma omp parallel for reduction(+:N) schedule(static)
+            for (std::size_t i = 0; i < re_.size(); ++i)
+                if ((i & mask) == val)
+                    N += re_[i] * re_[i] + im_[i] * im_[i];
+        }
+        else{
+            #pragma omp parallel for reduction(+:N) schedule(static)
+            for (std::size_t i = 0; i < vec_.size(); ++i)
+                if ((i & mask) == val)
+                    N += std::norm(vec_[i]);
+        }
+        return N;
+    }
 
-        Fusion::Matrix m;
-        Fusion::IndexVector ids, ctrls;
+    // sets the amplitudes of the basis states i with (i & mask) != val to 0
+    // and multiplies the others by factor
+    void project(std::size_t mask, std::size_t val, calc_type factor){
+        if (split_){
+            #pragma omp parallel for schedule(static)
+            for (std::size_t i = 0; i < re_.size(); ++i){
+                calc_type f = ((i & mask) == val) ? factor : 0.;
+                re_[i] *= f;
+                im_[i] *= f;
+            }
+        }
+        else{
+            #pragma omp parallel for schedule(static)
+            for (std::size_t i = 0; i < vec_.size(); ++i){
+                if ((i & mask) != val)
+                    vec_[i] = 0.;
+                else
+                    vec_[i] *= factor;
+            }
+        }
+    }
 
-        fused_gates_.perform_fusion(m, ids, ctrls);
+    static void zero_state(StateVector& v){
+        #pragma omp parallel for schedule(static)
+        for (std::size_t i = 0; i < v.size(); ++i)
+            v[i] = 0.;
+    }
+
+    static void copy_state(StateVector const& from, StateVector& to){
+        #pragma omp parallel for schedule(static)
+        for (std::size_t i = 0; i < from.size(); ++i)
+            to[i] = from[i];
+    }
 
-        for (auto& id : ids)
-            id = map_[id];
+    // fuses and applies the planned blocks in order
+    void apply_blocks(std::vector<Fusion> blocks){
+        for (auto& block : blocks){
+            if (block.size() < 1)
+                continue;
+            Fusion::Matrix m;
+            Fusion::IndexVector ids, ctrls;
+            block.perform_fusion(m, ids, ctrls);
+            for (auto& id : ids)
+                id = map_[id];
+            apply_fused_matrix(m, ids, get_control_mask(ctrls));
+        }
+    }
 
-        auto ctrlmask = get_control_mask(ctrls);
+    // whether the AVX kernels sweep the state with software prefetches
+    bool prefetch_state() const{
+        return vec_.size() * sizeof(complex_type) > prefetch_threshold_;
+    }
 
+    // applies the matrix m to the bit locations ids (at most kernel_max_qubits)
+    void apply_fused_matrix(Fusion::Matrix const& m, Fusion::IndexVector const& ids,
+                            std::size_t ctrlmask){
+        if (ids.size() > 5){
+            if (layout_ == SPLIT){
+                to_split();
+                kernel_k_split(re_, im_, ids, m, ctrlmask);
+            }
+            else
+                kernel_k(vec_, ids, m, ctrlmask);
+            return;
+        }
+        if (is_real_matrix(m)){
+            apply_real_matrix(m, ids, ctrlmask);
+            return;
+        }
+        if (layout_ == SPLIT){
+            apply_fused_matrix_split(m, ids, ctrlmask);
+            return;
+        }
+        bool prefetch = prefetch_state();
         switch (ids.size()){
             case 1:
                 #pragma omp parallel
-                kernel(vec_, ids[0], m, ctrlmask);
+                kernel(vec_, ids[0], m, ctrlmask, prefetch);
                 break;
             case 2:
                 #pragma omp parallel
-                kernel(vec_, ids[1], ids[0], m, ctrlmask);
+                kernel(vec_, ids[1], ids[0], m, ctrlmask, prefetch);
                 break;
             case 3:
                 #pragma omp parallel
-                kernel(vec_, ids[2], ids[1], ids[0], m, ctrlmask);
+                kernel(vec_, ids[2], ids[1], ids[0], m, ctrlmask, prefetch);
                 break;
             case 4:
                 #pragma omp parallel
-                kernel(vec_, ids[3], ids[2], ids[1], ids[0], m, ctrlmask);
+                kernel(vec_, ids[3], ids[2], ids[1], ids[0], m, ctrlmask, prefetch);
                 break;
             case 5:
                 #pragma omp parallel
-                kernel(vec_, ids[4], ids[3], ids[2], ids[1], ids[0], m, ctrlmask);
+                kernel(vec_, ids[4], ids[3], ids[2], ids[1], ids[0], m, ctrlmask, prefetch);
                 break;
         }
+    }
 
-        fused_gates_ = Fusion();
+    // real m (see realkernels.hpp): on both planes of the split layout, or on
+    // the interleaved state read as doubles
+    void apply_real_matrix(Fusion::Matrix const& m, Fusion::IndexVector const& ids,
+                           std::size_t ctrlmask){
+        if (layout_ == SPLIT){
+            to_split();
+            double* const planes[2] = {re_.data(), im_.data()};
+            apply_real_matrix(planes, re_.size(), m, ids, ctrlmask);
+        }
+        else{
+            double* const planes[1] = {reinterpret_cast<double*>(vec_.data())};
+            Fusion::IndexVector shifted(ids);
+            for (auto& id : shifted)
+                ++id;
+            apply_real_matrix(planes, 2 * vec_.size(), m, shifted, ctrlmask << 1);
+        }
     }
 
-    std::tuple<Map, StateVector&> cheat(){
-        run();
-        return make_tuple(map_, std::ref(vec_));
+    template <unsigned NP>
+    void apply_real_matrix(double* const (&planes)[NP], std::size_t size, Fusion::Matrix const& m,
+                           Fusion::IndexVector const& ids, std::size_t ctrlmask){
+        switch (ids.size()){
+            case 1:
+                #pragma omp parallel
+                kernel_real<1>(planes, size, ids.data(), m, ctrlmask);
+                break;
+            case 2:
+                #pragma omp parallel
+                kernel_real<2>(planes, size, ids.data(), m, ctrlmask);
+                break;
+            case 3:
+                #pragma omp parallel
+                kernel_real<3>(planes, size, ids.data(), m, ctrlmask);
+                break;
+            case 4:
+                #pragma omp parallel
+                kernel_real<4>(planes, size, ids.data(), m, ctrlmask);
+                break;
+            case 5:
+                #pragma omp parallel
+                kernel_real<5>(planes, size, ids.data(), m, ctrlmask);
+                break;
+        }
     }
 
-    ~Simulator(){
+    void apply_fused_matrix_split(Fusion::Matrix const& m, Fusion::IndexVector const& ids,
+                                  std::size_t ctrlmask){
+        to_split();
+        switch (ids.size()){
+            case 1:
+                #pragma omp parallel
+                kernel_split<1>(re_, im_, ids.data(), m, ctrlmask);
+                break;
+            case 2:
+                #pragma omp parallel
+                kernel_split<2>(re_, im_, ids.data(), m, ctrlmask);
+                break;
+            case 3:
+                #pragma omp parallel
+                kernel_split<3>(re_, im_, ids.data(), m, ctrlmask);
+                break;
+            case 4:
+                #pragma omp parallel
+                kernel_split<4>(re_, im_, ids.data(), m, ctrlmask);
+                break;
+            case 5:
+                #pragma omp parallel
+                kernel_split<5>(re_, im_, ids.data(), m, ctrlmask);
+                break;
+        }
+    }
+
+    static unsigned max_threads(){
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    // Applies the register permutation given by table (input -> output value
+    // of the registers at bit locations pos) by following its cycles, once
+    // for every setting of the remaining qubits. Returns false if the table
+    // is not a permutation, in which case nothing is done. Besides the table
+    // this needs two bits per table entry (the check and one mark per cycle)
+    // and two offset tables of 2^(#pos/2) entries, far less than the second
+    // state vector of the out-of-place pass. The cycles are distributed over
+    // the threads if there are fewer settings of the other qubits than threads.
+    bool permute_in_place(MathTable const& table, std::vector<unsigned> const& pos,
+                          std::size_t ctrlmask){
+        std::vector<bool> seen(table.size(), false);
+        for (auto out : table){
+            if (out >= table.size() || seen[out])
+                return false;
+            seen[out] = true;
+        }
+
+        // mark the smallest value of every cycle (without fixed points)
+        std::vector<bool> leader(table.size(), false);
+        std::fill(seen.begin(), seen.end(), false);
+        bool identity = true;
+        for (std::size_t v = 0; v < table.size(); ++v){
+            if (seen[v])
+                continue;
+            for (auto w = v; !seen[w]; w = table[w])
+                seen[w] = true;
+            if (table[v] != v){
+                leader[v] = true;
+                identity = false;
+            }
+        }
+        if (identity)
+            return true;
+
+        // bit locations of a register value, from its low and high half
+        unsigned half = pos.size() / 2;
+        std::vector<std::size_t> low(1UL << half, 0), high(1UL << (pos.size() - half), 0);
+        for (std::size_t v = 0; v < low.size(); ++v)
+            for (unsigned b = 0; b < half; ++b)
+                low[v] |= ((v >> b)&1UL) << pos[b];
+        for (std::size_t v = 0; v < high.size(); ++v)
+            for (unsigned b = half; b < pos.size(); ++b)
+                high[v] |= ((v >> (b - half))&1UL) << pos[b];
+        std::size_t lowmask = low.size() - 1;
+        auto offset = [&](std::size_t v){ return low[v & lowmask] | high[v >> half]; };
+
+        std::size_t fixedmask = ctrlmask;
+        for (auto p : pos)
+            fixedmask |= 1UL << p;
+        std::vector<unsigned> free;
+        for (unsigned p = 0; p < N_; ++p)
+            if (!((fixedmask >> p)&1UL))
+                free.push_back(p);
+        std::size_t nrest = 1UL << free.size();
+        auto rest = [&](std::size_t r){
+            std::size_t base = ctrlmask;
+            for (unsigned b = 0; b < free.size(); ++b)
+                base |= ((r >> b)&1UL) << free[b];
+            return base;
+        };
+        // new[table[v]] = old[v] along the cycle of v
+        auto rotate = [&](std::size_t base, std::size_t v){
+            auto carry = vec_[base | offset(v)];
+            for (auto w = table[v]; w != v; w = table[w])
+                std::swap(carry, vec_[base | offset(w)]);
+            vec_[base | offset(v)] = carry;
+        };
+
+        if (nrest >= max_threads()){
+            #pragma omp parallel for schedule(static)
+            for (std::size_t r = 0; r < nrest; ++r){
+                auto base = rest(r);
+                for (std::size_t v = 0; v < table.size(); ++v)
+                    if (leader[v])
+                        rotate(base, v);
+            }
+        }
+        else{
+            // cycles are disjoint; leader is only read
+            #pragma omp parallel for schedule(dynamic, 256)
+            for (std::size_t v = 0; v < table.size(); ++v)
+                if (leader[v])
+                    for (std::size_t r = 0; r < nrest; ++r)
+                        rotate(rest(r), v);
+        }
+        return true;
     }
 
-private:
     void apply_term(Term const& term, std::vector<unsigned> const& ids,
                     std::vector<unsigned> const& ctrl){
         complex_type I(0., 1.);
@@ -477,8 +1151,66 @@ private:
             unsigned id = ids[local_op.first];
             apply_controlled_gate(gates[local_op.second - 'X'], {id}, ctrl);
         }
-        run();
+        flush();
+    }
+    LocatedGate locate_gate(CircuitGate const& gate, std::size_t num_params){
+        gate.check(num_params);
+        if (gate.kind == CircuitGate::MEASURE)
+            throw(std::runtime_error("get_expectation_gradient(): Circuits with measurements cannot be differentiated."));
+        if (!check_ids(gate.ids) || !check_ids(gate.ctrl))
+            throw(std::runtime_error("get_expectation_gradient(): Unknown qubit id(s) provided. Try calling eng.flush() before invoking this function."));
+        LocatedGate g;
+        g.kind = gate.kind;
+        g.ctrlmask = get_control_mask(gate.ctrl);
+        g.phasemask = g.ctrlmask;
+        g.factor = 0.5;
+        g.param = gate.param;
+        g.scale = gate.scale;
+        switch (gate.kind){
+            case CircuitGate::MATRIX: {
+                for (auto id : gate.ids)
+                    g.locs.push_back(map_[id]);
+                g.matrix = gate.matrix;
+                g.inverse = gate.matrix;
+                for (std::size_t i = 0; i < g.matrix.size(); ++i)
+                    for (std::size_t j = 0; j < g.matrix.size(); ++j)
+                        g.inverse[i][j] = std::conj(gate.matrix[j][i]);
+                break;
+            }
+            case CircuitGate::RX:
+            case CircuitGate::RY:
+            case CircuitGate::RZ:
+                g.pauli = get_pauli_string({std::make_pair(0U, "XYZ"[gate.kind - CircuitGate::RX])}, gate.ids);
+                g.generator.add(g.pauli, 0.5);
+                break;
+            case CircuitGate::R:
+                // -|1><1| = (Z - 1)/2
+                g.phasemask |= 1UL << map_[gate.ids[0]];
+                g.generator.add(get_pauli_string({std::make_pair(0U, 'Z')}, gate.ids), 0.5);
+                g.generator.add(PauliString(), -0.5);
+                break;
+            case CircuitGate::PH:
+                g.generator.add(PauliString(), -1.);
+                break;
+            case CircuitGate::PAULI:
+                g.pauli = get_pauli_string(gate.term, gate.ids);
+                g.factor = 1.;
+                g.generator.add(g.pauli, 1.);
+                break;
+            default:
+                break;
+        }
+        return g;
+    }
+
+    // Pauli string of a term acting on ids, in bit locations of the state
+    PauliString get_pauli_string(Term const& term, std::vector<unsigned> const& ids){
+        Term located;
+        for (auto const& local_op : term)
+            located.push_back(std::make_pair(map_[ids[local_op.first]], local_op.second));
+        return PauliString(located);
     }
+
     std::size_t get_control_mask(std::vector<unsigned> const& ctrls){
         std::size_t ctrlmask = 0;
         for (auto c : ctrls)
@@ -495,9 +1227,16 @@ private:
 
     unsigned N_; // #qubits
     StateVector vec_;
+    Layout layout_;
+    bool split_; // the buffer of vec_ holds the planes re_, im_
+    Plane re_, im_;
     Map map_;
-    Fusion fused_gates_;
+    FusionPlanner planner_;
     unsigned fusion_qubits_min_, fusion_qubits_max_;
+    unsigned fusion_window_; // #gates the planner looks ahead
+    unsigned krylov_dim_; // max. Krylov basis size of emulate_time_evolution
+    std::size_t prefetch_threshold_; // state size in bytes
+    ScratchArena<StateVector> scratch_; // temporaries of the operations
     RndEngine rnd_eng_;
     std::function<double()> rng_;
 };
@@ -0,0 +1,1085 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SPARSE_HPP_
+#define SPARSE_HPP_
+
+#include "simulator.hpp"
+#include <cstdint>
+#include <memory>
+#include <limits>
+
+// Open-addressing (linear probing) hash table from basis index to amplitude.
+// The capacity is a power of two and kept at least twice the number of
+// entries. Slots can be visited by index, which allows parallel sweeps.
+class AmplitudeTable{
+public:
+    using Key = std::uint64_t;
+    using complex_type = std::complex<double>;
+
+    explicit AmplitudeTable(std::size_t expected = 0) : size_(0) {
+        rehash(capacity_for(expected));
+    }
+
+    std::size_t size() const { return size_; }
+    std::size_t capacity() const { return keys_.size(); }
+
+    bool occupied(std::size_t slot) const { return keys_[slot] != empty(); }
+    Key key(std::size_t slot) const { return keys_[slot]; }
+    complex_type& value(std::size_t slot){ return values_[slot]; }
+    complex_type const& value(std::size_t slot) const { return values_[slot]; }
+
+    complex_type const* find(Key k) const {
+        for (std::size_t s = slot(k);; s = (s + 1) & mask_){
+            if (keys_[s] == k)
+                return &values_[s];
+            if (keys_[s] == empty())
+                return nullptr;
+        }
+    }
+
+    // inserts a zero amplitude if k is not present yet
+    complex_type& operator[](Key k){
+        if (2 * (size_ + 1) > keys_.size())
+            rehash(2 * keys_.size());
+        std::size_t s = slot(k);
+        for (; keys_[s] != empty(); s = (s + 1) & mask_)
+            if (keys_[s] == k)
+                return values_[s];
+        keys_[s] = k;
+        values_[s] = 0.;
+        ++size_;
+        return values_[s];
+    }
+
+    // Inserts the entries (key, value) for which f(i, key, value) returns
+    // true, i < n, in parallel. The keys must be distinct and not present
+    // yet. The slots are split into one range per thread, the entries are
+    // sorted by the range of their home slot and every thread places those of
+    // its range; the few keys whose probe sequence would leave the range are
+    // placed afterwards.
+    template <class F>
+    void insert_distinct(std::size_t n, F const& f){
+        unsigned range_bits = 0;
+        while (range_bits < 7 && (2U << range_bits) <= max_threads())
+            ++range_bits;
+        unsigned parts = 1U << range_bits;
+        std::vector<unsigned> part(n);
+        // counts[r * parts + t]: entries of range r in chunk t of [0, n)
+        std::vector<std::size_t> counts(parts * parts + 1, 0);
+        #pragma omp parallel for schedule(static, 1) num_threads(parts)
+        for (unsigned t = 0; t < parts; ++t){
+            for (std::size_t i = n * t / parts; i < n * (t + 1) / parts; ++i){
+                Key k = 0;
+                complex_type v;
+                if (!f(i, k, v)){
+                    part[i] = skip();
+                    continue;
+                }
+                part[i] = range_bits ? static_cast<unsigned>(hash(k) >> (64 - range_bits)) : 0;
+                ++counts[part[i] * parts + t];
+            }
+        }
+        std::size_t count = 0;
+        for (auto& c : counts){
+            auto tmp = c;
+            c = count;
+            count += tmp;
+        }
+        if (2 * (size_ + count) > keys_.size())
+            rehash(capacity_for(size_ + count));
+        size_ += count;
+
+        if (parts == 1 || count < (std::size_t(1) << 16)){
+            for (std::size_t i = 0; i < n; ++i){
+                Key k = 0;
+                complex_type v;
+                if (part[i] != skip() && f(i, k, v))
+                    place(k, v);
+            }
+            return;
+        }
+
+        std::vector<std::size_t> order(count);
+        #pragma omp parallel for schedule(static, 1) num_threads(parts)
+        for (unsigned t = 0; t < parts; ++t){
+            std::vector<std::size_t> pos(parts);
+            for (unsigned r = 0; r < parts; ++r)
+                pos[r] = counts[r * parts + t];
+            for (std::size_t i = n * t / parts; i < n * (t + 1) / parts; ++i)
+                if (part[i] != skip())
+                    order[pos[part[i]]++] = i;
+        }
+
+        // the home slots of range r are the ones with the top range_bits bits r
+        unsigned range_shift = 64 - shift_ - range_bits;
+        std::vector<std::vector<std::size_t>> deferred(parts);
+        #pragma omp parallel for schedule(static, 1) num_threads(parts)
+        for (unsigned r = 0; r < parts; ++r){
+            std::size_t end = std::size_t(r + 1) << range_shift;
+            for (std::size_t j = counts[r * parts]; j < counts[(r + 1) * parts]; ++j){
+                Key k = 0;
+                complex_type v;
+                f(order[j], k, v);
+                std::size_t s = slot(k);
+                while (s < end && keys_[s] != empty())
+                    ++s;
+                if (s == end){
+                    deferred[r].push_back(order[j]);
+                    continue;
+                }
+                keys_[s] = k;
+                values_[s] = v;
+            }
+        }
+        for (auto const& d : deferred){
+            for (auto i : d){
+                Key k = 0;
+                complex_type v;
+                f(i, k, v);
+                place(k, v);
+            }
+        }
+    }
+
+private:
+    static Key empty(){ return ~Key(0); }
+    static unsigned skip(){ return ~0U; }
+
+    static unsigned max_threads(){
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    static std::size_t capacity_for(std::size_t n){
+        std::size_t cap = 16;
+        while (cap < 2 * n)
+            cap *= 2;
+        return cap;
+    }
+
+    // Fibonacci hashing, the high bits of the product are well mixed
+    static Key hash(Key k){
+        return k * 0x9E3779B97F4A7C15ULL;
+    }
+
+    std::size_t slot(Key k) const {
+        return static_cast<std::size_t>(hash(k) >> shift_);
+    }
+
+    // stores a key which is not present, the capacity must suffice
+    void place(Key k, complex_type const& v){
+        std::size_t s = slot(k);
+        while (keys_[s] != empty())
+            s = (s + 1) & mask_;
+        keys_[s] = k;
+        values_[s] = v;
+    }
+
+    void rehash(std::size_t cap){
+        std::vector<Key> keys(cap, empty());
+        std::vector<complex_type> values(cap);
+        std::swap(keys, keys_);
+        std::swap(values, values_);
+        mask_ = cap - 1;
+        shift_ = 64;
+        for (std::size_t c = cap; c > 1; c >>= 1)
+            --shift_;
+        for (std::size_t i = 0; i < keys.size(); ++i){
+            if (keys[i] == empty())
+                continue;
+            place(keys[i], values[i]);
+        }
+    }
+
+    std::vector<Key> keys_;
+    std::vector<complex_type> values_;
+    std::size_t size_, mask_;
+    unsigned shift_;
+};
+
+// State-vector simulator which only stores the nonzero amplitudes, for
+// circuits whose states stay in a small part of the 2^n basis (classical
+// reversible logic, oracles, structured superpositions). Supports up to 63
+// qubits and offers the same interface as Simulator.
+//
+// Once the number of nonzero amplitudes exceeds density_ * 2^n (and n is at
+// most max_dense_qubits_), the state is handed to a dense Simulator for
+// good. Expectation values, qubit operators, Pauli rotations and the other
+// structured operations work on the table; gradients and cheat() read a
+// dense copy, and time evolution runs on one, which is only kept if the
+// evolved state is dense. These need n <= max_dense_qubits_.
+class SparseSimulator{
+public:
+    using calc_type = Simulator::calc_type;
+    using complex_type = Simulator::complex_type;
+    using StateVector = Simulator::StateVector;
+    using Map = Simulator::Map;
+    using RndEngine = Simulator::RndEngine;
+    using Term = Simulator::Term;
+    using TermsDict = Simulator::TermsDict;
+    using ComplexTermsDict = Simulator::ComplexTermsDict;
+    using QuRegs = Simulator::QuRegs;
+    using MathTable = Simulator::MathTable;
+    using Key = AmplitudeTable::Key;
+
+    // layout is the one of the dense Simulator the state moves to
+    SparseSimulator(unsigned seed = 1, Simulator::Layout layout = Simulator::INTERLEAVED)
+        : N_(0), density_(1. / 16.), max_dense_qubits_(30), layout_(layout),
+          fusion_limits_(4, 5), fusion_costs_(FusionPlanner::default_costs()),
+          scratch_budget_(std::numeric_limits<std::size_t>::max()), krylov_dim_(10),
+          prefetch_threshold_(prefetch_threshold()), rnd_eng_(seed), prune_(1.e-28) {
+        table_[0] = 1.; // all-zero initial state
+        std::uniform_real_distribution<double> dist(0., 1.);
+        rng_ = std::bind(dist, std::ref(rnd_eng_));
+    }
+
+    void allocate_qubit(unsigned id){
+        if (dense_)
+            return dense_->allocate_qubit(id);
+        if (map_.count(id) != 0)
+            throw(std::runtime_error(
+                "AllocateQubit: ID already exists. Qubit IDs should be unique."));
+        if (N_ == 63)
+            throw(std::runtime_error("SparseSimulator: At most 63 qubits are supported."));
+        map_[id] = N_++; // the new bit is 0 in every stored basis state
+    }
+
+    bool get_classical_value(unsigned id, calc_type tol = 1.e-12){
+        if (dense_)
+            return dense_->get_classical_value(id, tol);
+        Key bit = Key(1) << map_[id];
+        for (std::size_t s = 0; s < table_.capacity(); ++s)
+            if (table_.occupied(s) && std::norm(table_.value(s)) > tol)
+                return (table_.key(s) & bit) != 0;
+        assert(false); // this will never happen
+        return false;
+    }
+
+    bool is_classical(unsigned id, calc_type tol = 1.e-12){
+        if (dense_)
+            return dense_->is_classical(id, tol);
+        Key bit = Key(1) << map_[id];
+        bool up = false, down = false;
+        for (std::size_t s = 0; s < table_.capacity(); ++s){
+            if (!table_.occupied(s) || std::norm(table_.value(s)) <= tol)
+                continue;
+            if (table_.key(s) & bit)
+                down = true;
+            else
+                up = true;
+        }
+        return up != down;
+    }
+
+    void measure_qubits(std::vector<unsigned> const& ids, std::vector<bool> &res){
+        if (dense_)
+            return dense_->measure_qubits(ids, res);
+        std::vector<unsigned> positions(ids.size());
+        for (unsigned i = 0; i < ids.size(); ++i)
+            positions[i] = map_[ids[i]];
+
+        // pick entry at random with probability |entry|^2
+        calc_type P = 0., rnd = rng_();
+        Key pick = 0;
+        for (std::size_t s = 0; s < table_.capacity() && P < rnd; ++s){
+            if (table_.occupied(s)){
+                P += std::norm(table_.value(s));
+                pick = table_.key(s);
+            }
+        }
+
+        res = std::vector<bool>(ids.size());
+        Key mask = 0, val = 0;
+        for (unsigned i = 0; i < ids.size(); ++i){
+            bool r = ((pick >> positions[i]) & 1) == 1;
+            res[i] = r;
+            mask |= Key(1) << positions[i];
+            val |= Key(r) << positions[i];
+        }
+        project(mask, val);
+    }
+
+    std::vector<bool> measure_qubits_return(std::vector<unsigned> const& ids){
+        std::vector<bool> ret;
+        measure_qubits(ids, ret);
+        return ret;
+    }
+
+    void deallocate_qubit(unsigned id){
+        if (dense_)
+            return dense_->deallocate_qubit(id);
+        assert(map_.count(id) == 1);
+        if (!is_classical(id))
+            throw(std::runtime_error("Error: Qubit has not been measured / uncomputed! There is most likely a bug in your code."));
+
+        // drop the bit of the qubit from every key
+        unsigned pos = map_[id];
+        Key low = (Key(1) << pos) - 1;
+        AmplitudeTable next(table_.size());
+        for (std::size_t s = 0; s < table_.capacity(); ++s){
+            if (!table_.occupied(s) || std::norm(table_.value(s)) <= prune_)
+                continue;
+            Key k = table_.key(s);
+            next[(k & low) | ((k >> 1) & ~low)] += table_.value(s);
+        }
+        table_ = std::move(next);
+        for (auto& p : map_)
+            if (p.second > pos)
+                p.second--;
+        map_.erase(id);
+        N_--;
+    }
+
+    template <class M>
+    void apply_controlled_gate(M const& m, std::vector<unsigned> ids,
+                               std::vector<unsigned> ctrl){
+        if (dense_)
+            return dense_->apply_controlled_gate(m, ids, ctrl);
+        unsigned k = ids.size();
+        std::size_t dim = std::size_t(1) << k;
+        std::vector<unsigned> pos(k);
+        for (unsigned i = 0; i < k; ++i)
+            pos[i] = map_[ids[i]];
+        std::vector<Key> offset(dim, 0);
+        for (std::size_t i = 0; i < dim; ++i)
+            for (unsigned j = 0; j < k; ++j)
+                offset[i] |= Key((i >> j) & 1) << pos[j];
+        apply_blocks(pos, offset, get_control_mask(ctrl),
+                     [&](Key, complex_type const* in, complex_type* out){
+            for (std::size_t r = 0; r < dim; ++r){
+                complex_type v = 0.;
+                for (std::size_t c = 0; c < dim; ++c)
+                    v += complex_type(m[r][c]) * in[c];
+                out[r] = v;
+            }
+        });
+        check_density();
+    }
+
+    // f is called once per stored basis state which satisfies the controls
+    template <class F, class QuReg>
+    void emulate_math(F const& f, QuReg quregs, std::vector<unsigned> ctrl,
+                      unsigned num_threads = 1){
+        if (dense_)
+            return dense_->emulate_math(f, quregs, ctrl, num_threads);
+        std::vector<std::vector<unsigned>> pos(quregs.size());
+        for (unsigned i = 0; i < quregs.size(); ++i)
+            for (auto id : quregs[i])
+                pos[i].push_back(map_[id]);
+        permute(pos, ctrl, [&](std::vector<int>& x){ f(x); });
+    }
+
+    template <class QuReg>
+    void emulate_math_table(MathTable const& table, QuReg quregs,
+                            std::vector<unsigned> const& ctrl){
+        if (dense_)
+            return dense_->emulate_math_table(table, quregs, ctrl);
+        std::vector<std::vector<unsigned>> pos(1);
+        for (auto const& qr : quregs)
+            for (auto id : qr)
+                pos[0].push_back(map_[id]);
+        if (table.size() != (std::size_t(1) << pos[0].size()))
+            throw(std::runtime_error("emulate_math_table(): Table size does not match the quantum registers."));
+        permute(pos, ctrl, [&](std::vector<int>& x){ x[0] = static_cast<int>(table[x[0]]); });
+    }
+
+    void emulate_math_operation(MathOperation const& op, QuRegs const& quregs,
+                                std::vector<unsigned> const& ctrl){
+        if (quregs.size() != 1)
+            throw(std::runtime_error("emulate_math_operation(): The operation acts on a single quantum register."));
+        emulate_math(op, quregs, ctrl);
+    }
+
+    calc_type get_expectation_value(TermsDict const& td, std::vector<unsigned> const& ids){
+        if (dense_)
+            return dense_->get_expectation_value(td, ids);
+        if (!check_ids(ids))
+            throw(std::runtime_error("get_expectation_value(): Unknown qubit id(s). Try calling eng.flush() before invoking this function."));
+        PauliSum H;
+        for (auto const& term : td)
+            H.add(get_pauli_string(term.first, ids), term.second);
+        return std::real(expectation(H));
+    }
+
+    calc_type get_expectation_value(Observable& observable, std::vector<unsigned> const& ids){
+        if (dense_)
+            return dense_->get_expectation_value(observable, ids);
+        if (ids.size() < observable.num_qubits())
+            throw(std::runtime_error("get_expectation_value(): The observable acts on more qubits than contained in the qureg."));
+        std::vector<unsigned> bits(observable.num_qubits());
+        for (unsigned k = 0; k < bits.size(); ++k){
+            auto it = map_.find(ids[k]);
+            if (it == map_.end())
+                throw(std::runtime_error("get_expectation_value(): Unknown qubit id(s). Try calling eng.flush() before invoking this function."));
+            bits[k] = it->second;
+        }
+        return std::real(expectation(observable.locate(bits)));
+    }
+
+    // computed on a dense copy of the state, which is left sparse
+    calc_type get_expectation_gradient(std::vector<CircuitGate> const& circuit,
+                                       std::vector<calc_type> const& params,
+                                       TermsDict const& td, std::vector<unsigned> const& ids,
+                                       std::vector<calc_type>& gradient){
+        if (dense_)
+            return dense_->get_expectation_gradient(circuit, params, td, ids, gradient);
+        return make_dense()->get_expectation_gradient(circuit, params, td, ids, gradient);
+    }
+
+    // the blocks are applied like gates, i.e. the state only becomes dense
+    // if the circuit fills it in
+    std::vector<bool> apply_compiled(CompiledCircuit& circuit, std::vector<calc_type> const& params,
+                                     bool reset = false){
+        if (dense_)
+            return dense_->apply_compiled(circuit, params, reset);
+        circuit.update(params);
+        if (reset){
+            table_ = AmplitudeTable();
+            table_[0] = 1.;
+        }
+        std::vector<bool> outcomes;
+        for (auto const& block : circuit.blocks()){
+            std::vector<unsigned> ids(block.ids.begin(), block.ids.end());
+            std::vector<unsigned> ctrls(block.ctrls.begin(), block.ctrls.end());
+            if (!check_ids(ids) || !check_ids(ctrls))
+                throw(std::runtime_error("apply_compiled(): Unknown qubit id(s) in the circuit. Try calling eng.flush() before invoking this function."));
+            if (block.measure){
+                auto res = measure_qubits_return(ids);
+                outcomes.insert(outcomes.end(), res.begin(), res.end());
+            }
+            else
+                apply_controlled_gate(block.matrix, ids, ctrls);
+        }
+        return outcomes;
+    }
+
+    void apply_qubit_operator(ComplexTermsDict const& td, std::vector<unsigned> const& ids){
+        if (dense_)
+            return dense_->apply_qubit_operator(td, ids);
+        if (!check_ids(ids))
+            throw(std::runtime_error("apply_qubit_operator(): Unknown qubit id(s) provided. Try calling eng.flush() before invoking this function."));
+        AmplitudeTable sum(table_.size());
+        for (auto const& term : td){
+            auto p = get_pauli_string(term.first, ids);
+            for (std::size_t s = 0; s < table_.capacity(); ++s){
+                if (!table_.occupied(s))
+                    continue;
+                Key k = table_.key(s);
+                complex_type c = term.second * p.phase;
+                sum[k ^ p.xmask] += (parity(k & p.zmask) ? -c : c) * table_.value(s);
+            }
+        }
+        AmplitudeTable next(sum.size());
+        for (std::size_t s = 0; s < sum.capacity(); ++s)
+            if (sum.occupied(s) && std::norm(sum.value(s)) > prune_)
+                next[sum.key(s)] = sum.value(s);
+        table_ = std::move(next);
+        check_density();
+    }
+
+    // Lanczos needs the dense state: it is evolved on a dense copy, which
+    // is kept unless the result is still sparse
+    void emulate_time_evolution(TermsDict const& tdict, calc_type const& time,
+                                std::vector<unsigned> const& ids,
+                                std::vector<unsigned> const& ctrl){
+        if (dense_)
+            return dense_->emulate_time_evolution(tdict, time, ids, ctrl);
+        auto sim = make_dense();
+        sim->emulate_time_evolution(tdict, time, ids, ctrl);
+        from_dense(std::move(sim));
+    }
+
+    void apply_pauli_rotation(Term const& term, calc_type theta,
+                              std::vector<unsigned> const& ids,
+                              std::vector<unsigned> const& ctrl){
+        if (dense_)
+            return dense_->apply_pauli_rotation(term, theta, ids, ctrl);
+        if (!check_ids(ids) || !check_ids(ctrl))
+            throw(std::runtime_error("apply_pauli_rotation(): Unknown qubit id(s) provided. Try calling eng.flush() before invoking this function."));
+        auto p = get_pauli_string(term, ids);
+        Key ctrlmask = get_control_mask(ctrl);
+        double c = std::cos(theta);
+        complex_type mis = complex_type(0., -std::sin(theta)) * p.phase;
+        if (p.xmask == 0){ // diagonal, see ::apply_pauli_rotation
+            complex_type ph[] = {c + mis, c - mis};
+            scale([&](Key k){ return (k & ctrlmask) == ctrlmask ? ph[parity(k & p.zmask)] : complex_type(1.); });
+            return;
+        }
+        unsigned h = 0;
+        while (p.xmask >> (h + 1))
+            ++h;
+        apply_blocks({h}, {0, p.xmask}, ctrlmask,
+                     [&](Key j0, complex_type const* in, complex_type* out){
+            Key j1 = j0 ^ p.xmask;
+            out[0] = c * in[0] + (parity(j1 & p.zmask) ? -mis : mis) * in[1];
+            out[1] = c * in[1] + (parity(j0 & p.zmask) ? -mis : mis) * in[0];
+        });
+        check_density();
+    }
+
+    // one butterfly pass per qubit like ::apply_qft; a register which will
+    // fill the state in is transformed densely right away
+    void apply_qft(std::vector<unsigned> const& ids, std::vector<unsigned> const& ctrl,
+                   bool inverse = false){
+        if (dense_)
+            return dense_->apply_qft(ids, ctrl, inverse);
+        if (!check_ids(ids) || !check_ids(ctrl))
+            throw(std::runtime_error("apply_qft(): Unknown qubit id. Please make sure all qubits have been allocated previously (call eng.flush())."));
+        if (N_ <= max_dense_qubits_ && ids.size() < 64
+            && table_.size() > density_ * std::ldexp(1., static_cast<int>(N_) - static_cast<int>(ids.size()))){
+            promote();
+            return dense_->apply_qft(ids, ctrl, inverse);
+        }
+        std::vector<unsigned> locs;
+        for (auto id : ids)
+            locs.push_back(map_[id]);
+        RegisterBits reg(locs);
+        Key ctrlmask = get_control_mask(ctrl);
+        unsigned n = locs.size();
+        for (unsigned j = 0; j < n; ++j){
+            unsigned q = inverse ? j : n - 1 - j;
+            // the twiddle tables of ::apply_qft would have 2^(q/2) entries
+            double scale = std::acos(-1.) / std::ldexp(1., q);
+            apply_blocks({locs[q]}, {0, Key(1) << locs[q]}, ctrlmask,
+                         [&](Key i0, complex_type const*, complex_type* out){
+                auto w = std::polar(1., scale * static_cast<double>(reg.low(i0, q)));
+                qft_detail::butterfly(out, 0, 1, w, inverse);
+            });
+        }
+        check_density();
+    }
+
+    void apply_uniformly_controlled_rotation(char axis, std::vector<calc_type> const& angles,
+                                             std::vector<unsigned> const& ids, unsigned target,
+                                             std::vector<unsigned> const& ctrl){
+        if (dense_)
+            return dense_->apply_uniformly_controlled_rotation(axis, angles, ids, target, ctrl);
+        if (!check_ids(ids) || !check_ids({target}) || !check_ids(ctrl))
+            throw(std::runtime_error("apply_uniformly_controlled_rotation(): Unknown qubit id. Please make sure all qubits have been allocated previously (call eng.flush())."));
+        if (axis != 'Y' && axis != 'Z')
+            throw(std::runtime_error("apply_uniformly_controlled_rotation(): Unknown axis (must be Y or Z)."));
+        if (angles.size() != (std::size_t(1) << ids.size()))
+            throw(std::runtime_error("apply_uniformly_controlled_rotation(): Expected 2^#controls angles."));
+        std::vector<unsigned> locs;
+        for (auto id : ids)
+            locs.push_back(map_[id]);
+        RegisterBits reg(locs);
+        unsigned t = map_[target];
+        apply_blocks({t}, {0, Key(1) << t}, get_control_mask(ctrl),
+                     [&](Key i, complex_type const* in, complex_type* out){
+            double angle = 0.5 * angles[reg.value(i)];
+            double cs = std::cos(angle), sn = std::sin(angle);
+            if (axis == 'Y'){
+                out[0] = cs * in[0] - sn * in[1];
+                out[1] = sn * in[0] + cs * in[1];
+            }
+            else{
+                out[0] = in[0] * complex_type(cs, -sn);
+                out[1] = in[1] * complex_type(cs, sn);
+            }
+        });
+        check_density();
+    }
+
+    void apply_phase_oracle(std::vector<unsigned> const& ids, PhaseOracleBitmap const& bitmap,
+                            std::vector<unsigned> const& ctrl){
+        if (dense_)
+            return dense_->apply_phase_oracle(ids, bitmap, ctrl);
+        if (ids.empty() || !check_ids(ids) || !check_ids(ctrl))
+            throw(std::runtime_error("apply_phase_oracle(): Unknown qubit id(s) provided. Try calling eng.flush() before invoking this function."));
+        if (ids.size() >= 64 || bitmap.size() != ((std::size_t(1) << ids.size()) + 7) / 8)
+            throw(std::runtime_error("apply_phase_oracle(): The bitmap must have one bit per register value."));
+        std::vector<unsigned> locs;
+        for (auto id : ids)
+            locs.push_back(map_[id]);
+        RegisterBits reg(locs);
+        Key ctrlmask = get_control_mask(ctrl);
+        scale([&](Key k){
+            std::size_t x = reg.value(k);
+            bool marked = (k & ctrlmask) == ctrlmask && ((bitmap[x >> 3] >> (x & 7)) & 1U);
+            return complex_type(marked ? -1. : 1.);
+        });
+    }
+
+    void prepare_state(std::vector<unsigned> const& ids, StateVector const& amplitudes){
+        if (dense_)
+            return dense_->prepare_state(ids, amplitudes);
+        if (!check_ids(ids))
+            throw(std::runtime_error("prepare_state(): Unknown qubit id(s) provided. Try calling eng.flush() before invoking this function."));
+        if (ids.size() >= 64 || amplitudes.size() != (std::size_t(1) << ids.size()))
+            throw(std::runtime_error("prepare_state(): Expected 2^#qubits amplitudes."));
+        std::vector<Key> offset(amplitudes.size(), 0);
+        Key mask = 0;
+        for (unsigned j = 0; j < ids.size(); ++j){
+            Key bit = Key(1) << map_[ids[j]];
+            if (mask & bit)
+                throw(std::runtime_error("prepare_state(): Qubit ids must be unique."));
+            mask |= bit;
+            for (std::size_t x = 0; x < offset.size(); ++x)
+                offset[x] |= ((x >> j) & 1) ? bit : 0;
+        }
+        calc_type norm = 0.;
+        for (auto const& a : amplitudes)
+            norm += std::norm(a);
+        if (std::abs(norm - 1.) > 1.e-10)
+            throw(std::runtime_error("prepare_state(): The amplitudes must be normalized."));
+
+        calc_type excited = 0.;
+        for (std::size_t s = 0; s < table_.capacity(); ++s)
+            if (table_.occupied(s) && (table_.key(s) & mask))
+                excited += std::norm(table_.value(s));
+        if (excited > 1.e-12)
+            throw(std::runtime_error("prepare_state(): The qubits must be in state |0...0>."));
+
+        AmplitudeTable next(table_.size());
+        for (std::size_t s = 0; s < table_.capacity(); ++s){
+            if (!table_.occupied(s) || (table_.key(s) & mask))
+                continue;
+            for (std::size_t x = 0; x < amplitudes.size(); ++x){
+                auto v = table_.value(s) * amplitudes[x];
+                if (std::norm(v) > prune_)
+                    next[table_.key(s) | offset[x]] = v;
+            }
+        }
+        table_ = std::move(next);
+        check_density();
+    }
+
+    calc_type get_probability(std::vector<bool> const& bit_string,
+                              std::vector<unsigned> const& ids){
+        if (dense_)
+            return dense_->get_probability(bit_string, ids);
+        if (!check_ids(ids))
+            throw(std::runtime_error("get_probability(): Unknown qubit id. Please make sure you have called eng.flush()."));
+        Key mask = 0, bit_str = 0;
+        for (unsigned i = 0; i < ids.size(); ++i){
+            mask |= Key(1) << map_[ids[i]];
+            bit_str |= Key(bit_string[i] ? 1 : 0) << map_[ids[i]];
+        }
+        calc_type probability = 0.;
+        for (std::size_t s = 0; s < table_.capacity(); ++s)
+            if (table_.occupied(s) && (table_.key(s) & mask) == bit_str)
+                probability += std::norm(table_.value(s));
+        return probability;
+    }
+
+    complex_type get_amplitude(std::vector<bool> const& bit_string,
+                               std::vector<unsigned> const& ids){
+        if (dense_)
+            return dense_->get_amplitude(bit_string, ids);
+        Key chk = 0, index = 0;
+        for (unsigned i = 0; i < ids.size(); ++i){
+            if (map_.count(ids[i]) == 0)
+                break;
+            chk |= Key(1) << map_[ids[i]];
+            index |= Key(bit_string[i] ? 1 : 0) << map_[ids[i]];
+        }
+        if (chk + 1 != (Key(1) << N_))
+            throw(std::runtime_error("The second argument to get_amplitude() must be a permutation of all allocated qubits. Please make sure you have called eng.flush()."));
+        auto p = table_.find(index);
+        return p ? *p : complex_type(0.);
+    }
+
+    void set_wavefunction(StateVector const& wavefunction, std::vector<unsigned> const& ordering){
+        if (dense_)
+            return dense_->set_wavefunction(wavefunction, ordering);
+        assert(wavefunction.size() == (std::size_t(1) << ordering.size()));
+        if (map_.size() != ordering.size() || !check_ids(ordering))
+            throw(std::runtime_error("set_wavefunction(): Invalid mapping provided. Please make sure all qubits have been allocated previously (call eng.flush())."));
+
+        for (unsigned i = 0; i < ordering.size(); ++i)
+            map_[ordering[i]] = i;
+        AmplitudeTable next;
+        for (std::size_t i = 0; i < wavefunction.size(); ++i)
+            if (std::norm(wavefunction[i]) > prune_)
+                next[i] = wavefunction[i];
+        table_ = std::move(next);
+        check_density();
+    }
+
+    void collapse_wavefunction(std::vector<unsigned> const& ids, std::vector<bool> const& values){
+        if (dense_)
+            return dense_->collapse_wavefunction(ids, values);
+        assert(ids.size() == values.size());
+        if (!check_ids(ids))
+            throw(std::runtime_error("collapse_wavefunction(): Unknown qubit id(s) provided. Try calling eng.flush() before invoking this function."));
+        Key mask = 0, val = 0;
+        for (unsigned i = 0; i < ids.size(); ++i){
+            mask |= Key(1) << map_[ids[i]];
+            val |= Key(values[i] ? 1 : 0) << map_[ids[i]];
+        }
+        calc_type N = 0.;
+        for (std::size_t s = 0; s < table_.capacity(); ++s)
+            if (table_.occupied(s) && (table_.key(s) & mask) == val)
+                N += std::norm(table_.value(s));
+        if (N < 1.e-12)
+            throw(std::runtime_error("collapse_wavefunction(): Invalid collapse! Probability is ~0."));
+        project(mask, val);
+    }
+
+    void run(){
+        if (dense_)
+            dense_->run();
+    }
+
+    // the fusion limits of the dense Simulator (see Simulator::set_fusion_limits)
+    void set_fusion_limits(unsigned min, unsigned max){
+        Simulator::check_fusion_limits(min, max);
+        fusion_limits_ = std::make_pair(min, max);
+        if (dense_)
+            dense_->set_fusion_limits(min, max);
+    }
+
+    std::pair<unsigned, unsigned> get_fusion_limits() const{
+        return fusion_limits_;
+    }
+
+    std::pair<unsigned, unsigned> autotune_fusion(unsigned num_qubits = 20){
+        Simulator tuner(1, layout_);
+        tuner.set_scratch_budget(scratch_budget_);
+        tuner.set_prefetch_threshold(prefetch_threshold_);
+        auto limits = tuner.autotune_fusion(num_qubits);
+        set_fusion_limits(limits.first, limits.second);
+        fusion_costs_ = tuner.get_fusion_costs();
+        if (dense_)
+            dense_->set_fusion_costs(fusion_costs_);
+        return limits;
+    }
+
+    // the scratch budget of the dense Simulator (see Simulator::set_scratch_budget)
+    void set_scratch_budget(std::size_t bytes){
+        scratch_budget_ = bytes;
+        if (dense_)
+            dense_->set_scratch_budget(bytes);
+    }
+
+    std::size_t get_scratch_budget() const{
+        return scratch_budget_;
+    }
+
+    void release_scratch(){
+        if (dense_)
+            dense_->release_scratch();
+    }
+
+    // the Krylov dimension of the dense Simulator (see Simulator::set_krylov_dim)
+    void set_krylov_dim(unsigned m){
+        Simulator::check_krylov_dim(m);
+        krylov_dim_ = m;
+        if (dense_)
+            dense_->set_krylov_dim(m);
+    }
+
+    unsigned get_krylov_dim() const{
+        return krylov_dim_;
+    }
+
+    // the prefetch threshold of the dense Simulator (see Simulator::set_prefetch_threshold)
+    void set_prefetch_threshold(std::size_t bytes){
+        prefetch_threshold_ = bytes;
+        if (dense_)
+            dense_->set_prefetch_threshold(bytes);
+    }
+
+    std::size_t get_prefetch_threshold() const{
+        return prefetch_threshold_;
+    }
+
+    // the amplitudes are copied to a dense snapshot, which stays valid
+    // until the next call
+    std::tuple<Map, StateVector&> cheat(){
+        if (dense_)
+            return dense_->cheat();
+        check_dense_size();
+        snapshot_.assign(std::size_t(1) << N_, 0.);
+        for (std::size_t s = 0; s < table_.capacity(); ++s)
+            if (table_.occupied(s))
+                snapshot_[table_.key(s)] = table_.value(s);
+        return std::make_tuple(map_, std::ref(snapshot_));
+    }
+
+    // number of stored amplitudes (2^n once the state is dense)
+    std::size_t num_amplitudes() const {
+        return dense_ ? (std::size_t(1) << N_) : table_.size();
+    }
+
+    bool is_dense() const { return static_cast<bool>(dense_); }
+
+private:
+    Key get_control_mask(std::vector<unsigned> const& ctrls){
+        Key ctrlmask = 0;
+        for (auto c : ctrls)
+            ctrlmask |= Key(1) << map_[c];
+        return ctrlmask;
+    }
+
+    bool check_ids(std::vector<unsigned> const& ids){
+        for (auto id : ids)
+            if (!map_.count(id))
+                return false;
+        return true;
+    }
+
+    // keeps the basis states with (key & mask) == val and re-normalizes
+    void project(Key mask, Key val){
+        calc_type N = 0.;
+        AmplitudeTable next(table_.size());
+        for (std::size_t s = 0; s < table_.capacity(); ++s){
+            if (table_.occupied(s) && (table_.key(s) & mask) == val){
+                next[table_.key(s)] = table_.value(s);
+                N += std::norm(table_.value(s));
+            }
+        }
+        N = 1. / std::sqrt(N);
+        for (std::size_t s = 0; s < next.capacity(); ++s)
+            if (next.occupied(s))
+                next.value(s) *= N;
+        table_ = std::move(next);
+    }
+
+    // maps every stored basis state which satisfies the controls through
+    // the classical function f of the register values (registers at the
+    // bit locations pos)
+    template <class F>
+    void permute(std::vector<std::vector<unsigned>> const& pos,
+                 std::vector<unsigned> const& ctrl, F const& f){
+        Key ctrlmask = get_control_mask(ctrl);
+        AmplitudeTable next(table_.size());
+        std::vector<int> x(pos.size());
+        for (std::size_t s = 0; s < table_.capacity(); ++s){
+            if (!table_.occupied(s))
+                continue;
+            Key k = table_.key(s);
+            if ((k & ctrlmask) == ctrlmask){
+                for (unsigned r = 0; r < pos.size(); ++r){
+                    x[r] = 0;
+                    for (unsigned b = 0; b < pos[r].size(); ++b)
+                        x[r] |= static_cast<int>((k >> pos[r][b]) & 1) << b;
+                }
+                f(x);
+                for (unsigned r = 0; r < pos.size(); ++r)
+                    for (unsigned b = 0; b < pos[r].size(); ++b)
+                        k = (k & ~(Key(1) << pos[r][b])) | (Key((x[r] >> b) & 1) << pos[r][b]);
+            }
+            next[k] += table_.value(s);
+        }
+        table_ = std::move(next);
+    }
+
+    // Applies f to the blocks of amplitudes the operation mixes: the block
+    // of a basis state k is {base ^ offset[i]}, where base = k ^ offset[index]
+    // and bit j of index is bit pos[j] of k. f maps the amplitudes of a block
+    // (zero if not stored) to the new ones; basis states which do not satisfy
+    // the controls are kept.
+    template <class F>
+    void apply_blocks(std::vector<unsigned> const& pos, std::vector<Key> const& offset,
+                      Key ctrlmask, F const& f){
+        std::size_t dim = offset.size();
+        auto index = [&](Key k){
+            std::size_t i = 0;
+            for (unsigned j = 0; j < pos.size(); ++j)
+                i |= std::size_t((k >> pos[j]) & 1) << j;
+            return i;
+        };
+        // a block is listed by its stored basis state of the lowest index,
+        // chunks of slots are gathered in parallel and concatenated in order
+        std::size_t cap = table_.capacity();
+        std::size_t chunks = std::max<std::size_t>(1, std::min<std::size_t>(cap >> 10, 256));
+        std::vector<std::vector<Key>> found(chunks);
+        #pragma omp parallel for schedule(dynamic)
+        for (std::size_t c = 0; c < chunks; ++c){
+            for (std::size_t s = cap * c / chunks; s < cap * (c + 1) / chunks; ++s){
+                if (!table_.occupied(s) || (table_.key(s) & ctrlmask) != ctrlmask)
+                    continue;
+                Key k = table_.key(s);
+                std::size_t i = index(k);
+                Key b = k ^ offset[i];
+                bool first = true;
+                for (std::size_t j = 0; j < i && first; ++j)
+                    first = !table_.find(b ^ offset[j]);
+                if (first)
+                    found[c].push_back(b);
+            }
+        }
+        std::vector<Key> bases;
+        for (auto const& part : found)
+            bases.insert(bases.end(), part.begin(), part.end());
+
+        std::vector<complex_type> out(bases.size() * dim);
+        #pragma omp parallel
+        {
+            std::vector<complex_type> in(dim);
+            #pragma omp for schedule(static)
+            for (std::size_t b = 0; b < bases.size(); ++b){
+                for (std::size_t i = 0; i < dim; ++i){
+                    auto p = table_.find(bases[b] ^ offset[i]);
+                    in[i] = p ? *p : complex_type(0.);
+                }
+                std::copy(in.begin(), in.end(), out.begin() + b * dim);
+                f(bases[b], in.data(), out.data() + b * dim);
+            }
+        }
+
+        // all keys are distinct: the blocks are disjoint and hold the stored
+        // basis states which satisfy the controls
+        AmplitudeTable next(table_.size() + out.size() / 2);
+        next.insert_distinct(cap, [&](std::size_t s, Key& k, complex_type& v){
+            if (!table_.occupied(s) || (table_.key(s) & ctrlmask) == ctrlmask)
+                return false;
+            k = table_.key(s);
+            v = table_.value(s);
+            return true;
+        });
+        next.insert_distinct(out.size(), [&](std::size_t i, Key& k, complex_type& v){
+            if (std::norm(out[i]) <= prune_)
+                return false;
+            k = bases[i / dim] ^ offset[i % dim];
+            v = out[i];
+            return true;
+        });
+        table_ = std::move(next);
+    }
+
+    // multiplies every stored amplitude by the diagonal entry f(key)
+    template <class F>
+    void scale(F const& f){
+        #pragma omp parallel for schedule(static)
+        for (std::size_t s = 0; s < table_.capacity(); ++s)
+            if (table_.occupied(s))
+                table_.value(s) *= f(table_.key(s));
+    }
+
+    // <psi|H|psi>, see PauliSum::expectation
+    complex_type expectation(PauliSum const& H) const {
+        double re = 0., im = 0.;
+        for (auto const& g : H.groups()){
+            #pragma omp parallel for reduction(+:re,im) schedule(static)
+            for (std::size_t s = 0; s < table_.capacity(); ++s){
+                if (!table_.occupied(s))
+                    continue;
+                Key src = table_.key(s) ^ g.xmask;
+                auto v = table_.find(src);
+                if (!v)
+                    continue;
+                complex_type c = 0.;
+                for (auto const& t : g.terms)
+                    c += parity(src & t.zmask) ? -t.coeff : t.coeff;
+                auto e = std::conj(table_.value(s)) * c * *v;
+                re += std::real(e);
+                im += std::imag(e);
+            }
+        }
+        return complex_type(re, im);
+    }
+
+    PauliString get_pauli_string(Term const& term, std::vector<unsigned> const& ids){
+        Term located;
+        for (auto const& local_op : term)
+            located.push_back(std::make_pair(map_[ids[local_op.first]], local_op.second));
+        return PauliString(located);
+    }
+
+    void check_density(){
+        if (N_ <= max_dense_qubits_ && table_.size() > density_ * (std::size_t(1) << N_))
+            promote();
+    }
+
+    void check_dense_size() const {
+        if (N_ > max_dense_qubits_)
+            throw(std::runtime_error("SparseSimulator: This operation needs a dense state vector, which is too large for the number of allocated qubits."));
+    }
+
+    // a dense Simulator (with the settings of this one) holding a copy of
+    // the state
+    std::unique_ptr<Simulator> make_dense(){
+        check_dense_size();
+        std::unique_ptr<Simulator> sim(new Simulator(static_cast<unsigned>(rnd_eng_()), layout_));
+        sim->set_fusion_limits(fusion_limits_.first, fusion_limits_.second);
+        sim->set_fusion_costs(fusion_costs_);
+        sim->set_scratch_budget(scratch_budget_);
+        sim->set_krylov_dim(krylov_dim_);
+        sim->set_prefetch_threshold(prefetch_threshold_);
+        std::vector<unsigned> ordering(N_);
+        for (auto const& p : map_)
+            ordering[p.second] = p.first;
+        for (auto id : ordering)
+            sim->allocate_qubit(id);
+        StateVector vec(std::size_t(1) << N_, 0.);
+        for (std::size_t s = 0; s < table_.capacity(); ++s)
+            if (table_.occupied(s))
+                vec[table_.key(s)] = table_.value(s);
+        sim->set_wavefunction(vec, ordering);
+        return sim;
+    }
+
+    // hands the state to a dense Simulator for good
+    void promote(){
+        dense_ = make_dense();
+        table_ = AmplitudeTable();
+    }
+
+    // takes the state back from a dense copy, which is kept if the state
+    // is dense enough
+    void from_dense(std::unique_ptr<Simulator> sim){
+        auto state = sim->cheat();
+        auto const& order = std::get<0>(state);
+        auto const& vec = std::get<1>(state);
+        std::size_t nonzero = 0;
+        for (auto const& a : vec)
+            nonzero += std::norm(a) > prune_;
+        if (nonzero > density_ * vec.size()){
+            dense_ = std::move(sim);
+            table_ = AmplitudeTable();
+            return;
+        }
+        // the dense simulator may have reordered the qubits
+        std::vector<Key> bit(N_);
+        for (auto const& p : order)
+            bit[p.second] = Key(1) << map_[p.first];
+        AmplitudeTable next(nonzero);
+        for (std::size_t i = 0; i < vec.size(); ++i){
+            if (std::norm(vec[i]) <= prune_)
+                continue;
+            Key k = 0;
+            for (unsigned j = 0; j < N_; ++j)
+                if ((i >> j) & 1)
+                    k |= bit[j];
+            next[k] = vec[i];
+        }
+        table_ = std::move(next);
+    }
+
+    unsigned N_; // #qubits
+    AmplitudeTable table_;
+    Map map_;
+    calc_type density_; // fill ratio at which the state becomes dense
+    unsigned max_dense_qubits_;
+    Simulator::Layout layout_;
+    std::pair<unsigned, unsigned> fusion_limits_;
+    FusionPlanner::Costs fusion_costs_;
+    std::size_t scratch_budget_;
+    unsigned krylov_dim_;
+    std::size_t prefetch_threshold_;
+    std::unique_ptr<Simulator> dense_;
+    StateVector snapshot_; // see cheat()
+    RndEngine rnd_eng_;
+    std::function<double()> rng_;
+    calc_type prune_; // smaller |amplitude|^2 are dropped
+};
+
+#endif
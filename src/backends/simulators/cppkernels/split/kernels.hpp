@@ -0,0 +1,129 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SPLIT_KERNELS_HPP_
+#define SPLIT_KERNELS_HPP_
+
+#include <complex>
+#include <cstddef>
+#include <algorithm>
+
+// Kernels for a state stored as separate real and imaginary planes
+// (Simulator::SPLIT). Basis states which only differ below the lowest gate
+// bit are contiguous in both planes, so the kernels process split_chunk of
+// them at once: every complex multiply-accumulate becomes four real
+// multiply-adds over contiguous doubles, which vectorize without the
+// shuffles the interleaved kernels need.
+static const unsigned split_chunk = 8;
+
+namespace split_detail{
+
+// k with zeros inserted at the bit locations sorted[0] < ... < sorted[K-1]
+template <unsigned K>
+inline std::size_t insert_zeros(std::size_t k, unsigned const* sorted){
+    for (unsigned j = 0; j < K; ++j){
+        std::size_t low = k & ((1UL << sorted[j]) - 1);
+        k = ((k ^ low) << 1) | low;
+    }
+    return k;
+}
+
+// m applied to the C consecutive groups of 2^K amplitudes starting at I
+// (group member x at I + off[x]); only basis states which contain lowctrl
+// are written
+template <unsigned K, unsigned C, class P>
+inline void core(P& re, P& im, std::size_t I, std::size_t const* off,
+                 double const (&mr)[1U << K][1U << K], double const (&mi)[1U << K][1U << K],
+                 std::size_t lowctrl){
+    constexpr unsigned D = 1U << K;
+    double vr[D][C], vi[D][C];
+    for (unsigned x = 0; x < D; ++x)
+        for (unsigned l = 0; l < C; ++l){
+            vr[x][l] = re[I + off[x] + l];
+            vi[x][l] = im[I + off[x] + l];
+        }
+    for (unsigned r = 0; r < D; ++r){
+        double ar[C] = {}, ai[C] = {};
+        for (unsigned x = 0; x < D; ++x){
+            double const cr = mr[r][x], ci = mi[r][x];
+            #pragma omp simd
+            for (unsigned l = 0; l < C; ++l){
+                ar[l] += cr * vr[x][l] - ci * vi[x][l];
+                ai[l] += cr * vi[x][l] + ci * vr[x][l];
+            }
+        }
+        for (unsigned l = 0; l < C; ++l){
+            if (((I + l) & lowctrl) == lowctrl){
+                re[I + off[r] + l] = ar[l];
+                im[I + off[r] + l] = ai[l];
+            }
+        }
+    }
+}
+
+template <unsigned K, unsigned C, class P>
+inline void sweep(P& re, P& im, unsigned const* sorted, std::size_t const* off,
+                  double const (&mr)[1U << K][1U << K], double const (&mi)[1U << K][1U << K],
+                  std::size_t ctrlmask){
+    std::size_t run = 1UL << sorted[0];
+    std::size_t lowctrl = ctrlmask & (run - 1);
+    std::size_t highctrl = ctrlmask & ~(run - 1);
+    std::size_t nruns = (re.size() >> K) / run;
+    #pragma omp for schedule(static)
+    for (std::size_t h = 0; h < nruns; ++h){
+        std::size_t base = insert_zeros<K>(h * run, sorted);
+        if ((base & highctrl) != highctrl)
+            continue;
+        for (std::size_t l = 0; l < run; l += C)
+            core<K, C>(re, im, base + l, off, mr, mi, lowctrl);
+    }
+}
+
+}
+
+// (re, im) <- m (re, im) on the bit locations ids (ids[j] <-> bit j of the
+// row and column index of m) for the basis states which satisfy the control
+// mask. Has to be called from within a parallel region, like the kernels of
+// nointrin/ and intrin/.
+template <unsigned K, class P, class M>
+void kernel_split(P& re, P& im, unsigned const* ids, M const& m, std::size_t ctrlmask){
+    using namespace split_detail;
+    constexpr unsigned D = 1U << K;
+    double mr[D][D], mi[D][D];
+    for (unsigned r = 0; r < D; ++r)
+        for (unsigned c = 0; c < D; ++c){
+            mr[r][c] = std::real(m[r][c]);
+            mi[r][c] = std::imag(m[r][c]);
+        }
+    std::size_t off[D];
+    for (unsigned x = 0; x < D; ++x){
+        off[x] = 0;
+        for (unsigned j = 0; j < K; ++j)
+            off[x] |= static_cast<std::size_t>((x >> j) & 1U) << ids[j];
+    }
+    unsigned sorted[K];
+    std::copy(ids, ids + K, sorted);
+    std::sort(sorted, sorted + K);
+
+    // the chunk (at most split_chunk = 2^3) has to fit into the contiguous
+    // runs of 2^sorted[0] states
+    switch (std::min(sorted[0], 3U)){
+        case 0: sweep<K, 1>(re, im, sorted, off, mr, mi, ctrlmask); break;
+        case 1: sweep<K, 2>(re, im, sorted, off, mr, mi, ctrlmask); break;
+        case 2: sweep<K, 4>(re, im, sorted, off, mr, mi, ctrlmask); break;
+        default: sweep<K, split_chunk>(re, im, sorted, off, mr, mi, ctrlmask); break;
+    }
+}
+
+#endif
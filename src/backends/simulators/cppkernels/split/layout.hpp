@@ -0,0 +1,111 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SPLIT_LAYOUT_HPP_
+#define SPLIT_LAYOUT_HPP_
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+// In-place conversion of n = 2^k interleaved complex amplitudes (2n doubles
+// re0 im0 re1 im1 ...) into a real plane followed by an imaginary plane
+// (re0 re1 ... im0 im1 ...) and back, i.e. a rotation of the bits of the
+// double index by one. It runs in two passes:
+//  - every block of split_layout_block amplitudes is (un)interleaved locally
+//    through a small buffer, which leaves alternating real and imaginary
+//    chunks of one block each;
+//  - the chunks are moved to their places by following the cycles of the
+//    same rotation of the chunk index (one chunk-sized carry per thread).
+// Both passes stream over the state, so a conversion costs about two copies
+// of it in memory traffic but no second state vector.
+static const std::size_t split_layout_block = 2048;
+
+namespace split_layout_detail{
+
+// q rotated by one bit to the right (left if !right) within bits bits
+inline std::size_t rotate(std::size_t q, unsigned bits, bool right){
+    std::size_t top = std::size_t(1) << (bits - 1);
+    return right ? (q >> 1) | ((q & 1) * top) : ((q & (top - 1)) << 1) | ((q & top) ? 1 : 0);
+}
+
+// moves chunk q of size block (doubles) to chunk rotate(q) for all q
+inline void rotate_chunks(double* d, std::size_t chunks, std::size_t block, bool right){
+    unsigned bits = 0;
+    while ((std::size_t(1) << bits) < chunks)
+        ++bits;
+    if (bits < 2)
+        return; // nothing moves
+    #pragma omp parallel
+    {
+        std::vector<double> carry(block);
+        #pragma omp for schedule(dynamic, 16)
+        for (std::size_t q = 0; q < chunks; ++q){
+            // each cycle is rotated once, by its smallest member
+            bool leader = rotate(q, bits, right) != q;
+            for (std::size_t r = rotate(q, bits, right); leader && r != q; r = rotate(r, bits, right))
+                leader = r > q;
+            if (!leader)
+                continue;
+            std::copy(d + q * block, d + (q + 1) * block, carry.begin());
+            for (std::size_t r = rotate(q, bits, right); r != q; r = rotate(r, bits, right))
+                std::swap_ranges(carry.begin(), carry.end(), d + r * block);
+            std::copy(carry.begin(), carry.end(), d + q * block);
+        }
+    }
+}
+
+}
+
+// d[2 i + c] -> d[c n + i] for the n = 2^k complex amplitudes in d
+inline void interleaved_to_planes(double* d, std::size_t n){
+    std::size_t block = std::min(n, split_layout_block);
+    std::size_t blocks = n / block;
+    #pragma omp parallel
+    {
+        std::vector<double> buffer(2 * block);
+        #pragma omp for schedule(static)
+        for (std::size_t k = 0; k < blocks; ++k){
+            double* b = d + 2 * k * block;
+            for (std::size_t i = 0; i < block; ++i){
+                buffer[i] = b[2 * i];
+                buffer[block + i] = b[2 * i + 1];
+            }
+            std::copy(buffer.begin(), buffer.end(), b);
+        }
+    }
+    split_layout_detail::rotate_chunks(d, 2 * blocks, block, true);
+}
+
+// the inverse of interleaved_to_planes
+inline void planes_to_interleaved(double* d, std::size_t n){
+    std::size_t block = std::min(n, split_layout_block);
+    std::size_t blocks = n / block;
+    split_layout_detail::rotate_chunks(d, 2 * blocks, block, false);
+    #pragma omp parallel
+    {
+        std::vector<double> buffer(2 * block);
+        #pragma omp for schedule(static)
+        for (std::size_t k = 0; k < blocks; ++k){
+            double* b = d + 2 * k * block;
+            for (std::size_t i = 0; i < block; ++i){
+                buffer[2 * i] = b[i];
+                buffer[2 * i + 1] = b[block + i];
+            }
+            std::copy(buffer.begin(), buffer.end(), b);
+        }
+    }
+}
+
+#endif
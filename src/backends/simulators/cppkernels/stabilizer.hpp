@@ -0,0 +1,352 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STABILIZER_HPP_
+#define STABILIZER_HPP_
+
+#include <vector>
+#include <map>
+#include <string>
+#include <cstdint>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+
+// Stabilizer (CHP) simulator for Clifford circuits, following Aaronson and
+// Gottesman, "Improved simulation of stabilizer circuits" (2004).
+//
+// The tableau holds n destabilizer and n stabilizer generators plus one
+// scratch row. Each row stores its X and Z parts bit-packed into 64-bit
+// words, one bit per column, so that multiplying two rows (rowsum) is a
+// word-wise XOR whose phase is accumulated with two bit-sliced counters.
+// Gates touch a single bit column of every row.
+//
+// Qubit ids are mapped to columns. Deallocated qubits have to be classical;
+// they are reset to |0> and their column is reused by the next allocation,
+// so the tableau only ever grows to the peak number of live qubits.
+class StabilizerSimulator{
+public:
+    using Word = std::uint64_t;
+    using Map = std::map<unsigned, unsigned>;
+    using RndEngine = std::mt19937;
+
+    StabilizerSimulator(unsigned seed = 1) : n_(0), cap_(0), words_(0), rnd_eng_(seed) {
+        std::uniform_int_distribution<int> dist(0, 1);
+        rng_ = std::bind(dist, std::ref(rnd_eng_));
+        resize(64);
+    }
+
+    void allocate_qubit(unsigned id){
+        if (map_.count(id) != 0)
+            throw(std::runtime_error(
+                "AllocateQubit: ID already exists. Qubit IDs should be unique."));
+        if (!free_.empty()){ // freed columns are in |0> already
+            map_[id] = free_.back();
+            free_.pop_back();
+            return;
+        }
+        if (n_ == cap_)
+            resize(2 * cap_);
+        // |0>: destabilizer X_n, stabilizer +Z_n
+        set_x(n_, n_, true);
+        set_z(cap_ + n_, n_, true);
+        map_[id] = n_++;
+    }
+
+    void deallocate_qubit(unsigned id){
+        unsigned q = column(id);
+        if (find_x(q, cap_, cap_ + n_) != cap_ + n_)
+            throw(std::runtime_error("Error: Qubit has not been measured / uncomputed! There is most likely a bug in your code."));
+        if (deterministic_value(q))
+            x(q);
+        map_.erase(id);
+        free_.push_back(q);
+    }
+
+    bool is_classical(unsigned id){
+        unsigned q = column(id);
+        return find_x(q, cap_, cap_ + n_) == cap_ + n_;
+    }
+
+    bool get_classical_value(unsigned id){
+        unsigned q = column(id);
+        if (find_x(q, cap_, cap_ + n_) != cap_ + n_)
+            throw(std::runtime_error("StabilizerSimulator: Qubit is not in a classical state."));
+        return deterministic_value(q);
+    }
+
+    void measure_qubits(std::vector<unsigned> const& ids, std::vector<bool> &res){
+        res = std::vector<bool>(ids.size());
+        for (unsigned i = 0; i < ids.size(); ++i)
+            res[i] = measure(column(ids[i]));
+    }
+
+    std::vector<bool> measure_qubits_return(std::vector<unsigned> const& ids){
+        std::vector<bool> ret;
+        measure_qubits(ids, ret);
+        return ret;
+    }
+
+    // gate: one of X, Y, Z, H, S, Sdag (one target, at most one control)
+    // or Swap (two targets, no controls)
+    void apply_controlled_gate(std::string const& gate, std::vector<unsigned> const& ids,
+                               std::vector<unsigned> const& ctrl){
+        if (gate == "Swap"){
+            if (ids.size() != 2 || !ctrl.empty())
+                throw(std::runtime_error("StabilizerSimulator: Swap acts on two qubits without controls."));
+            swap(column(ids[0]), column(ids[1]));
+            return;
+        }
+        if (ids.size() != 1)
+            throw(std::runtime_error("StabilizerSimulator: Gate " + gate + " acts on a single qubit."));
+        unsigned t = column(ids[0]);
+        if (ctrl.size() > 1)
+            throw(std::runtime_error("StabilizerSimulator: Gates with more than one control are not Clifford."));
+        if (ctrl.size() == 1){
+            unsigned c = column(ctrl[0]);
+            if (c == t)
+                throw(std::runtime_error("StabilizerSimulator: Control and target qubit coincide."));
+            if (gate == "X")
+                cnot(c, t);
+            else if (gate == "Z"){
+                h(t); cnot(c, t); h(t);
+            }
+            else if (gate == "Y"){
+                sdag(t); cnot(c, t); s(t);
+            }
+            else
+                throw(std::runtime_error("StabilizerSimulator: Controlled " + gate + " is not a Clifford gate."));
+            return;
+        }
+        if (gate == "X") x(t);
+        else if (gate == "Y") y(t);
+        else if (gate == "Z") z(t);
+        else if (gate == "H") h(t);
+        else if (gate == "S") s(t);
+        else if (gate == "Sdag") sdag(t);
+        else
+            throw(std::runtime_error("StabilizerSimulator: Unknown gate " + gate + "."));
+    }
+
+    // nothing is cached, kept for interface compatibility with Simulator
+    void run(){}
+
+    unsigned num_qubits() const { return static_cast<unsigned>(map_.size()); }
+
+private:
+    std::size_t rows() const { return 2 * cap_ + 1; }
+    std::size_t scratch() const { return 2 * cap_; }
+
+    Word* xrow(std::size_t i){ return &x_[i * words_]; }
+    Word* zrow(std::size_t i){ return &z_[i * words_]; }
+
+    bool get_x(std::size_t i, unsigned q) const { return (x_[i * words_ + q / 64] >> (q % 64)) & 1; }
+    bool get_z(std::size_t i, unsigned q) const { return (z_[i * words_ + q / 64] >> (q % 64)) & 1; }
+    void set_x(std::size_t i, unsigned q, bool b){ set(x_[i * words_ + q / 64], q, b); }
+    void set_z(std::size_t i, unsigned q, bool b){ set(z_[i * words_ + q / 64], q, b); }
+    static void set(Word& w, unsigned q, bool b){
+        Word m = Word(1) << (q % 64);
+        w = b ? (w | m) : (w & ~m);
+    }
+
+    unsigned column(unsigned id){
+        auto it = map_.find(id);
+        if (it == map_.end())
+            throw(std::runtime_error("StabilizerSimulator: Unknown qubit id."));
+        return it->second;
+    }
+
+    // destabilizers live in rows [0, cap), stabilizers in [cap, 2 cap) and
+    // the scratch row is 2 cap; rows of unused columns stay zero
+    void resize(unsigned cap){
+        std::size_t words = (cap + 63) / 64;
+        std::vector<Word> x(std::size_t(2 * cap + 1) * words, 0), z(x.size(), 0);
+        std::vector<unsigned char> r(2 * cap + 1, 0);
+        for (unsigned i = 0; i < n_; ++i){
+            std::size_t src[] = {i, cap_ + i}, dst[] = {i, cap + std::size_t(i)};
+            for (unsigned k = 0; k < 2; ++k){
+                std::copy_n(&x_[src[k] * words_], words_, &x[dst[k] * words]);
+                std::copy_n(&z_[src[k] * words_], words_, &z[dst[k] * words]);
+                r[dst[k]] = r_[src[k]];
+            }
+        }
+        x_ = std::move(x);
+        z_ = std::move(z);
+        r_ = std::move(r);
+        cap_ = cap;
+        words_ = words;
+    }
+
+    // first row in [begin, end) with an X (or Y) on column q
+    std::size_t find_x(unsigned q, std::size_t begin, std::size_t end) const {
+        for (std::size_t i = begin; i < end; ++i)
+            if (get_x(i, q))
+                return i;
+        return end;
+    }
+
+    // Clifford gates as column updates of every used row; r_ picks up the
+    // sign of the conjugated Pauli
+    template <class F>
+    void for_each_row(unsigned q, F const& f){
+        std::size_t w = q / 64;
+        Word m = Word(1) << (q % 64);
+        std::size_t end[] = {n_, cap_ + std::size_t(n_)}, begin[] = {0, cap_};
+        for (unsigned k = 0; k < 2; ++k){
+            #pragma omp parallel for schedule(static) if(n_ > 4096)
+            for (std::size_t i = begin[k]; i < end[k]; ++i)
+                f(x_[i * words_ + w], z_[i * words_ + w], r_[i], m);
+        }
+    }
+
+    void x(unsigned q){
+        for_each_row(q, [](Word&, Word& z, unsigned char& r, Word m){ r ^= (z & m) != 0; });
+    }
+    void z(unsigned q){
+        for_each_row(q, [](Word& x, Word&, unsigned char& r, Word m){ r ^= (x & m) != 0; });
+    }
+    void y(unsigned q){
+        for_each_row(q, [](Word& x, Word& z, unsigned char& r, Word m){ r ^= ((x ^ z) & m) != 0; });
+    }
+    void h(unsigned q){
+        for_each_row(q, [](Word& x, Word& z, unsigned char& r, Word m){
+            r ^= (x & z & m) != 0;
+            Word d = (x ^ z) & m;
+            x ^= d;
+            z ^= d;
+        });
+    }
+    void s(unsigned q){
+        for_each_row(q, [](Word& x, Word& z, unsigned char& r, Word m){
+            r ^= (x & z & m) != 0;
+            z ^= x & m;
+        });
+    }
+    void sdag(unsigned q){
+        for_each_row(q, [](Word& x, Word& z, unsigned char& r, Word m){
+            r ^= (x & ~z & m) != 0;
+            z ^= x & m;
+        });
+    }
+
+    void cnot(unsigned c, unsigned t){
+        std::size_t end[] = {n_, cap_ + std::size_t(n_)}, begin[] = {0, cap_};
+        for (unsigned k = 0; k < 2; ++k){
+            #pragma omp parallel for schedule(static) if(n_ > 4096)
+            for (std::size_t i = begin[k]; i < end[k]; ++i){
+                bool xc = get_x(i, c), zc = get_z(i, c), xt = get_x(i, t), zt = get_z(i, t);
+                r_[i] ^= xc && zt && (xt == zc);
+                if (xc)
+                    set_x(i, t, !xt);
+                if (zt)
+                    set_z(i, c, !zc);
+            }
+        }
+    }
+
+    void swap(unsigned a, unsigned b){
+        std::size_t end[] = {n_, cap_ + std::size_t(n_)}, begin[] = {0, cap_};
+        for (unsigned k = 0; k < 2; ++k){
+            #pragma omp parallel for schedule(static) if(n_ > 4096)
+            for (std::size_t i = begin[k]; i < end[k]; ++i){
+                bool xa = get_x(i, a), za = get_z(i, a);
+                set_x(i, a, get_x(i, b));
+                set_z(i, a, get_z(i, b));
+                set_x(i, b, xa);
+                set_z(i, b, za);
+            }
+        }
+    }
+
+    // row h <- row h * row i, with the phase of the product of the two
+    // Pauli strings computed for 64 columns at once: cnt1 and cnt2 are the
+    // low and high bits of a per-column counter of factors of i
+    void rowsum(std::size_t h, std::size_t i){
+        Word* x1 = xrow(h);
+        Word* z1 = zrow(h);
+        Word const* x2 = xrow(i);
+        Word const* z2 = zrow(i);
+        Word cnt1 = 0, cnt2 = 0;
+        for (std::size_t w = 0; w < words_; ++w){
+            Word ox1 = x1[w], oz1 = z1[w];
+            x1[w] ^= x2[w];
+            z1[w] ^= z2[w];
+            Word x1z2 = ox1 & z2[w];
+            Word anti = (x2[w] & oz1) ^ x1z2;
+            cnt2 ^= (cnt1 ^ x1[w] ^ z1[w] ^ x1z2) & anti;
+            cnt1 ^= anti;
+        }
+        unsigned log_i = popcount(cnt1) + 2 * popcount(cnt2) + 2 * (r_[h] + r_[i]);
+        r_[h] = (log_i & 3) >= 2;
+    }
+
+    static unsigned popcount(Word w){
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_popcountll(w);
+#else
+        unsigned c = 0;
+        for (; w; w &= w - 1)
+            ++c;
+        return c;
+#endif
+    }
+
+    // outcome of measuring column q if no stabilizer anticommutes with Z_q
+    bool deterministic_value(unsigned q){
+        std::size_t sc = scratch();
+        std::fill_n(xrow(sc), words_, Word(0));
+        std::fill_n(zrow(sc), words_, Word(0));
+        r_[sc] = 0;
+        for (unsigned i = 0; i < n_; ++i)
+            if (get_x(i, q))
+                rowsum(sc, cap_ + i);
+        return r_[sc] != 0;
+    }
+
+    bool measure(unsigned q){
+        std::size_t p = find_x(q, cap_, cap_ + n_);
+        if (p == cap_ + n_)
+            return deterministic_value(q);
+
+        // random outcome: make p the only row that anticommutes with Z_q,
+        // move it to the destabilizers and replace it by +-Z_q
+        for (std::size_t i = 0; i < cap_ + n_; ++i){
+            if (i == p || (i >= n_ && i < cap_))
+                continue;
+            if (get_x(i, q))
+                rowsum(i, p);
+        }
+        std::size_t d = p - cap_;
+        std::copy_n(xrow(p), words_, xrow(d));
+        std::copy_n(zrow(p), words_, zrow(d));
+        r_[d] = r_[p];
+        std::fill_n(xrow(p), words_, Word(0));
+        std::fill_n(zrow(p), words_, Word(0));
+        set_z(p, q, true);
+        r_[p] = static_cast<unsigned char>(rng_());
+        return r_[p] != 0;
+    }
+
+    unsigned n_, cap_; // #columns in use (live or free) and allocated
+    std::size_t words_; // words per row part
+    std::vector<Word> x_, z_;
+    std::vector<unsigned char> r_;
+    Map map_;
+    std::vector<unsigned> free_;
+    RndEngine rnd_eng_;
+    std::function<int()> rng_;
+};
+
+#endif
@@ -0,0 +1,70 @@
+// Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef UNIFORMLY_CONTROLLED_HPP_
+#define UNIFORMLY_CONTROLLED_HPP_
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <stdexcept>
+#include "registerbits.hpp"
+
+// psi <- UniformlyControlledRy/Rz(angles) psi (ops/uniformly_controlled_rotation.ts):
+// Ry(angles[k]) (axis 'Y') or Rz(angles[k]) (axis 'Z') on the qubit at bit
+// location target, where k is the value of the qubits at bit locations locs
+// (locs[0] least significant). One pass over the pairs of the target
+// instead of 2^#locs rotations and CNOTs, for the basis states which satisfy
+// the control mask.
+template <class V>
+void apply_uniformly_controlled_rotation(V& psi, char axis, std::vector<double> const& angles,
+                                         std::vector<unsigned> const& locs, unsigned target,
+                                         std::size_t ctrlmask){
+    using complex_type = std::complex<double>;
+    if (axis != 'Y' && axis != 'Z')
+        throw(std::runtime_error("apply_uniformly_controlled_rotation(): Unknown axis (must be Y or Z)."));
+    if (angles.size() != (1UL << locs.size()))
+        throw(std::runtime_error("apply_uniformly_controlled_rotation(): Expected 2^#controls angles."));
+
+    // Ry: [[c, -s], [s, c]], Rz: diag(c - i s, c + i s) with c, s of angle / 2
+    std::vector<double> cs(angles.size()), sn(angles.size());
+    for (std::size_t k = 0; k < angles.size(); ++k){
+        cs[k] = std::cos(0.5 * angles[k]);
+        sn[k] = std::sin(0.5 * angles[k]);
+    }
+
+    RegisterBits reg(locs);
+    std::size_t bit = 1UL << target;
+    std::size_t lowmask = bit - 1;
+
+    #pragma omp parallel for schedule(static)
+    for (std::size_t j = 0; j < psi.size() / 2; ++j){
+        std::size_t i = ((j & ~lowmask) << 1) | (j & lowmask);
+        if ((i & ctrlmask) != ctrlmask)
+            continue;
+        std::size_t k = reg.value(i);
+        auto a0 = psi[i];
+        auto a1 = psi[i | bit];
+        if (axis == 'Y'){
+            psi[i] = cs[k] * a0 - sn[k] * a1;
+            psi[i | bit] = sn[k] * a0 + cs[k] * a1;
+        }
+        else{
+            psi[i] = a0 * complex_type(cs[k], -sn[k]);
+            psi[i | bit] = a1 * complex_type(cs[k], sn[k]);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import assert from 'assert'
+import math from 'mathjs'
+import { BasicEngine } from '@/cengines/basics'
+import CPPSimulatorBackend from './cppsim'
+import {
+  Allocate,
+  AllocateQubitGate,
+  Deallocate,
+  DeallocateQubitGate,
+  FlushGate,
+  Measure,
+  MeasureGate
+} from '@/ops/gates'
+import { BasicQubit } from '@/meta/qubit'
+import { LogicalQubitIDTag } from '@/meta/tag'
+import { instanceOf } from '@/libs/util'
+import { len, stringToBitArray } from '@/libs/polyfill'
+import { ICommand, IMathGate, IQubit, IQureg } from '@/interfaces'
+
+/**
+ * @desc
+MPSSimulator is a compiler engine which simulates a quantum computer as a
+matrix product state (MPS) using C++-based kernels. Memory and run time
+grow with the bond dimension instead of 2^n, so weakly entangled states of
+many qubits (e.g., 1D Trotter or variational circuits) are cheap.
+
+  The qubits form a chain ordered by their (mapped) ids. Use a LinearMapper
+in front of the simulator to keep all two-qubit gates nearest-neighbour;
+other gates are routed with swaps and are correspondingly more expensive.
+
+  Bonds are truncated to `maxBondDimension` singular values, see
+truncationError() for the accumulated discarded weight.
+
+    @example
+
+const eng = new MainEngine(new MPSSimulator(32), [
+  new AutoReplacer(rule_set), new LinearMapper(60)
+])
+
+  Note:
+The MPS simulator requires the C++ extension; there is no Javascript
+fallback.
+ */
+export class MPSSimulator extends BasicEngine {
+  private _simulator: any;
+
+  /**
+    @param maxBondDimension Maximal number of singular values kept on each bond.
+    @param rnd_seed Random seed of the measurement outcomes.
+   */
+  constructor(maxBondDimension: number = 64, rnd_seed?: number) {
+    super()
+    if (!CPPSimulatorBackend || !CPPSimulatorBackend.MPSSimulator) {
+      throw new Error('MPSSimulator requires the C++ extension.')
+    }
+    if (!rnd_seed) {
+      rnd_seed = Math.floor(Math.random() * 4294967295)
+    }
+    const S = CPPSimulatorBackend.MPSSimulator
+    this._simulator = new S(rnd_seed, maxBondDimension)
+  }
+
+  /**
+  Specialized implementation of isAvailable: The MPS simulator can deal
+with all gates which provide a gate-matrix (via gate.matrix) and act on at
+most two qubits, control qubits included.
+
+  @param cmd Command for which to check availability
+
+  @return true if it can be simulated and false otherwise.
+   */
+  isAvailable(cmd: ICommand) {
+    if (instanceOf(cmd.gate, [MeasureGate, AllocateQubitGate, DeallocateQubitGate, FlushGate])) {
+      return true
+    }
+    let num_qubits = cmd.controlCount
+    cmd.qubits.forEach(qr => num_qubits += qr.length)
+    if (num_qubits > 2) {
+      return false
+    }
+    try {
+      const m = (cmd.gate as IMathGate).matrix
+      const [row, col] = m.size()
+      return row <= 4 && col <= 4
+    } catch (e) {
+      return false
+    }
+  }
+
+  /**
+    Converts a qureg from logical to mapped qubits if there is a mapper.
+    @param qureg Logical quantum bits
+  */
+  convertLogicalToMappedQureg(qureg: IQureg) {
+    const { mapper } = this.main
+    if (mapper) {
+      const mapped_qureg: IQubit[] = []
+      qureg.forEach((qubit) => {
+        const v = mapper.currentMapping![qubit.id]
+        if (typeof v === 'undefined') {
+          throw new Error(`Unknown qubit id. Please make sure you have called eng.flush().`);
+        }
+        mapped_qureg.push(new BasicQubit(qubit.engine, v))
+      })
+      return mapped_qureg
+    }
+    return qureg
+  }
+
+  /**
+  Return the probability amplitude of the supplied `bit_string`.
+    The ordering is given by the quantum register `qureg`, which must
+contain all allocated qubits.
+
+   @param {string} bitString Computational basis state
+   @param {Qureg|Array.<Qubit>} qureg Quantum register determining the
+ordering. Must contain all allocated qubits.
+   */
+  getAmplitude(bitString: string, qureg: IQureg) {
+    qureg = this.convertLogicalToMappedQureg(qureg)
+    const bit_string = stringToBitArray(bitString)
+    return this._simulator.getAmplitude(bit_string, qureg.map(qb => qb.id))
+  }
+
+  /**
+  Sum of the discarded weights (squared singular values) of all
+truncations so far. To first order this bounds the infidelity of the
+simulated state.
+   */
+  truncationError(): number {
+    return this._simulator.getTruncationError()
+  }
+
+  /**
+  Bond dimensions between neighbouring qubits of the chain.
+   */
+  bondDimensions(): number[] {
+    return this._simulator.getBondDimensions()
+  }
+
+  /**
+  Change the maximal bond dimension used for subsequent gates.
+   */
+  setMaxBondDimension(maxBondDimension: number) {
+    this._simulator.setMaxBondDimension(maxBondDimension)
+  }
+
+  /**
+  Handle all commands, i.e., call the member functions of the C++-
+MPS object corresponding to measurement, allocation/deallocation, and
+(controlled) one- and two-qubit gates.
+
+    @throws Error If a gate acts on more than two qubits (which should never happen due to isAvailable).
+   */
+  handle(cmd: ICommand) {
+    if (cmd.gate.equal(Measure)) {
+      assert(cmd.controlCount === 0)
+      const ids: number[] = []
+      cmd.qubits.forEach(qr => qr.forEach(qb => ids.push(qb.id)))
+      const out = this._simulator.measureQubits(ids)
+      let i = 0
+      cmd.qubits.forEach((qr) => {
+        qr.forEach((qb) => {
+          // Check if a mapper assigned a different logical id
+          let logical_id_tag: LogicalQubitIDTag | undefined
+          cmd.tags.forEach((tag) => {
+            if (tag instanceof LogicalQubitIDTag) {
+              logical_id_tag = tag
+            }
+          })
+          if (logical_id_tag) {
+            qb = new BasicQubit(qb.engine, (logical_id_tag as LogicalQubitIDTag).logicalQubitID)
+          }
+          this.main.setMeasurementResult!(qb, Boolean(out[i]))
+          i += 1
+        })
+      })
+    } else if (cmd.gate.equal(Allocate)) {
+      this._simulator.allocateQubit(cmd.qubits[0][0].id)
+    } else if (cmd.gate.equal(Deallocate)) {
+      this._simulator.deallocateQubit(cmd.qubits[0][0].id)
+    } else {
+      const matrix = (cmd.gate as IMathGate).matrix
+      const ids: number[] = []
+      cmd.qubits.forEach(qr => qr.forEach(qb => ids.push(qb.id)))
+      if (2 ** ids.length !== len(matrix) || ids.length + cmd.controlCount > 2) {
+        throw new Error(`MPSSimulator: Error applying ${cmd.gate.toString()} gate: only gates on at most two qubits (including controls) are supported.`)
+      }
+      const m = (math.clone(matrix) as any)._data
+      this._simulator.applyControlledGate(m, ids, cmd.controlQubits.map(qb => qb.id))
+    }
+  }
+
+  receive(commandList: ICommand[]) {
+    commandList.forEach((cmd) => {
+      if (!(cmd.gate instanceof FlushGate)) {
+        this.handle(cmd)
+      }
+      if (!this.isLastEngine) {
+        this.send([cmd])
+      }
+    })
+  }
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import math from 'mathjs'
+import { BasicGate } from '@/ops/basics'
+import { len } from '@/libs/polyfill'
+import { IMathGate, IQubit } from '@/interfaces'
+
+/**
+ * Gate kinds of the native adjoint differentiation (see
+ * cppkernels/adjoint.hpp), used as the first entry of a gate descriptor.
+ */
+export const CircuitGateKind = {
+  Matrix: 0,
+  Rx: 1,
+  Ry: 2,
+  Rz: 3,
+  R: 4,
+  Ph: 5,
+  Pauli: 6,
+  Measure: 7
+}
+
+export type RotationKind = 'Rx' | 'Ry' | 'Rz' | 'R' | 'Ph'
+
+/**
+ * @desc
+ParametrizedCircuit records a gate sequence whose rotation angles are bound
+to entries of a parameter vector, for Simulator.getExpectationGradient.
+
+  Fixed gates are added with apply(); rotate() adds an Rx, Ry, Rz, R or Ph
+gate with angle `scale * params[param]`, and evolve() adds exp(-i theta P)
+for a Pauli string P with theta = `scale * params[param]`. A parameter may
+be used by several gates.
+
+    @example
+
+const circuit = new ParametrizedCircuit()
+circuit.rotate('Ry', 0, qureg[0])
+circuit.apply(X, qureg[1], [qureg[0]])
+circuit.evolve([[0, 'Z'], [1, 'Z']], 1, [qureg[0], qureg[1]])
+const { value, gradient } = sim.getExpectationGradient(circuit, [0.3, 1.2], hamiltonian, qureg)
+ */
+export class ParametrizedCircuit {
+  gates: any[][];
+  numParameters: number;
+
+  constructor() {
+    this.gates = []
+    this.numParameters = 0
+  }
+
+  /**
+  Add a fixed gate which provides a matrix (on at most 5 qubits).
+    @param gate Gate to apply.
+    @param qubits Qubits the gate acts on.
+    @param controls Control qubits.
+   */
+  apply(gate: BasicGate, qubits: IQubit | IQubit[], controls: IQubit[] = []) {
+    const ids = (Array.isArray(qubits) ? qubits : [qubits]).map(qb => qb.id)
+    const matrix = (gate as IMathGate).matrix
+    if (2 ** ids.length !== len(matrix) || ids.length > 5) {
+      throw new Error(`ParametrizedCircuit: Error adding ${gate.toString()} gate: matrix size does not match the number of qubits.`)
+    }
+    this.gates.push([CircuitGateKind.Matrix, ids, controls.map(qb => qb.id), -1, 0, (math.clone(matrix) as any)._data])
+    return this
+  }
+
+  /**
+  Add a single-qubit rotation with angle `scale * params[param]`.
+    @param kind Type of the rotation gate.
+    @param param Index of the parameter.
+    @param qubit Qubit the gate acts on.
+    @param controls Control qubits.
+    @param scale Factor of the parameter.
+   */
+  rotate(kind: RotationKind, param: number, qubit: IQubit, controls: IQubit[] = [], scale: number = 1) {
+    this.bind(param)
+    this.gates.push([CircuitGateKind[kind], [qubit.id], controls.map(qb => qb.id), param, scale, []])
+    return this
+  }
+
+  /**
+  Add exp(-i theta P) with theta = `scale * params[param]`.
+    @param term Pauli string P as [[index into qubits, 'X' | 'Y' | 'Z'], ...].
+    @param param Index of the parameter.
+    @param qubits Qubits the term acts on.
+    @param controls Control qubits.
+    @param scale Factor of the parameter.
+   */
+  evolve(term: [number, string][], param: number, qubits: IQubit[], controls: IQubit[] = [], scale: number = 1) {
+    this.bind(param)
+    this.gates.push([CircuitGateKind.Pauli, qubits.map(qb => qb.id), controls.map(qb => qb.id), param, scale, term])
+    return this
+  }
+
+  /**
+  Add a measurement point; when the compiled circuit is replayed, the
+outcomes are returned by Simulator.applyCompiled.
+    @param qubits Qubits to measure.
+   */
+  measure(qubits: IQubit | IQubit[]) {
+    const ids = (Array.isArray(qubits) ? qubits : [qubits]).map(qb => qb.id)
+    this.gates.push([CircuitGateKind.Measure, ids, [], -1, 0, []])
+    return this
+  }
+
+  private bind(param: number) {
+    if (!Number.isInteger(param) || param < 0) {
+      throw new Error(`ParametrizedCircuit: Invalid parameter index ${param}.`)
+    }
+    this.numParameters = Math.max(this.numParameters, param + 1)
+  }
+}
+
+/**
+ * @desc
+A ParametrizedCircuit compiled by Simulator.compile (or recorded with
+Simulator.startRecording): its fused blocks are computed once and replayed
+with Simulator.applyCompiled.
+
+  save() writes the compiled circuit to a versioned binary file which
+Simulator.loadCompiled reads back without running any compiler engines.
+ */
+export class CompiledCircuit {
+  native: any;
+
+  constructor(native: any) {
+    this.native = native
+  }
+
+  /**
+  Number of fused blocks a replay applies.
+   */
+  get numBlocks(): number {
+    return this.native.numBlocks()
+  }
+
+  get numParameters(): number {
+    return this.native.numParameters()
+  }
+
+  /**
+  Write the compiled circuit (gates and fused blocks) to a binary file.
+    @param path File name.
+   */
+  save(path: string) {
+    this.native.save(path)
+  }
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import assert from 'assert'
+import CPPSimulatorBackend from './cppsim'
+import { ClassicalSimulator } from './classicalsimulator'
+import { nativeMathDescriptor } from './simulator'
+import {
+  Allocate,
+  AllocateQubitGate,
+  Deallocate,
+  DeallocateQubitGate,
+  FlushGate,
+  Measure,
+  MeasureGate,
+  SwapGate,
+  XGate
+} from '@/ops/gates'
+import { BasicMathGate } from '@/ops/basics'
+import { BasicQubit } from '@/meta/qubit'
+import { LogicalQubitIDTag } from '@/meta/tag'
+import { instanceOf } from '@/libs/util'
+import { ICommand, IQubit, IQureg } from '@/interfaces'
+
+/**
+ * Operation codes of the native applyOps batches (see
+ * cppkernels/reversible.hpp): `[code, #targets, #controls, targets..., controls...]`.
+ */
+export const ReversibleOpCode = {
+  NOT: 0,
+  SWAP: 1
+}
+
+/**
+ * @desc
+ReversibleSimulator is a ClassicalSimulator whose state lives in the C++
+kernels as bit-packed 256-bit words. X, CNOT, Toffoli and (controlled) Swap
+gates are queued and run natively in one batch at the next flush,
+measurement or math gate; AddConstant, AddConstantModN and
+MultiplyByConstantModN are evaluated natively as well.
+
+  The simulator can evaluate the circuit on many input patterns at once
+(bit-sliced, 256 patterns per word): load one value per pattern with
+writeRegisterPatterns and read all results with readRegisterPatterns.
+Measurements, readBit and readRegister report pattern 0.
+
+    @example
+
+const sim = new ReversibleSimulator(256)
+const eng = new MainEngine(sim, [])
+const a = eng.allocateQureg(4)
+const b = eng.allocateQureg(5)
+sim.writeRegisterPatterns(a, [...Array(256).keys()].map(p => p & 15))
+sim.writeRegisterPatterns(b, [...Array(256).keys()].map(p => p >> 4))
+new AddConstant(3).or(b)
+eng.flush()
+sim.readRegisterPatterns(b) // ((p >> 4) + 3) & 31 for every pattern p
+
+  Note:
+The reversible simulator requires the C++ extension; there is no
+Javascript fallback.
+ */
+export class ReversibleSimulator extends ClassicalSimulator {
+  private _simulator: any;
+  private _ops: number[];
+  private _patterns: number;
+
+  /**
+    @param patterns Number of input patterns which are simulated at once.
+   */
+  constructor(patterns: number = 1) {
+    super()
+    if (!CPPSimulatorBackend || !CPPSimulatorBackend.ReversibleSimulator) {
+      throw new Error('ReversibleSimulator requires the C++ extension.')
+    }
+    const S = CPPSimulatorBackend.ReversibleSimulator
+    this._simulator = new S(patterns)
+    this._ops = []
+    this._patterns = patterns
+  }
+
+  get patterns() {
+    return this._patterns
+  }
+
+  // Runs the queued NOT/Swap operations.
+  flushOps() {
+    if (this._ops.length > 0) {
+      this._simulator.applyOps(this._ops)
+      this._ops = []
+    }
+  }
+
+  readMappedBit(mappedQubit: IQubit) {
+    this.flushOps()
+    return Number(this._simulator.getClassicalValue(mappedQubit.id))
+  }
+
+  writeMappedBit(mappedQubit: IQubit, value: boolean | number) {
+    this.writeMappedRegister([mappedQubit], value ? 1 : 0)
+  }
+
+  readMappedRegister(mappedQureg: IQubit[]) {
+    this.flushOps()
+    return this._simulator.readRegister(mappedQureg.map(qb => qb.id))
+  }
+
+  writeMappedRegister(mappedQureg: IQubit[], value: number) {
+    if (value < 0 || value >= (2 ** mappedQureg.length)) {
+      throw new Error("Value won't fit in register.")
+    }
+    this.flushOps()
+    this._simulator.writeRegister(mappedQureg.map(qb => qb.id), value)
+  }
+
+  /**
+  Reads a group of bits as a little-endian integer in every input pattern.
+
+  @param qureg The group of bits to read, in little-endian order.
+
+  @return One register value per pattern.
+   */
+  readRegisterPatterns(qureg: IQureg): number[] {
+    this.flushOps()
+    const ids = qureg.map(qubit => this.convertLogicalToMappedQubit(qubit).id)
+    return this._simulator.readRegisterPatterns(ids)
+  }
+
+  /**
+  Sets a group of bits to one little-endian integer value per input pattern.
+
+   @param qureg The bits to write, in little-endian order.
+   @param values One value per pattern. Each must fit in the register.
+   */
+  writeRegisterPatterns(qureg: IQureg, values: number[]) {
+    if (values.length !== this._patterns) {
+      throw new Error(`Expected ${this._patterns} values, one per pattern.`)
+    }
+    values.forEach((value) => {
+      if (value < 0 || value >= (2 ** qureg.length)) {
+        throw new Error("Value won't fit in register.")
+      }
+    })
+    this.flushOps()
+    const ids = qureg.map(qubit => this.convertLogicalToMappedQubit(qubit).id)
+    this._simulator.writeRegisterPatterns(ids, values)
+  }
+
+  isAvailable(cmd: ICommand) {
+    return instanceOf(cmd.gate, [MeasureGate, AllocateQubitGate, DeallocateQubitGate, BasicMathGate, FlushGate, XGate, SwapGate])
+  }
+
+  handle(cmd: ICommand) {
+    const ctrlids = cmd.controlQubits.map(qb => qb.id)
+    // SwapGate is a BasicMathGate, so check it first
+    if (cmd.gate instanceof SwapGate) {
+      const ids: number[] = []
+      cmd.qubits.forEach(qr => qr.forEach(qb => ids.push(qb.id)))
+      assert(ids.length === 2)
+      this._ops.push(ReversibleOpCode.SWAP, 2, ctrlids.length, ...ids, ...ctrlids)
+      return
+    }
+    if (cmd.gate instanceof XGate) {
+      assert(cmd.qubits.length === 1 && cmd.qubits[0].length === 1)
+      this._ops.push(ReversibleOpCode.NOT, 1, ctrlids.length, cmd.qubits[0][0].id, ...ctrlids)
+      return
+    }
+    if (cmd.gate.equal(Allocate)) {
+      this._simulator.allocateQubit(cmd.qubits[0][0].id)
+      return
+    }
+
+    this.flushOps()
+    if (cmd.gate instanceof FlushGate) {
+      return
+    }
+
+    if (cmd.gate.equal(Measure)) {
+      const ids: number[] = []
+      cmd.qubits.forEach(qr => qr.forEach(qb => ids.push(qb.id)))
+      const out = this._simulator.measureQubits(ids)
+      let i = 0
+      cmd.qubits.forEach(qr => qr.forEach((qb) => {
+        // Check if a mapper assigned a different logical id
+        let logical_id_tag: LogicalQubitIDTag | undefined
+        cmd.tags.forEach((tag) => {
+          if (tag instanceof LogicalQubitIDTag) {
+            logical_id_tag = tag
+          }
+        })
+        if (logical_id_tag) {
+          qb = new BasicQubit(qb.engine, (logical_id_tag as LogicalQubitIDTag).logicalQubitID)
+        }
+        this.main.setMeasurementResult!(qb, Boolean(out[i]))
+        i += 1
+      }))
+      return
+    }
+
+    if (cmd.gate.equal(Deallocate)) {
+      this._simulator.deallocateQubit(cmd.qubits[0][0].id)
+      return
+    }
+
+    if (cmd.gate instanceof BasicMathGate) {
+      const qubitids = cmd.qubits.map(qr => qr.map(qb => qb.id))
+      const descriptor = nativeMathDescriptor(cmd.gate)
+      if (descriptor) {
+        this._simulator.emulateMathOperation(descriptor, qubitids, ctrlids)
+      } else {
+        this._simulator.emulateMath(cmd.gate.getMathFunction(cmd.qubits), qubitids, ctrlids)
+      }
+      return
+    }
+    throw new Error('Only support alloc/dealloc/measure/not/swap/math ops.')
+  }
+}
@@ -25,13 +25,109 @@ import {
 } from '@/ops/gates';
 import { BasicMathGate } from '@/ops/basics';
 import TimeEvolution from '@/ops/timeevolution';
+import QFTGate from '@/ops/qftgate';
+import { DaggeredGate } from '@/ops/metagates';
+import { UniformlyControlledRy, UniformlyControlledRz } from '@/ops/uniformly_controlled_rotation';
+import { StatePreparation } from '@/ops/statepreparation';
+import { PhaseOracle } from '@/ops/phaseoracle';
+import { AddConstant, AddConstantModN, MultiplyByConstantModN } from '@/libs/math/gates';
 import { BasicQubit } from '@/meta/qubit'
 import { stringToArray } from '@/ops/qubitoperator'
+import { CircuitGateKind, CompiledCircuit, ParametrizedCircuit } from './parametrizedcircuit'
 import { LogicalQubitIDTag } from '@/meta/tag'
 import { instanceOf } from '@/libs/util';
 import { len, stringToBitArray } from '@/libs/polyfill';
 import { ICommand, ISimulator, IMathGate, IQubit, IQubitOperator, IQureg } from '@/interfaces';
 
+/**
+ * Returns false for a QFT gate, true for its inverse and undefined for any
+ * other gate.
+ */
+export function qftDirection(gate: any): boolean | undefined {
+  if (gate instanceof QFTGate) {
+    return false
+  }
+  if (gate instanceof DaggeredGate && gate.gate instanceof QFTGate) {
+    return true
+  }
+  return undefined
+}
+
+/**
+ * Operation kinds understood by the native math library (see
+ * cppkernels/mathops.hpp), used as the first entry of a math descriptor.
+ */
+export const NativeMathOperation = {
+  AddConstant: 0,
+  AddConstantModN: 1,
+  MultiplyByConstantModN: 2
+}
+
+/**
+ * Return the native descriptor `[kind, a, N]` of a math gate, or undefined if
+ * the gate can only be emulated through its JavaScript math function.
+ */
+export function nativeMathDescriptor(gate: BasicMathGate): number[] | undefined {
+  if (gate instanceof AddConstant) {
+    return [NativeMathOperation.AddConstant, gate.a, 0]
+  }
+  if (gate instanceof AddConstantModN) {
+    return [NativeMathOperation.AddConstantModN, gate.a, gate.N]
+  }
+  if (gate instanceof MultiplyByConstantModN) {
+    return [NativeMathOperation.MultiplyByConstantModN, gate.a, gate.N]
+  }
+  return undefined
+}
+
+/**
+ * Return true if all Pauli strings (given as arrays of [index, 'X' | 'Y' | 'Z'])
+ * commute pairwise, i.e., if every pair differs on an even number of shared qubits.
+ */
+export function pauliTermsCommute(terms: [number, string][][]): boolean {
+  for (let i = 0; i < terms.length; ++i) {
+    const actions: { [key: number]: string } = {}
+    terms[i].forEach(([idx, action]) => {
+      actions[idx] = action
+    })
+    for (let j = i + 1; j < terms.length; ++j) {
+      let anticommuting = 0
+      terms[j].forEach(([idx, action]) => {
+        if (actions[idx] && actions[idx] !== action) {
+          anticommuting += 1
+        }
+      })
+      if (anticommuting % 2 === 1) {
+        return false
+      }
+    }
+  }
+  return true
+}
+
+/**
+ * A QubitOperator prepared with Simulator.prepareObservable for repeated
+ * calls of getExpectationValue.
+ */
+export class PreparedObservable {
+  // [[[index, 'X' | 'Y' | 'Z'], ...], coefficient] per term
+  terms: any[];
+  // qubits of the qureg the terms act on
+  numQubits: number;
+  // native Observable (see cppkernels/observable.hpp), if the C++ extension is available
+  native: any;
+
+  constructor(terms: any[], numQubits: number, native?: any) {
+    this.terms = terms
+    this.numQubits = numQubits
+    this.native = native
+  }
+
+  get numTerms(): number {
+    return this.terms.length
+  }
+}
+
 /**
  * @desc
 Simulator is a compiler engine which simulates a quantum computer using
@@ -46,17 +142,24 @@ export OMP_NUM_THREADS=4 # use 4 threads
 export OMP_PROC_BIND=spread # bind threads to processors by spreading
  */
 export class Simulator extends BasicEngine {
-  private _simulator: ISimulator;
+  protected _simulator: ISimulator;
   private _gate_fusion: boolean;
+  private _recording?: any[][];
   /**
   Construct the C++/JavaScript-simulator object and initialize it with a
   random seed.
 
-    @param gate_fusion If true, gates are cached and only executed
-once a certain gate-size has been reached (only has an effect
-for the c++ simulator).
+    @param gate_fusion If true, gates are cached in a lookahead window and
+executed as fused blocks; gates which commute (e.g. diagonal gates, or gates
+which only share controls) are reordered to pack the blocks (only has an
+effect for the c++ simulator).
     @param rnd_seed Random seed (uses random.randint(0, 4294967295) by default). Ignored currently!!!
     @param forceSimulation if true, will force use cpp simulator
+    @param splitLayout If true, the C++ simulator stores the state as separate
+real and imaginary planes while it applies fused gates, measures or computes
+probabilities, which makes the 3 to 5-qubit fused kernels considerably faster.
+Other operations convert the state back first (only has an effect for the
+c++ simulator).
 
 Example of gate_fusion Instead of applying a Hadamard gate to 5
 qubits, the simulator calculates the kronecker product of the 1-qubit
@@ -75,7 +178,8 @@ quantum algorithms.
 the docs which gives futher hints on how to build the C++
 extension.
    */
-  constructor(gate_fusion: boolean = false, rnd_seed?: number, forceSimulation: boolean = false) {
+  constructor(gate_fusion: boolean = false, rnd_seed?: number, forceSimulation: boolean = false,
+    splitLayout: boolean = false) {
     super()
     if (!rnd_seed) {
       rnd_seed = Math.random()
@@ -83,7 +187,7 @@ extension.
 
     if (!forceSimulation && CPPSimulatorBackend) {
       const S = CPPSimulatorBackend.Simulator
-      this._simulator = new S(rnd_seed)
+      this._simulator = new S(rnd_seed, splitLayout)
     } else {
       this._simulator = new SimulatorBackend(rnd_seed)
     }
@@ -93,8 +197,10 @@ extension.
   /**
   Specialized implementation of isAvailable: The simulator can deal
 with all arbitrarily-controlled gates which provide a
-gate-matrix (via gate.matrix) and acts on 5 or less qubits (not
-counting the control qubits).
+gate-matrix (via gate.matrix) and acts on 5 or less qubits (10 or less
+with the C++ extension, not counting the control qubits). With the C++ extension, QFT gates (and their
+inverses), uniformly controlled Ry / Rz gates, phase oracles and
+(uncontrolled) StatePreparation gates are simulated natively as well.
 
   @param cmd Command for which to check availability (single-qubit gate, arbitrary controls)
 
@@ -104,11 +210,24 @@ counting the control qubits).
     if (instanceOf(cmd.gate, [MeasureGate, AllocateQubitGate, DeallocateQubitGate, BasicMathGate, TimeEvolution])) {
       return true
     }
+    if (this._simulator.applyQFT && typeof qftDirection(cmd.gate) !== 'undefined') {
+      return true
+    }
+    if (this._simulator.applyUniformlyControlledRotation
+      && instanceOf(cmd.gate, [UniformlyControlledRy, UniformlyControlledRz])) {
+      return true
+    }
+    if (this._simulator.prepareState && cmd.gate instanceof StatePreparation && cmd.controlCount === 0) {
+      return true
+    }
+    if (this._simulator.applyPhaseOracle && cmd.gate instanceof PhaseOracle) {
+      return true
+    }
     try {
       const m = (cmd.gate as IMathGate).matrix;
-      // Allow up to 5-qubit gates
+      // Allow up to 5-qubit gates (10 with the generic C++ kernel)
       const [row, col] = m.size()
-      if (row > 2 ** 5 || col > 2 ** 5) return false
+      if (row > 2 ** this.maxGateQubits || col > 2 ** this.maxGateQubits) return false
       return true
     } catch (e) {
       return false
@@ -140,7 +259,7 @@ counting the control qubits).
   Get the expectation value of qubit_operator w.r.t. the current wave
 function represented by the supplied quantum register.
 
-    @param qubitOperator  Operator to measure.
+    @param qubitOperator  Operator to measure, or an operator prepared with prepareObservable.
     @param {Array.<Qubit>|Qureg} qureg  Quantum bits to measure.
 
     @return Expectation value
@@ -157,8 +276,18 @@ automatically converts from logical qubits to mapped qubits for
 
     @throws {Error} If `qubit_operator` acts on more qubits than present in the `qureg` argument.
    */
-  getExpectationValue(qubitOperator: IQubitOperator, qureg: IQureg): number {
+  getExpectationValue(qubitOperator: IQubitOperator | PreparedObservable, qureg: IQureg): number {
     qureg = this.convertLogicalToMappedQureg(qureg)
+    if (qubitOperator instanceof PreparedObservable) {
+      if (qubitOperator.numQubits > qureg.length) {
+        throw new Error('qubit_operator acts on more qubits than contained in the qureg.')
+      }
+      const ids = qureg.map(qb => qb.id)
+      if (qubitOperator.native && !(this._simulator instanceof SimulatorBackend)) {
+        return this._simulator.getExpectationValue(qubitOperator.native, ids)
+      }
+      return this._simulator.getExpectationValue(qubitOperator.terms, ids)
+    }
     const operator = []
     const num_qubits = qureg.length
     Object.keys(qubitOperator.terms).forEach((term) => {
@@ -171,6 +300,318 @@ automatically converts from logical qubits to mapped qubits for
     return this._simulator.getExpectationValue(operator, qureg.map(qb => qb.id))
   }
 
+  /**
+  Prepare qubitOperator for repeated calls of getExpectationValue, e.g. in a
+variational loop which measures the same Hamiltonian after every parameter
+update. The terms are converted once; with the C++ extension they are also
+parsed into bit masks grouped by the qubits they flip, which stay in native
+memory, so a query only sweeps the wave function.
+
+    @param qubitOperator Operator to measure.
+
+    @return Handle to pass to getExpectationValue instead of the operator.
+
+    Note:
+The handle refers to qubits by their position in the qureg passed to
+getExpectationValue, like the operator itself.
+   */
+  prepareObservable(qubitOperator: IQubitOperator): PreparedObservable {
+    const operator = []
+    let num_qubits = 0
+    Object.keys(qubitOperator.terms).forEach((term) => {
+      const keys = stringToArray(term)
+      if (term !== '') {
+        num_qubits = Math.max(num_qubits, keys[keys.length - 1][0] + 1)
+      }
+      operator.push([keys, qubitOperator.terms[term]])
+    })
+    let native
+    if (CPPSimulatorBackend && CPPSimulatorBackend.Observable) {
+      const O = CPPSimulatorBackend.Observable
+      native = new O(operator)
+    }
+    return new PreparedObservable(operator, num_qubits, native)
+  }
+
+  /**
+  Get the expectation value of qubitOperator w.r.t. the wave function
+obtained by applying `circuit` (with parameters `params`) to the current
+wave function, together with its partial derivatives with respect to all
+parameters.
+
+    The derivatives are computed natively by adjoint differentiation: one
+forward pass through the circuit and one backward pass with two state
+vectors, instead of two circuit evaluations per parameter as with the
+parameter-shift rule. The current wave function is not changed.
+
+    @param circuit Parametrized gate sequence.
+    @param params Parameter values (at least circuit.numParameters).
+    @param qubitOperator Operator to measure.
+    @param qureg Quantum bits the operator acts on.
+
+    @return {value, gradient}, where gradient[i] is the derivative with respect to params[i].
+
+    Note:
+Requires the C++ extension. Make sure all qubits of the circuit have been
+allocated (call main.flush()).
+   */
+  getExpectationGradient(circuit: ParametrizedCircuit, params: number[], qubitOperator: IQubitOperator,
+    qureg: IQureg): { value: number, gradient: number[] } {
+    if (!this._simulator.getExpectationGradient) {
+      throw new Error('getExpectationGradient requires the C++ extension.')
+    }
+    if (params.length < circuit.numParameters) {
+      throw new Error(`The circuit uses ${circuit.numParameters} parameters, but only ${params.length} were provided.`)
+    }
+    qureg = this.convertLogicalToMappedQureg(qureg)
+    const operator = []
+    const num_qubits = qureg.length
+    Object.keys(qubitOperator.terms).forEach((term) => {
+      const keys = stringToArray(term)
+      if (term !== '' && keys[keys.length - 1][0] >= num_qubits) {
+        throw new Error('qubit_operator acts on more qubits than contained in the qureg.')
+      }
+      operator.push([keys, qubitOperator.terms[term]])
+    })
+    return this._simulator.getExpectationGradient(this.mappedGates(circuit), params, operator, qureg.map(qb => qb.id))
+  }
+
+  /**
+  Compile a parametrized circuit for repeated execution with applyCompiled:
+the gates are grouped into fused blocks once and the block matrices are
+cached, so a replay only applies the blocks. Blocks with parametrized
+gates are fused again when their angles change.
+
+    @param circuit Gate sequence to compile.
+    @param params Parameter values to fuse the parametrized blocks with initially.
+
+    Note:
+Requires the C++ extension. The qubits are fixed at compile time, so
+compile after they have been allocated (call main.flush()).
+   */
+  compile(circuit: ParametrizedCircuit, params: number[] = []): CompiledCircuit {
+    if (!CPPSimulatorBackend || !CPPSimulatorBackend.CompiledCircuit || !this._simulator.applyCompiled) {
+      throw new Error('compile requires the C++ extension.')
+    }
+    const C = CPPSimulatorBackend.CompiledCircuit
+    return new CompiledCircuit(new C(this.mappedGates(circuit), params))
+  }
+
+  /**
+  Prepare the qubits of `qureg`, which must be in |0...0>, in the state with
+the given amplitudes (qureg[0] least significant), like a StatePreparation
+gate but without going through the compiler engines. Requires the C++
+extension.
+
+    @param qureg Quantum bits to prepare.
+    @param amplitudes 2^n real amplitudes, 2^n interleaved (re, im) pairs or an
+array of (complex) numbers. Must be normalized.
+
+    Note:
+Make sure all previous commands have passed through the compilation chain
+(call main.flush() to make sure).
+   */
+  prepareState(qureg: IQureg, amplitudes: Float64Array | any[]) {
+    if (!this._simulator.prepareState) {
+      throw new Error('prepareState requires the C++ extension.')
+    }
+    qureg = this.convertLogicalToMappedQureg(qureg)
+    this._simulator.prepareState(qureg.map(qb => qb.id), amplitudes)
+  }
+
+  /**
+  Set the gate fusion limits of the C++ simulator: once the lookahead window
+is full, fused blocks are applied if they act on at least `min` qubits, and
+gates are not fused beyond `max` qubits (1 <= min <= max <= 10; the defaults are 4 and 5). Blocks on more
+than 5 qubits use a generic dense kernel. Only has an effect with gate_fusion.
+
+    @param min Minimum number of qubits of an applied block.
+    @param max Maximum number of qubits of a fused block.
+   */
+  setFusionLimits(min: number, max: number) {
+    if (!this._simulator.setFusionLimits) {
+      throw new Error('setFusionLimits requires the C++ extension.')
+    }
+    this._simulator.setFusionLimits(min, max)
+  }
+
+  /**
+  Time the fused-gate kernels of each width on a scratch state of
+`numQubits` qubits and set the fusion limits to the width which needs the
+least time per qubit it covers on this host. The timings also decide how far
+the fusion planner widens a block. The scratch state counts against the
+scratch budget (see setScratchBudget).
+
+    @param numQubits Size of the scratch state (10 to 24 qubits).
+
+    @return the chosen limits [min, max]
+   */
+  autotuneFusion(numQubits: number = 20): number[] {
+    if (!this._simulator.autotuneFusion) {
+      throw new Error('autotuneFusion requires the C++ extension.')
+    }
+    return this._simulator.autotuneFusion(numQubits)
+  }
+
+  /**
+  Limit the scratch memory of the C++ simulator. Expectation values, qubit
+operators, time evolution and math emulation need temporary state vectors,
+which are kept and reused by later calls. An operation which would exceed the
+budget throws before it starts.
+
+    @param bytes Budget in bytes (no limit if omitted).
+   */
+  setScratchBudget(bytes?: number) {
+    if (!this._simulator.setScratchBudget) {
+      throw new Error('setScratchBudget requires the C++ extension.')
+    }
+    this._simulator.setScratchBudget(bytes)
+  }
+
+  /**
+  Free the scratch buffers the C++ simulator keeps for later calls.
+   */
+  releaseScratch() {
+    if (this._simulator.releaseScratch) {
+      this._simulator.releaseScratch()
+    }
+  }
+
+  /**
+  Set the dimension of the Krylov basis with which the C++ simulator emulates
+time evolutions of non-commuting terms (the default is 10). The basis takes
+`m + 1` scratch state vectors, or only 3 if the scratch budget does not hold
+`m + 1` of them, at the price of twice the applications of the Hamiltonian. A
+smaller `m` needs shorter (and more) steps.
+
+    @param m Krylov dimension (6 <= m <= 64).
+   */
+  setKrylovDim(m: number) {
+    if (!this._simulator.setKrylovDim) {
+      throw new Error('setKrylovDim requires the C++ extension.')
+    }
+    this._simulator.setKrylovDim(m)
+  }
+
+  /**
+  Set the state size above which the AVX kernels of the C++ simulator sweep
+with software prefetches (by default four times the last-level cache).
+
+    @param bytes State size in bytes; the default if undefined, no
+prefetches if Infinity.
+   */
+  setPrefetchThreshold(bytes?: number) {
+    if (!this._simulator.setPrefetchThreshold) {
+      throw new Error('setPrefetchThreshold requires the C++ extension.')
+    }
+    this._simulator.setPrefetchThreshold(bytes)
+  }
+
+  /**
+  Load a compiled circuit saved with CompiledCircuit.save.
+
+    @param path File name.
+
+    Note:
+The circuit refers to the (mapped) qubit ids of the job it was compiled
+in; allocate the same qubits before applying it.
+   */
+  loadCompiled(path: string): CompiledCircuit {
+    if (!CPPSimulatorBackend || !CPPSimulatorBackend.CompiledCircuit || !this._simulator.applyCompiled) {
+      throw new Error('loadCompiled requires the C++ extension.')
+    }
+    const C = CPPSimulatorBackend.CompiledCircuit
+    return new CompiledCircuit(new C(path))
+  }
+
+  /**
+  Record the commands handled from now on (gates and measurements, after
+all compiler engines) until stopRecording() is called. They are still
+simulated as usual.
+   */
+  startRecording() {
+    if (!CPPSimulatorBackend || !CPPSimulatorBackend.CompiledCircuit || !this._simulator.applyCompiled) {
+      throw new Error('startRecording requires the C++ extension.')
+    }
+    this._recording = []
+  }
+
+  /**
+  Stop recording and compile the recorded commands, e.g. to save them for
+later jobs (see CompiledCircuit.save).
+   */
+  stopRecording(): CompiledCircuit {
+    if (!this._recording) {
+      throw new Error('stopRecording called without startRecording.')
+    }
+    const C = CPPSimulatorBackend.CompiledCircuit
+    const compiled = new CompiledCircuit(new C(this._recording, []))
+    this._recording = undefined
+    return compiled
+  }
+
+  /**
+  Apply a compiled circuit to the current wave function.
+
+    @param compiled Circuit returned by compile() or loadCompiled().
+    @param params Parameter values (at least compiled.numParameters).
+    @param reset If true, start from the all-zero state instead of the current wave function.
+
+    @return The outcomes of the measurements of the circuit, in order.
+   */
+  applyCompiled(compiled: CompiledCircuit, params: number[] = [], reset: boolean = false): boolean[] {
+    const outcomes = this._simulator.applyCompiled(compiled.native, params, reset)
+    return outcomes.map(Boolean)
+  }
+
+  // largest gate (in qubits) applied as a matrix
+  private get maxGateQubits() {
+    return this._simulator.setFusionLimits ? 10 : 5
+  }
+
+  // adds the gate descriptor(s) of cmd to the recording
+  private record(cmd) {
+    const ids: number[] = []
+    cmd.qubits.forEach(qr => qr.forEach(qb => ids.push(qb.id)))
+    const ctrls = cmd.controlQubits.map(qb => qb.id)
+    if (cmd.gate instanceof TimeEvolution) {
+      const op = Object.keys(cmd.gate.hamiltonian.terms).map(k => [stringToArray(k), cmd.gate.hamiltonian.terms[k]])
+      if (!pauliTermsCommute(op.map(([term]) => term)) || ids.length > 5) {
+        throw new Error('Simulator: Only time evolutions of commuting terms on at most 5 qubits can be recorded.')
+      }
+      op.forEach(([term, coefficient]) => {
+        this._recording!.push([CircuitGateKind.Pauli, ids, ctrls, -1, cmd.gate.time * coefficient, term])
+      })
+    } else if (cmd.gate.equal(Measure)) {
+      this._recording!.push([CircuitGateKind.Measure, ids, [], -1, 0, []])
+    } else if (cmd.gate.equal(Allocate) || cmd.gate.equal(Deallocate)) {
+      // replays run on qubits which are already allocated
+    } else if (instanceOf(cmd.gate, [BasicMathGate, UniformlyControlledRy, UniformlyControlledRz, StatePreparation, PhaseOracle])
+      || typeof qftDirection(cmd.gate) !== 'undefined' || len(cmd.gate.matrix) > 2 ** 5) {
+      throw new Error(`Simulator: ${cmd.gate.toString()} cannot be recorded.`)
+    } else {
+      this._recording!.push([CircuitGateKind.Matrix, ids, ctrls, -1, 0, math.clone(cmd.gate.matrix)._data])
+    }
+  }
+
+  // gate descriptors of circuit with mapped qubit ids
+  private mappedGates(circuit: ParametrizedCircuit) {
+    const { mapper } = this.main
+    const mapped = (id: number) => {
+      if (!mapper) {
+        return id
+      }
+      const v = mapper.currentMapping![id]
+      if (typeof v === 'undefined') {
+        throw new Error(`Unknown qubit id. Please make sure you have called eng.flush().`);
+      }
+      return v
+    }
+    return circuit.gates.map(([kind, ids, ctrls, param, scale, payload]) => [
+      kind, ids.map(mapped), ctrls.map(mapped), param, scale, payload
+    ])
+  }
+
   /**
   Apply a (possibly non-unitary) qubit_operator to the current wave
 function represented by the supplied quantum register.
@@ -345,6 +786,9 @@ deallocation, and (controlled) single-qubit gate.
     @throws Error If a non-single-qubit gate needs to be processed (which should never happen due to isAvailable).
    */
   handle(cmd) {
+    if (this._recording) {
+      this.record(cmd)
+    }
     if (cmd.gate instanceof TimeEvolution) {
       const { terms } = cmd.gate.hamiltonian
       const op = []
@@ -355,7 +799,14 @@ deallocation, and (controlled) single-qubit gate.
       const t = cmd.gate.time
       const qubitids = cmd.qubits[0].map(qb => qb.id)
       const ctrlids = cmd.controlQubits.map(qb => qb.id)
-      this._simulator.emulateTimeEvolution(op, t, qubitids, ctrlids)
+      if (this._simulator.applyPauliRotation && pauliTermsCommute(op.map(([term]) => term))) {
+        // exp(-i t sum_k c_k P_k) = prod_k exp(-i t c_k P_k), one pass per term
+        op.forEach(([term, coefficient]) => {
+          this._simulator.applyPauliRotation(term, t * coefficient, qubitids, ctrlids)
+        })
+      } else {
+        this._simulator.emulateTimeEvolution(op, t, qubitids, ctrlids)
+      }
     } else if (cmd.gate.equal(Measure)) {
       assert(cmd.controlCount === 0)
       const ids = []
@@ -394,9 +845,36 @@ deallocation, and (controlled) single-qubit gate.
         })
       })
 
-      const math_fun = cmd.gate.getMathFunction(cmd.qubits)
-      this._simulator.emulateMath(math_fun, qubitids, cmd.controlQubits.map(qb => qb.id))
-    } else if (len(cmd.gate.matrix) <= 2 ** 5) {
+      const ctrlids = cmd.controlQubits.map(qb => qb.id)
+      const descriptor = nativeMathDescriptor(cmd.gate)
+      if (descriptor && this._simulator.emulateMathOperation) {
+        // evaluated natively, without calling back into JavaScript
+        this._simulator.emulateMathOperation(descriptor, qubitids, ctrlids)
+      } else {
+        const math_fun = cmd.gate.getMathFunction(cmd.qubits)
+        this._simulator.emulateMath(math_fun, qubitids, ctrlids)
+      }
+    } else if (this._simulator.applyQFT && typeof qftDirection(cmd.gate) !== 'undefined') {
+      // a single kernel call instead of the ~n^2/2 gates of the decomposition
+      const ids = cmd.qubits[0].map(qb => qb.id)
+      this._simulator.applyQFT(ids, cmd.controlQubits.map(qb => qb.id), qftDirection(cmd.gate))
+    } else if (this._simulator.applyUniformlyControlledRotation
+      && instanceOf(cmd.gate, [UniformlyControlledRy, UniformlyControlledRz])) {
+      // qubits: (controls, target); one pass instead of 2^#controls rotations
+      const axis = cmd.gate instanceof UniformlyControlledRy ? 'Y' : 'Z'
+      const ids = cmd.qubits[0].map(qb => qb.id)
+      const target = cmd.qubits[1][0].id
+      this._simulator.applyUniformlyControlledRotation(axis, cmd.gate.angles, ids, target, cmd.controlQubits.map(qb => qb.id))
+    } else if (this._simulator.prepareState && cmd.gate instanceof StatePreparation) {
+      // the qubits are in |0...0>, so the amplitudes are written directly
+      const ids: number[] = []
+      cmd.qubits.forEach(qr => qr.forEach(qb => ids.push(qb.id)))
+      this._simulator.prepareState(ids, cmd.gate.finalState)
+    } else if (this._simulator.applyPhaseOracle && cmd.gate instanceof PhaseOracle) {
+      const ids: number[] = []
+      cmd.qubits.forEach(qr => qr.forEach(qb => ids.push(qb.id)))
+      this._simulator.applyPhaseOracle(ids, cmd.gate.marked, cmd.controlQubits.map(qb => qb.id))
+    } else if (len(cmd.gate.matrix) <= 2 ** this.maxGateQubits) {
       const matrix = cmd.gate.matrix
       const ids = []
       cmd.qubits.forEach(qr => qr.forEach(qb => ids.push(qb.id)))
@@ -411,7 +889,7 @@ deallocation, and (controlled) single-qubit gate.
       }
     } else {
       throw new Error('This simulator only supports controlled k-qubit'
-        + ' gates with k < 6!\nPlease add an auto-replacer'
+        + ` gates with k <= ${this.maxGateQubits}!\nPlease add an auto-replacer`
         + ' engine to your list of compiler engines.')
     }
   }
@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import math from 'mathjs'
+import { BasicEngine } from '@/cengines/basics'
+import CPPSimulatorBackend from './cppsim'
+import {
+  Allocate,
+  AllocateQubitGate,
+  Deallocate,
+  DeallocateQubitGate,
+  FlushGate,
+  Measure,
+  MeasureGate
+} from '@/ops/gates'
+import { instanceOf } from '@/libs/util'
+import { len } from '@/libs/polyfill'
+import { ICommand, IMathGate } from '@/interfaces'
+
+/**
+ * @desc
+A gate of a PoolJob: `matrix` acts on the qubits `ids` (low bit first) if
+all `controls` are one. Qubits are numbered 0, ..., numQubits - 1.
+ */
+export interface PoolGate {
+  matrix: any[][];
+  ids: number[];
+  controls: number[];
+}
+
+/**
+ * @desc
+A small, self-contained circuit for the SimulatorPool.
+
+  After all gates have been applied, `shots` outcomes of the qubits
+`measure` are sampled (bit i of a sample is the outcome of measure[i]);
+with `probabilities` set, the probabilities of all 2^numQubits basis
+states are returned as well.
+ */
+export interface PoolJob {
+  numQubits: number;
+  gates: PoolGate[];
+  measure?: number[];
+  shots?: number;
+  probabilities?: boolean;
+}
+
+export interface PoolResult {
+  id: number;
+  samples: number[];
+  probabilities: number[];
+}
+
+/**
+ * @desc
+SimulatorPool runs many small, independent circuits concurrently in C++
+worker threads, one simulator per job (e.g. the circuits of a parameter
+sweep, of randomized benchmarking, or of a batch of shots with different
+noise realisations). Jobs are spread over the workers and idle workers
+steal queued jobs from busy ones, so throughput scales with the number of
+cores even when every job on its own is too small to parallelize.
+
+  Results are delivered as soon as their job completes, in completion
+order; submit() returns a promise per job and run() waits for a whole
+list.
+
+    @example
+
+const pool = new SimulatorPool()
+const results = await pool.run(angles.map(theta => ({
+  numQubits: 2,
+  gates: [
+    { matrix: [[Math.cos(theta), -Math.sin(theta)], [Math.sin(theta), Math.cos(theta)]], ids: [0], controls: [] },
+    { matrix: [[0, 1], [1, 0]], ids: [1], controls: [0] }
+  ],
+  measure: [0, 1],
+  shots: 1000
+})))
+
+  Note:
+The simulator pool requires the C++ extension; there is no Javascript
+fallback.
+ */
+export class SimulatorPool {
+  private _pool: any;
+
+  /**
+    @param numThreads Number of worker threads, 0 for one per core.
+    @param rnd_seed Random seed of the sampled outcomes; job i uses rnd_seed + i.
+   */
+  constructor(numThreads: number = 0, rnd_seed?: number) {
+    if (!CPPSimulatorBackend || !CPPSimulatorBackend.SimulatorPool) {
+      throw new Error('SimulatorPool requires the C++ extension.')
+    }
+    if (!rnd_seed) {
+      rnd_seed = Math.floor(Math.random() * 4294967295)
+    }
+    const P = CPPSimulatorBackend.SimulatorPool
+    this._pool = new P(numThreads, rnd_seed)
+  }
+
+  /**
+  Number of worker threads.
+   */
+  get numThreads(): number {
+    return this._pool.numThreads()
+  }
+
+  /**
+  Number of submitted jobs which have not been reported yet.
+   */
+  get pending(): number {
+    return this._pool.pending()
+  }
+
+  /**
+  Queue a job; the promise resolves with its result once it has been
+simulated, or rejects if the job is invalid (e.g., a qubit index out of
+range).
+   */
+  submit(job: PoolJob): Promise<PoolResult> {
+    const gates = job.gates.map(g => [g.matrix, g.ids, g.controls])
+    return new Promise((resolve, reject) => {
+      this._pool.submit(job.numQubits, gates, job.measure || [], job.shots || 0, Boolean(job.probabilities),
+        (err: Error | null, result: PoolResult) => {
+          if (err) {
+            reject(err)
+          } else {
+            resolve(result)
+          }
+        })
+    })
+  }
+
+  /**
+  Submit all jobs and wait for their results, which are returned in the
+order of `jobs`.
+   */
+  run(jobs: PoolJob[]): Promise<PoolResult[]> {
+    return Promise.all(jobs.map(job => this.submit(job)))
+  }
+}
+
+/**
+ * @desc
+PoolJobRecorder is a compiler engine which records the circuit sent to it as
+a PoolJob instead of simulating it, so jobs for the SimulatorPool can be
+written with the usual gate syntax. Qubits are numbered in the order of
+their allocation; measured qubits are collected in `measure`.
+
+    @example
+
+const recorder = new PoolJobRecorder()
+const eng = new MainEngine(recorder, [])
+...
+eng.flush()
+pool.submit(recorder.job(1000))
+ */
+export class PoolJobRecorder extends BasicEngine {
+  private _index: { [id: number]: number };
+  private _gates: PoolGate[];
+  private _measure: number[];
+
+  constructor() {
+    super()
+    this._index = {}
+    this._gates = []
+    this._measure = []
+  }
+
+  /**
+  The recorder accepts allocation, measurement and all gates with a matrix
+on at most ten qubits (controls excluded).
+   */
+  isAvailable(cmd: ICommand) {
+    if (instanceOf(cmd.gate, [MeasureGate, AllocateQubitGate, DeallocateQubitGate, FlushGate])) {
+      return true
+    }
+    try {
+      const m = (cmd.gate as IMathGate).matrix
+      return len(m) <= 2 ** 10
+    } catch (e) {
+      return false
+    }
+  }
+
+  /**
+  The recorded circuit.
+    @param shots Number of outcomes of the measured qubits to sample.
+    @param probabilities Whether to return all basis-state probabilities.
+   */
+  job(shots: number = 0, probabilities: boolean = false): PoolJob {
+    return {
+      numQubits: Object.keys(this._index).length,
+      gates: this._gates.slice(0),
+      measure: this._measure.slice(0),
+      shots,
+      probabilities
+    }
+  }
+
+  /**
+  Forget the recorded circuit (qubit numbering included).
+   */
+  reset() {
+    this._index = {}
+    this._gates = []
+    this._measure = []
+  }
+
+  private indexOf(id: number) {
+    const v = this._index[id]
+    if (typeof v === 'undefined') {
+      throw new Error(`PoolJobRecorder: Qubit ${id} has not been allocated.`)
+    }
+    return v
+  }
+
+  handle(cmd: ICommand) {
+    if (cmd.gate.equal(Allocate)) {
+      this._index[cmd.qubits[0][0].id] = Object.keys(this._index).length
+    } else if (cmd.gate.equal(Deallocate)) {
+      // the qubit keeps its index, jobs never reuse qubits
+    } else if (cmd.gate.equal(Measure)) {
+      cmd.qubits.forEach(qr => qr.forEach(qb => this._measure.push(this.indexOf(qb.id))))
+    } else {
+      const matrix = (cmd.gate as IMathGate).matrix
+      const ids: number[] = []
+      cmd.qubits.forEach(qr => qr.forEach(qb => ids.push(this.indexOf(qb.id))))
+      if (2 ** ids.length !== len(matrix)) {
+        throw new Error(`PoolJobRecorder: Error recording ${cmd.gate.toString()} gate: matrix size does not match the number of qubits.`)
+      }
+      this._gates.push({
+        matrix: (math.clone(matrix) as any)._data,
+        ids,
+        controls: cmd.controlQubits.map(qb => this.indexOf(qb.id))
+      })
+    }
+  }
+
+  receive(commandList: ICommand[]) {
+    commandList.forEach((cmd) => {
+      if (!(cmd.gate instanceof FlushGate)) {
+        this.handle(cmd)
+      }
+      if (!this.isLastEngine) {
+        this.send([cmd])
+      }
+    })
+  }
+}
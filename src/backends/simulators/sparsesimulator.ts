@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import CPPSimulatorBackend from './cppsim'
+import { Simulator } from './simulator'
+
+/**
+ * @desc
+SparseSimulator is a Simulator whose C++ kernels only store the nonzero
+amplitudes (in a hash table keyed by the basis state). Classical reversible
+logic and oracles leave most of the 2^n amplitudes at zero, so such
+circuits can be simulated on 40 and more qubits (at most 63).
+
+  Once the state fills in (more than 1/16 of the amplitudes are nonzero),
+it is moved to the dense kernels of the Simulator. Expectation values,
+qubit operators, state preparation and the QFT, oracle and rotation
+shortcuts work on the sparse state. Expectation gradients, cheat() and time
+evolution need a dense copy of the state and fail if there are too many
+qubits for it (more than 30).
+
+  Note:
+The sparse simulator requires the C++ extension; there is no Javascript
+fallback.
+ */
+export class SparseSimulator extends Simulator {
+  /**
+    @param rnd_seed Random seed of the measurement outcomes.
+   */
+  constructor(rnd_seed?: number) {
+    super(false, rnd_seed)
+    if (!CPPSimulatorBackend || !CPPSimulatorBackend.SparseSimulator) {
+      throw new Error('SparseSimulator requires the C++ extension.')
+    }
+    if (!rnd_seed) {
+      rnd_seed = Math.floor(Math.random() * 4294967295)
+    }
+    const S = CPPSimulatorBackend.SparseSimulator
+    this._simulator = new S(rnd_seed)
+  }
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import assert from 'assert'
+import { BasicEngine } from '@/cengines/basics'
+import CPPSimulatorBackend from './cppsim'
+import {
+  Allocate,
+  AllocateQubitGate,
+  Deallocate,
+  DeallocateQubitGate,
+  FlushGate,
+  HGate,
+  Measure,
+  MeasureGate,
+  SGate,
+  SwapGate,
+  XGate,
+  YGate,
+  ZGate
+} from '@/ops/gates'
+import { DaggeredGate } from '@/ops/metagates'
+import { BasicQubit } from '@/meta/qubit'
+import { LogicalQubitIDTag } from '@/meta/tag'
+import { instanceOf } from '@/libs/util'
+import { ICommand } from '@/interfaces'
+
+/**
+ * @desc
+Returns the name under which the native stabilizer simulator knows the
+Clifford gate of `cmd`, or undefined if `cmd` is not a Clifford operation it
+supports: X, Y, Z with at most one control, H, S, Sdag and Swap without
+controls.
+ */
+export function cliffordGateName(cmd: ICommand): string | undefined {
+  const { gate } = cmd
+  if (gate instanceof SwapGate) {
+    return cmd.controlCount === 0 ? 'Swap' : undefined
+  }
+  if (instanceOf(gate, [XGate, YGate, ZGate])) {
+    return cmd.controlCount <= 1 ? gate.toString() : undefined
+  }
+  if (cmd.controlCount > 0) {
+    return undefined
+  }
+  if (gate instanceof HGate) {
+    return 'H'
+  }
+  if (gate instanceof SGate) {
+    return 'S'
+  }
+  if (gate instanceof DaggeredGate && gate.gate instanceof SGate) {
+    return 'Sdag'
+  }
+  return undefined
+}
+
+/**
+ * @desc
+StabilizerSimulator is a compiler engine which simulates Clifford circuits
+with the C++ stabilizer tableau (CHP) kernel. Memory and time per gate grow
+with the number of qubits instead of the dimension of the state space, so
+circuits on thousands of qubits (e.g., error-correction codes) are cheap.
+
+  Only Clifford gates are available (see cliffordGateName), so put an
+auto-replacer in front of it for anything else.
+
+  Note:
+The stabilizer simulator requires the C++ extension; there is no
+Javascript fallback.
+ */
+export class StabilizerSimulator extends BasicEngine {
+  private _simulator: any;
+
+  /**
+    @param rnd_seed Random seed of the measurement outcomes.
+   */
+  constructor(rnd_seed?: number) {
+    super()
+    if (!CPPSimulatorBackend || !CPPSimulatorBackend.StabilizerSimulator) {
+      throw new Error('StabilizerSimulator requires the C++ extension.')
+    }
+    if (!rnd_seed) {
+      rnd_seed = Math.floor(Math.random() * 4294967295)
+    }
+    const S = CPPSimulatorBackend.StabilizerSimulator
+    this._simulator = new S(rnd_seed)
+  }
+
+  isAvailable(cmd: ICommand) {
+    if (instanceOf(cmd.gate, [MeasureGate, AllocateQubitGate, DeallocateQubitGate, FlushGate])) {
+      return true
+    }
+    return typeof cliffordGateName(cmd) !== 'undefined'
+  }
+
+  /**
+  Handle all commands, i.e., call the member functions of the C++-
+stabilizer object corresponding to measurement, allocation/
+deallocation, and (controlled) Clifford gates.
+
+    @throws Error If a non-Clifford gate needs to be processed (which should never happen due to isAvailable).
+   */
+  handle(cmd: ICommand) {
+    if (cmd.gate.equal(Measure)) {
+      assert(cmd.controlCount === 0)
+      const ids: number[] = []
+      cmd.qubits.forEach(qr => qr.forEach(qb => ids.push(qb.id)))
+      const out = this._simulator.measureQubits(ids)
+      let i = 0
+      cmd.qubits.forEach((qr) => {
+        qr.forEach((qb) => {
+          // Check if a mapper assigned a different logical id
+          let logical_id_tag: LogicalQubitIDTag | undefined
+          cmd.tags.forEach((tag) => {
+            if (tag instanceof LogicalQubitIDTag) {
+              logical_id_tag = tag
+            }
+          })
+          if (logical_id_tag) {
+            qb = new BasicQubit(qb.engine, (logical_id_tag as LogicalQubitIDTag).logicalQubitID)
+          }
+          this.main.setMeasurementResult!(qb, Boolean(out[i]))
+          i += 1
+        })
+      })
+    } else if (cmd.gate.equal(Allocate)) {
+      this._simulator.allocateQubit(cmd.qubits[0][0].id)
+    } else if (cmd.gate.equal(Deallocate)) {
+      this._simulator.deallocateQubit(cmd.qubits[0][0].id)
+    } else {
+      const name = cliffordGateName(cmd)
+      if (typeof name === 'undefined') {
+        throw new Error(`StabilizerSimulator: ${cmd.gate.toString()} is not a supported Clifford operation.`)
+      }
+      const ids: number[] = []
+      cmd.qubits.forEach(qr => qr.forEach(qb => ids.push(qb.id)))
+      this._simulator.applyControlledGate(name, ids, cmd.controlQubits.map(qb => qb.id))
+    }
+  }
+
+  receive(commandList: ICommand[]) {
+    commandList.forEach((cmd) => {
+      if (!(cmd.gate instanceof FlushGate)) {
+        this.handle(cmd)
+      }
+      if (!this.isLastEngine) {
+        this.send([cmd])
+      }
+    })
+  }
+}
@@ -0,0 +1,19 @@
+import { expect } from 'chai'
+import { PhaseOracle } from '@/ops'
+import { getInverse } from '@/ops/_cycle'
+
+describe('phase oracle test', () => {
+  it('should test fromPredicate', () => {
+    const gate = PhaseOracle.fromPredicate(4, x => x % 5 === 0)
+    // 0, 5, 10, 15
+    expect(Array.from(gate.marked)).to.deep.equal([0x21, 0x84])
+  })
+
+  it('should test equality and inverse', () => {
+    const gate1 = new PhaseOracle([1, 3])
+    expect(gate1.equal(new PhaseOracle([1, 3]))).to.equal(true)
+    expect(gate1.equal(new PhaseOracle([1, 2]))).to.equal(false)
+    expect(getInverse(gate1).equal(gate1)).to.equal(true)
+    expect(gate1.toString()).to.equal('PhaseOracle')
+  })
+})
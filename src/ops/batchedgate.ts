@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import { BasicGate } from './basics'
+import { IGate } from '@/interfaces'
+
+/**
+ * @desc
+Gate which applies a different gate to each state of a batched simulation
+(see BatchSimulator), typically the same rotation with one angle per
+point of a parameter sweep. All gates must act on the same qubits.
+
+    @example
+
+new BatchedGate(angles.map(theta => new Ry(theta))).or(qubit)
+ */
+export default class BatchedGate extends BasicGate {
+  gates: IGate[]
+
+  /**
+   * @param gates One gate per state of the batch
+   */
+  constructor(gates: IGate[]) {
+    super()
+    if (gates.length === 0) {
+      throw new Error('BatchedGate: At least one gate is required.')
+    }
+    this.gates = gates
+  }
+
+  getInverse() {
+    return new BatchedGate(this.gates.map(gate => gate.getInverse()))
+  }
+
+  equal(other: IGate): boolean {
+    if (other instanceof BatchedGate) {
+      return other.gates.length === this.gates.length
+        && other.gates.every((gate, i) => gate.equal(this.gates[i]))
+    }
+    return false
+  }
+
+  toString() {
+    return `Batched(${this.gates.map(gate => gate.toString()).join(', ')})`
+  }
+}
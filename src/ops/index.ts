@@ -26,6 +26,8 @@ export * from './qftgate'
 
 export { QFT } from './qftgate'
 
+export { default as BatchedGate } from './batchedgate'
+
 export * from './command'
 
 export {
@@ -46,4 +48,6 @@ export {
 
 export * from './statepreparation'
 
+export * from './phaseoracle'
+
 export { UniformlyControlledRy, UniformlyControlledRz } from './uniformly_controlled_rotation'
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2018 Isaac Phoenix (tearsofphoenix@icloud.com).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import { SelfInverseGate } from './basics'
+// @ts-ignore
+import deepEqual from 'deep-eql'
+import { IGate } from '@/interfaces';
+
+/**
+ * Phase oracle: flips the sign of the basis states in which the register
+ * has a marked value, e.g. the oracle of a Grover search.
+
+   Example:
+   ```js
+   qureg = eng.allocateQureg(3)
+   new PhaseOracle([5]).or(qureg)
+   ```
+   Note:
+   When the value of the register is written in binary notation, then
+   qureg[0] denotes the least significant bit. The marked values are given
+   as a list of values, as a truth table (a Uint8Array with one entry per
+   value) or as a packed bitmap (a Uint8Array with one bit per value, value
+   x in bit x & 7 of byte x >> 3, see PhaseOracle.fromPredicate).
+
+   The oracle is simulated natively by the C++ simulator; there is no
+   decomposition.
+ */
+export class PhaseOracle extends SelfInverseGate {
+  marked: number[] | Uint8Array;
+
+  /**
+   * @param marked Marked values, truth table or packed bitmap.
+   */
+  constructor(marked: number[] | Uint8Array) {
+    super()
+    this.marked = marked
+  }
+
+  /**
+   * Phase oracle of an n-qubit register marking the values x for which
+   * predicate(x) is true, as a packed bitmap.
+   */
+  static fromPredicate(n: number, predicate: (x: number) => boolean) {
+    const size = 2 ** n
+    const bitmap = new Uint8Array(Math.ceil(size / 8))
+    for (let x = 0; x < size; ++x) {
+      if (predicate(x)) {
+        bitmap[x >> 3] |= 1 << (x & 7)
+      }
+    }
+    return new PhaseOracle(bitmap)
+  }
+
+  toString() {
+    return 'PhaseOracle'
+  }
+
+  equal(other: IGate): boolean {
+    if (other instanceof PhaseOracle) {
+      return deepEqual(this.marked, other.marked)
+    }
+    return false
+  }
+}
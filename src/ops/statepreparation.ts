@@ -31,6 +31,13 @@ export class StatePreparation extends BasicGate {
     this._finalState = finalState
   }
 
+  /**
+   * Amplitudes of the desired state (numbers or complex numbers).
+   */
+  get finalState() {
+    return this._finalState
+  }
+
   toString() {
     return 'StatePreparation'
   }